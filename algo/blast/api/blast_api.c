@@ -47,6 +47,7 @@
 #include <algo/blast/core/hspfilter_collector.h>
 #include <algo/blast/api/hspfilter_queue.h>
 #include <algo/blast/core/phi_lookup.h>
+#include <algo/blast/core/blast_aalookup.h>
 #include <algo/blast/core/blast_psi.h>
 #include <algo/blast/api/blast_mtlock.h>
 #include <algo/blast/api/blast_prelim.h>
@@ -139,6 +140,14 @@ s_BlastRPSInfoInit(BlastRPSInfo **ppinfo, Nlm_MemMap **rps_mmap,
       }
    }
 
+   /* Both files are mapped read-only and used in place, so concurrent
+      searches share one copy of them in the page cache.  The lookup
+      table backbone is read in full when the search starts, while only
+      the profiles that a query hits are ever touched; read-ahead is
+      wasted on the latter. */
+   Nlm_MemMapAdvisePtr(lut_mmap, eMMA_WillNeed);
+   Nlm_MemMapAdvisePtr(pssm_mmap, eMMA_Random);
+
    num_db_seqs = info->profile_header->num_profiles;
 
    sprintf(filename, "%s.aux", (char *)pathname);
@@ -296,7 +305,10 @@ s_BlastHSPStreamSetUp(BLAST_SequenceBlk* query, BlastQueryInfo* query_info,
             BlastHSPStreamRegisterMTLock(*hsp_stream, lock);
         }
     } else {
-        writer_info = BlastHSPQueueInfoNew(BlastHSPQueueParamsNew());
+        /* The queue can only be bounded if the formatting thread reads
+           it while the search is running. */
+        writer_info = BlastHSPQueueInfoNew(BlastHSPQueueParamsNew(
+                          NlmThreadsAvailable() ? BLAST_HSP_QUEUE_MAX_SIZE : 0));
         *hsp_stream = BlastHSPStreamNew(
                                        options->program,
                                        options->ext_options,
@@ -308,10 +320,49 @@ s_BlastHSPStreamSetUp(BLAST_SequenceBlk* query, BlastQueryInfo* query_info,
                            options->score_options, sbp, options->eff_len_options,
                            options->ext_options, options->hit_options, 
                            options->db_options);
+        tf_data->num_threads = options->num_cpus;
     }
     return status;
 }
 
+/** Runs the preliminary search on options->num_cpus threads, all writing to
+ * the same HSP stream. 
+ * @param eff_len_options Effective lengths options to use instead of the
+ *                        ones in the options wrapper [in]
+ */
+static void
+s_BlastPrelimSearchThreads(BLAST_SequenceBlk* query, BlastQueryInfo* query_info,
+                           const BlastSeqSrc* seq_src, 
+                           const SBlastOptions* options, 
+                           const BlastEffectiveLengthsOptions* eff_len_options,
+                           LookupTableWrap* lookup_wrap, BlastScoreBlk* sbp, 
+                           BlastDiagnostics* diagnostics, 
+                           BlastHSPStream* hsp_stream)
+{
+    const int kNumCpus = options->num_cpus;
+    TNlmThread* thread_array =
+        (TNlmThread*) calloc(kNumCpus, sizeof(TNlmThread));
+    BlastPrelimSearchThreadData* search_data = NULL;
+    void* join_status = NULL;
+    int index;
+
+    for (index = 0; index < kNumCpus; index++) {
+        search_data = 
+            BlastPrelimSearchThreadDataInit(options->program, query, 
+                query_info, seq_src, lookup_wrap, options->score_options, 
+                options->word_options, options->ext_options, 
+                options->hit_options, eff_len_options, options->psi_options,
+                options->db_options, sbp, diagnostics, hsp_stream);
+
+        thread_array[index] =
+           NlmThreadCreate(Blast_PrelimSearchThreadRun, (void*) search_data);
+    }
+    for (index = 0; index < kNumCpus; index++)
+        NlmThreadJoin(thread_array[index], &join_status);
+
+    MemFree(thread_array);
+}
+
 /** Starts and joins all threads performing a multi-threaded search, with or 
  * without on-the-fly output, or performs a single-threaded search.
  */
@@ -357,29 +408,11 @@ s_BlastThreadManager(BLAST_SequenceBlk* query, BlastQueryInfo* query_info,
     }
 
     if (NlmThreadsAvailable() && kNumCpus > 1) {
-        TNlmThread* thread_array =
-            (TNlmThread*) calloc(kNumCpus, sizeof(TNlmThread));
-        BlastPrelimSearchThreadData* search_data = NULL;
-        void* join_status = NULL;
-        int index;
-        
         diagnostics = Blast_DiagnosticsInitMT(Blast_MT_LOCKInit());
 
-        for (index = 0; index < kNumCpus; index++) {
-            search_data = 
-                BlastPrelimSearchThreadDataInit(kProgram, query, 
-                    query_info, seq_src, lookup_wrap, score_options, 
-                    word_options, ext_options, hit_options, eff_len_options, 
-                    psi_options, db_options, sbp, diagnostics, hsp_stream);
-
-            thread_array[index] =
-               NlmThreadCreate(Blast_PrelimSearchThreadRun, 
-                               (void*) search_data);
-        }
-        for (index = 0; index < kNumCpus; index++)
-            NlmThreadJoin(thread_array[index], &join_status);
-  
-        MemFree(thread_array);
+        s_BlastPrelimSearchThreads(query, query_info, seq_src, options,
+                                   eff_len_options, lookup_wrap, sbp, 
+                                   diagnostics, hsp_stream);
         
         if (!tf_data) {
             SPHIPatternSearchBlk* pattern_blk = NULL;
@@ -389,11 +422,11 @@ s_BlastThreadManager(BLAST_SequenceBlk* query, BlastQueryInfo* query_info,
                                 (Int4)diagnostics->ungapped_stat->lookup_hits;
             }
 
-            if ((status = Blast_RunTracebackSearch(kProgram, query, 
+            if ((status = Blast_RunTracebackSearchMT(kProgram, query, 
                              query_info, seq_src, score_options, 
                              ext_options, hit_options, eff_len_options, 
                              db_options, psi_options, sbp, hsp_stream, 
-                             rps_info, pattern_blk, results)) != 0) {
+                             rps_info, pattern_blk, results, kNumCpus)) != 0) {
                 SBlastMessageWrite(&extra_returns->error, SEV_ERROR,
                                    "Traceback engine failed\n", NULL, options->believe_query);
             }
@@ -440,6 +473,629 @@ s_BlastThreadManager(BLAST_SequenceBlk* query, BlastQueryInfo* query_info,
     return status;
 }
 
+/** Concatenated blastn queries longer than this are searched in overlapping
+ * chunks of this size, so that the lookup table and the other structures of
+ * the preliminary search do not grow with the length of the query.
+ */
+#ifndef BLAST_SPLIT_QUERY_CHUNK_SIZE
+#define BLAST_SPLIT_QUERY_CHUNK_SIZE 1000000
+#endif
+
+/** Number of bases shared by adjacent query chunks. HSPs found in the shared
+ * strip by both chunks are merged before the traceback.
+ */
+#ifndef BLAST_SPLIT_QUERY_OVERLAP
+#define BLAST_SPLIT_QUERY_OVERLAP 10000
+#endif
+
+/** Length of a nucleotide query, i.e. the length of whichever strand of it 
+ * is searched.
+ * @param query_info Query information structure [in]
+ * @param query_index Index of the query [in]
+ */
+static Int4
+s_BlastnQueryLength(const BlastQueryInfo* query_info, Int4 query_index)
+{
+    return MAX(query_info->contexts[NUM_STRANDS*query_index].query_length,
+               query_info->contexts[NUM_STRANDS*query_index+1].query_length);
+}
+
+/** Decides whether a set of blastn queries should be split, and if so, lays
+ * the queries end to end and cuts them into overlapping chunks. Each query
+ * that reaches into a chunk contributes both its strands to that chunk; the
+ * piece of the minus strand is the reverse complement of the piece of the 
+ * plus strand.
+ * @param query_info Query information for the unsplit queries [in]
+ * @param gapped_merge TRUE if HSPs from adjacent chunks may be merged across
+ *                     a gap [in]
+ * @param query_starts Start of each query on the line of all queries, 
+ *                     allocated here if the queries are split [out]
+ * @return The split query structure, or NULL if the queries are short enough
+ *         to be searched at once.
+ */
+static SSplitQueryBlk*
+s_BlastSplitQueryBlkNew(const BlastQueryInfo* query_info, Boolean gapped_merge,
+                        Int4** query_starts)
+{
+    const Int4 kChunkSize = BLAST_SPLIT_QUERY_CHUNK_SIZE;
+    const Int4 kOverlap = BLAST_SPLIT_QUERY_OVERLAP;
+    const Int4 kStep = kChunkSize - kOverlap;
+    SSplitQueryBlk* squery_blk = NULL;
+    Int4* starts = NULL;
+    Int4 total_length = 0;
+    Int4 query_index, first_query = 0;
+    Uint4 num_chunks, chunk;
+
+    ASSERT(kStep > 0);
+    *query_starts = NULL;
+
+    for (query_index = 0; query_index < query_info->num_queries; 
+         query_index++) {
+        total_length += s_BlastnQueryLength(query_info, query_index);
+    }
+    if (total_length <= kChunkSize)
+        return NULL;
+
+    starts = (Int4*) malloc(query_info->num_queries * sizeof(Int4));
+    num_chunks = 1 + (total_length - kChunkSize + kStep - 1) / kStep;
+    squery_blk = SplitQueryBlkNew(num_chunks, gapped_merge);
+    if (!starts || !squery_blk) {
+        sfree(starts);
+        return SplitQueryBlkFree(squery_blk);
+    }
+    SplitQueryBlk_SetChunkOverlapSize(squery_blk, kOverlap);
+
+    starts[0] = 0;
+    for (query_index = 1; query_index < query_info->num_queries; 
+         query_index++) {
+        starts[query_index] = starts[query_index-1] + 
+            s_BlastnQueryLength(query_info, query_index-1);
+    }
+
+    for (chunk = 0; chunk < num_chunks; chunk++) {
+        const Int4 kChunkStart = chunk * kStep;
+        const Int4 kChunkEnd = MIN(kChunkStart + kChunkSize, total_length);
+
+        SplitQueryBlk_SetChunkBounds(squery_blk, chunk, kChunkStart, 
+                                     kChunkEnd);
+
+        /* Chunks advance along the line, so queries that end before this
+           chunk will not be seen again */
+        while (first_query < query_info->num_queries &&
+               starts[first_query] + 
+               s_BlastnQueryLength(query_info, first_query) <= kChunkStart)
+            first_query++;
+
+        for (query_index = first_query; 
+             query_index < query_info->num_queries && 
+             starts[query_index] < kChunkEnd; query_index++) {
+            const Int4 kLength = s_BlastnQueryLength(query_info, query_index);
+            const Int4 kFrom = 
+                MAX(kChunkStart, starts[query_index]) - starts[query_index];
+            const Int4 kTo = MIN(kChunkEnd, starts[query_index] + kLength) -
+                starts[query_index];
+            Int4 strand;
+
+            SplitQueryBlk_AddQueryToChunk(squery_blk, query_index, chunk);
+            for (strand = 0; strand < NUM_STRANDS; strand++) {
+                Int4 context = NUM_STRANDS*query_index + strand;
+
+                if (query_info->contexts[context].query_length == 0) {
+                    SplitQueryBlk_AddContextToChunk(squery_blk, 
+                                                    kInvalidContext, chunk);
+                    SplitQueryBlk_AddContextOffsetToChunk(squery_blk, 0, chunk);
+                } else {
+                    SplitQueryBlk_AddContextToChunk(squery_blk, context, chunk);
+                    SplitQueryBlk_AddContextOffsetToChunk(squery_blk, 
+                        (strand == 0 ? kFrom : kLength - kTo), chunk);
+                }
+            }
+        }
+    }
+
+    *query_starts = starts;
+    return squery_blk;
+}
+
+/** Copies the pieces of the unsplit query that make up one chunk, with a 
+ * sentinel byte around each context.
+ * @param buffer Chunk sequence buffer, including the leading sentinel [out]
+ * @param sequence Unsplit query sequence, without the leading sentinel [in]
+ * @param sentinel Value of the sentinel byte [in]
+ * @param query_info Query information for the unsplit query [in]
+ * @param chunk_info Query information for the chunk [in]
+ * @param context_list Unsplit query context of each chunk context [in]
+ * @param offset_list Start of each chunk context in its unsplit context [in]
+ */
+static void
+s_BlastQueryChunkCopy(Uint1* buffer, const Uint1* sequence, Uint1 sentinel,
+                      const BlastQueryInfo* query_info, 
+                      const BlastQueryInfo* chunk_info, 
+                      const Int4* context_list, const Uint4* offset_list)
+{
+    Int4 index;
+
+    buffer[0] = sentinel;
+    for (index = 0; index <= chunk_info->last_context; index++) {
+        const BlastContextInfo* kContext = &chunk_info->contexts[index];
+        Uint1* dest = buffer + 1 + kContext->query_offset;
+
+        if (kContext->query_length > 0) {
+            memcpy(dest, sequence + 
+                   query_info->contexts[context_list[index]].query_offset +
+                   offset_list[index], kContext->query_length);
+        }
+        dest[kContext->query_length] = sentinel;
+    }
+}
+
+/** Sets up the query, query information and lookup table segments of one 
+ * chunk of a split query.
+ * @param query Unsplit query [in]
+ * @param query_info Query information for the unsplit query [in]
+ * @param lookup_segments Unmasked ranges of the unsplit query [in]
+ * @param query_starts Start of each query on the line of all queries [in]
+ * @param squery_blk Split query structure [in]
+ * @param chunk Index of the chunk [in]
+ * @param chunk_query Query of the chunk [out]
+ * @param chunk_info Query information for the chunk [out]
+ * @param chunk_segments Unmasked ranges of the chunk query [out]
+ * @param chunk_contexts Unsplit query context of each chunk context [out]
+ */
+static Int2
+s_BlastQueryChunkSetUp(const BLAST_SequenceBlk* query, 
+                       const BlastQueryInfo* query_info,
+                       const BlastSeqLoc* lookup_segments,
+                       const Int4* query_starts, 
+                       const SSplitQueryBlk* squery_blk, Uint4 chunk,
+                       BLAST_SequenceBlk** chunk_query,
+                       BlastQueryInfo** chunk_info,
+                       BlastSeqLoc** chunk_segments, Int4** chunk_contexts)
+{
+    Uint4* query_list = NULL;
+    Int4* context_list = NULL;
+    Uint4* offset_list = NULL;
+    Uint4 num_contexts = 0;
+    size_t num_queries = 0, chunk_start = 0, chunk_end = 0;
+    BlastQueryInfo* info = NULL;
+    Uint1* buffer = NULL;
+    Int4 index, offset = 0;
+    const Uint1 kSentinel = query->sequence_start[0];
+
+    SplitQueryBlk_GetChunkBounds(squery_blk, chunk, &chunk_start, &chunk_end);
+    SplitQueryBlk_GetNumQueriesForChunk(squery_blk, chunk, &num_queries);
+    if (SplitQueryBlk_GetQueryIndicesForChunk(squery_blk, chunk, 
+                                              &query_list) ||
+        SplitQueryBlk_GetQueryContextsForChunk(squery_blk, chunk, 
+                                               &context_list, &num_contexts) ||
+        SplitQueryBlk_GetContextOffsetsForChunk(squery_blk, chunk, 
+                                                &offset_list) ||
+        (info = BlastQueryInfoNew(eBlastTypeBlastn, (int)num_queries)) 
+        == NULL) {
+        sfree(query_list);
+        sfree(context_list);
+        sfree(offset_list);
+        return BLASTERR_MEMORY;
+    }
+    ASSERT(num_contexts == (Uint4)(info->last_context + 1));
+
+    for (index = 0; index <= info->last_context; index++) {
+        BlastContextInfo* context = &info->contexts[index];
+        const Int4 kQuery = query_list[index / NUM_STRANDS];
+        const Int4 kStart = query_starts[kQuery];
+
+        context->query_offset = offset;
+        if (context_list[index] == kInvalidContext) {
+            context->query_length = 0;
+            context->is_valid = FALSE;
+        } else {
+            context->query_length = 
+                MIN((Int4)chunk_end, 
+                    kStart + s_BlastnQueryLength(query_info, kQuery)) -
+                MAX((Int4)chunk_start, kStart);
+            context->is_valid = 
+                query_info->contexts[context_list[index]].is_valid;
+            info->max_length = 
+                MAX(info->max_length, (Uint4)context->query_length);
+        }
+        offset += context->query_length + 1;
+    }
+
+    /* The buffer holds a sentinel before every context and one at the end */
+    buffer = (Uint1*) malloc(offset + 1);
+    if (buffer == NULL || BlastSeqBlkNew(chunk_query) != 0) {
+        sfree(buffer);
+        sfree(query_list);
+        sfree(context_list);
+        sfree(offset_list);
+        BlastQueryInfoFree(info);
+        return BLASTERR_MEMORY;
+    }
+    s_BlastQueryChunkCopy(buffer, query->sequence, kSentinel, query_info, 
+                          info, context_list, offset_list);
+    BlastSeqBlkSetSequence(*chunk_query, buffer, offset - 1);
+
+    if (query->nomask_allocated) {
+        buffer = (Uint1*) malloc(offset + 1);
+        if (buffer == NULL) {
+            *chunk_query = BlastSequenceBlkFree(*chunk_query);
+            sfree(query_list);
+            sfree(context_list);
+            sfree(offset_list);
+            BlastQueryInfoFree(info);
+            return BLASTERR_MEMORY;
+        }
+        s_BlastQueryChunkCopy(buffer, query->sequence_nomask, kSentinel, 
+                              query_info, info, context_list, offset_list);
+        (*chunk_query)->sequence_start_nomask = buffer;
+        (*chunk_query)->sequence_nomask = buffer + 1;
+        (*chunk_query)->nomask_allocated = TRUE;
+    }
+
+    /* Clip the unmasked ranges to each piece and shift them to the chunk */
+    *chunk_segments = NULL;
+    for (index = 0; index <= info->last_context; index++) {
+        const BlastSeqLoc* loc;
+        Int4 from, to;
+
+        if (info->contexts[index].query_length == 0)
+            continue;
+        from = query_info->contexts[context_list[index]].query_offset +
+            offset_list[index];
+        to = from + info->contexts[index].query_length - 1;
+
+        for (loc = lookup_segments; loc; loc = loc->next) {
+            const Int4 kLeft = MAX(loc->ssr->left, from);
+            const Int4 kRight = MIN(loc->ssr->right, to);
+            if (kLeft <= kRight) {
+                BlastSeqLocNew(chunk_segments, 
+                    kLeft - from + info->contexts[index].query_offset,
+                    kRight - from + info->contexts[index].query_offset);
+            }
+        }
+    }
+
+    sfree(query_list);
+    sfree(offset_list);
+    *chunk_info = info;
+    *chunk_contexts = context_list;
+    return 0;
+}
+
+/** Finds the Karlin block array of a chunk score block that corresponds to
+ * one of the arrays of the unsplit score block.
+ * @param sbp Score block of the unsplit query [in]
+ * @param chunk_sbp Score block of the chunk [in]
+ * @param kbp Array of the unsplit score block, e.g. its kbp alias [in]
+ */
+static Blast_KarlinBlk**
+s_BlastChunkKarlinBlkAlias(const BlastScoreBlk* sbp, 
+                           const BlastScoreBlk* chunk_sbp, 
+                           Blast_KarlinBlk** kbp)
+{
+    if (kbp == NULL)
+        return NULL;
+    else if (kbp == sbp->kbp_std)
+        return chunk_sbp->kbp_std;
+    else if (kbp == sbp->kbp_gap_std)
+        return chunk_sbp->kbp_gap_std;
+    else if (kbp == sbp->kbp_psi)
+        return chunk_sbp->kbp_psi;
+    else if (kbp == sbp->kbp_gap_psi)
+        return chunk_sbp->kbp_gap_psi;
+    return NULL;
+}
+
+/** Makes a score block for a chunk of a split query. The statistical 
+ * parameters of every chunk context are those of the unsplit context it was
+ * cut from; only the arrays holding them are allocated.
+ * @param sbp Score block of the unsplit query [in]
+ * @param context_list Unsplit query context of each chunk context [in]
+ * @param num_contexts Number of chunk contexts [in]
+ * @return The new score block, to be freed with s_BlastChunkScoreBlkFree
+ */
+static BlastScoreBlk*
+s_BlastChunkScoreBlkNew(const BlastScoreBlk* sbp, const Int4* context_list,
+                        Int4 num_contexts)
+{
+    BlastScoreBlk* retval = 
+        (BlastScoreBlk*) BlastMemDup(sbp, sizeof(BlastScoreBlk));
+    Int4 index;
+
+    retval->number_of_contexts = num_contexts;
+    retval->sfp = (Blast_ScoreFreq**) 
+        calloc(num_contexts, sizeof(Blast_ScoreFreq*));
+    retval->kbp_std = (Blast_KarlinBlk**) 
+        calloc(num_contexts, sizeof(Blast_KarlinBlk*));
+    retval->kbp_gap_std = (Blast_KarlinBlk**) 
+        calloc(num_contexts, sizeof(Blast_KarlinBlk*));
+    retval->kbp_psi = (Blast_KarlinBlk**) 
+        calloc(num_contexts, sizeof(Blast_KarlinBlk*));
+    retval->kbp_gap_psi = (Blast_KarlinBlk**) 
+        calloc(num_contexts, sizeof(Blast_KarlinBlk*));
+
+    for (index = 0; index < num_contexts; index++) {
+        const Int4 kContext = context_list[index];
+        if (kContext == kInvalidContext)
+            continue;
+        if (sbp->sfp)
+            retval->sfp[index] = sbp->sfp[kContext];
+        if (sbp->kbp_std)
+            retval->kbp_std[index] = sbp->kbp_std[kContext];
+        if (sbp->kbp_gap_std)
+            retval->kbp_gap_std[index] = sbp->kbp_gap_std[kContext];
+        if (sbp->kbp_psi)
+            retval->kbp_psi[index] = sbp->kbp_psi[kContext];
+        if (sbp->kbp_gap_psi)
+            retval->kbp_gap_psi[index] = sbp->kbp_gap_psi[kContext];
+    }
+    retval->kbp = s_BlastChunkKarlinBlkAlias(sbp, retval, sbp->kbp);
+    retval->kbp_gap = s_BlastChunkKarlinBlkAlias(sbp, retval, sbp->kbp_gap);
+    return retval;
+}
+
+/** Frees a score block made by s_BlastChunkScoreBlkNew, leaving the shared
+ * parameters alone.
+ * @param sbp Score block to free [in]
+ * @return NULL
+ */
+static BlastScoreBlk*
+s_BlastChunkScoreBlkFree(BlastScoreBlk* sbp)
+{
+    if (sbp) {
+        sfree(sbp->sfp);
+        sfree(sbp->kbp_std);
+        sfree(sbp->kbp_gap_std);
+        sfree(sbp->kbp_psi);
+        sfree(sbp->kbp_gap_psi);
+        sfree(sbp);
+    }
+    return NULL;
+}
+
+/** Compares two subject ordinal ids, for qsort.
+ * @param a first ordinal id [in]
+ * @param b second ordinal id [in]
+ */
+static int
+s_OidCompare(const void* a, const void* b)
+{
+    const Int4 kOid1 = *(const Int4*) a;
+    const Int4 kOid2 = *(const Int4*) b;
+
+    return (kOid1 < kOid2 ? -1 : (kOid1 > kOid2 ? 1 : 0));
+}
+
+/** Counts the distinct subject sequences with HSPs saved in a stream. A 
+ * subject found by several query chunks has a single HSP list per query once
+ * the chunks are merged, and is counted only once here.
+ * @param hsp_stream Stream holding the merged preliminary results [in]
+ * @return number of subjects, or -1 if memory could not be allocated
+ */
+static Int4
+s_BlastHSPStreamCountSubjects(const BlastHSPStream* hsp_stream)
+{
+    const BlastHSPResults* results = hsp_stream->results;
+    Int4* oids = NULL;
+    Int4 num_oids = 0, num_subjects = 0;
+    Int4 query_index, index;
+
+    if (!results)
+        return 0;
+
+    for (query_index = 0; query_index < results->num_queries; query_index++) {
+        if (results->hitlist_array[query_index])
+            num_oids += results->hitlist_array[query_index]->hsplist_count;
+    }
+    if (num_oids == 0)
+        return 0;
+
+    if ((oids = (Int4*) malloc(num_oids * sizeof(Int4))) == NULL)
+        return -1;
+
+    num_oids = 0;
+    for (query_index = 0; query_index < results->num_queries; query_index++) {
+        const BlastHitList* hitlist = results->hitlist_array[query_index];
+        if (!hitlist)
+            continue;
+        for (index = 0; index < hitlist->hsplist_count; index++)
+            oids[num_oids++] = hitlist->hsplist_array[index]->oid;
+    }
+
+    qsort(oids, num_oids, sizeof(Int4), s_OidCompare);
+    for (index = 0; index < num_oids; index++) {
+        if (index == 0 || oids[index] != oids[index-1])
+            num_subjects++;
+    }
+    sfree(oids);
+
+    return num_subjects;
+}
+
+/** Searches a long blastn query one chunk at a time. The preliminary search
+ * of each chunk is done with its own lookup table and merged into a single 
+ * HSP stream for the unsplit query, which then goes through the traceback as
+ * if the query had been searched at once. Every chunk is searched with the 
+ * effective search spaces of the unsplit query, so the cutoff scores do not 
+ * depend on the splitting.
+ */
+static Int2
+s_BlastSplitQueryManager(BLAST_SequenceBlk* query, BlastQueryInfo* query_info,
+                         const BlastSeqLoc* lookup_segments, 
+                         SSplitQueryBlk* squery_blk, const Int4* query_starts,
+                         const BlastSeqSrc* seq_src, 
+                         const SBlastOptions* options, BlastScoreBlk* sbp, 
+                         BlastHSPResults **results,
+                         Blast_SummaryReturn* extra_returns)
+{
+    Int2 status = 0;
+    const EBlastProgramType kProgram = options->program;
+    const int kNumCpus = options->num_cpus;
+    const Boolean kMultiThreaded = (NlmThreadsAvailable() && kNumCpus > 1);
+    const BlastEffectiveLengthsOptions* eff_len_options = 
+        options->eff_len_options;
+    BlastScoringParameters* score_params = NULL;
+    BlastExtensionParameters* ext_params = NULL;
+    BlastHitSavingParameters* hit_params = NULL;
+    BlastEffectiveLengthsParameters* eff_len_params = NULL;
+    BlastGapAlignStruct* gap_align = NULL;
+    BlastHSPStream* hsp_stream = NULL;
+    BlastDiagnostics* diagnostics = NULL;
+    Uint4 chunk;
+
+    /* Fill in the effective lengths of the unsplit query */
+    if ((status = 
+         BLAST_GapAlignSetUp(kProgram, seq_src, options->score_options, 
+                             eff_len_options, options->ext_options, 
+                             options->hit_options, query_info, sbp, 
+                             &score_params, &ext_params, &hit_params, 
+                             &eff_len_params, &gap_align)) != 0)
+        return status;
+    gap_align->sbp = NULL;
+    gap_align = BLAST_GapAlignStructFree(gap_align);
+    score_params = BlastScoringParametersFree(score_params);
+    hit_params = BlastHitSavingParametersFree(hit_params);
+    ext_params = BlastExtensionParametersFree(ext_params);
+    eff_len_params = BlastEffectiveLengthsParametersFree(eff_len_params);
+
+    if ((status = s_BlastHSPStreamSetUp(query, query_info, seq_src, options, 
+                                        sbp, NULL, &hsp_stream, 
+                                        extra_returns)) != 0)
+        return status;
+
+    diagnostics = (kMultiThreaded ? 
+                   Blast_DiagnosticsInitMT(Blast_MT_LOCKInit()) : 
+                   Blast_DiagnosticsInit());
+
+    for (chunk = 0; chunk < squery_blk->num_chunks && !status; chunk++) {
+        BLAST_SequenceBlk* chunk_query = NULL;
+        BlastQueryInfo* chunk_info = NULL;
+        BlastSeqLoc* chunk_segments = NULL;
+        Int4* chunk_contexts = NULL;
+        Int8* searchsp_eff = NULL;
+        Int4 num_contexts, index;
+        BlastEffectiveLengthsOptions* chunk_eff_len_options = NULL;
+        BlastScoreBlk* chunk_sbp = NULL;
+        LookupTableWrap* lookup_wrap = NULL;
+        BlastHSPStream* chunk_stream = NULL;
+        Blast_Message* core_msg = NULL;
+
+        if ((status = 
+             s_BlastQueryChunkSetUp(query, query_info, lookup_segments, 
+                                    query_starts, squery_blk, chunk, 
+                                    &chunk_query, &chunk_info, 
+                                    &chunk_segments, &chunk_contexts)) != 0)
+            break;
+        num_contexts = chunk_info->last_context + 1;
+
+        searchsp_eff = (Int8*) calloc(num_contexts, sizeof(Int8));
+        for (index = 0; index < num_contexts; index++) {
+            if (chunk_contexts[index] != kInvalidContext) {
+                searchsp_eff[index] = 
+                    query_info->contexts[chunk_contexts[index]].eff_searchsp;
+            }
+        }
+        BlastEffectiveLengthsOptionsNew(&chunk_eff_len_options);
+        BLAST_FillEffectiveLengthsOptions(chunk_eff_len_options, 
+                                          eff_len_options->dbseq_num, 
+                                          eff_len_options->db_length, 
+                                          searchsp_eff, num_contexts);
+        chunk_sbp = s_BlastChunkScoreBlkNew(sbp, chunk_contexts, num_contexts);
+
+        status = LookupTableWrapInit_MT(chunk_query, options->lookup_options, 
+                                     options->query_options, chunk_segments, 
+                                     chunk_sbp, &lookup_wrap, NULL, &core_msg,
+                                     kNumCpus);
+        if (core_msg) {
+            extra_returns->error = 
+                Blast_MessageToSBlastMessage(core_msg, NULL, NULL, 
+                                             options->believe_query);
+            core_msg = Blast_MessageFree(core_msg);
+        }
+
+        if (!status)
+            status = s_BlastHSPStreamSetUp(chunk_query, chunk_info, seq_src, 
+                                           options, chunk_sbp, NULL, 
+                                           &chunk_stream, extra_returns);
+
+        if (!status) {
+            BlastSeqSrcResetChunkIterator((BlastSeqSrc*) seq_src);
+            if (kMultiThreaded) {
+                s_BlastPrelimSearchThreads(chunk_query, chunk_info, seq_src, 
+                                           options, chunk_eff_len_options, 
+                                           lookup_wrap, chunk_sbp, 
+                                           diagnostics, chunk_stream);
+            } else if ((status = 
+                        Blast_RunPreliminarySearch(kProgram, chunk_query, 
+                            chunk_info, seq_src, options->score_options, 
+                            chunk_sbp, lookup_wrap, options->word_options, 
+                            options->ext_options, options->hit_options, 
+                            chunk_eff_len_options, options->psi_options, 
+                            options->db_options, chunk_stream, 
+                            diagnostics)) != 0) {
+                SBlastMessageWrite(&extra_returns->error, SEV_ERROR,
+                                   "Preliminary search engine failed\n", 
+                                   NULL, options->believe_query);
+            }
+        }
+
+        if (!status)
+            status = BlastHSPStreamMerge(squery_blk, chunk, chunk_stream, 
+                                         hsp_stream);
+
+        chunk_stream = BlastHSPStreamFree(chunk_stream);
+        lookup_wrap = LookupTableWrapFree(lookup_wrap);
+        chunk_sbp = s_BlastChunkScoreBlkFree(chunk_sbp);
+        chunk_eff_len_options = 
+            BlastEffectiveLengthsOptionsFree(chunk_eff_len_options);
+        sfree(searchsp_eff);
+        sfree(chunk_contexts);
+        chunk_segments = BlastSeqLocFree(chunk_segments);
+        chunk_info = BlastQueryInfoFree(chunk_info);
+        chunk_query = BlastSequenceBlkFree(chunk_query);
+    }
+
+    /* The chunks add up their own subject counts, so a subject found by 
+       several chunks would be counted more than once */
+    if (!status && diagnostics->gapped_stat) {
+        Int4 num_subjects = s_BlastHSPStreamCountSubjects(hsp_stream);
+        if (num_subjects < 0)
+            status = BLASTERR_MEMORY;
+        else
+            diagnostics->gapped_stat->num_seqs_passed = num_subjects;
+    }
+
+    if (!status) {
+        if (kMultiThreaded) {
+            status = Blast_RunTracebackSearchMT(kProgram, query, query_info, 
+                         seq_src, options->score_options, options->ext_options,
+                         options->hit_options, eff_len_options, 
+                         options->db_options, options->psi_options, sbp, 
+                         hsp_stream, NULL, NULL, results, kNumCpus);
+        } else {
+            status = Blast_RunTracebackSearch(kProgram, query, query_info, 
+                         seq_src, options->score_options, options->ext_options,
+                         options->hit_options, eff_len_options, 
+                         options->db_options, options->psi_options, sbp, 
+                         hsp_stream, NULL, NULL, results);
+        }
+        if (status) {
+            SBlastMessageWrite(&extra_returns->error, SEV_ERROR,
+                               "Traceback engine failed\n", NULL, 
+                               options->believe_query);
+        }
+    }
+
+    hsp_stream = BlastHSPStreamFree(hsp_stream);
+    Blast_SummaryReturnFill(kProgram, options->score_options, sbp, 
+                            options->lookup_options, options->word_options, 
+                            options->ext_options, options->hit_options,
+                            eff_len_options, options->query_options, 
+                            query_info, seq_src, &diagnostics, extra_returns);
+
+    return status;
+}
+
 /** GET_MATRIX_PATH callback to find the path to a specified matrix.
  * Looks first in current directory, then one specified by
  * .ncbirc, then in local data directory, then env
@@ -610,6 +1266,8 @@ Blast_RunSearch(SeqLoc* query_seqloc,
     const Boolean kPhiBlast = Blast_ProgramIsPhiBlast(kProgram);
     const Uint1 kDeallocateMe = 253;
     Blast_Message *core_msg = NULL;
+    SSplitQueryBlk* squery_blk = NULL;
+    Int4* query_starts = NULL;
 
     if (!query_seqloc || !seq_src || !options || !extra_returns) 
         return -1;
@@ -729,8 +1387,55 @@ Blast_RunSearch(SeqLoc* query_seqloc,
           }
     }
 
-    status = LookupTableWrapInit(query, lookup_options, query_options,
-                        lookup_segments, sbp, &lookup_wrap, rps_info, &core_msg);
+    /* Long nucleotide queries are searched in chunks when the search
+       space does not depend on the subject, i.e. against a database. 
+       Ungapped searches are not split, because their final e-values come 
+       from linking all HSPs of a subject in the preliminary stage. */
+    if (kProgram == eBlastTypeBlastn && !tf_data && 
+        score_options->gapped_calculation &&
+        BlastSeqSrcGetTotLen(seq_src) > 0 &&
+        (squery_blk = s_BlastSplitQueryBlkNew(query_info, TRUE, 
+                                              &query_starts)) != NULL) {
+        status = s_BlastSplitQueryManager(query, query_info, lookup_segments,
+                                          squery_blk, query_starts, seq_src,
+                                          options, sbp, results, extra_returns);
+        squery_blk = SplitQueryBlkFree(squery_blk);
+        sfree(query_starts);
+        lookup_segments = BlastSeqLocFree(lookup_segments);
+        query = BlastSequenceBlkFree(query);
+        query_info = BlastQueryInfoFree(query_info);
+        BlastScoreBlkFree(sbp);
+        return status;
+    }
+
+    /* A blastp database search may use a compressed alphabet lookup
+       table if the caller allows it and the cost model expects it to be
+       faster. If that table turns out too large, the standard table is
+       built instead. */
+    if (kProgram == eBlastTypeBlastp && lookup_options->compressed_batches &&
+        lookup_options->lut_type == eAaLookupTable &&
+        !(sbp->psi_matrix && sbp->psi_matrix->pssm) &&
+        BlastCompressedAaLookupIsCheaper(query->length, 
+                                         BlastSeqSrcGetTotLen(seq_src),
+                                         options->num_cpus)) {
+        LookupTableOptions compressed_options = *lookup_options;
+
+        compressed_options.lut_type = eCompressedAaLookupTable;
+        compressed_options.word_size = BLAST_WORDSIZE_COMPRESSED_BATCH;
+        compressed_options.threshold = BLAST_WORD_THRESHOLD_COMPRESSED_BATCH;
+        status = LookupTableWrapInit_MT(query, &compressed_options, 
+                        query_options, lookup_segments, sbp, &lookup_wrap, 
+                        rps_info, &core_msg, options->num_cpus);
+        if (status) {
+            lookup_wrap = LookupTableWrapFree(lookup_wrap);
+            core_msg = Blast_MessageFree(core_msg);
+        }
+    }
+
+    if (lookup_wrap == NULL)
+        status = LookupTableWrapInit_MT(query, lookup_options, query_options,
+                        lookup_segments, sbp, &lookup_wrap, rps_info, 
+                        &core_msg, options->num_cpus);
     if (core_msg)
     {
           extra_returns->error = Blast_MessageToSBlastMessage(core_msg, query_seqloc, query_info, options->believe_query);
@@ -777,16 +1482,34 @@ Blast_RunSearch(SeqLoc* query_seqloc,
     return status;
 }
 
-Int2
-Blast_DatabaseSearch(SeqLoc* query_seqloc,
-                     Blast_PsiCheckpointLoc * psi_checkpoint,
-                     char* db_name,
-                     SeqLoc* masking_locs,
-                     const SBlastOptions* options,
-                     BlastTabularFormatData* tf_data,
-                     SBlastSeqalignArray* *seqalign_arr,
-                     SeqLoc** filter_out,
-                     Blast_SummaryReturn* extra_returns)
+/** Searches a database and either formats the results on the fly, saves
+ * them in a columnar file, returns them as they are or converts them to
+ * Seq-aligns.
+ * @param query_seqloc List of query Seq-loc's [in]
+ * @param psi_checkpoint a checkpoint file for PSSM searches [in]
+ * @param db_name Name of a BLAST database to search [in]
+ * @param masking_locs Locations in the queries that should be masked [in]
+ * @param options Search options [in]
+ * @param tf_data Structure to use for on-the-fly tabular formatting [in]
+ * @param columnar Columnar file to append the results to [in]
+ * @param results_out The search results, if given [out]
+ * @param seqalign_arr object that holds the array of SeqAligns, if neither
+ *                     tf_data, columnar nor results_out is given [out]
+ * @param filter_out Filtering locations [out]
+ * @param extra_returns Additional information about the search [out]
+ */
+static Int2
+s_DatabaseSearch(SeqLoc* query_seqloc,
+                 Blast_PsiCheckpointLoc * psi_checkpoint,
+                 char* db_name,
+                 SeqLoc* masking_locs,
+                 const SBlastOptions* options,
+                 BlastTabularFormatData* tf_data,
+                 BlastColumnarWriter* columnar,
+                 BlastHSPResults** results_out,
+                 SBlastSeqalignArray* *seqalign_arr,
+                 SeqLoc** filter_out,
+                 Blast_SummaryReturn* extra_returns)
 {
     BlastSeqSrc *seq_src = NULL;
     Boolean db_is_prot;
@@ -834,7 +1557,18 @@ Blast_DatabaseSearch(SeqLoc* query_seqloc,
        initialising function used readdb_attach */
     BlastSeqSrcFree(seq_src);
 
-    if (!status && !tf_data) {
+    if (!status && columnar) {
+        status = 
+            BlastColumnarWriteResults(columnar, options->program, results,
+                                      query_seqloc, db_name, rdfp,
+                                      options->score_options->gapped_calculation,
+                                      options->score_options->is_ooframe,
+                                      options->believe_query);
+        results = Blast_HSPResultsFree(results);
+    } else if (!status && results_out) {
+        *results_out = results;
+        results = NULL;
+    } else if (!status && !tf_data) {
         status = 
             BLAST_ResultsToSeqAlign(options->program, &results, 
                                     query_seqloc, rdfp, NULL, 
@@ -851,6 +1585,59 @@ Blast_DatabaseSearch(SeqLoc* query_seqloc,
     return status;
 }
 
+Int2
+Blast_DatabaseSearch(SeqLoc* query_seqloc,
+                     Blast_PsiCheckpointLoc * psi_checkpoint,
+                     char* db_name,
+                     SeqLoc* masking_locs,
+                     const SBlastOptions* options,
+                     BlastTabularFormatData* tf_data,
+                     SBlastSeqalignArray* *seqalign_arr,
+                     SeqLoc** filter_out,
+                     Blast_SummaryReturn* extra_returns)
+{
+    return s_DatabaseSearch(query_seqloc, psi_checkpoint, db_name,
+                            masking_locs, options, tf_data, NULL, NULL,
+                            seqalign_arr, filter_out, extra_returns);
+}
+
+Int2
+Blast_DatabaseSearchToColumnar(SeqLoc* query_seqloc,
+                               Blast_PsiCheckpointLoc * psi_checkpoint,
+                               char* db_name,
+                               SeqLoc* masking_locs,
+                               const SBlastOptions* options,
+                               BlastColumnarWriter* columnar,
+                               SeqLoc** filter_out,
+                               Blast_SummaryReturn* extra_returns)
+{
+    if (!columnar)
+        return -1;
+
+    return s_DatabaseSearch(query_seqloc, psi_checkpoint, db_name,
+                            masking_locs, options, NULL, columnar, NULL,
+                            NULL, filter_out, extra_returns);
+}
+
+Int2
+Blast_DatabaseSearchHSPResults(SeqLoc* query_seqloc,
+                               Blast_PsiCheckpointLoc * psi_checkpoint,
+                               char* db_name,
+                               SeqLoc* masking_locs,
+                               const SBlastOptions* options,
+                               BlastHSPResults* *results,
+                               SeqLoc** filter_out,
+                               Blast_SummaryReturn* extra_returns)
+{
+    if (!results)
+        return -1;
+    *results = NULL;
+
+    return s_DatabaseSearch(query_seqloc, psi_checkpoint, db_name,
+                            masking_locs, options, NULL, NULL, results,
+                            NULL, filter_out, extra_returns);
+}
+
 /** Splits the PHI BLAST results corresponding to different pattern occurrences
  * in query, converts them to Seq-aligns and puts in a list of ValNodes.
  * @param results All results from different pattern occurrences 
@@ -45,6 +45,7 @@ extern "C" {
 #endif
 
 #include <algo/blast/api/blast_tabular.h>
+#include <algo/blast/api/blast_columnar.h>
 #include <algo/blast/api/blast_options_api.h>
 #include <algo/blast/api/blast_seqalign.h>
 #include <algo/blast/api/blast_input.h>
@@ -87,6 +88,49 @@ Blast_DatabaseSearch(SeqLoc* query_seqloc,
                      SeqLoc** filter_out,
                      Blast_SummaryReturn* extra_returns);
 
+/** Compares a list of SeqLoc's against a BLAST database and appends the
+ * results to a columnar file instead of returning them.
+ * @param query_seqloc List of query Seq-loc's [in]
+ * @param psi_checkpoint a checkpoint file for PSSM searches [in]
+ * @param db_name Name of a BLAST database to search [in]
+ * @param masking_locs Locations in the queries that should be masked [in]
+ * @param options Search options [in]
+ * @param columnar Columnar file to append the results to [in]
+ * @param filter_out Filtering locations [out]
+ * @param extra_returns Additional information about the search [out]
+ */
+Int2
+Blast_DatabaseSearchToColumnar(SeqLoc* query_seqloc,
+                               Blast_PsiCheckpointLoc * psi_checkpoint,
+                               char* db_name,
+                               SeqLoc* masking_locs,
+                               const SBlastOptions* options,
+                               BlastColumnarWriter* columnar,
+                               SeqLoc** filter_out,
+                               Blast_SummaryReturn* extra_returns);
+
+/** Compares a list of SeqLoc's against a BLAST database and returns the
+ * results without converting them to Seq-aligns, e.g. for
+ * BLAST_FormatHSPResults.
+ * @param query_seqloc List of query Seq-loc's [in]
+ * @param psi_checkpoint a checkpoint file for PSSM searches [in]
+ * @param db_name Name of a BLAST database to search [in]
+ * @param masking_locs Locations in the queries that should be masked [in]
+ * @param options Search options [in]
+ * @param results The search results [out]
+ * @param filter_out Filtering locations [out]
+ * @param extra_returns Additional information about the search [out]
+ */
+Int2
+Blast_DatabaseSearchHSPResults(SeqLoc* query_seqloc,
+                               Blast_PsiCheckpointLoc * psi_checkpoint,
+                               char* db_name,
+                               SeqLoc* masking_locs,
+                               const SBlastOptions* options,
+                               BlastHSPResults* *results,
+                               SeqLoc** filter_out,
+                               Blast_SummaryReturn* extra_returns);
+
 /** Compares a list of SeqLoc's against another list of SeqLoc's,
  * using the BLAST algorithm, with all options preset.
  * @param query_seqloc List of query Seq-loc's [in]
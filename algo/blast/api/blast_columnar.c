@@ -0,0 +1,925 @@
+/* $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's offical duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================*/
+
+/** @file blast_columnar.c
+ * Writing, reading and converting columnar binary BLAST result files
+ */
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+static char const rcsid[] = "$Id$";
+#endif /* SKIP_DOXYGEN_PROCESSING */
+
+#include <algo/blast/api/blast_columnar.h>
+#include <algo/blast/api/blast_format.h>
+#include <algo/blast/api/blast_tabular.h>
+#include <txalign.h>
+
+#ifdef OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+/** @addtogroup CToolkitAlgoBlast
+ *
+ * @{
+ */
+
+/** Round a size up to the alignment of the arrays in a block */
+#define COLUMNAR_ALIGN(size) (((size) + 7) & ~((Int8) 7))
+
+/** Maximal length of a query Seq-id saved in a block */
+#define COLUMNAR_SEQID_MAX 1024
+
+struct BlastColumnarWriter {
+    char* filename;             /**< Name of the file */
+#ifdef OS_UNIX
+    int fd;                     /**< File opened for appending */
+#else
+    FILE* fp;                   /**< File opened for appending */
+#endif
+    Boolean with_traceback;     /**< Save the edit scripts? */
+};
+
+struct BlastColumnarReader {
+    Nlm_MemMap* mmap;           /**< The mapped file, if it could be mapped */
+    char* contents;             /**< The file contents */
+    Int8 size;                  /**< Size of the file */
+    Int8 offset;                /**< Offset of the next block */
+};
+
+/** Growing pool of '\0'-terminated strings. */
+typedef struct SColumnarStrings {
+    char* data;                 /**< The strings */
+    Int4 size;                  /**< Bytes used */
+    Int4 alloc;                 /**< Bytes allocated */
+} SColumnarStrings;
+
+/** Add a string to a string pool.
+ * @param pool The pool [in][out]
+ * @param str The string [in]
+ * @return Offset of the string in the pool, or -1 if out of memory
+ */
+static Int4
+s_ColumnarStringsAdd(SColumnarStrings* pool, const char* str)
+{
+    Int4 length = (Int4) strlen(str) + 1;
+    Int4 offset = pool->size;
+
+    if (pool->size + length > pool->alloc) {
+        Int4 new_alloc = MAX(2*pool->alloc, pool->size + length);
+        char* new_data = (char*) realloc(pool->data, new_alloc);
+        if (!new_data)
+            return -1;
+        pool->data = new_data;
+        pool->alloc = new_alloc;
+    }
+    memcpy(pool->data + offset, str, length);
+    pool->size += length;
+    return offset;
+}
+
+/** Compute the position of the sections of a block. Used both to lay out a
+ * new block and to find the arrays of a block read from a file.
+ * @param header The block header; only the counts are used [in]
+ * @param base Start of the block, or NULL to only compute the size [in]
+ * @param block Filled with pointers to the arrays if base is not NULL [out]
+ * @return The size of the block
+ */
+static Int8
+s_ColumnarLayout(const BlastColumnarBlockHeader* header, const char* base,
+                 BlastColumnarBlock* block)
+{
+    Int8 num_hits = header->num_hits;
+    Int8 offset = COLUMNAR_ALIGN((Int8) sizeof(BlastColumnarBlockHeader));
+
+#define COLUMNAR_SECTION(field, type, count) \
+    if (base) \
+        block->field = (const type*) (base + offset); \
+    offset += COLUMNAR_ALIGN((Int8) (count) * (Int8) sizeof(type))
+
+    COLUMNAR_SECTION(queries, BlastColumnarQuery, header->num_queries);
+    COLUMNAR_SECTION(query_index, Int4, num_hits);
+    COLUMNAR_SECTION(context, Int4, num_hits);
+    COLUMNAR_SECTION(subject_oid, Int4, num_hits);
+    COLUMNAR_SECTION(subject_length, Int4, num_hits);
+    COLUMNAR_SECTION(query_start, Int4, num_hits);
+    COLUMNAR_SECTION(query_end, Int4, num_hits);
+    COLUMNAR_SECTION(subject_start, Int4, num_hits);
+    COLUMNAR_SECTION(subject_end, Int4, num_hits);
+    COLUMNAR_SECTION(score, Int4, num_hits);
+    COLUMNAR_SECTION(num_ident, Int4, num_hits);
+    COLUMNAR_SECTION(align_length, Int4, num_hits);
+    COLUMNAR_SECTION(mismatches, Int4, num_hits);
+    COLUMNAR_SECTION(gap_opens, Int4, num_hits);
+    COLUMNAR_SECTION(num, Int4, num_hits);
+    COLUMNAR_SECTION(tb_offset, Int4, num_hits);
+    COLUMNAR_SECTION(tb_size, Int4, num_hits);
+    COLUMNAR_SECTION(query_frame, Int2, num_hits);
+    COLUMNAR_SECTION(subject_frame, Int2, num_hits);
+    COLUMNAR_SECTION(comp_adjustment_method, Int2, num_hits);
+    COLUMNAR_SECTION(evalue, double, num_hits);
+    COLUMNAR_SECTION(bit_score, double, num_hits);
+    COLUMNAR_SECTION(tb_ops, Int4, header->num_tb_ops);
+    COLUMNAR_SECTION(strings, char, header->strings_size);
+
+#undef COLUMNAR_SECTION
+
+    return offset;
+}
+
+BlastColumnarWriter*
+BlastColumnarWriterNew(const char* filename, Boolean with_traceback)
+{
+    BlastColumnarWriter* writer;
+
+    if (!filename)
+        return NULL;
+
+    writer = (BlastColumnarWriter*) calloc(1, sizeof(BlastColumnarWriter));
+    if (!writer)
+        return NULL;
+
+    writer->filename = strdup(filename);
+    writer->with_traceback = with_traceback;
+#ifdef OS_UNIX
+    writer->fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if (writer->fd < 0) {
+#else
+    writer->fp = FileOpen(filename, "ab");
+    if (writer->fp == NULL) {
+#endif
+        ErrPostEx(SEV_ERROR, 0, 0, "Unable to open columnar output file %s",
+                  filename);
+        sfree(writer->filename);
+        sfree(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+BlastColumnarWriter*
+BlastColumnarWriterFree(BlastColumnarWriter* writer)
+{
+    if (!writer)
+        return NULL;
+
+#ifdef OS_UNIX
+    close(writer->fd);
+#else
+    FileClose(writer->fp);
+#endif
+    sfree(writer->filename);
+    sfree(writer);
+    return NULL;
+}
+
+#ifdef OS_UNIX
+/** Write all of a buffer to a file descriptor.
+ * @param fd The file descriptor [in]
+ * @param data What to write [in]
+ * @param size Number of bytes to write [in]
+ * @return TRUE on success
+ */
+static Boolean
+s_ColumnarWriteAll(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        data += written;
+        size -= written;
+    }
+    return TRUE;
+}
+#endif
+
+/** Append a block to the file, preceded by the file header if the file is
+ * still empty. On Unix the file is locked for the duration, so that blocks
+ * from several processes never interleave.
+ * @param writer The writer [in]
+ * @param block The block [in]
+ * @param size Size of the block [in]
+ * @return TRUE on success
+ */
+static Boolean
+s_ColumnarAppend(BlastColumnarWriter* writer, const char* block, size_t size)
+{
+    BlastColumnarFileHeader file_header;
+    Boolean retval;
+
+    memset(&file_header, 0, sizeof(file_header));
+    strcpy(file_header.magic, BLAST_COLUMNAR_FILE_MAGIC);
+    file_header.version = BLAST_COLUMNAR_VERSION;
+    file_header.byte_order = BLAST_COLUMNAR_BYTE_ORDER;
+
+#ifdef OS_UNIX
+    {{
+        struct flock lock;
+        struct stat st;
+
+        memset(&lock, 0, sizeof(lock));
+        lock.l_type = F_WRLCK;
+        lock.l_whence = SEEK_SET;
+        while (fcntl(writer->fd, F_SETLKW, &lock) < 0) {
+            /* Locking is not available on every file system; appending
+               still works there, but only one process may write. */
+            if (errno != EINTR)
+                break;
+        }
+
+        retval = (fstat(writer->fd, &st) == 0);
+        if (retval && st.st_size == 0)
+            retval = s_ColumnarWriteAll(writer->fd, (char*) &file_header,
+                                        sizeof(file_header));
+        if (retval)
+            retval = s_ColumnarWriteAll(writer->fd, block, size);
+
+        lock.l_type = F_UNLCK;
+        fcntl(writer->fd, F_SETLK, &lock);
+    }}
+#else
+    fseek(writer->fp, 0, SEEK_END);
+    retval = TRUE;
+    if (ftell(writer->fp) == 0)
+        retval = (FileWrite(&file_header, sizeof(file_header), 1,
+                            writer->fp) == 1);
+    if (retval)
+        retval = (FileWrite(block, size, 1, writer->fp) == 1);
+    if (fflush(writer->fp) != 0)
+        retval = FALSE;
+#endif
+
+    return retval;
+}
+
+Int2
+BlastColumnarWriteResults(BlastColumnarWriter* writer,
+                          EBlastProgramType program,
+                          const BlastHSPResults* results,
+                          SeqLoc* query_slp, const char* db_name,
+                          ReadDBFILE* rdfp, Boolean is_gapped,
+                          Boolean is_ooframe, Boolean believe_query)
+{
+    BlastColumnarBlockHeader header;
+    BlastColumnarBlock layout;
+    SColumnarStrings strings;
+    BlastColumnarQuery* queries;
+    char* block;
+    Int8 block_size;
+    Int4 query_index, hit, tb_op;
+    Boolean with_traceback;
+    SeqLoc* slp;
+    Int2 status = 0;
+
+    if (!writer || !results)
+        return -1;
+
+    with_traceback = (writer->with_traceback && is_gapped);
+
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, BLAST_COLUMNAR_BLOCK_MAGIC);
+    header.program = program;
+    header.num_queries = results->num_queries;
+    header.flags = (is_gapped ? BLAST_COLUMNAR_GAPPED : 0) |
+        (is_ooframe ? BLAST_COLUMNAR_OOFRAME : 0) |
+        (believe_query ? BLAST_COLUMNAR_BELIEVE_QUERY : 0) |
+        (with_traceback ? BLAST_COLUMNAR_TRACEBACK : 0);
+
+    /* Count the hits and edit script entries, and collect the strings */
+    memset(&strings, 0, sizeof(strings));
+    header.db_name = db_name ? s_ColumnarStringsAdd(&strings, db_name) : -1;
+    queries = (BlastColumnarQuery*)
+        calloc(MAX(results->num_queries, 1), sizeof(BlastColumnarQuery));
+    if (!queries)
+        return -1;
+
+    for (query_index = 0, slp = query_slp; query_index < results->num_queries;
+         ++query_index, slp = slp ? slp->next : NULL) {
+        BlastHitList* hit_list = results->hitlist_array[query_index];
+        char id_buffer[COLUMNAR_SEQID_MAX];
+        char* label = NULL;
+        Int4 index, index2;
+
+        queries[query_index].id = queries[query_index].label = -1;
+        if (slp) {
+            SeqId* query_id = SeqLocId(slp);
+            queries[query_index].from = SeqLocStart(slp);
+            queries[query_index].to = SeqLocStop(slp);
+            queries[query_index].strand = SeqLocStrand(slp);
+            SeqIdWrite(query_id, id_buffer, PRINTID_FASTA_LONG,
+                       sizeof(id_buffer) - 1);
+            queries[query_index].id = s_ColumnarStringsAdd(&strings, id_buffer);
+            Blast_SeqIdGetDefLine(query_id, &label, FALSE, FALSE,
+                                  believe_query);
+            queries[query_index].label =
+                s_ColumnarStringsAdd(&strings, label ? label : "");
+            sfree(label);
+            if (queries[query_index].id < 0 || queries[query_index].label < 0)
+                status = -1;
+        }
+
+        if (!hit_list)
+            continue;
+        for (index = 0; index < hit_list->hsplist_count; ++index) {
+            BlastHSPList* hsp_list = hit_list->hsplist_array[index];
+            if (!hsp_list)
+                continue;
+            header.num_hits += hsp_list->hspcnt;
+            if (!with_traceback)
+                continue;
+            for (index2 = 0; index2 < hsp_list->hspcnt; ++index2) {
+                if (hsp_list->hsp_array[index2]->gap_info)
+                    header.num_tb_ops +=
+                        hsp_list->hsp_array[index2]->gap_info->size;
+            }
+        }
+    }
+    header.strings_size = strings.size;
+
+    block_size = s_ColumnarLayout(&header, NULL, NULL);
+    header.size = block_size;
+    block = (status == 0) ? (char*) calloc(1, (size_t) block_size) : NULL;
+    if (!block) {
+        sfree(queries);
+        sfree(strings.data);
+        return -1;
+    }
+    memcpy(block, &header, sizeof(header));
+    s_ColumnarLayout(&header, block, &layout);
+    memcpy((char*) layout.queries, queries,
+           header.num_queries * sizeof(BlastColumnarQuery));
+    if (strings.size > 0)
+        memcpy((char*) layout.strings, strings.data, strings.size);
+    sfree(queries);
+    sfree(strings.data);
+
+    /* Fill the columns */
+    hit = tb_op = 0;
+    for (query_index = 0; query_index < results->num_queries; ++query_index) {
+        BlastHitList* hit_list = results->hitlist_array[query_index];
+        Int4 index, index2;
+
+        if (!hit_list)
+            continue;
+        for (index = 0; index < hit_list->hsplist_count; ++index) {
+            BlastHSPList* hsp_list = hit_list->hsplist_array[index];
+            Int4 subject_length;
+
+            if (!hsp_list)
+                continue;
+            subject_length =
+                rdfp ? readdb_get_sequence_length(rdfp, hsp_list->oid) : 0;
+
+            for (index2 = 0; index2 < hsp_list->hspcnt; ++index2, ++hit) {
+                BlastHSP* hsp = hsp_list->hsp_array[index2];
+                Int4 align_length, num_gaps, num_gap_opens;
+
+                Blast_HSPCalcLengthAndGaps(hsp, &align_length, &num_gaps,
+                                           &num_gap_opens);
+
+                ((Int4*) layout.query_index)[hit] = query_index;
+                ((Int4*) layout.context)[hit] = hsp->context;
+                ((Int4*) layout.subject_oid)[hit] = hsp_list->oid;
+                ((Int4*) layout.subject_length)[hit] = subject_length;
+                ((Int4*) layout.query_start)[hit] = hsp->query.offset;
+                ((Int4*) layout.query_end)[hit] = hsp->query.end;
+                ((Int4*) layout.subject_start)[hit] = hsp->subject.offset;
+                ((Int4*) layout.subject_end)[hit] = hsp->subject.end;
+                ((Int4*) layout.score)[hit] = hsp->score;
+                ((Int4*) layout.num_ident)[hit] = hsp->num_ident;
+                ((Int4*) layout.align_length)[hit] = align_length;
+                ((Int4*) layout.mismatches)[hit] =
+                    align_length - hsp->num_ident - num_gaps;
+                ((Int4*) layout.gap_opens)[hit] = num_gap_opens;
+                ((Int4*) layout.num)[hit] = hsp->num;
+                ((Int2*) layout.query_frame)[hit] = hsp->query.frame;
+                ((Int2*) layout.subject_frame)[hit] = hsp->subject.frame;
+                ((Int2*) layout.comp_adjustment_method)[hit] =
+                    hsp->comp_adjustment_method;
+                ((double*) layout.evalue)[hit] = hsp->evalue;
+                ((double*) layout.bit_score)[hit] = hsp->bit_score;
+
+                ((Int4*) layout.tb_offset)[hit] = -1;
+                if (with_traceback && hsp->gap_info) {
+                    GapEditScript* esp = hsp->gap_info;
+                    Int4 op;
+                    ((Int4*) layout.tb_offset)[hit] = tb_op;
+                    ((Int4*) layout.tb_size)[hit] = esp->size;
+                    for (op = 0; op < esp->size; ++op, ++tb_op) {
+                        ((Int4*) layout.tb_ops)[tb_op] =
+                            (esp->num[op] << BLAST_COLUMNAR_OP_BITS) |
+                            esp->op_type[op];
+                    }
+                }
+            }
+        }
+    }
+    ASSERT(hit == header.num_hits && tb_op == header.num_tb_ops);
+
+    if (!s_ColumnarAppend(writer, block, (size_t) block_size)) {
+        ErrPostEx(SEV_ERROR, 0, 0, "Unable to write to columnar output "
+                  "file %s", writer->filename);
+        status = -2;
+    }
+    sfree(block);
+    return status;
+}
+
+BlastColumnarReader*
+BlastColumnarReaderNew(const char* filename)
+{
+    BlastColumnarReader* reader;
+    const BlastColumnarFileHeader* file_header;
+
+    if (!filename)
+        return NULL;
+
+    reader = (BlastColumnarReader*) calloc(1, sizeof(BlastColumnarReader));
+    if (!reader)
+        return NULL;
+
+    if (Nlm_MemMapAvailable() &&
+        (reader->mmap = Nlm_MemMapInit(filename)) != NULL) {
+        reader->contents = reader->mmap->mmp_begin;
+        reader->size = reader->mmap->file_size;
+    } else {
+        FILE* fp = FileOpen(filename, "rb");
+        Int8 size = FileLength((char*) filename);
+        if (fp && size > 0 && (reader->contents = (char*) malloc(size))) {
+            if (FileRead(reader->contents, 1, (size_t) size, fp) ==
+                (size_t) size)
+                reader->size = size;
+        }
+        FileClose(fp);
+    }
+
+    file_header = (const BlastColumnarFileHeader*) reader->contents;
+    if (reader->contents == NULL ||
+        reader->size < (Int8) sizeof(BlastColumnarFileHeader) ||
+        strcmp(file_header->magic, BLAST_COLUMNAR_FILE_MAGIC) != 0) {
+        ErrPostEx(SEV_ERROR, 0, 0, "%s is not a columnar BLAST results file",
+                  filename);
+        return BlastColumnarReaderFree(reader);
+    }
+    if (file_header->byte_order != BLAST_COLUMNAR_BYTE_ORDER ||
+        file_header->version != BLAST_COLUMNAR_VERSION) {
+        ErrPostEx(SEV_ERROR, 0, 0, "Columnar BLAST results file %s was "
+                  "written by another version or on a machine with a "
+                  "different byte order", filename);
+        return BlastColumnarReaderFree(reader);
+    }
+    reader->offset = COLUMNAR_ALIGN((Int8) sizeof(BlastColumnarFileHeader));
+
+    return reader;
+}
+
+BlastColumnarReader*
+BlastColumnarReaderFree(BlastColumnarReader* reader)
+{
+    if (!reader)
+        return NULL;
+
+    if (reader->mmap)
+        Nlm_MemMapFini(reader->mmap);
+    else
+        sfree(reader->contents);
+    sfree(reader);
+    return NULL;
+}
+
+/** Check that all indices stored in a block point inside the block.
+ * @param block The block [in]
+ * @return TRUE if the block is consistent
+ */
+static Boolean
+s_ColumnarBlockIsValid(const BlastColumnarBlock* block)
+{
+    Int4 index;
+
+    if (block->num_hits > 0 && block->num_queries <= 0)
+        return FALSE;
+
+    for (index = 0; index < block->num_queries; ++index) {
+        const BlastColumnarQuery* query = &block->queries[index];
+        if (query->id < -1 || query->id >= block->num_strings ||
+            query->label < -1 || query->label >= block->num_strings)
+            return FALSE;
+    }
+
+    for (index = 0; index < block->num_hits; ++index) {
+        if (block->query_index[index] < 0 ||
+            block->query_index[index] >= block->num_queries ||
+            block->subject_oid[index] < 0)
+            return FALSE;
+        if (block->tb_offset[index] >= 0 &&
+            (block->tb_size[index] < 0 ||
+             block->tb_offset[index] > block->num_tb_ops -
+                                       block->tb_size[index]))
+            return FALSE;
+    }
+
+    for (index = 0; index < block->num_tb_ops; ++index) {
+        const Int4 kOp = block->tb_ops[index];
+        if (kOp < 0 ||
+            (kOp & ((1 << BLAST_COLUMNAR_OP_BITS) - 1)) >= eGapAlignInvalid)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+Boolean
+BlastColumnarReaderNextBlock(BlastColumnarReader* reader,
+                             BlastColumnarBlock* block)
+{
+    const BlastColumnarBlockHeader* header;
+    const char* base;
+    Int8 remaining;
+
+    if (!reader || !block || reader->offset >= reader->size)
+        return FALSE;
+
+    base = reader->contents + reader->offset;
+    header = (const BlastColumnarBlockHeader*) base;
+    remaining = reader->size - reader->offset;
+
+    memset(block, 0, sizeof(BlastColumnarBlock));
+    if (remaining < (Int8) sizeof(BlastColumnarBlockHeader) ||
+        strcmp(header->magic, BLAST_COLUMNAR_BLOCK_MAGIC) != 0 ||
+        header->size > remaining || header->size != COLUMNAR_ALIGN(header->size) ||
+        header->num_queries < 0 || header->num_hits < 0 ||
+        header->num_tb_ops < 0 || header->strings_size < 0 ||
+        header->db_name < -1 || header->db_name >= header->strings_size ||
+        s_ColumnarLayout(header, NULL, NULL) > header->size) {
+        ErrPostEx(SEV_WARNING, 0, 0, "Incomplete or damaged block at offset "
+                  "%s of columnar BLAST results file; the rest of the file "
+                  "is ignored", Nlm_Int8tostr(reader->offset, 0));
+        reader->offset = reader->size;
+        return FALSE;
+    }
+
+    s_ColumnarLayout(header, base, block);
+    block->program = (EBlastProgramType) header->program;
+    block->flags = header->flags;
+    block->num_queries = header->num_queries;
+    block->num_hits = header->num_hits;
+    block->num_tb_ops = header->num_tb_ops;
+    block->num_strings = header->strings_size;
+    block->db_name =
+        header->db_name >= 0 ? block->strings + header->db_name : NULL;
+
+    if ((header->strings_size > 0 &&
+         block->strings[header->strings_size - 1] != NULLB) ||
+        !s_ColumnarBlockIsValid(block)) {
+        ErrPostEx(SEV_WARNING, 0, 0, "Damaged block at offset %s of "
+                  "columnar BLAST results file; the rest of the file is "
+                  "ignored", Nlm_Int8tostr(reader->offset, 0));
+        reader->offset = reader->size;
+        return FALSE;
+    }
+
+    reader->offset += header->size;
+    return TRUE;
+}
+
+/** Fill a BlastHSP with the coordinates and scores of a hit, without the
+ * edit script.
+ * @param block The block [in]
+ * @param hit Index of the hit [in]
+ * @param hsp The HSP to fill [out]
+ */
+static void
+s_ColumnarGetHSP(const BlastColumnarBlock* block, Int4 hit, BlastHSP* hsp)
+{
+    hsp->score = block->score[hit];
+    hsp->num_ident = block->num_ident[hit];
+    hsp->bit_score = block->bit_score[hit];
+    hsp->evalue = block->evalue[hit];
+    hsp->query.offset = hsp->query.gapped_start = block->query_start[hit];
+    hsp->query.end = block->query_end[hit];
+    hsp->query.frame = block->query_frame[hit];
+    hsp->subject.offset = hsp->subject.gapped_start =
+        block->subject_start[hit];
+    hsp->subject.end = block->subject_end[hit];
+    hsp->subject.frame = block->subject_frame[hit];
+    hsp->context = block->context[hit];
+    hsp->num = block->num[hit];
+    hsp->comp_adjustment_method = block->comp_adjustment_method[hit];
+}
+
+/** Convert the offsets of a translated segment to 1-based coordinates on
+ * the nucleotide sequence, the way the Seq-align conversion does.
+ * @param frame Frame of the segment [in]
+ * @param offset Start of the segment in the translation [in]
+ * @param end End of the segment in the translation [in]
+ * @param length Length of the nucleotide sequence [in]
+ * @param start_ptr Start on the nucleotide sequence [out]
+ * @param end_ptr End on the nucleotide sequence [out]
+ */
+static void
+s_ColumnarTranslatedOffsets(Int2 frame, Int4 offset, Int4 end, Int4 length,
+                            Int4* start_ptr, Int4* end_ptr)
+{
+    if (frame > 0) {
+        *start_ptr = CODON_LENGTH*offset + frame;
+        *end_ptr = CODON_LENGTH*end + frame - 1;
+    } else {
+        *start_ptr = length - CODON_LENGTH*offset + frame + 1;
+        *end_ptr = length - CODON_LENGTH*end + frame + 2;
+    }
+}
+
+void
+BlastColumnarGetAdjustedOffsets(const BlastColumnarBlock* block, Int4 hit,
+                                Int4* q_start, Int4* q_end,
+                                Int4* s_start, Int4* s_end)
+{
+    const BlastColumnarQuery* query = &block->queries[block->query_index[hit]];
+    Int4 query_length = query->to - query->from + 1;
+
+    /* Blast_HSPGetAdjustedOffsets is not used here: it leaves ungapped
+       hits on the minus strand as they are and does not handle translated
+       segments the way the Seq-align based tabular output does. */
+    *q_start = block->query_start[hit] + 1;
+    *q_end = block->query_end[hit];
+    *s_start = block->subject_start[hit] + 1;
+    *s_end = block->subject_end[hit];
+
+    if (Blast_QueryIsTranslated(block->program)) {
+        s_ColumnarTranslatedOffsets(block->query_frame[hit],
+                                    block->query_start[hit],
+                                    block->query_end[hit], query_length,
+                                    q_start, q_end);
+    }
+    if (Blast_SubjectIsTranslated(block->program)) {
+        s_ColumnarTranslatedOffsets(block->subject_frame[hit],
+                                    block->subject_start[hit],
+                                    block->subject_end[hit],
+                                    block->subject_length[hit],
+                                    s_start, s_end);
+    }
+    if (!Blast_QueryIsTranslated(block->program) &&
+        !Blast_SubjectIsTranslated(block->program) &&
+        block->query_frame[hit] != block->subject_frame[hit]) {
+        /* Blastn hit on the minus strand of the query: flip the query
+           offsets and reverse the order of the subject offsets */
+        *q_end = query_length - block->query_start[hit];
+        *q_start = query_length - block->query_end[hit] + 1;
+        *s_start = block->subject_end[hit];
+        *s_end = block->subject_start[hit] + 1;
+    }
+}
+
+SeqLoc*
+BlastColumnarBlockGetQuerySeqLocs(const BlastColumnarBlock* block)
+{
+    SeqLoc* head = NULL;
+    SeqLoc* last = NULL;
+    Int4 index;
+
+    for (index = 0; index < block->num_queries; ++index) {
+        const BlastColumnarQuery* query = &block->queries[index];
+        SeqInt* sintp = SeqIntNew();
+        SeqLoc* slp;
+
+        /* The Seq-id may be a chain of several ids, all of which should be
+           kept, so SeqLocIntNew cannot be used */
+        if (query->id >= 0)
+            sintp->id = SeqIdParse((char*) block->strings + query->id);
+        if (!sintp->id)
+            sintp->id = SeqIdParse("lcl|Unknown");
+        sintp->from = query->from;
+        sintp->to = query->to;
+        sintp->strand = (Uint1) query->strand;
+
+        slp = ValNodeAddPointer(NULL, SEQLOC_INT, sintp);
+        if (last)
+            last->next = slp;
+        else
+            head = slp;
+        last = slp;
+    }
+    return head;
+}
+
+Int2
+BlastColumnarBlockToHSPResults(const BlastColumnarBlock* block,
+                               BlastHSPResults** results_ptr)
+{
+    BlastHSPResults* results;
+    BlastHSPList* hsp_list = NULL;
+    Int4 hit;
+    Int2 status = 0;
+
+    *results_ptr = results = Blast_HSPResultsNew(block->num_queries);
+    if (!results)
+        return -1;
+
+    /* The hits of one HSP list are stored together, in the order of the
+       lists in the hit lists of the queries. */
+    for (hit = 0; hit < block->num_hits && status == 0; ++hit) {
+        BlastHSP* hsp = NULL;
+        GapEditScript* esp = NULL;
+
+        if (hsp_list && (hsp_list->oid != block->subject_oid[hit] ||
+                         hsp_list->query_index != block->query_index[hit])) {
+            Blast_HSPResultsInsertHSPList(results, hsp_list, INT4_MAX);
+            hsp_list = NULL;
+        }
+        if (!hsp_list) {
+            if ((hsp_list = Blast_HSPListNew(0)) == NULL) {
+                status = -1;
+                break;
+            }
+            hsp_list->oid = block->subject_oid[hit];
+            hsp_list->query_index = block->query_index[hit];
+        }
+
+        if (block->tb_offset[hit] >= 0) {
+            const Int4* tb_ops = block->tb_ops + block->tb_offset[hit];
+            Int4 op;
+            if ((esp = GapEditScriptNew(block->tb_size[hit])) == NULL) {
+                status = -1;
+                break;
+            }
+            for (op = 0; op < esp->size; ++op) {
+                esp->op_type[op] = (EGapAlignOpType)
+                    (tb_ops[op] & ((1 << BLAST_COLUMNAR_OP_BITS) - 1));
+                esp->num[op] = tb_ops[op] >> BLAST_COLUMNAR_OP_BITS;
+            }
+        }
+
+        if ((hsp = Blast_HSPNew()) == NULL) {
+            GapEditScriptDelete(esp);
+            status = -1;
+            break;
+        }
+        s_ColumnarGetHSP(block, hit, hsp);
+        hsp->gap_info = esp;
+        if (Blast_HSPListSaveHSP(hsp_list, hsp) != 0)
+            status = -1;
+    }
+
+    if (hsp_list) {
+        if (status == 0)
+            Blast_HSPResultsInsertHSPList(results, hsp_list, INT4_MAX);
+        else
+            Blast_HSPListFree(hsp_list);
+    }
+    if (status != 0)
+        *results_ptr = Blast_HSPResultsFree(results);
+    return status;
+}
+
+Int2
+BlastColumnarBlockToSeqAlign(const BlastColumnarBlock* block,
+                             ReadDBFILE* rdfp, SeqLoc* query_slp,
+                             SBlastSeqalignArray** seqalign_arr)
+{
+    BlastHSPResults* results = NULL;
+    Boolean is_gapped = (block->flags & BLAST_COLUMNAR_GAPPED) != 0;
+    Int2 status;
+
+    *seqalign_arr = NULL;
+
+    if (is_gapped && !(block->flags & BLAST_COLUMNAR_TRACEBACK)) {
+        ErrPostEx(SEV_ERROR, 0, 0, "Gapped results saved without traceback "
+                  "cannot be converted to Seq-aligns");
+        return -1;
+    }
+
+    if ((status = BlastColumnarBlockToHSPResults(block, &results)) != 0)
+        return status;
+
+    return BLAST_ResultsToSeqAlign(block->program, &results, query_slp, rdfp,
+                                   NULL, is_gapped,
+                                   (block->flags & BLAST_COLUMNAR_OOFRAME) != 0,
+                                   seqalign_arr);
+}
+
+/** Write an integer followed by a tab.
+ * @param obuf Where to write [in]
+ * @param value The number [in]
+ */
+static void
+s_ColumnarPutInt(OutBuf* obuf, Int4 value)
+{
+    OutBufPutInt8(obuf, value);
+    OutBufWrite(obuf, "\t", 1);
+}
+
+Int2
+BlastColumnarBlockPrintTabular(const BlastColumnarBlock* block,
+                               ReadDBFILE* rdfp, OutBuf* obuf,
+                               Boolean show_gi, Boolean show_accession)
+{
+    Boolean believe_query =
+        (block->flags & BLAST_COLUMNAR_BELIEVE_QUERY) != 0;
+    char** query_labels;
+    char* subject_buffer = NULL;
+    Int4 subject_oid = -1;
+    Int4 index, hit;
+
+    if (!rdfp || !obuf)
+        return -1;
+
+    /* Labels of the queries, as in the on-the-fly tabular output */
+    query_labels = (char**) calloc(MAX(block->num_queries, 1), sizeof(char*));
+    if (!query_labels)
+        return -1;
+    for (index = 0; index < block->num_queries; ++index) {
+        const BlastColumnarQuery* query = &block->queries[index];
+        char* label = NULL;
+
+        if (believe_query && (show_gi || show_accession) && query->id >= 0) {
+            SeqId* query_id = SeqIdParse((char*) block->strings + query->id);
+            Blast_SeqIdGetDefLine(query_id, &label, show_gi, show_accession,
+                                  TRUE);
+            SeqIdSetFree(query_id);
+        }
+        if (!label)
+            label = strdup(query->label >= 0 ?
+                           block->strings + query->label : "Unknown");
+        query_labels[index] = label;
+    }
+
+    for (hit = 0; hit < block->num_hits; ++hit) {
+        const char* query_buffer = query_labels[block->query_index[hit]];
+        char bit_score_buff[10], eval_buff[10];
+        char* eval_buff_ptr = eval_buff;
+        Int4 q_start, q_end, s_start, s_end;
+        Int4 align_length = block->align_length[hit];
+
+        if (block->subject_oid[hit] != subject_oid) {
+            sfree(subject_buffer);
+            subject_oid = block->subject_oid[hit];
+            subject_buffer = Blast_TabularGetSubjectId(rdfp, subject_oid,
+                                                       show_gi, show_accession,
+                                                       NULL);
+        }
+
+        if (strstr(query_buffer, "lcl|") == query_buffer)
+            query_buffer += 4;
+
+        ScoreAndEvalueToBuffers(block->bit_score[hit], block->evalue[hit],
+                                bit_score_buff, &eval_buff_ptr, 0);
+        BlastColumnarGetAdjustedOffsets(block, hit, &q_start, &q_end,
+                                        &s_start, &s_end);
+
+        OutBufPuts(obuf, query_buffer);
+        OutBufWrite(obuf, "\t", 1);
+        OutBufPuts(obuf, subject_buffer);
+        OutBufWrite(obuf, "\t", 1);
+        OutBufPutFixed(obuf,
+                       ((double) block->num_ident[hit]) / align_length * 100,
+                       2);
+        OutBufWrite(obuf, "\t", 1);
+        s_ColumnarPutInt(obuf, align_length);
+        s_ColumnarPutInt(obuf, block->mismatches[hit]);
+        s_ColumnarPutInt(obuf, block->gap_opens[hit]);
+        s_ColumnarPutInt(obuf, q_start);
+        s_ColumnarPutInt(obuf, q_end);
+        s_ColumnarPutInt(obuf, s_start);
+        s_ColumnarPutInt(obuf, s_end);
+        OutBufPuts(obuf, eval_buff);
+        OutBufWrite(obuf, "\t", 1);
+        OutBufPuts(obuf, bit_score_buff);
+        OutBufWrite(obuf, "\n", 1);
+    }
+
+    sfree(subject_buffer);
+    for (index = 0; index < block->num_queries; ++index)
+        sfree(query_labels[index]);
+    sfree(query_labels);
+
+    return obuf->failed ? -1 : 0;
+}
+
+/* @} */
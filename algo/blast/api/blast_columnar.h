@@ -0,0 +1,304 @@
+/* $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's offical duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*/
+
+/** @file blast_columnar.h
+ * Columnar binary file format for BLAST results.
+ *
+ * A columnar file is a short file header followed by any number of blocks.
+ * Each block holds the results of one search (one BlastHSPResults
+ * structure): a table of the queries, one fixed-width array per hit
+ * attribute, the edit scripts of the alignments if they were requested,
+ * and a pool of strings. All integers are in native byte order and every
+ * array starts on an 8 byte boundary, so that a mapped file can be used
+ * in place.
+ *
+ * A block is always appended with a single write while the file is locked,
+ * so several search processes may append to the same file.
+ */
+
+#ifndef __BLAST_COLUMNAR__
+#define __BLAST_COLUMNAR__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NCBI_C_TOOLKIT
+#define NCBI_C_TOOLKIT
+#endif
+
+#include <ncbi.h>
+#include <readdb.h>
+#include <algo/blast/core/blast_hits.h>
+#include <algo/blast/api/blast_seqalign.h>
+
+/** @addtogroup CToolkitAlgoBlast
+ *
+ * @{
+ */
+
+/** Magic bytes at the start of a columnar file */
+#define BLAST_COLUMNAR_FILE_MAGIC "BLSTCOL"
+/** Magic bytes at the start of every block */
+#define BLAST_COLUMNAR_BLOCK_MAGIC "BLSTBLK"
+/** Version of the format written by this code */
+#define BLAST_COLUMNAR_VERSION 1
+/** Written in the file header to detect files from a machine with a
+    different byte order */
+#define BLAST_COLUMNAR_BYTE_ORDER 0x01020304
+
+/** Block flag: the search was gapped */
+#define BLAST_COLUMNAR_GAPPED 0x1
+/** Block flag: out-of-frame gapping was used */
+#define BLAST_COLUMNAR_OOFRAME 0x2
+/** Block flag: query identifiers were parsed from the definition lines */
+#define BLAST_COLUMNAR_BELIEVE_QUERY 0x4
+/** Block flag: the block contains the edit scripts of the alignments */
+#define BLAST_COLUMNAR_TRACEBACK 0x8
+
+/** Number of bits of a traceback entry holding the operation type; the
+    rest holds the number of operations */
+#define BLAST_COLUMNAR_OP_BITS 4
+
+/** Header of a columnar file */
+typedef struct BlastColumnarFileHeader {
+    char magic[8];      /**< BLAST_COLUMNAR_FILE_MAGIC */
+    Uint4 version;      /**< BLAST_COLUMNAR_VERSION */
+    Uint4 byte_order;   /**< BLAST_COLUMNAR_BYTE_ORDER */
+} BlastColumnarFileHeader;
+
+/** Header of a block; the query table, the hit columns, the traceback
+    entries and the string pool follow in that order */
+typedef struct BlastColumnarBlockHeader {
+    char magic[8];      /**< BLAST_COLUMNAR_BLOCK_MAGIC */
+    Int8 size;          /**< Size of the block including this header */
+    Int4 program;       /**< EBlastProgramType of the search */
+    Uint4 flags;        /**< BLAST_COLUMNAR_* flags */
+    Int4 num_queries;   /**< Number of entries in the query table */
+    Int4 num_hits;      /**< Number of entries in every hit column */
+    Int4 num_tb_ops;    /**< Number of traceback entries */
+    Int4 strings_size;  /**< Size of the string pool */
+    Int4 db_name;       /**< Offset of the database name in the string pool,
+                             or -1 */
+    Int4 reserved;      /**< Padding, always 0 */
+} BlastColumnarBlockHeader;
+
+/** Entry of the query table */
+typedef struct BlastColumnarQuery {
+    Int4 from;          /**< Start of the searched query interval */
+    Int4 to;            /**< End of the searched query interval */
+    Int4 strand;        /**< Strand of the searched query interval */
+    Int4 id;            /**< Offset in the string pool of the Seq-id, in
+                             FASTA format */
+    Int4 label;         /**< Offset in the string pool of the label used in
+                             tabular output when the query identifiers were
+                             not parsed */
+    Int4 reserved;      /**< Padding, always 0 */
+} BlastColumnarQuery;
+
+/** One block of a columnar file as seen by a reader. The arrays point into
+ * the file contents and are valid until the reader is freed. Offsets are
+ * 0-based and in the coordinates of the query context and subject frame,
+ * as in BlastHSP.
+ */
+typedef struct BlastColumnarBlock {
+    EBlastProgramType program;  /**< Type of BLAST program */
+    Uint4 flags;                /**< BLAST_COLUMNAR_* flags */
+    const char* db_name;        /**< Database searched, or NULL */
+    Int4 num_queries;           /**< Number of queries */
+    const BlastColumnarQuery* queries; /**< Query table */
+    const char* strings;        /**< String pool */
+    Int4 num_strings;           /**< Size of the string pool */
+    Int4 num_hits;              /**< Number of hits (HSPs) */
+    const Int4* query_index;    /**< Index of the query in the query table */
+    const Int4* context;        /**< Query context, as in BlastHSP */
+    const Int4* subject_oid;    /**< Ordinal id of the subject */
+    const Int4* subject_length; /**< Length of the subject */
+    const Int4* query_start;    /**< Start of the alignment on the query */
+    const Int4* query_end;      /**< End of the alignment on the query */
+    const Int4* subject_start;  /**< Start of the alignment on the subject */
+    const Int4* subject_end;    /**< End of the alignment on the subject */
+    const Int4* score;          /**< Raw score */
+    const Int4* num_ident;      /**< Number of identities */
+    const Int4* align_length;   /**< Length of the alignment */
+    const Int4* mismatches;     /**< Number of mismatches */
+    const Int4* gap_opens;      /**< Number of gap openings */
+    const Int4* num;            /**< Number of HSPs in the linked set */
+    const Int4* tb_offset;      /**< First traceback entry of the hit, or -1 */
+    const Int4* tb_size;        /**< Number of traceback entries of the hit */
+    const Int2* query_frame;    /**< Query frame */
+    const Int2* subject_frame;  /**< Subject frame */
+    const Int2* comp_adjustment_method; /**< Composition adjustment mode */
+    const double* evalue;       /**< Expect value */
+    const double* bit_score;    /**< Bit score */
+    Int4 num_tb_ops;            /**< Number of traceback entries */
+    const Int4* tb_ops;         /**< Traceback entries: number of operations
+                                     shifted left by BLAST_COLUMNAR_OP_BITS,
+                                     or'ed with the EGapAlignOpType */
+} BlastColumnarBlock;
+
+/** Writer appending blocks to a columnar file. */
+typedef struct BlastColumnarWriter BlastColumnarWriter;
+
+/** Reader walking through the blocks of a columnar file. */
+typedef struct BlastColumnarReader BlastColumnarReader;
+
+/** Open a columnar file for appending, creating it if necessary.
+ * @param filename Name of the file [in]
+ * @param with_traceback Should the edit scripts of gapped alignments be
+ *                       saved? They are needed to convert the results back to
+ *                       Seq-aligns. [in]
+ * @return The writer, or NULL if the file could not be opened
+ */
+BlastColumnarWriter*
+BlastColumnarWriterNew(const char* filename, Boolean with_traceback);
+
+/** Close the file and free the writer.
+ * @param writer The writer to free [in]
+ * @return NULL
+ */
+BlastColumnarWriter*
+BlastColumnarWriterFree(BlastColumnarWriter* writer);
+
+/** Append the results of one search to the file as a single block.
+ * @param writer The writer [in]
+ * @param program Type of BLAST program [in]
+ * @param results The results, with the offsets of every HSP in the
+ *                coordinates of its query [in]
+ * @param query_slp List of the query locations searched, one per
+ *                  results->hitlist_array entry [in]
+ * @param db_name Name of the database searched, or NULL [in]
+ * @param rdfp The database, used to look up subject lengths [in]
+ * @param is_gapped Was the search gapped? [in]
+ * @param is_ooframe Was out-of-frame gapping used? [in]
+ * @param believe_query Were the query identifiers parsed? [in]
+ * @return 0 on success, -1 if out of memory, -2 if the file could not be
+ *         written
+ */
+Int2
+BlastColumnarWriteResults(BlastColumnarWriter* writer,
+                          EBlastProgramType program,
+                          const BlastHSPResults* results,
+                          SeqLoc* query_slp, const char* db_name,
+                          ReadDBFILE* rdfp, Boolean is_gapped,
+                          Boolean is_ooframe, Boolean believe_query);
+
+/** Open a columnar file for reading. The file is memory mapped if
+ * possible, and read into memory otherwise.
+ * @param filename Name of the file [in]
+ * @return The reader, or NULL if the file could not be read or is not a
+ *         columnar file written on a machine with the same byte order
+ */
+BlastColumnarReader*
+BlastColumnarReaderNew(const char* filename);
+
+/** Free the reader and release the file contents.
+ * @param reader The reader to free [in]
+ * @return NULL
+ */
+BlastColumnarReader*
+BlastColumnarReaderFree(BlastColumnarReader* reader);
+
+/** Get the next block of the file. A damaged or incomplete block, for
+ * example one left by a process that was killed while appending, ends the
+ * file and is reported with ErrPostEx.
+ * @param reader The reader [in]
+ * @param block Filled with the block contents [out]
+ * @return TRUE if a block was found, FALSE at the end of the file
+ */
+Boolean
+BlastColumnarReaderNextBlock(BlastColumnarReader* reader,
+                             BlastColumnarBlock* block);
+
+/** Get the start and end of a hit in 1-based nucleotide or protein
+ * coordinates, as shown in tabular output; the start is past the end on
+ * the minus strand.
+ * @param block The block [in]
+ * @param hit Index of the hit in the block [in]
+ * @param q_start Start of the alignment on the query [out]
+ * @param q_end End of the alignment on the query [out]
+ * @param s_start Start of the alignment on the subject [out]
+ * @param s_end End of the alignment on the subject [out]
+ */
+void
+BlastColumnarGetAdjustedOffsets(const BlastColumnarBlock* block, Int4 hit,
+                                Int4* q_start, Int4* q_end,
+                                Int4* s_start, Int4* s_end);
+
+/** Rebuild the query locations of a block.
+ * @param block The block [in]
+ * @return Linked list of Seq-locs, one per query, to be freed with
+ *         FreeSeqLocSetComponents and SeqLocSetFree
+ */
+SeqLoc*
+BlastColumnarBlockGetQuerySeqLocs(const BlastColumnarBlock* block);
+
+/** Rebuild the BLAST results structure of a block.
+ * @param block The block [in]
+ * @param results The results, with one hit list per query [out]
+ * @return 0 on success, -1 if out of memory
+ */
+Int2
+BlastColumnarBlockToHSPResults(const BlastColumnarBlock* block,
+                               BlastHSPResults** results);
+
+/** Convert the results of a block to Seq-aligns, as the search would have
+ * returned them.
+ * @param block The block [in]
+ * @param rdfp The database searched, for the subject Seq-ids [in]
+ * @param query_slp The query locations, as returned by
+ *                  BlastColumnarBlockGetQuerySeqLocs [in]
+ * @param seqalign_arr The Seq-aligns, one list per query [out]
+ * @return 0 on success, -1 on failure; gapped results can only be converted
+ *         if the block contains the traceback
+ */
+Int2
+BlastColumnarBlockToSeqAlign(const BlastColumnarBlock* block,
+                             ReadDBFILE* rdfp, SeqLoc* query_slp,
+                             SBlastSeqalignArray** seqalign_arr);
+
+/** Write the results of a block in the format of the tabular (-m 8)
+ * output.
+ * @param block The block [in]
+ * @param rdfp The database searched, for the subject Seq-ids [in]
+ * @param obuf Where to write the output [in]
+ * @param show_gi Show gi's instead of full ids, if possible [in]
+ * @param show_accession Show accessions instead of full ids, if possible.
+ *                       This option has lower priority than show_gi. [in]
+ * @return 0 on success, -1 on failure
+ */
+Int2
+BlastColumnarBlockPrintTabular(const BlastColumnarBlock* block,
+                               ReadDBFILE* rdfp, OutBuf* obuf,
+                               Boolean show_gi, Boolean show_accession);
+
+/* @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !__BLAST_COLUMNAR__ */
@@ -490,8 +490,6 @@ Int2 BlastFormattingInfoNew(EAlignView align_view,
       info->outfp = outfp;
    } else {
       char write_mode[3];
-      /* AsnIoOpen requires a non-const argument, so use a local variable. */
-      char* filename_copy = strdup(outfile_name);
       if (align_view == eAlignViewXml)
           strcpy(write_mode, "wx");
       else if (align_view == eAlignViewAsnText)
@@ -499,12 +497,17 @@ Int2 BlastFormattingInfoNew(EAlignView align_view,
       else
           strcpy(write_mode, "wb"); 
       
-      if ((info->aip = AsnIoOpen(filename_copy, write_mode)) == NULL)
+      /* The ASN.1 writer's small blocks are collected in a large OutBuf
+         before they reach the file. */
+      if ((info->aip_fp = FileOpen(outfile_name, 
+                          (align_view == eAlignViewAsnBinary) ? "wb" : "w")) 
+          == NULL ||
+          (info->aip_obuf = OutBufNew(info->aip_fp, 0)) == NULL ||
+          (info->aip = AsnIoOutBufOpen(write_mode, info->aip_obuf)) == NULL)
       {
-          ErrPostEx(SEV_WARNING, 0, 0, "Unable to open output file %s:", filename_copy);
+          ErrPostEx(SEV_WARNING, 0, 0, "Unable to open output file %s:", outfile_name);
           return -1;
       }
-      sfree(filename_copy);
    }
    info->is_seqalign_null = TRUE; /* will be updated in BLAST_FormatResults */
    info->head_on_every_query = FALSE; /* One header for a file is the default. */
@@ -575,6 +578,11 @@ BlastFormattingInfo* BlastFormattingInfoFree(BlastFormattingInfo* info)
     } else if (info->aip) {
         AsnIoClose(info->aip);
     }
+    /* Both of the above write out what aip still holds; only then can the
+       buffer behind it be emptied. */
+    info->aip_obuf = OutBufFree(info->aip_obuf);
+    if (info->aip_fp)
+        FileClose(info->aip_fp);
     sfree(info->program_name);
     sfree(info->db_name);
     sfree(info->format_options);
@@ -731,52 +739,61 @@ s_AcknowledgeEmptyResults(SeqLoc *slp,
     fprintf(outfp, " ***** No hits found ******\n\n\n");
 }
 
-Int2 BLAST_FormatResults(SBlastSeqalignArray* seqalign_arr, Int4 num_queries, 
-        SeqLoc* query_slp, SeqLoc* mask_loc_head, 
-        BlastFormattingInfo* format_info,
-        Blast_SummaryReturn* sum_returns)
-{  
-   SeqLoc* mask_loc;
-   SeqLoc* next_mask_loc = NULL;
-   SeqLoc* tmp_loc = NULL;
-   Uint1 align_type;
+/** State of one output stream while a set of queries is being formatted. */
+typedef struct SBlastFormatPass {
+   BlastFormattingInfo* format_info; /**< Formatting options and streams */
+   Blast_SummaryReturn* sum_returns; /**< Summary data from the search */
+   SeqLoc* mask_loc;        /**< Masking locations of the queries not yet
+                                 formatted */
+   AsnIo* aip;              /**< ASN.1 output, for the ASN.1 views */
+   MBXml* xmlp;             /**< XML output, for the XML view */
+   FILE* outfp;             /**< Text output, for all other views */
+   Uint1 align_type;        /**< Type of the alignments, for Seq-annots */
+   Boolean ungapped;        /**< Was the search ungapped? */
+} SBlastFormatPass;
+
+/** Set up the output stream and the database fetching for formatting a set
+ * of queries.
+ * @param pass The state to initialize [out]
+ * @param query_slp Linked list of query SeqLocs [in]
+ * @param mask_loc_head Masking locations for all queries [in]
+ * @param format_info Formatting options and other information [in]
+ * @param sum_returns Summary data returned from the search [in]
+ */
+static void
+s_FormatPassBegin(SBlastFormatPass* pass, SeqLoc* query_slp,
+                  SeqLoc* mask_loc_head, BlastFormattingInfo* format_info,
+                  Blast_SummaryReturn* sum_returns)
+{
+   BlastFormattingOptions* format_options = format_info->format_options;
+   EAlignView align_view = format_options->align_view;
    Boolean db_is_na;
-   Int4 query_index;
-   SeqLoc* slp;
-   SeqLoc* mask_slp;
-   AsnIo* aip = NULL;
-   MBXml* xmlp = NULL;
-   FILE *outfp = NULL;
-   BlastFormattingOptions* format_options;
-   EAlignView align_view;
-   Boolean ungapped;
 
-   ASSERT(format_info && format_info->format_options && 
-          format_info->search_options && query_slp);
-
-   format_options = format_info->format_options;
-   align_view = format_options->align_view;
-   ungapped = 
+   memset(pass, 0, sizeof(SBlastFormatPass));
+   pass->format_info = format_info;
+   pass->sum_returns = sum_returns;
+   pass->mask_loc = mask_loc_head;
+   pass->ungapped = 
        !format_info->search_options->score_options->gapped_calculation;
 
    if (align_view == eAlignViewXml) {
        const Int4 kXmlFlag = 0; /* Change to BXML_INCLUDE_QUERY if inclusion
                                    of query sequence is desired in the XML
                                    output header. */
-       xmlp = format_info->xmlp;
-       if (!xmlp) {
-           xmlp = format_info->xmlp = 
+       pass->xmlp = format_info->xmlp;
+       if (!pass->xmlp) {
+           pass->xmlp = format_info->xmlp = 
                s_MBXmlInit(format_info->aip, format_info->program_name, 
                            format_info->db_name, query_slp, kXmlFlag, 
                            sum_returns->search_params);
        }
    } else if (align_view == eAlignViewAsnText || 
               align_view == eAlignViewAsnBinary)
-       aip = format_info->aip; 
+       pass->aip = format_info->aip; 
    else 
-       outfp = format_info->outfp;
+       pass->outfp = format_info->outfp;
 
-   align_type = 
+   pass->align_type = 
        GetOldAlignType(format_info->search_options->program, &db_is_na);
 
    if (format_info->db_name) {
@@ -793,184 +810,211 @@ Int2 BLAST_FormatResults(SBlastSeqalignArray* seqalign_arr, Int4 num_queries,
         ErrPostEx(SEV_WARNING, 0, 0, 
          "Out-of-frame option selected, Expect values are only approximate and calculated not assuming out-of-frame alignments");
    }
+}
 
+/** Format the Seq-aligns of one query.
+ * @param pass The formatting state [in] [out]
+ * @param seqalign The Seq-aligns of this query, NULL if it has no hits [in]
+ * @param query_index Index of the query in the current set [in]
+ * @param slp SeqLoc of this query [in]
+ */
+static void
+s_FormatPassQuery(SBlastFormatPass* pass, SeqAlign* seqalign,
+                  Int4 query_index, SeqLoc* slp)
+{
+   BlastFormattingInfo* format_info = pass->format_info;
+   BlastFormattingOptions* format_options = format_info->format_options;
+   Blast_SummaryReturn* sum_returns = pass->sum_returns;
+   EAlignView align_view = format_options->align_view;
+   Boolean ungapped = pass->ungapped;
+   MBXml* xmlp = pass->xmlp;
+   AsnIo* aip = pass->aip;
+   FILE* outfp = pass->outfp;
+   SeqLoc* mask_loc = pass->mask_loc;
+   SeqLoc* next_mask_loc = NULL;
+   SeqLoc* tmp_loc = NULL;
+   SeqLoc* mask_slp;
+   Bioseq* bsp = NULL;
+   /* Find which query the current SeqAlign is for */
+   SeqId* query_id = TxGetQueryIdFromSeqAlign(seqalign);
 
-   slp = query_slp;
-   mask_loc = mask_loc_head;
-  
-   for (query_index=0; query_index<seqalign_arr->num_queries && slp; query_index++, slp=slp->next)
+   if (seqalign == NULL)
    {
-      Bioseq* bsp = NULL;
-      SeqAlignPtr seqalign = seqalign_arr->array[query_index];
-      /* Find which query the current SeqAlign is for */
-      SeqId* query_id = TxGetQueryIdFromSeqAlign(seqalign);
-      if (seqalign == NULL)
-      {
-            if (align_view < eAlignViewXml)
-                s_AcknowledgeEmptyResults(slp, format_options, format_info, outfp);  /* this query has no results. */
-            else if (align_view == eAlignViewXml)
-            {
-                /* Retrieve this query's Bioseq */
-                Iteration* iterp;
-                /* Call to TxGetQueryIdFromSeqAlign returned NULL. */
-                query_id = SeqLocId(slp);
-      		bsp = BioseqLockById(query_id);
-                iterp = s_XMLBuildOneQueryIteration(NULL, sum_returns, FALSE, ungapped, 
-                                         query_index+1+format_info->num_formatted,
-                                         "No hits found", bsp, NULL);
-                IterationAsnWrite(iterp, xmlp->aip, xmlp->atp);
-                AsnIoFlush(xmlp->aip);
-                IterationFree(iterp);
-      		BioseqUnlock(bsp);
-            }
-            else if (align_view == eAlignViewTabularWithComments)
-            {
-                 query_id = SeqLocId(slp);
-      		 bsp = BioseqLockById(query_id);
-                 PrintTabularOutputHeader(format_info->db_name, bsp, NULL, 
-                                     format_info->program_name,
-                                     0, format_options->believe_query, outfp);
-      		 BioseqUnlock(bsp);
-            }
-            continue;
-      }
-      format_info->is_seqalign_null = FALSE; /* reset flag, at least one query has seqalign */
-
-      /* Find the masking location for this query. Initialize next_mask_loc
-	 to the current start of the chain, in case nothing for this query 
-	 will be found. */
-      next_mask_loc = mask_loc;
-      for ( ; mask_loc; mask_loc = mask_loc->next) {
-         mask_slp = (SeqLoc*) mask_loc->data.ptrvalue;
-         if (SeqIdComp(query_id, SeqLocId(mask_slp)) == SIC_YES) {
-            break;
+         if (align_view < eAlignViewXml)
+             s_AcknowledgeEmptyResults(slp, format_options, format_info, outfp);  /* this query has no results. */
+         else if (align_view == eAlignViewXml)
+         {
+             /* Retrieve this query's Bioseq */
+             Iteration* iterp;
+             /* Call to TxGetQueryIdFromSeqAlign returned NULL. */
+             query_id = SeqLocId(slp);
+   	     bsp = BioseqLockById(query_id);
+             iterp = s_XMLBuildOneQueryIteration(NULL, sum_returns, FALSE, ungapped, 
+                                      query_index+1+format_info->num_formatted,
+                                      "No hits found", bsp, NULL);
+             IterationAsnWrite(iterp, xmlp->aip, xmlp->atp);
+             AsnIoFlush(xmlp->aip);
+             IterationFree(iterp);
+   	     BioseqUnlock(bsp);
+         }
+         else if (align_view == eAlignViewTabularWithComments)
+         {
+              query_id = SeqLocId(slp);
+   	      bsp = BioseqLockById(query_id);
+              PrintTabularOutputHeader(format_info->db_name, bsp, NULL, 
+                                  format_info->program_name,
+                                  0, format_options->believe_query, outfp);
+   	      BioseqUnlock(bsp);
          }
+         return;
+   }
+   format_info->is_seqalign_null = FALSE; /* reset flag, at least one query has seqalign */
+
+   /* Find the masking location for this query. Initialize next_mask_loc
+      to the current start of the chain, in case nothing for this query 
+      will be found. */
+   next_mask_loc = mask_loc;
+   for ( ; mask_loc; mask_loc = mask_loc->next) {
+      mask_slp = (SeqLoc*) mask_loc->data.ptrvalue;
+      if (SeqIdComp(query_id, SeqLocId(mask_slp)) == SIC_YES) {
+         break;
       }
-      /* Unlink the masking location for this query and save the next one */
-      if (mask_loc) {
-         for (next_mask_loc = mask_loc; next_mask_loc->next; 
-              next_mask_loc = next_mask_loc->next) {
-            mask_slp = (SeqLoc*) next_mask_loc->next->data.ptrvalue;
-            if (SeqIdComp(query_id, SeqLocId(mask_slp))
-                != SIC_YES) {
-               break;
-            }
+   }
+   /* Unlink the masking location for this query and save the next one */
+   if (mask_loc) {
+      for (next_mask_loc = mask_loc; next_mask_loc->next; 
+           next_mask_loc = next_mask_loc->next) {
+         mask_slp = (SeqLoc*) next_mask_loc->next->data.ptrvalue;
+         if (SeqIdComp(query_id, SeqLocId(mask_slp))
+             != SIC_YES) {
+            break;
          }
-         tmp_loc = next_mask_loc;
-         next_mask_loc = next_mask_loc->next;
-         tmp_loc->next = NULL;
       }
+      tmp_loc = next_mask_loc;
+      next_mask_loc = next_mask_loc->next;
+      tmp_loc->next = NULL;
+   }
 
-      /* On the next iteration we can start from the next query */
+   /* On the next iteration we can start from the next query */
 
-      /* Retrieve this query's Bioseq */
-      bsp = BioseqLockById(query_id);
+   /* Retrieve this query's Bioseq */
+   bsp = BioseqLockById(query_id);
 
-      if (align_view < eAlignViewXml) {
-         if (format_info->head_on_every_query == TRUE)
-             BLAST_PrintOutputHeader(format_info);
+   if (align_view < eAlignViewXml) {
+      if (format_info->head_on_every_query == TRUE)
+          BLAST_PrintOutputHeader(format_info);
 
-         init_buff_ex(70);
-         AcknowledgeBlastQuery(bsp, 70, outfp, 
-            format_options->believe_query, format_options->html);
-         free_buff();
+      init_buff_ex(70);
+      AcknowledgeBlastQuery(bsp, 70, outfp, 
+         format_options->believe_query, format_options->html);
+      free_buff();
 
-         if (format_info->head_on_every_query == TRUE)
-         {
-             s_BLAST_PrintDatabaseInfo(format_info);
-             fprintf(format_info->outfp, "%s", "Searching..................................................done\n\n");
-         }
+      if (format_info->head_on_every_query == TRUE)
+      {
+          s_BLAST_PrintDatabaseInfo(format_info);
+          fprintf(format_info->outfp, "%s", "Searching..................................................done\n\n");
       }
-      if (align_view == eAlignViewTabular || 
-          align_view == eAlignViewTabularWithComments) {
-         if (align_view == eAlignViewTabularWithComments)
-            PrintTabularOutputHeader(format_info->db_name, bsp, NULL, 
-                                     format_info->program_name,
-                                     0, format_options->believe_query, outfp);
-         
-         BlastPrintTabulatedResults(seqalign, bsp, NULL, 
-            format_options->number_of_alignments, format_info->program_name, 
-            ungapped, format_options->believe_query, 0, 0, 
-            outfp, (Boolean)(align_view == eAlignViewTabularWithComments));
-      } else if(align_view == eAlignViewXml) {
-         Iteration* iterp;
+   }
+   if (align_view == eAlignViewTabular || 
+       align_view == eAlignViewTabularWithComments) {
+      if (align_view == eAlignViewTabularWithComments)
+         PrintTabularOutputHeader(format_info->db_name, bsp, NULL, 
+                                  format_info->program_name,
+                                  0, format_options->believe_query, outfp);
+      
+      BlastPrintTabulatedResults(seqalign, bsp, NULL, 
+         format_options->number_of_alignments, format_info->program_name, 
+         ungapped, format_options->believe_query, 0, 0, 
+         outfp, (Boolean)(align_view == eAlignViewTabularWithComments));
+   } else if(align_view == eAlignViewXml) {
+      Iteration* iterp;
+      
+      ASSERT(xmlp && xmlp->aip);
+      /* The index of this "query iteration" is the query_index in the 
+         current formatting round, plus the number of previously formatted
+         queries. */
+      iterp = 
+          s_XMLBuildOneQueryIteration(seqalign, sum_returns, FALSE, 
+                                      ungapped, 
+                                      query_index+1+format_info->num_formatted,
+                                      NULL, bsp, mask_loc);
+      IterationAsnWrite(iterp, xmlp->aip, xmlp->atp);
+      AsnIoFlush(xmlp->aip);
+      IterationFree(iterp);
+   } else {
+      SeqAnnot* seqannot = SeqAnnotNew();
+      seqannot->type = 2;
+      AddAlignInfoToSeqAnnot(seqannot, pass->align_type);
+      seqannot->data = seqalign;
+      if (aip) {
+         SeqAnnotAsnWrite((SeqAnnot*) seqannot, aip, NULL);
+         AsnIoReset(aip);
+      } 
+      if (outfp) {
+         BlastPruneSapStruct* prune;
+         Int4** matrix = s_LoadMatrix(sum_returns->search_params->matrix);
+         ObjMgrSetHold();
+         init_buff_ex(85);
+         PrintDefLinesFromSeqAlignEx2(seqalign, 80, outfp, 
+            format_options->print_options, FIRST_PASS, NULL,
+            format_options->number_of_descriptions, NULL, NULL);
+         free_buff();
          
-         ASSERT(xmlp && xmlp->aip);
-         /* The index of this "query iteration" is the query_index in the 
-            current formatting round, plus the number of previously formatted
-            queries. */
-         iterp = 
-             s_XMLBuildOneQueryIteration(seqalign, sum_returns, FALSE, 
-                                         ungapped, 
-                                         query_index+1+format_info->num_formatted,
-                                         NULL, bsp, mask_loc);
-         IterationAsnWrite(iterp, xmlp->aip, xmlp->atp);
-         AsnIoFlush(xmlp->aip);
-         IterationFree(iterp);
-      } else {
-         SeqAnnot* seqannot = SeqAnnotNew();
-         seqannot->type = 2;
-         AddAlignInfoToSeqAnnot(seqannot, align_type);
-         seqannot->data = seqalign;
-         if (aip) {
-            SeqAnnotAsnWrite((SeqAnnot*) seqannot, aip, NULL);
-            AsnIoReset(aip);
-         } 
-         if (outfp) {
-            BlastPruneSapStruct* prune;
-            Int4** matrix = s_LoadMatrix(sum_returns->search_params->matrix);
-            ObjMgrSetHold();
-            init_buff_ex(85);
-            PrintDefLinesFromSeqAlignEx2(seqalign, 80, outfp, 
-               format_options->print_options, FIRST_PASS, NULL,
-               format_options->number_of_descriptions, NULL, NULL);
-            free_buff();
-            
-            /** @todo FIXME: note that by calling BlastPruneHitsFromSeqAlign
-             * we're making a COPY of the seqalign to print it out! Clearly
-             * this could use a better design */
-            prune = BlastPruneHitsFromSeqAlign(seqalign, 
-                       format_options->number_of_alignments, NULL);
-            seqannot->data = prune->sap;
-
-            if(format_info->search_options->score_options->is_ooframe) {
-               OOFShowBlastAlignment(prune->sap, mask_loc, outfp, 
-                                     format_options->align_options, NULL);
-            } else if (align_view != eAlignViewPairwise) {
-               ShowTextAlignFromAnnot(seqannot, 60, outfp, NULL, NULL, 
-                  format_options->align_options, matrix, mask_loc, NULL);
-            } else {
-               ShowTextAlignFromAnnot(seqannot, 60, outfp, NULL, NULL, 
-                  format_options->align_options, matrix, mask_loc, 
-                  FormatScoreFunc);
-            }
-            s_DeleteMatrix(matrix);
-            seqannot->data = seqalign;
-            prune = BlastPruneSapStructDestruct(prune);
-            ObjMgrClearHold();
+         /** @todo FIXME: note that by calling BlastPruneHitsFromSeqAlign
+          * we're making a COPY of the seqalign to print it out! Clearly
+          * this could use a better design */
+         prune = BlastPruneHitsFromSeqAlign(seqalign, 
+                    format_options->number_of_alignments, NULL);
+         seqannot->data = prune->sap;
+
+         if(format_info->search_options->score_options->is_ooframe) {
+            OOFShowBlastAlignment(prune->sap, mask_loc, outfp, 
+                                  format_options->align_options, NULL);
+         } else if (align_view != eAlignViewPairwise) {
+            ShowTextAlignFromAnnot(seqannot, 60, outfp, NULL, NULL, 
+               format_options->align_options, matrix, mask_loc, NULL);
+         } else {
+            ShowTextAlignFromAnnot(seqannot, 60, outfp, NULL, NULL, 
+               format_options->align_options, matrix, mask_loc, 
+               FormatScoreFunc);
          }
-         /* Set data to NULL, because we do not free Seq-align here. */
-         seqannot->data = NULL;
-         seqannot = SeqAnnotFree(seqannot);
+         s_DeleteMatrix(matrix);
+         seqannot->data = seqalign;
+         prune = BlastPruneSapStructDestruct(prune);
+         ObjMgrClearHold();
       }
-      BioseqUnlock(bsp);
-      /* Relink the mask locations so chain can be freed in the end.
-       The 'tmp_loc' variable points to the location that was unlinked. */
-      if (tmp_loc)
-          tmp_loc->next = next_mask_loc;
-      
-      mask_loc = next_mask_loc;
-      ObjMgrFreeCache(0);
+      /* Set data to NULL, because we do not free Seq-align here. */
+      seqannot->data = NULL;
+      seqannot = SeqAnnotFree(seqannot);
+   }
+   BioseqUnlock(bsp);
+   /* Relink the mask locations so chain can be freed in the end.
+    The 'tmp_loc' variable points to the location that was unlinked. */
+   if (tmp_loc)
+       tmp_loc->next = next_mask_loc;
+   
+   pass->mask_loc = next_mask_loc;
+   ObjMgrFreeCache(0);
+}
 
-   } /* End loop on seqaligns for different queries */
+/** Finish formatting a set of queries.
+ * @param pass The formatting state [in]
+ * @param num_queries Number of queries in the set [in]
+ */
+static void
+s_FormatPassEnd(SBlastFormatPass* pass, Int4 num_queries)
+{
+   BlastFormattingInfo* format_info = pass->format_info;
+   MBXml* xmlp = pass->xmlp;
 
    /* close BlastOutput_iterations openned in s_MBXmlInit; Rt ticket # 15135151 */
-   if((format_info->is_seqalign_null==TRUE) && (align_view == eAlignViewXml)) {
+   if((format_info->is_seqalign_null==TRUE) && 
+      (format_info->format_options->align_view == eAlignViewXml)) {
      /* extra output only if no hits at all, otherwise "for loop" logic should take care*/
      Iteration* iterp;    
      iterp = IterationNew();
      iterp->iter_num = 1;
-     iterp->stat = s_XMLBuildStatistics(sum_returns, ungapped);
+     iterp->stat = s_XMLBuildStatistics(pass->sum_returns, pass->ungapped);
 
      ASSERT(xmlp && xmlp->aip);
      IterationAsnWrite(iterp, xmlp->aip, xmlp->atp);
@@ -987,10 +1031,114 @@ Int2 BLAST_FormatResults(SBlastSeqalignArray* seqalign_arr, Int4 num_queries,
 
    /* Update the count of the formatted queries. */
    format_info->num_formatted += num_queries;
+}
+
+Int2 BLAST_FormatResults(SBlastSeqalignArray* seqalign_arr, Int4 num_queries, 
+        SeqLoc* query_slp, SeqLoc* mask_loc_head, 
+        BlastFormattingInfo* format_info,
+        Blast_SummaryReturn* sum_returns)
+{  
+   SBlastFormatPass pass;
+   Int4 query_index;
+   SeqLoc* slp;
+
+   ASSERT(format_info && format_info->format_options && 
+          format_info->search_options && query_slp);
+
+   s_FormatPassBegin(&pass, query_slp, mask_loc_head, format_info,
+                     sum_returns);
+
+   slp = query_slp;
+   for (query_index=0; query_index<seqalign_arr->num_queries && slp; query_index++, slp=slp->next)
+   {
+      s_FormatPassQuery(&pass, seqalign_arr->array[query_index], query_index,
+                        slp);
+   } /* End loop on seqaligns for different queries */
+
+   s_FormatPassEnd(&pass, num_queries);
 
    return 0;
 }
 
+Int2 BLAST_FormatHSPResults(BlastHSPResults** results_ptr, Int4 num_queries, 
+        SeqLoc* query_slp, SeqLoc* subject_slp, SeqLoc* mask_loc_head, 
+        BlastFormattingInfo** format_info_array, Int4 num_formats,
+        Blast_SummaryReturn* sum_returns)
+{
+   SBlastFormatPass* passes;
+   const SBlastOptions* search_options;
+   BlastHSPResults* results;
+   ReadDBFILE* rdfp = NULL;
+   Int4 query_index, index;
+   SeqLoc* slp;
+   Int2 status = 0;
+
+   if (!results_ptr || !format_info_array || num_formats <= 0 || !query_slp)
+      return -1;
+
+   results = *results_ptr;
+   search_options = format_info_array[0]->search_options;
+   ASSERT(search_options);
+
+   if (format_info_array[0]->db_name) {
+      /* The Seq-ids of the subjects come from the database; the formatting
+         passes open it separately for fetching the sequences. */
+      Boolean db_is_na;
+      GetOldAlignType(search_options->program, &db_is_na);
+      if ((rdfp = readdb_new(format_info_array[0]->db_name, !db_is_na))
+          == NULL)
+         return -1;
+   } else if (!subject_slp) {
+      return -1;
+   }
+
+   passes = (SBlastFormatPass*) calloc(num_formats, sizeof(SBlastFormatPass));
+   if (!passes) {
+      readdb_destruct(rdfp);
+      return -1;
+   }
+   for (index = 0; index < num_formats; ++index) {
+      ASSERT(format_info_array[index] && 
+             format_info_array[index]->format_options && 
+             format_info_array[index]->search_options);
+      s_FormatPassBegin(&passes[index], query_slp, mask_loc_head, 
+                        format_info_array[index], sum_returns);
+   }
+
+   /* Build the Seq-aligns of one query at a time and give them to every
+      output before building those of the next one, so that the Seq-aligns
+      of all queries are never held at the same time. */
+   slp = query_slp;
+   for (query_index = 0; query_index < num_queries && slp; 
+        ++query_index, slp = slp->next) {
+      SeqAlign* seqalign = NULL;
+
+      if (results && query_index < results->num_queries) {
+         status = 
+            BLAST_QueryResultsToSeqAlign(search_options->program, results,
+               query_index, slp, rdfp, subject_slp,
+               search_options->score_options->gapped_calculation,
+               search_options->score_options->is_ooframe, &seqalign);
+         if (status)
+            break;
+      }
+
+      for (index = 0; index < num_formats; ++index)
+         s_FormatPassQuery(&passes[index], seqalign, query_index, slp);
+
+      seqalign = SeqAlignSetFree(seqalign);
+   }
+
+   for (index = 0; index < num_formats; ++index)
+      s_FormatPassEnd(&passes[index], num_queries);
+
+   sfree(passes);
+   readdb_destruct(rdfp);
+   *results_ptr = Blast_HSPResultsFree(results);
+
+   return status;
+}
+
 /** Creates a list of SeqLoc structures with data about PHI BLAST pattern 
  * occurrences, to be used as features on Query Seq-locs.
  * @param pattern_info Pattern information structure. [in]
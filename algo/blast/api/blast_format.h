@@ -85,6 +85,9 @@ typedef enum EAlignView {
     eAlignViewAsnText                    = 10,
     /** ASN.1 in binary form. */
     eAlignViewAsnBinary                  = 11,
+    /** Columnar binary results file, see blast_columnar.h. Not produced by
+        BLAST_FormatResults. */
+    eAlignViewColumnar                   = 12,
     /** Sentinel value, binding the allowed range. */
     eAlignViewMax
 } EAlignView;
@@ -116,6 +119,9 @@ typedef struct BlastFormattingInfo {
     BlastFormattingOptions* format_options; /**< Formatting options. */
     FILE* outfp;                 /**< Output stream for text output. */
     AsnIo* aip;                  /**< Output stream for ASN.1 output */
+    FILE* aip_fp;                /**< File behind aip */
+    OutBuf* aip_obuf;            /**< Large-block buffer between aip and 
+                                    aip_fp */
     MBXml* xmlp;                 /**< Output stream for XML output */
     Boolean is_seqalign_null;    /**< flag indicating absence of seqalign */
     Boolean head_on_every_query; /**< Flag indicating that reference, db, etc. should appear
@@ -190,6 +196,32 @@ Int2 BLAST_FormatResults(SBlastSeqalignArray* seqalign_arr, Int4 num_queries,
                          BlastFormattingInfo* format_info,
                          Blast_SummaryReturn* sum_returns);
 
+/** Print formatted output straight from the search results, converting them
+ * to Seq-aligns one query at a time. Each query's hit list is freed once it
+ * has been converted, and its Seq-aligns once they have been written to all
+ * the outputs, so the Seq-aligns of the whole set of queries never exist at
+ * the same time and the first query's report is written before the others
+ * are converted.
+ * @param results_ptr Results of the search; freed on return [in] [out]
+ * @param num_queries Number of query sequences [in]
+ * @param query_slp Linked list of query SeqLocs [in]
+ * @param subject_slp List of subject SeqLocs, if no database was searched [in]
+ * @param mask_loc Masking locations for all queries [in]
+ * @param format_info_array Formatting information for each of the outputs,
+ *                          e.g. the report and a secondary ASN.1 file; all
+ *                          must be for the same search [in]
+ * @param num_formats Number of elements in format_info_array [in]
+ * @param sum_returns Summary data returned from the search. [in]
+ * @return 0 on success, -1 if the database could not be opened or on
+ *         bad arguments.
+ */
+Int2 BLAST_FormatHSPResults(BlastHSPResults** results_ptr, Int4 num_queries,
+                            SeqLocPtr query_slp, SeqLoc* subject_slp,
+                            SeqLoc* mask_loc,
+                            BlastFormattingInfo** format_info_array,
+                            Int4 num_formats,
+                            Blast_SummaryReturn* sum_returns);
+
 /** Print the summary at the end of the BLAST report.
  * @param format_info Formatting options and other information. [in]
  * @param sum_returns infor from inside blast engine [in]
@@ -170,6 +170,16 @@ Int2 SBlastOptionsSetThreshold(SBlastOptions* options, double threshold)
    return 0;
 }
 
+Int2 SBlastOptionsSetCompressedLookup(SBlastOptions* options, 
+                                      Boolean compressed_batches)
+{
+    if (!options || !options->lookup_options)
+        return -1;
+
+    options->lookup_options->compressed_batches = compressed_batches;
+    return 0;
+}
+
 Int2 SBlastOptionsSetWindowSize(SBlastOptions* options, Int4 window_size)
 {
 
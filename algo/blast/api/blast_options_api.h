@@ -141,6 +141,17 @@ Int2 SBlastOptionsSetRewardPenaltyAndGapCosts(SBlastOptions* options,
 Int2 SBlastOptionsSetThreshold(SBlastOptions* options, 
                                double threshold);
 
+/** Allow a blastp database search to use a compressed alphabet lookup
+ * table when a cost model based on the query and database lengths
+ * expects it to be faster. The compressed table finds fewer seeds, so
+ * some weak matches may be missed.
+ * @param options options Options structure to update. [in] [out]
+ * @param compressed_batches TRUE to allow the switch [in]
+ * @return zero unless error
+ */
+Int2 SBlastOptionsSetCompressedLookup(SBlastOptions* options, 
+                                      Boolean compressed_batches);
+
 /** Set window size for two hit extension.
  * @param options options Options structure to update. [in] [out]
  * @param window_size New value to set, if zero default value for matrix
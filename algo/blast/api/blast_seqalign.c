@@ -1286,15 +1286,151 @@ s_HSPListToSeqAlignGapped(EBlastProgramType program_number,
    return status;
 }
 
+/** Convert the results of one query to a chain of Seq-aligns.
+ * @param program_number Type of BLAST program [in]
+ * @param hit_list Results for this query [in]
+ * @param query_slp Seq-loc of this query [in]
+ * @param rdfp Pointer to a BLAST database structure [in]
+ * @param subject_loc_array Subject Seq-locs indexed by oid, when there is no
+ *                          database [in]
+ * @param is_gapped Is this a gapped alignment search? [in]
+ * @param is_ooframe Is this a search with out-of-frame gapping? [in]
+ * @param head_seqalign Start of the Seq-align chain [out]
+ */
+static void
+s_HitListToSeqAlign(EBlastProgramType program_number, BlastHitList* hit_list,
+                    SeqLoc* query_slp, ReadDBFILE* rdfp,
+                    SeqLoc** subject_loc_array, Boolean is_gapped,
+                    Boolean is_ooframe, SeqAlign** head_seqalign)
+{
+   Int4 subject_index;
+   SeqIdPtr query_id, subject_id = NULL;
+   SeqAlignPtr last_seqalign = NULL;
+
+   *head_seqalign = NULL;
+   query_id = SeqLocId(query_slp);
+
+   for (subject_index = 0; subject_index < hit_list->hsplist_count;
+        ++subject_index) {
+      SeqAlignPtr seqalign = NULL;
+      Int4 subject_length = 0;
+      BlastHSPList* hsp_list = hit_list->hsplist_array[subject_index];
+      if (!hsp_list)
+         continue;
+
+      /* Sort HSPs with e-values as first priority and scores as 
+         tie-breakers, since that is the order we want to see them in 
+         in Seq-aligns. */
+      Blast_HSPListSortByEvalue(hsp_list);
+
+      if (rdfp) {
+          /* NB: The following call allocates the SeqId structure. */
+         readdb_get_descriptor(rdfp, hsp_list->oid, &subject_id, NULL);
+         subject_length = readdb_get_sequence_length(rdfp, hsp_list->oid);
+      } else {
+          /* NB: The following call does not allocate the SeqId structure,
+             but returns the existing one. */
+         subject_id = SeqLocId(subject_loc_array[hsp_list->oid]);
+         subject_length = SeqLocLen(subject_loc_array[hsp_list->oid]);
+      }
+
+      if (is_gapped) {
+         s_HSPListToSeqAlignGapped(program_number, hsp_list, query_id, 
+                                   subject_id, SeqLocLen(query_slp),
+                                   subject_length, is_ooframe, &seqalign);
+      } else {
+         s_HSPListToSeqAlignUngapped(program_number, hsp_list, query_id,
+                                     subject_id, SeqLocLen(query_slp), 
+                                     subject_length, &seqalign);
+      }                      
+
+      if (seqalign)
+      {
+          SeqLocPtr subject_loc = NULL;
+          if (subject_loc_array)
+             subject_loc = subject_loc_array[hsp_list->oid];
+          AdjustOffSetsInSeqAlign(seqalign, query_slp, subject_loc); 
+      }
+
+      /* The subject id must be deallocated only in case of a ReadDB 
+         interface */
+      if (rdfp)
+          subject_id = SeqIdSetFree(subject_id);
+
+      if (seqalign) {
+         if (!last_seqalign) {
+            *head_seqalign = last_seqalign = seqalign;
+         } else {
+            last_seqalign->next = seqalign;
+         }
+         for ( ; last_seqalign->next; last_seqalign = last_seqalign->next);
+      }
+   }
+}
+
+/** Index the subject Seq-locs by their position in the list, which is the
+ * oid used in the results.
+ * @param subject_slp List of subject sequences locations [in]
+ * @return Array of the subject locations, NULL if out of memory.
+ */
+static SeqLoc**
+s_SubjectLocArrayNew(SeqLoc* subject_slp)
+{
+   SeqLoc** subject_loc_array;
+   SeqLoc* slp;
+   Int4 subject_index;
+
+   subject_loc_array = 
+      (SeqLoc**) malloc(MAX(ValNodeLen(subject_slp), 1)*sizeof(SeqLoc*));
+   if (!subject_loc_array)
+      return NULL;
+   for (slp = subject_slp, subject_index = 0; slp; slp = slp->next, ++subject_index)
+      subject_loc_array[subject_index] = slp;
+   return subject_loc_array;
+}
+
+Int2 BLAST_QueryResultsToSeqAlign(EBlastProgramType program_number, 
+        BlastHSPResults* results, Int4 query_index, SeqLoc* query_slp, 
+        ReadDBFILE* rdfp, SeqLoc* subject_slp,
+        Boolean is_gapped, Boolean is_ooframe, SeqAlign** seqalign_ptr)
+{
+   SeqLoc** subject_loc_array = NULL;
+   BlastHitList* hit_list;
+
+   if (!seqalign_ptr)
+      return -1;
+   *seqalign_ptr = NULL;
+
+   if (!results || query_index < 0 || query_index >= results->num_queries ||
+       !query_slp)
+      return -1;
+
+   if (!rdfp && !subject_slp)
+      return -1;
+
+   if ((hit_list = results->hitlist_array[query_index]) == NULL)
+      return 0;
+
+   if (!rdfp && (subject_loc_array = s_SubjectLocArrayNew(subject_slp)) == NULL)
+      return -1;
+
+   s_HitListToSeqAlign(program_number, hit_list, query_slp, rdfp,
+                       subject_loc_array, is_gapped, is_ooframe,
+                       seqalign_ptr);
+   results->hitlist_array[query_index] = Blast_HitListFree(hit_list);
+   sfree(subject_loc_array);
+
+   return 0;
+}
+
 Int2 BLAST_ResultsToSeqAlign(EBlastProgramType program_number, 
         BlastHSPResults** results_ptr, SeqLocPtr query_slp, 
         ReadDBFILE* rdfp, SeqLoc* subject_slp,
         Boolean is_gapped, Boolean is_ooframe, 
         SBlastSeqalignArray* *seqalign_arr)
 {
-   Int4 query_index, subject_index;
+   Int4 query_index;
    SeqLocPtr slp = query_slp;
-   SeqIdPtr query_id, subject_id = NULL;
    SeqLoc** subject_loc_array = NULL;
    BlastHSPResults* results = NULL;
    
@@ -1314,80 +1450,19 @@ Int2 BLAST_ResultsToSeqAlign(EBlastProgramType program_number,
       return -1;
    
 
-   if (!rdfp) {
-      subject_loc_array = 
-         (SeqLoc**) malloc(ValNodeLen(subject_slp)*sizeof(SeqLoc*));
-      for (slp = subject_slp, subject_index = 0; slp; slp = slp->next, ++subject_index)
-         subject_loc_array[subject_index] = slp;
-   }
+   if (!rdfp)
+      subject_loc_array = s_SubjectLocArrayNew(subject_slp);
 
    slp = query_slp;
    for (query_index = 0; slp && query_index < results->num_queries; 
         ++query_index, slp = slp->next) {
-      SeqAlignPtr head_seqalign = NULL, last_seqalign = NULL;
       BlastHitList* hit_list = results->hitlist_array[query_index];
       if (!hit_list)
          continue;
 
-      query_id = SeqLocId(slp);
-
-      for (subject_index = 0; subject_index < hit_list->hsplist_count;
-           ++subject_index) {
-         SeqAlignPtr seqalign = NULL;
-         Int4 subject_length = 0;
-         BlastHSPList* hsp_list = hit_list->hsplist_array[subject_index];
-         if (!hsp_list)
-            continue;
-
-         /* Sort HSPs with e-values as first priority and scores as 
-            tie-breakers, since that is the order we want to see them in 
-            in Seq-aligns. */
-         Blast_HSPListSortByEvalue(hsp_list);
-
-         if (rdfp) {
-             /* NB: The following call allocates the SeqId structure. */
-            readdb_get_descriptor(rdfp, hsp_list->oid, &subject_id, NULL);
-            subject_length = readdb_get_sequence_length(rdfp, hsp_list->oid);
-         } else {
-             /* NB: The following call does not allocate the SeqId structure,
-                but returns the existing one. */
-            subject_id = SeqLocId(subject_loc_array[hsp_list->oid]);
-            subject_length = SeqLocLen(subject_loc_array[hsp_list->oid]);
-         }
-
-         if (is_gapped) {
-            s_HSPListToSeqAlignGapped(program_number, hsp_list, query_id, 
-                                      subject_id, SeqLocLen(slp), subject_length,
-                                      is_ooframe, &seqalign);
-         } else {
-            s_HSPListToSeqAlignUngapped(program_number, hsp_list, query_id,
-                                        subject_id, SeqLocLen(slp), 
-                                        subject_length, &seqalign);
-         }                      
-
-         if (seqalign)
-         {
-             SeqLocPtr subject_loc = NULL;
-             if (subject_loc_array)
-                subject_loc = subject_loc_array[hsp_list->oid];
-             AdjustOffSetsInSeqAlign(seqalign, slp, subject_loc); 
-         }
-
-         /* The subject id must be deallocated only in case of a ReadDB 
-            interface */
-         if (rdfp)
-             subject_id = SeqIdSetFree(subject_id);
-
-         if (seqalign) {
-	    if (!last_seqalign) {
-	       head_seqalign = last_seqalign = seqalign;
-	    } else {
-	       last_seqalign->next = seqalign;
-	    }
-	    for ( ; last_seqalign->next; last_seqalign = last_seqalign->next);
-         }
-      }
-      (*seqalign_arr)->array[query_index] = head_seqalign;
+      s_HitListToSeqAlign(program_number, hit_list, slp, rdfp,
+                          subject_loc_array, is_gapped, is_ooframe,
+                          &(*seqalign_arr)->array[query_index]);
       results->hitlist_array[query_index] = Blast_HitListFree(results->hitlist_array[query_index]);
    }
 
@@ -81,6 +81,26 @@ Int2 BLAST_ResultsToSeqAlign(EBlastProgramType program_number,
         ReadDBFILE* rdfp, SeqLoc* subject_slp, 
         Boolean is_gapped, Boolean is_ooframe, SBlastSeqalignArray* *seqalign_arr);
 
+/** Convert the results of one query to a chain of SeqAlign's, so that the
+ * results of a multi-query search can be formatted one query at a time
+ * instead of building the SeqAlign's of all queries first.
+ * @param program_number Type of BLAST program [in]
+ * @param results The BLAST results; the hit list of this query is deleted
+ *                once it has been converted [in|out]
+ * @param query_index Index of the query in results [in]
+ * @param query_slp SeqLoc of this query (not the whole list) [in]
+ * @param rdfp Pointer to a BLAST database structure [in]
+ * @param subject_slp List of subject sequences locations [in]
+ * @param is_gapped Is this a gapped alignment search? [in]
+ * @param is_ooframe Is this a search with out-of-frame gapping? [in]
+ * @param seqalign_ptr SeqAlign's of this query, NULL if it has no hits [out]
+ * @return 0 on success, -1 on bad arguments or out of memory.
+ */
+Int2 BLAST_QueryResultsToSeqAlign(EBlastProgramType program_number, 
+        BlastHSPResults* results, Int4 query_index, SeqLoc* query_slp, 
+        ReadDBFILE* rdfp, SeqLoc* subject_slp, 
+        Boolean is_gapped, Boolean is_ooframe, SeqAlign** seqalign_ptr);
+
 /** Given an internal edit block structure, returns the segments information in
  * form of arrays.
  * @param hsp HSP structure containing traceback for one local alignment [in]
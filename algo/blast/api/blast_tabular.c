@@ -42,6 +42,7 @@ static char const rcsid[] = "$Id: blast_tabular.c,v 1.41 2009/06/01 14:33:38 man
 #include <algo/blast/api/blast_seqalign.h>
 #include <algo/blast/core/blast_seqsrc_impl.h>
 #include <algo/blast/core/gencode_singleton.h>
+#include <ncbithr.h>
 
 #include <txalign.h>
 
@@ -250,319 +251,659 @@ FillNuclSequenceBuffers(EBlastProgramType program, BlastHSP* hsp,
     that are packed into a single seq-annot */
 #define INCREMENTAL_ASN_BATCH_SIZE 50
 
-void* Blast_TabularFormatThread(void* data) 
+/** Initial size of the buffer in which a formatting thread collects the
+    output for one HSP list */
+#define TABULAR_BUFFER_SIZE 8192
+
+/** Room reserved in the output buffer for one tabular line, in addition to
+    the Seq-ids and the aligned sequences */
+#define TABULAR_LINE_SIZE 256
+
+char*
+Blast_TabularGetSubjectId(ReadDBFILE* rdfp, Int4 oid, Boolean show_gi, 
+                          Boolean show_accession, SeqId** subject_id_ptr)
 {
-   BlastTabularFormatData* tf_data;
-   EBlastProgramType program;
-   BlastHSPList* hsp_list = NULL;
-   BlastSeqSrc* seq_src;
-   BLAST_SequenceBlk* query = NULL; 
-   BlastQueryInfo* query_info = NULL;
-   BlastScoringParameters* score_params = NULL;
-   BlastExtensionParameters* ext_params = NULL;
-   BlastHitSavingParameters* hit_params = NULL;
-   BlastEffectiveLengthsParameters* eff_len_params = NULL;
-   Uint1* gen_code_string = NULL;
-   BlastGapAlignStruct* gap_align = NULL;
+   SeqId* subject_id = NULL;
+   char* subject_buffer = NULL;
+   char* descr = NULL;
+   char* rest = NULL;
+
+   if (!readdb_get_descriptor(rdfp, oid, &subject_id, &descr)) {
+       subject_buffer = strdup("Unknown");
+   } else if (subject_id->choice != SEQID_GENERAL ||
+              strcmp(((DbtagPtr)subject_id->data.ptrvalue)->db, 
+                     "BL_ORD_ID")) {
+      /* All cases except when database was formatted without seqid indices. 
+         In that case all real Seq-id information is hidden in the 
+         description. */
+      if (show_gi || show_accession) {
+         Blast_SeqIdGetDefLine(subject_id, &subject_buffer, 
+                               show_gi, show_accession, TRUE); 
+      } else if ((subject_buffer = 
+                  (char*) malloc(sizeof(char)*SEQIDLEN_MAX)) != NULL) {
+         SeqIdWrite(subject_id, subject_buffer, PRINTID_FASTA_LONG, 
+                    SEQIDLEN_MAX-1);
+      }
+      /* Found something for the seqid buffer; description can be 
+         discarded now. */
+      if (subject_buffer != NULL)
+         sfree(descr);
+   }
+
+   /* Last chance to assign anything - take the first token from the 
+      description. */
+   if (!subject_buffer && descr)
+      subject_buffer = StringTokMT(descr, " \t\n\r", &rest);
+   if (!subject_buffer)
+      subject_buffer = strdup("Unknown");
+
+   if (subject_id_ptr)
+      *subject_id_ptr = subject_id;
+   else
+      subject_id = SeqIdSetFree(subject_id);
+
+   return subject_buffer;
+}
+
+struct SBlastTabularWorker;
+
+/** State shared by all threads formatting the same set of results. */
+typedef struct SBlastTabularShared {
+   BlastTabularFormatData* tf_data; /**< Formatting data and options */
+   SeqId** query_id_array; /**< Seq-ids of the queries */
+   Int4* query_lengths; /**< Lengths of the queries */
+   Int4 num_queries; /**< Number of queries */
+   Boolean one_seq_update_params; /**< TRUE if this is not a database search,
+                                       so that effective lengths have to be
+                                       recalculated for every subject */
+   Int4 num_workers; /**< Number of formatting threads */
+   TNlmMutex lock; /**< Protects the fields below and the output streams */
+   OutBuf* outbuf; /**< Large-block buffer in front of tf_data->outfp */
+   Int4 next_ordinal; /**< Queue position of the next HSP list to write */
+   struct SBlastTabularWorker** waiting; /**< A worker whose HSP list is not
+                                             next in line waits in entry
+                                             ordinal % num_workers; at most
+                                             num_workers lists are ever in
+                                             flight, so entries never clash */
+   Int4 num_asn_results; /**< Number of Seq-aligns in the current batch */
+   SeqAlignPtr sap_head; /**< Current batch of incremental ASN.1 output */
+   SeqAlignPtr sap_last; /**< Last Seq-align in the current batch */
+} SBlastTabularShared;
+
+/** State private to one formatting thread. */
+typedef struct SBlastTabularWorker {
+   SBlastTabularShared* shared; /**< State shared with the other threads */
+   BlastSeqSrc* seq_src; /**< Source of subject sequences */
+   BlastGapAlignStruct* gap_align; /**< Gapped alignment structure */
+   Boolean own_resources; /**< Were seq_src and gap_align allocated for this
+                               worker, rather than taken from tf_data? */
+   BlastSeqSrcGetSeqArg seq_arg; /**< Subject sequence retrieval argument */
+   char* buffer; /**< Tabular output for the current HSP list */
+   size_t buffer_used; /**< Number of characters in buffer */
+   size_t buffer_alloc; /**< Allocated size of buffer */
+   SeqAlignPtr sap_head; /**< Seq-aligns for the current HSP list */
+   SeqAlignPtr sap_last; /**< Last of the Seq-aligns for the current list */
+   TNlmSemaphore turn; /**< Posted when the current HSP list of this worker
+                            is next to be written */
+} SBlastTabularWorker;
+
+/** Make sure there is room for at least size more characters in the output
+ * buffer of a formatting thread.
+ * @param worker The formatting thread's state [in][out]
+ * @param size Number of characters that will be appended [in]
+ * @return Pointer to the end of the buffer contents, or NULL if out of 
+ *         memory
+ */
+static char*
+s_TabularBufferReserve(SBlastTabularWorker* worker, size_t size)
+{
+   if (worker->buffer_used + size > worker->buffer_alloc) {
+      size_t new_alloc = 
+         MAX(2*worker->buffer_alloc, worker->buffer_used + size);
+      char* new_buffer = (char*) realloc(worker->buffer, new_alloc);
+      if (!new_buffer)
+         return NULL;
+      worker->buffer = new_buffer;
+      worker->buffer_alloc = new_alloc;
+   }
+   return worker->buffer + worker->buffer_used;
+}
+
+/** Append a string to a tabular line being built.
+ * @param ptr Where to put the string [in]
+ * @param str The string [in]
+ * @return Pointer just past the copied string
+ */
+static char*
+s_TabularPutString(char* ptr, const char* str)
+{
+   size_t length = strlen(str);
+   memcpy(ptr, str, length);
+   return ptr + length;
+}
+
+/** Append an integer and a tab to a tabular line being built.
+ * @param ptr Where to put the number [in]
+ * @param value The number [in]
+ * @return Pointer just past the tab
+ */
+static char*
+s_TabularPutInt(char* ptr, Int4 value)
+{
+   ptr += Int8ToText(value, ptr);
+   *ptr++ = '\t';
+   return ptr;
+}
+
+/** Write out the accumulated batch of incremental ASN.1 results.
+ * @param shared The shared formatting state [in][out]
+ */
+static void
+s_TabularFlushAsnBatch(SBlastTabularShared* shared)
+{
+   SeqAnnot* seqannot;
+   Boolean unused; 
+
+   if (shared->sap_head == NULL)
+      return;
+
+   seqannot = SeqAnnotNew();
+   seqannot->type = 2;
+   AddAlignInfoToSeqAnnot(seqannot, 
+                 GetOldAlignType(shared->tf_data->program, &unused));
+   seqannot->data = shared->sap_head;
+   SeqAnnotAsnWrite((SeqAnnot*) seqannot, shared->tf_data->asn_outfp, NULL);
+   AsnIoReset(shared->tf_data->asn_outfp);
+   shared->num_asn_results = 0;
+   shared->sap_head = shared->sap_last = NULL;
+   seqannot = SeqAnnotFree(seqannot);
+}
+
+/** Perform the traceback, if needed, for one HSP list and format it into 
+ * the worker's output buffer (tabular output) or its list of Seq-aligns 
+ * (incremental ASN.1 output). Nothing is written to the output streams here.
+ * @param worker The formatting thread's state [in][out]
+ * @param hsp_list The HSP list to format; freed on return [in]
+ */
+static void
+s_TabularFormatHSPList(SBlastTabularWorker* worker, BlastHSPList* hsp_list)
+{
+   SBlastTabularShared* shared = worker->shared;
+   BlastTabularFormatData* tf_data = shared->tf_data;
+   EBlastProgramType program = tf_data->program;
+   BlastSeqSrc* seq_src = worker->seq_src;
+   BlastGapAlignStruct* gap_align = worker->gap_align;
+   BlastSeqSrcGetSeqArg* seq_arg = &worker->seq_arg;
+   BLAST_SequenceBlk* query = tf_data->query;
+   BlastQueryInfo* query_info = tf_data->query_info;
    Int4 query_index, index;
    char* query_buffer = NULL;
    char* subject_buffer = NULL;
    Int4 q_start=0, q_end=0, s_start=0, s_end=0;
-   SeqLoc* slp;
    char bit_score_buff[10], eval_buff[10];
    char* eval_buff_ptr = NULL;
    BlastHSP* hsp;
-   SeqId** query_id_array = NULL;
    SeqId* subject_id = NULL;
    Int4 align_length = 0;
    Int4 num_gaps = 0, num_gap_opens = 0, num_mismatches = 0;
    double perc_ident = 0;
-   BlastSeqSrcGetSeqArg seq_arg;
-   Boolean one_seq_update_params;
    ReadDBFILE* rdfp = NULL;
-   char* descr;
-   Int4 num_queries;
-   Int4* query_lengths;
    Boolean sequence_in_use = FALSE;
-   Int4 num_asn_results = 0;
-   SeqAlignPtr sap_head = NULL;
-   SeqAlignPtr sap_last = NULL;
- 
-   tf_data = (BlastTabularFormatData*) data;
-   if (!tf_data || !tf_data->query_slp || !tf_data->hsp_stream ||
-       !tf_data->seq_src || (!tf_data->outfp && !tf_data->asn_outfp)) 
-      return NULL;
+   Int4 subject_length; 
 
-   program = tf_data->program;
-   seq_src = tf_data->seq_src;
-   query = tf_data->query;
-   query_info = tf_data->query_info;
+   worker->buffer_used = 0;
 
-   seq_arg.seq = NULL;
-   seq_arg.oid = 0;
-
-   if (tf_data->perform_traceback) {
-      score_params = tf_data->score_params;
-      ext_params = tf_data->ext_params;
-      hit_params = tf_data->hit_params;
-      eff_len_params = tf_data->eff_len_params;
-      gap_align = tf_data->gap_align;
-      gen_code_string = tf_data->gen_code_string;
-      seq_arg.encoding = Blast_TracebackGetEncoding(program);
+   if (!hsp_list) {
+      /* This should not happen, but just in case */
+      return;
    }
 
-   num_queries = ValNodeLen(tf_data->query_slp);
-   query_id_array = (SeqId**) malloc(num_queries*sizeof(SeqId*));
-   query_lengths = (Int4*) malloc(num_queries*sizeof(Int4));
+   /* Perform traceback if necessary */
+   if (tf_data->perform_traceback) {
+      seq_arg->oid = hsp_list->oid;
+      if (BlastSeqSrcGetSequence(seq_src, (void*) seq_arg) < 0) {
+          hsp_list = Blast_HSPListFree(hsp_list);
+          return;
+      }
+      
+      sequence_in_use = TRUE;
+      if (shared->one_seq_update_params) {
+         Int2 status;
+         /* This is not a database search, so effective search spaces
+            need to be recalculated based on this subject sequence length.
+            Only one formatting thread is used in this case. */
+         if ((status = BLAST_OneSubjectUpdateParameters(program, 
+                          seq_arg->seq->length, 
+                          tf_data->score_params->options, 
+                          query_info, gap_align->sbp, 
+                          tf_data->hit_params, NULL, 
+                          tf_data->eff_len_params)) != 0) {
+            hsp_list = Blast_HSPListFree(hsp_list);
+            BlastSeqSrcReleaseSequence(seq_src, (void*)seq_arg);
+            return;
+         }
+      }
 
-   for (index = 0, slp = tf_data->query_slp; slp; ++index, slp = slp->next) {
-      BioseqPtr bsp = BioseqLockById(SeqLocId(slp));
-      query_id_array[index] = SeqIdSetDup(bsp->id);
-      query_lengths[index] = BioseqGetLen(bsp);
-      BioseqUnlockById(SeqLocId(slp));
+      Blast_TracebackFromHSPList(program, hsp_list, query,
+         seq_arg->seq, query_info, gap_align, gap_align->sbp, 
+         tf_data->score_params, tf_data->ext_params->options, 
+         tf_data->hit_params, tf_data->gen_code_string, NULL);
+      /* Return subject sequence unless it is needed for the sequence
+         printout */
+      if (tf_data->format_options != eBlastTabularAddSequences) {
+         BlastSeqSrcReleaseSequence(seq_src, (void*)seq_arg);
+         sequence_in_use = FALSE;
+      }
+      /* Recalculate the bit scores, since they might have changed. */
+      Blast_HSPListGetBitScores(hsp_list, 
+         tf_data->score_params->options->gapped_calculation, gap_align->sbp);
    }
 
-   one_seq_update_params = (BlastSeqSrcGetTotLen(seq_src) == 0);
-
-   /* The line below shouldn't have to access the BlastSeqSrc's data structure
-    * FIXME*/
+   /* The line below shouldn't have to access the BlastSeqSrc's data 
+    * structure FIXME*/
    rdfp = (ReadDBFILE*) _BlastSeqSrcImpl_GetDataStructure(seq_src);
 
-   while (BlastHSPQueueRead(tf_data->hsp_stream->writer->data, &hsp_list) 
-          != kBlastHSPStream_Eof) {
-       Int4 subject_length; 
-      if (!hsp_list) {
-         /* This should not happen, but just in case */
-         continue;
-      }
+   subject_buffer = 
+      Blast_TabularGetSubjectId(rdfp, hsp_list->oid, tf_data->show_gi, 
+                                tf_data->show_accession, &subject_id);
+
+   /* Retrieve the subject sequence if it is needed and this has not 
+      already been done. */ 
+   if (tf_data->format_options == eBlastTabularAddSequences && 
+       !tf_data->perform_traceback) {
+       seq_arg->oid = hsp_list->oid;
+       seq_arg->encoding = eBlastEncodingNucleotide;
+       if (BlastSeqSrcGetSequence(seq_src, (void*) seq_arg) < 0) {
+          if (subject_id)
+             subject_id = SeqIdSetFree(subject_id);
+          sfree(subject_buffer);
+          hsp_list = Blast_HSPListFree(hsp_list);
+          return;
+       }
+       sequence_in_use = TRUE;
+   }
 
-      /* Perform traceback if necessary */
-      if (tf_data->perform_traceback) {
-         seq_arg.oid = hsp_list->oid;
-         if (BlastSeqSrcGetSequence(seq_src, (void*) &seq_arg) < 0)
-             continue;
-         
-         sequence_in_use = TRUE;
-         if (one_seq_update_params) {
-            Int2 status;
-            /* This is not a database search, so effective search spaces
-               need to be recalculated based on this subject sequence length */
-            if ((status = BLAST_OneSubjectUpdateParameters(program, 
-                             seq_arg.seq->length, 
-                             score_params->options, 
-                             query_info, gap_align->sbp, 
-                             hit_params, NULL, 
-                             eff_len_params)) != 0) {
-               hsp_list = Blast_HSPListFree(hsp_list);
-               BlastSeqSrcReleaseSequence(seq_src, (void*)&seq_arg);
-               sequence_in_use = FALSE;
-               continue;
-            }
+   subject_length = BlastSeqSrcGetSeqLen(seq_src, (void*)&hsp_list->oid);
+
+   for (index = 0; index < hsp_list->hspcnt; ++index) {
+      char* query_buffer_ptr=NULL;
+      char* line;
+      size_t line_size;
+      hsp = hsp_list->hsp_array[index];
+      query_index = 
+         Blast_GetQueryIndexFromContext(hsp->context, program);
+
+      /* handle incremental ASN.1 output */
+      if (tf_data->format_options == eBlastIncrementalASN) {
+         SeqAlignPtr sap = NULL;
+         if (tf_data->is_ooframe) {
+            sap = OOFBlastHSPToSeqAlign(program, hsp, 
+                        shared->query_id_array[query_index], subject_id,
+                        shared->query_lengths[query_index], subject_length);
          }
-
-         Blast_TracebackFromHSPList(program, hsp_list, query,
-            seq_arg.seq, query_info, gap_align, gap_align->sbp, score_params,
-            ext_params->options, hit_params, gen_code_string, NULL);
-         /* Return subject sequence unless it is needed for the sequence
-            printout */
-         if (tf_data->format_options != eBlastTabularAddSequences) {
-            BlastSeqSrcReleaseSequence(seq_src, (void*)&seq_arg);
-            sequence_in_use = FALSE;
+         else {
+            sap = BlastHSPToSeqAlign(program, hsp, 
+                        shared->query_id_array[query_index], subject_id,
+                        shared->query_lengths[query_index], subject_length);
+         }
+         sap->score = GetScoreSetFromBlastHsp(hsp);
+         /* Keep the alignments of this list until it is its turn to be
+            added to the batch being written. */
+         if (worker->sap_head == NULL) {
+            worker->sap_head = worker->sap_last = sap;
          }
-         /* Recalculate the bit scores, since they might have changed. */
-         Blast_HSPListGetBitScores(hsp_list, 
-            score_params->options->gapped_calculation, gap_align->sbp);
+         else {
+            worker->sap_last->next = sap;
+            worker->sap_last = sap;
+         }
+         continue;
       }
 
-      if (!readdb_get_descriptor(rdfp, hsp_list->oid, &subject_id, &descr)) {
-          subject_buffer = strdup("Unknown");
-      } else if (subject_id->choice != SEQID_GENERAL ||
-                 strcmp(((DbtagPtr)subject_id->data.ptrvalue)->db, 
-                        "BL_ORD_ID")) {
-         /* All cases except when database was formatted without seqid indices. 
-            In that case all real Seq-id information is hidden in the 
-            description. */
-         if (tf_data->show_gi || tf_data->show_accession) {
-            Blast_SeqIdGetDefLine(subject_id, &subject_buffer, 
-                                  tf_data->show_gi, tf_data->show_accession,
-                                  TRUE); 
-         } else {
-            if ( !(subject_buffer = (char*) malloc(sizeof(char)*SEQIDLEN_MAX)))
-               return NULL;
-            SeqIdWrite(subject_id, subject_buffer, PRINTID_FASTA_LONG, 
-                       SEQIDLEN_MAX-1);
-         }
-         /* Found something for the seqid buffer; description can be 
-            discarded now. */
-         if (subject_buffer != NULL)
-            sfree(descr);
+      /* handle ordinary tabular output */
+
+      Blast_SeqIdGetDefLine(shared->query_id_array[query_index], 
+                            &query_buffer, tf_data->show_gi, 
+                            tf_data->show_accession, tf_data->believe_query);
+      
+      eval_buff_ptr = eval_buff;
+      ScoreAndEvalueToBuffers(hsp->bit_score, hsp->evalue, 
+                              bit_score_buff, &eval_buff_ptr, 0);
+      
+      /* Calculate percentage of identities */
+      Blast_HSPCalcLengthAndGaps(hsp, &align_length, &num_gaps, 
+                                 &num_gap_opens);
+      perc_ident = ((double)hsp->num_ident)/align_length * 100;
+      num_mismatches = align_length - hsp->num_ident - num_gaps;
+      
+      Blast_HSPGetAdjustedOffsets(program, hsp, 
+                                  shared->query_lengths[query_index],
+                                  subject_length, &q_start, &q_end, 
+                                  &s_start, &s_end);
+      
+      query_buffer_ptr = query_buffer;
+      if (strstr(query_buffer, "lcl|") == query_buffer)
+         query_buffer_ptr += 4;
+
+      line_size = strlen(query_buffer_ptr) + strlen(subject_buffer) + 
+         TABULAR_LINE_SIZE;
+      if (tf_data->format_options == eBlastTabularAddSequences)
+         line_size += 2*align_length;
+      if ((line = s_TabularBufferReserve(worker, line_size)) == NULL) {
+         sfree(query_buffer);
+         break;
       }
 
-      /* Last chance to assign anything - take the first token from the 
-         description. */
-      if (!subject_buffer && descr)
-         subject_buffer = strtok(descr, " \t\n\r");
-
-      /* Retrieve the subject sequence if it is needed and this has not 
-         already been done. */ 
-      if (tf_data->format_options == eBlastTabularAddSequences && 
-          !tf_data->perform_traceback) {
-          seq_arg.oid = hsp_list->oid;
-          seq_arg.encoding = eBlastEncodingNucleotide;
-          if (BlastSeqSrcGetSequence(seq_src, (void*) &seq_arg) < 0) {
-             if (subject_id)
-                subject_id = SeqIdSetFree(subject_id);
-             continue;
-          }
-          sequence_in_use = TRUE;
+      /* Same text as 
+         "%s\t%s\t%.2f\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%s\t%s", but
+         without going through sprintf */
+      line = s_TabularPutString(line, query_buffer_ptr);
+      *line++ = '\t';
+      line = s_TabularPutString(line, subject_buffer);
+      *line++ = '\t';
+      line += FloatHiToFixed(perc_ident, 2, 0, line);
+      *line++ = '\t';
+      line = s_TabularPutInt(line, align_length);
+      line = s_TabularPutInt(line, num_mismatches);
+      line = s_TabularPutInt(line, num_gap_opens);
+      line = s_TabularPutInt(line, q_start);
+      line = s_TabularPutInt(line, q_end);
+      line = s_TabularPutInt(line, s_start);
+      line = s_TabularPutInt(line, s_end);
+      line = s_TabularPutString(line, eval_buff);
+      *line++ = '\t';
+      line = s_TabularPutString(line, bit_score_buff);
+
+      if (tf_data->format_options == eBlastTabularAddSequences) {
+         char* query_seq_buffer = NULL, *subject_seq_buffer = NULL;
+         Uint1* query_seq = NULL;
+         Int4 context;
+         context = hsp->context - (hsp->context % 2);
+         query_seq =
+             & query->sequence[query_info->contexts[context].query_offset];
+         
+         query_seq_buffer = MemNew((align_length+1));
+         subject_seq_buffer = MemNew((align_length+1));
+
+         FillNuclSequenceBuffers(program, hsp, query_seq, 
+                                 seq_arg->seq->sequence, 
+                                 shared->query_lengths[query_index], 
+                                 seq_arg->seq->length, query_seq_buffer, 
+                                 subject_seq_buffer);
+         
+         *line++ = '\t';
+         line = s_TabularPutString(line, query_seq_buffer);
+         *line++ = '\t';
+         line = s_TabularPutString(line, subject_seq_buffer);
+         sfree(query_seq_buffer);
+         sfree(subject_seq_buffer);
       }
+      *line++ = '\n';
+      worker->buffer_used = line - worker->buffer;
+      sfree(query_buffer);
+   }
 
-      subject_length = BlastSeqSrcGetSeqLen(seq_src, (void*)&hsp_list->oid);
-
-      for (index = 0; index < hsp_list->hspcnt; ++index) {
-         char* query_buffer_ptr=NULL;
-         hsp = hsp_list->hsp_array[index];
-         query_index = 
-            Blast_GetQueryIndexFromContext(hsp->context, program);
-
-         /* handle incremental ASN.1 output */
-         if (tf_data->format_options == eBlastIncrementalASN) {
-            SeqAlignPtr sap = NULL;
-            if (tf_data->is_ooframe) {
-               sap = OOFBlastHSPToSeqAlign(program, hsp, 
-                                   query_id_array[query_index], subject_id,
-                                   query_lengths[query_index], subject_length);
-            }
-            else {
-               sap = BlastHSPToSeqAlign(program, hsp, 
-                                   query_id_array[query_index], subject_id,
-                                   query_lengths[query_index], subject_length);
-            }
-            sap->score = GetScoreSetFromBlastHsp(hsp);
-            /* add to the current batch of results */
-            if (sap_head == NULL) {
-               sap_head = sap_last = sap;
-            }
-            else {
-               sap_last->next = sap;
-               sap_last = sap;
-            }
+   /* Return the subject sequence, if it hasn't yet been done. */
+   if (sequence_in_use)
+       BlastSeqSrcReleaseSequence(seq_src, (void*)seq_arg);
 
-            /* flush the current batch if enough alignments
-               have accumulated */
-            if (++num_asn_results == INCREMENTAL_ASN_BATCH_SIZE) {
-               SeqAnnot* seqannot = SeqAnnotNew();
-               Boolean unused; 
-               seqannot->type = 2;
-               AddAlignInfoToSeqAnnot(seqannot, 
-                             GetOldAlignType(program, &unused));
-               seqannot->data = sap_head;
-               SeqAnnotAsnWrite((SeqAnnot*) seqannot, tf_data->asn_outfp, NULL);
-               AsnIoReset(tf_data->asn_outfp);
-               num_asn_results = 0;
-               sap_head = sap_last = NULL;
-               seqannot = SeqAnnotFree(seqannot);
-            }
-            continue;
-         }
+   sfree(subject_buffer);
+   hsp_list = Blast_HSPListFree(hsp_list);
+   if (subject_id)
+      subject_id = SeqIdSetFree(subject_id);
+}
 
-         /* handle ordinary tabular output */
+/** Write out the results a worker has formatted for one HSP list, once all 
+ * HSP lists read from the queue before it have been written. 
+ * @param worker The formatting thread's state [in][out]
+ * @param ordinal Position of the formatted HSP list in the queue [in]
+ */
+static void
+s_TabularWriteInOrder(SBlastTabularWorker* worker, Int4 ordinal)
+{
+   SBlastTabularShared* shared = worker->shared;
+   SBlastTabularWorker* next_worker;
+   Int4 next_slot;
+
+   NlmMutexLockEx(&shared->lock);
+   if (shared->next_ordinal != ordinal) {
+      shared->waiting[ordinal % shared->num_workers] = worker;
+      NlmMutexUnlock(shared->lock);
+      NlmSemaWait(worker->turn);
+      NlmMutexLockEx(&shared->lock);
+   }
+   ASSERT(shared->next_ordinal == ordinal);
+
+   if (worker->buffer_used > 0)
+      OutBufWrite(shared->outbuf, worker->buffer, worker->buffer_used);
+   worker->buffer_used = 0;
+
+   while (worker->sap_head) {
+      SeqAlignPtr sap = worker->sap_head;
+      worker->sap_head = sap->next;
+      sap->next = NULL;
+      /* add to the current batch of results */
+      if (shared->sap_head == NULL) {
+         shared->sap_head = shared->sap_last = sap;
+      }
+      else {
+         shared->sap_last->next = sap;
+         shared->sap_last = sap;
+      }
+      /* flush the current batch if enough alignments have accumulated */
+      if (++shared->num_asn_results == INCREMENTAL_ASN_BATCH_SIZE)
+         s_TabularFlushAsnBatch(shared);
+   }
+   worker->sap_last = NULL;
+
+   /* Hand over to the worker holding the next HSP list, if it is done */
+   shared->next_ordinal++;
+   next_slot = shared->next_ordinal % shared->num_workers;
+   if ((next_worker = shared->waiting[next_slot]) != NULL) {
+      shared->waiting[next_slot] = NULL;
+      NlmSemaPost(next_worker->turn);
+   }
+   NlmMutexUnlock(shared->lock);
+}
 
-         Blast_SeqIdGetDefLine(query_id_array[query_index], &query_buffer, 
-                               tf_data->show_gi, tf_data->show_accession,
-                               tf_data->believe_query);
-         
-         eval_buff_ptr = eval_buff;
-         ScoreAndEvalueToBuffers(hsp->bit_score, hsp->evalue, 
-                                 bit_score_buff, &eval_buff_ptr, 0);
-         
-         /* Calculate percentage of identities */
-         Blast_HSPCalcLengthAndGaps(hsp, &align_length, &num_gaps, 
-                                    &num_gap_opens);
-         perc_ident = ((double)hsp->num_ident)/align_length * 100;
-         num_mismatches = align_length - hsp->num_ident - num_gaps;
-         
-         Blast_HSPGetAdjustedOffsets(program, hsp, query_lengths[query_index],
-                                     subject_length, &q_start, &q_end, 
-                                     &s_start, &s_end);
-         
-         query_buffer_ptr = query_buffer;
-         if (strstr(query_buffer, "lcl|") == query_buffer)
-            query_buffer_ptr += 4;
-
-
-         if (tf_data->format_options == eBlastTabularAddSequences) {
-            char* query_seq_buffer = NULL, *subject_seq_buffer = NULL;
-            Uint1* query_seq = NULL;
-            Int4 context;
-            context = hsp->context - (hsp->context % 2);
-            query_seq =
-                & query->sequence[query_info->contexts[context].query_offset];
-            
-            query_seq_buffer = MemNew((align_length+1));
-            subject_seq_buffer = MemNew((align_length+1));
-
-            FillNuclSequenceBuffers(program, hsp, query_seq, 
-                                    seq_arg.seq->sequence, 
-                                    query_lengths[query_index], 
-                                    seq_arg.seq->length, query_seq_buffer, 
-                                    subject_seq_buffer);
-            
-            fprintf(tf_data->outfp, 
-                    "%s\t%s\t%.2f\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%s\t%s\t%s\t%s\n",
-                    query_buffer_ptr, subject_buffer, perc_ident, 
-                    (long) align_length, (long) num_mismatches, 
-                    (long) num_gap_opens, (long) q_start, (long) q_end, 
-                    (long) s_start, (long) s_end, eval_buff, bit_score_buff,
-                    query_seq_buffer, subject_seq_buffer);
-            sfree(query_seq_buffer);
-            sfree(subject_seq_buffer);
-         } else {
-            fprintf(tf_data->outfp, 
-                    "%s\t%s\t%.2f\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%s\t%s\n",
-                    query_buffer_ptr, subject_buffer, perc_ident, 
-                    (long) align_length, (long) num_mismatches, 
-                    (long) num_gap_opens, (long) q_start, (long) q_end, 
-                    (long) s_start, (long) s_end, eval_buff, bit_score_buff);
-         }
-         sfree(query_buffer);
+/** Allocate the private state of a formatting thread.
+ * @param shared The shared formatting state [in]
+ * @param is_first If TRUE, the sequence source and gapped alignment 
+ *                 structure in tf_data are used; otherwise copies are 
+ *                 made for the new worker [in]
+ * @return The new worker, or NULL on failure
+ */
+static SBlastTabularWorker*
+s_TabularWorkerNew(SBlastTabularShared* shared, Boolean is_first)
+{
+   BlastTabularFormatData* tf_data = shared->tf_data;
+   SBlastTabularWorker* worker = 
+      (SBlastTabularWorker*) calloc(1, sizeof(SBlastTabularWorker));
+
+   if (!worker)
+      return NULL;
+
+   worker->shared = shared;
+   if (is_first) {
+      worker->seq_src = tf_data->seq_src;
+      worker->gap_align = tf_data->gap_align;
+   } else {
+      worker->own_resources = TRUE;
+      worker->seq_src = BlastSeqSrcCopy(tf_data->seq_src);
+      if (tf_data->perform_traceback &&
+          BLAST_GapAlignStructNew(tf_data->score_params, tf_data->ext_params,
+                         BlastSeqSrcGetMaxSeqLen(worker->seq_src),
+                         tf_data->gap_align->sbp, &worker->gap_align) != 0) {
+         worker->seq_src = BlastSeqSrcFree(worker->seq_src);
+         sfree(worker);
+         return NULL;
       }
+      if (worker->gap_align)
+         worker->gap_align->gap_x_dropoff = 
+            tf_data->ext_params->gap_x_dropoff_final;
+   }
 
-      /* Return the subject sequence, if it hasn't yet been done. */
-      if (sequence_in_use)
-          BlastSeqSrcReleaseSequence(seq_src, (void*)&seq_arg);
+   if (tf_data->perform_traceback)
+      worker->seq_arg.encoding = Blast_TracebackGetEncoding(tf_data->program);
 
-      fflush(tf_data->outfp);
-      sfree(subject_buffer);
+   worker->buffer_alloc = TABULAR_BUFFER_SIZE;
+   worker->buffer = (char*) malloc(worker->buffer_alloc);
+   worker->turn = NlmSemaInit(0);
+   return worker;
+}
+
+/** Free the private state of a formatting thread.
+ * @param worker The worker to free [in]
+ * @return NULL
+ */
+static SBlastTabularWorker*
+s_TabularWorkerFree(SBlastTabularWorker* worker)
+{
+   if (!worker)
+      return NULL;
+
+   BlastSequenceBlkFree(worker->seq_arg.seq);
+   if (worker->own_resources) {
+      worker->gap_align = BLAST_GapAlignStructFree(worker->gap_align);
+      worker->seq_src = BlastSeqSrcFree(worker->seq_src);
+   }
+   NlmSemaDestroy(worker->turn);
+   sfree(worker->buffer);
+   sfree(worker);
+   return NULL;
+}
+
+/** Main loop of a formatting thread: read HSP lists from the queue, format
+ * them and write them out in the queue order, until the queue is closed.
+ * @param data Pointer to the thread's SBlastTabularWorker structure [in]
+ */
+static void* 
+s_TabularWorkerRun(void* data)
+{
+   SBlastTabularWorker* worker = (SBlastTabularWorker*) data;
+   void* queue = worker->shared->tf_data->hsp_stream->writer->data;
+   BlastHSPList* hsp_list = NULL;
+   Int4 ordinal = 0;
+
+   while (BlastHSPQueueReadOrdered(queue, &hsp_list, &ordinal) 
+          != kBlastHSPStream_Eof) {
+      s_TabularFormatHSPList(worker, hsp_list);
+      s_TabularWriteInOrder(worker, ordinal);
+   }
+   return NULL;
+}
+
+/** Reads and frees everything in the HSP queue of a formatting thread that
+ * cannot format it, since the search threads may be waiting for room in it.
+ * @param tf_data Tabular formatting data [in]
+ */
+static void
+s_TabularDrainQueue(BlastTabularFormatData* tf_data)
+{
+   BlastHSPList* hsp_list = NULL;
+
+   while (BlastHSPQueueRead(tf_data->hsp_stream->writer->data, &hsp_list)
+          != kBlastHSPStream_Eof)
       hsp_list = Blast_HSPListFree(hsp_list);
-      if (subject_id)
-         subject_id = SeqIdSetFree(subject_id);
+}
+
+void* Blast_TabularFormatThread(void* data) 
+{
+   BlastTabularFormatData* tf_data;
+   SBlastTabularShared shared;
+   SBlastTabularWorker** workers;
+   TNlmThread* threads;
+   Int4 num_workers, index;
+   SeqLoc* slp;
+   void* join_status = NULL;
+ 
+   tf_data = (BlastTabularFormatData*) data;
+   if (!tf_data || !tf_data->hsp_stream)
+      return NULL;
+
+   if (!tf_data->query_slp || !tf_data->seq_src || 
+       (!tf_data->outfp && !tf_data->asn_outfp)) {
+      /* Nothing can be formatted, but the queue still has to be emptied */
+      s_TabularDrainQueue(tf_data);
+      return NULL;
+   }
+
+   memset(&shared, 0, sizeof(shared));
+   shared.tf_data = tf_data;
+   if (tf_data->outfp)
+      shared.outbuf = OutBufNew(tf_data->outfp, 0);
+
+   shared.num_queries = ValNodeLen(tf_data->query_slp);
+   shared.query_id_array = 
+      (SeqId**) malloc(shared.num_queries*sizeof(SeqId*));
+   shared.query_lengths = (Int4*) malloc(shared.num_queries*sizeof(Int4));
+
+   for (index = 0, slp = tf_data->query_slp; slp; ++index, slp = slp->next) {
+      BioseqPtr bsp = BioseqLockById(SeqLocId(slp));
+      shared.query_id_array[index] = SeqIdSetDup(bsp->id);
+      shared.query_lengths[index] = BioseqGetLen(bsp);
+      BioseqUnlockById(SeqLocId(slp));
+   }
+
+   shared.one_seq_update_params = (BlastSeqSrcGetTotLen(tf_data->seq_src) == 0);
+
+   /* Parameters updated for every subject cannot be shared between
+      threads, so such searches are formatted in this thread only. */
+   num_workers = tf_data->num_threads;
+   if (num_workers < 1 || shared.one_seq_update_params || 
+       !NlmThreadsAvailable())
+      num_workers = 1;
+
+   workers = (SBlastTabularWorker**) 
+      calloc(num_workers, sizeof(SBlastTabularWorker*));
+   for (index = 0; index < num_workers; ++index) {
+      if ((workers[index] = s_TabularWorkerNew(&shared, index == 0)) == NULL)
+         break;
+   }
+   /* Fewer workers than requested is not an error, but without any the
+      results can only be discarded */
+   num_workers = index;
+   shared.num_workers = num_workers;
+   threads = NULL;
+   if (num_workers == 0) {
+      s_TabularDrainQueue(tf_data);
+   } else {
+      shared.waiting = (SBlastTabularWorker**) 
+         calloc(num_workers, sizeof(SBlastTabularWorker*));
+
+      threads = (TNlmThread*) calloc(num_workers, sizeof(TNlmThread));
+      for (index = 1; index < num_workers; ++index)
+         threads[index] = NlmThreadCreate(s_TabularWorkerRun, workers[index]);
+
+      s_TabularWorkerRun(workers[0]);
+
+      for (index = 1; index < num_workers; ++index) {
+         if (threads[index] != NULL_thread)
+            NlmThreadJoin(threads[index], &join_status);
+      }
    }
 
    /* flush any leftover ASN.1 output */
-   if (sap_head != NULL) {
-      SeqAnnot* seqannot = SeqAnnotNew();
-      Boolean unused; 
-      seqannot->type = 2;
-      AddAlignInfoToSeqAnnot(seqannot, 
-                    GetOldAlignType(program, &unused));
-      seqannot->data = sap_head;
-      SeqAnnotAsnWrite((SeqAnnot*) seqannot, tf_data->asn_outfp, NULL);
-      AsnIoReset(tf_data->asn_outfp);
-      seqannot = SeqAnnotFree(seqannot);
+   s_TabularFlushAsnBatch(&shared);
+   if (shared.outbuf) {
+      shared.outbuf = OutBufFree(shared.outbuf);
+      fflush(tf_data->outfp);
    }
 
-   BlastSequenceBlkFree(seq_arg.seq);
+   for (index = 0; index < num_workers; ++index)
+      workers[index] = s_TabularWorkerFree(workers[index]);
+   sfree(workers);
+   sfree(threads);
+   sfree(shared.waiting);
+   NlmMutexDestroy(shared.lock);
 
-   for (index = 0; index<num_queries; ++index)
+   for (index = 0; index<shared.num_queries; ++index)
    {
-        SeqIdSetFree(query_id_array[index]);
-        query_id_array[index] = NULL;
+        SeqIdSetFree(shared.query_id_array[index]);
+        shared.query_id_array[index] = NULL;
    }
-   sfree(query_lengths);
-   sfree(query_id_array);
+   sfree(shared.query_lengths);
+   sfree(shared.query_id_array);
 
    return NULL;
 }
 /* @} */
-
@@ -47,6 +47,7 @@ extern "C" {
 #include <algo/blast/core/blast_hspstream.h>
 #include <algo/blast/core/blast_gapalign.h>
 #include <objloc.h>
+#include <readdb.h>
 
 /** @addtogroup CToolkitAlgoBlast
  *
@@ -94,6 +95,9 @@ typedef struct BlastTabularFormatData {
    Boolean is_ooframe; /**< TRUE if incremental ASN output is selected and
                             the results contain out-of-frame alignments */
    EBlastTabularFormatOptions format_options; /**< Tabular formatting options. */
+   Int4 num_threads; /**< Number of threads formatting the results; values
+                          below 2 format everything in the thread running
+                          Blast_TabularFormatThread */
 } BlastTabularFormatData;
 
 /** Allocate the tabular formatting data structure and save the output 
@@ -154,7 +158,27 @@ BlastTabularFormatDataClean(BlastTabularFormatData* tf_data);
 BlastTabularFormatData* 
 BlastTabularFormatDataFree(BlastTabularFormatData* tf_data);
 
-/** Driver for the thread producing tabular output. 
+/** Get the identifier of a database sequence as it is shown in tabular
+ * output. Thread safe, as long as rdfp is not shared between threads.
+ * @param rdfp The database [in]
+ * @param oid Ordinal id of the sequence [in]
+ * @param show_gi Show the gi instead of the full id, if possible [in]
+ * @param show_accession Show the accession instead of the full id, if 
+ *                       possible. This option has lower priority than 
+ *                       show_gi. [in]
+ * @param subject_id The Seq-id of the sequence, to be freed by the caller;
+ *                   may be NULL if not needed [out]
+ * @return The identifier, to be freed by the caller
+ */
+char*
+Blast_TabularGetSubjectId(ReadDBFILE* rdfp, Int4 oid, Boolean show_gi, 
+                          Boolean show_accession, SeqId** subject_id);
+
+/** Driver for the thread producing tabular output. If tf_data->num_threads
+ * is greater than 1, the HSP lists are read from the queue and formatted by
+ * that many worker threads, each with its own subject sequence source and
+ * gapped alignment structure; the formatted lists are still written in the
+ * order in which they were put in the queue.
  * @param data Pointer to a BlastTabularFormatData structure. [in]
  */
 void* Blast_TabularFormatThread(void* data);
@@ -50,6 +50,11 @@ typedef struct BlastHSPQueueData {
    Boolean    writeDone;  /**< Has writing to this stream been finished? */
    TNlmMutex  lock;       /**< reading/writing lock */
    TNlmSemaphore sema;    /**< Semaphore for reading */
+   Int4       max_size;   /**< Maximal number of lists in the queue, 0 if
+                               unlimited */
+   TNlmSemaphore space;   /**< Counts the free places in a bounded queue;
+                               writers wait on it, readers post it */
+   Int4       num_read;   /**< Number of HSP lists read so far */
 } BlastHSPQueueData;
 
 /*************************************************************/
@@ -104,6 +109,11 @@ s_BlastHSPQueueRun(void* data, BlastHSPList* hsp_list)
    if (q_data->writeDone)
       return -1;
 
+   /* Wait for room in a bounded queue; this is what keeps fast writers
+      from piling up results faster than they can be formatted. */
+   if (q_data->max_size > 0)
+      NlmSemaWait(q_data->space);
+
    NlmMutexLockEx(&q_data->lock);
    q_data->end = ListNodeAddPointer(&q_data->end, 0, (void *)hsp_list);
    if (!q_data->start)
@@ -127,6 +137,8 @@ s_BlastHSPQueueFree(BlastHSPWriter* writer)
    BlastHSPQueueData *q_data = writer->data;
 
    NlmSemaDestroy(q_data->sema);
+   if (q_data->space)
+      NlmSemaDestroy(q_data->space);
    NlmMutexDestroy(q_data->lock);
 
    for(p = q_data->start; p; p = p->next) {
@@ -149,6 +161,7 @@ s_BlastHSPQueueNew(void* params, BlastQueryInfo* query_info)
 {
    BlastHSPWriter * writer = NULL;
    BlastHSPQueueData * data = NULL;
+   BlastHSPQueueParams * q_params = params;
 
    /* allocate space for writer */
    writer = malloc(sizeof(BlastHSPWriter));
@@ -163,6 +176,11 @@ s_BlastHSPQueueNew(void* params, BlastQueryInfo* query_info)
    writer->data = calloc(1,sizeof(BlastHSPQueueData));
    data = writer->data;
    data->sema = NlmSemaInit(0);
+   if (q_params && q_params->max_size > 0) {
+      data->max_size = q_params->max_size;
+      data->space = NlmSemaInit(data->max_size);
+   }
+   BlastHSPQueueParamsFree(q_params);
     
    return writer;
 }
@@ -171,14 +189,19 @@ s_BlastHSPQueueNew(void* params, BlastQueryInfo* query_info)
 /** The following are exported functions to be used by APP   */
 
 BlastHSPQueueParams*
-BlastHSPQueueParamsNew()
+BlastHSPQueueParamsNew(Int4 max_size)
 {
-    return NULL;
+    BlastHSPQueueParams* retval = 
+        (BlastHSPQueueParams*) calloc(1, sizeof(BlastHSPQueueParams));
+
+    retval->max_size = MAX(max_size, 0);
+    return retval;
 }
 
 BlastHSPQueueParams*
 BlastHSPQueueParamsFree(BlastHSPQueueParams* opts)
 {
+    sfree(opts);
     return NULL;
 }
 
@@ -195,6 +218,12 @@ BlastHSPQueueInfoNew(BlastHSPQueueParams* params) {
 /** The follwoing is added to support queue implementation  */
 
 int BlastHSPQueueRead(void* data, BlastHSPList** hsp_list_out) 
+{
+   return BlastHSPQueueReadOrdered(data, hsp_list_out, NULL);
+}
+
+int BlastHSPQueueReadOrdered(void* data, BlastHSPList** hsp_list_out,
+                             Int4* ordinal) 
 {
    BlastHSPQueueData* q_data = (BlastHSPQueueData*) data;
    int status = kBlastHSPStream_Error;
@@ -218,6 +247,8 @@ int BlastHSPQueueRead(void* data, BlastHSPList** hsp_list_out)
       /* Nothing in the queue, but no more writing to the queue is expected. */
       *hsp_list_out = NULL;
       status =  kBlastHSPStream_Eof;
+      /* Pass the end-of-queue signal on to any other waiting reader */
+      NlmSemaPost(q_data->sema);
    } else {
       ListNode* start_node = q_data->start;
 
@@ -228,6 +259,11 @@ int BlastHSPQueueRead(void* data, BlastHSPList** hsp_list_out)
       ListNodeFree(start_node);
       if (!q_data->start)
          q_data->end = NULL;
+      if (ordinal)
+         *ordinal = q_data->num_read;
+      q_data->num_read++;
+      if (q_data->max_size > 0)
+         NlmSemaPost(q_data->space);
       status = kBlastHSPStream_Success;
    }
 
@@ -45,22 +45,28 @@
 extern "C" {
 #endif
 
-/** Probably need no options */
+/** Default maximal number of HSP lists that may wait in the queue for the
+    reader(s); a writer finding the queue full blocks until a list is read */
+#ifndef BLAST_HSP_QUEUE_MAX_SIZE
+#define BLAST_HSP_QUEUE_MAX_SIZE 256
+#endif
+
+/** Parameters of the queue writer */
 typedef struct BlastHSPQueueParams {
    EBlastProgramType program;/**< program type */
+   Int4 max_size; /**< Maximal number of HSP lists held in the queue; 0 means
+                       no limit. A limit may only be set if the queue is read
+                       by another thread while it is being written. */
 } BlastHSPQueueParams;
 
 /** Sets up parameter set for use by queue.
- * @param program Blast program type.[in]
- * @param hit_options field hitlist_size and hsp_num_max needed, a pointer to 
- *      this structure will be stored on resulting structure.[in]
- * @param ext_options field compositionBasedStats needed here. [in]
- * @param scoring_options gapped_calculation needed here. [in]
+ * @param max_size Maximal number of HSP lists held in the queue at any time,
+ *                 or 0 for an unbounded queue [in]
  * @return the pointer to the allocated parameter
  */
 NCBI_XBLAST_EXPORT
 BlastHSPQueueParams*
-BlastHSPQueueParamsNew();
+BlastHSPQueueParamsNew(Int4 max_size);
 
 /** Deallocates the BlastHSPQueueParams structure passed in
  * @param params structure to deallocate [in]
@@ -91,6 +97,21 @@ NCBI_XBLAST_EXPORT
 int 
 BlastHSPQueueRead(void* data, BlastHSPList** hsp_list_out);
 
+/** Same as BlastHSPQueueRead, but also returns the position of the HSP list
+ * in the queue, so that several threads reading the same queue can put
+ * their results back in the order in which the lists were written.
+ * @param data The queue writer's data [in]
+ * @param hsp_list_out The read HSP list. NULL, if there is nothing left 
+ *                     in the queue to read. [out]
+ * @param ordinal Number of HSP lists read from the queue before this one;
+ *                may be NULL [out]
+ * @return Status: success, error or end of reading.
+ */
+NCBI_XBLAST_EXPORT
+int 
+BlastHSPQueueReadOrdered(void* data, BlastHSPList** hsp_list_out,
+                         Int4* ordinal);
+
 #ifdef __cplusplus
 }
 #endif
@@ -31,12 +31,39 @@
 #include <algo/blast/core/blast_aalookup.h>
 #include <algo/blast/core/lookup_util.h>
 #include <algo/blast/core/blast_encoding.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifndef SKIP_DOXYGEN_PROCESSING
 static char const rcsid[] =
     "$Id: blast_aalookup.c,v 1.13 2009/10/01 17:55:38 kazimird Exp $";
 #endif                          /* SKIP_DOXYGEN_PROCESSING */
 
+/** Number of query words whose neighbors one thread generates before the
+ * threads switch to adding them to a protein lookup table */
+#ifndef AA_BUILD_CHUNK_WORDS
+#define AA_BUILD_CHUNK_WORDS 256
+#endif
+
+/** A neighboring word found while several threads build a protein lookup
+ * table, not yet added to the table */
+typedef struct AaWordHit {
+    Int4 index;            /**< backbone cell of the word */
+    Int4 query_bias;       /**< number added to each offset in offset_list,
+                                or the query offset itself if offset_list
+                                is NULL */
+    const Int4 *offset_list; /**< query offsets of the word, stored in the
+                                  same format as a backbone chain */
+} AaWordHit;
+
+/** Growable list of AaWordHit, in the order they were found */
+typedef struct AaWordHitList {
+    AaWordHit *hits;    /**< the hits */
+    Int4 num_hits;      /**< number of hits in the list */
+    Int4 num_alloc;     /**< allocated size of hits */
+} AaWordHitList;
+
 /** Structure containing information needed for adding neighboring words. 
  */
 typedef struct NeighborInfo {
@@ -51,6 +78,8 @@ typedef struct NeighborInfo {
     Int4 *offset_list;   /**< list of offsets where the word occurs in the query */
     Int4 threshold;      /**< the score threshold for neighboring words */
     Int4 query_bias;     /**< bias all stored offsets for multiple queries */
+    AaWordHitList *hits; /**< if not NULL, neighboring words are saved here
+                              instead of being added to the lookup table */
 } NeighborInfo;
 
 /**
@@ -65,10 +94,11 @@ typedef struct NeighborInfo {
  *                      query sequences to update the same lookup table)
  * @param location the list of ranges of query offsets to examine 
  *                 for indexing [in]
+ * @param num_threads number of threads to use [in]
  */
 static void s_AddNeighboringWords(BlastAaLookupTable * lookup, Int4 ** matrix,
                                   BLAST_SequenceBlk * query, Int4 query_bias,
-                                  BlastSeqLoc * location);
+                                  BlastSeqLoc * location, Int4 num_threads);
 
 /**
  * A position-specific version of AddNeighboringWords. Note that
@@ -81,10 +111,12 @@ static void s_AddNeighboringWords(BlastAaLookupTable * lookup, Int4 ** matrix,
  *                      (ordinarily 0; a nonzero value allows a succession of
  *                      query sequences to update the same lookup table)
  * @param location the list of ranges of query offsets to examine for indexing
+ * @param num_threads number of threads to use [in]
  */
 static void s_AddPSSMNeighboringWords(BlastAaLookupTable * lookup, 
                                       Int4 ** matrix, Int4 query_bias, 
-                                      BlastSeqLoc * location);
+                                      BlastSeqLoc * location, 
+                                      Int4 num_threads);
 
 /** Add neighboring words to the lookup table.
  * @param lookup Pointer to the lookup table.
@@ -93,11 +125,12 @@ static void s_AddPSSMNeighboringWords(BlastAaLookupTable * lookup,
  * @param offset_list list of offsets where the word occurs in the query
  * @param query_bias bias all stored offsets for multiple queries
  * @param row_max maximum possible score for each row of the matrix
+ * @param hits if not NULL, save the neighboring words here instead
  */
 static void s_AddWordHits(BlastAaLookupTable * lookup,
                           Int4 ** matrix, Uint1 * query,
                           Int4 * offset_list, Int4 query_bias, 
-                          Int4 * row_max);
+                          Int4 * row_max, AaWordHitList * hits);
 
 /** Add neighboring words to the lookup table using NeighborInfo structure.
  * @param info Pointer to the NeighborInfo structure.
@@ -113,9 +146,11 @@ static void s_AddWordHitsCore(NeighborInfo * info, Int4 score,
  * @param matrix The position-specific matrix.
  * @param query_bias bias all stored offsets for multiple queries
  * @param row_max maximum possible score for each row of the matrix
+ * @param hits if not NULL, save the neighboring words here instead
  */
 static void s_AddPSSMWordHits(BlastAaLookupTable * lookup,
-                            Int4 ** matrix, Int4 query_bias, Int4 * row_max);
+                            Int4 ** matrix, Int4 query_bias, Int4 * row_max,
+                            AaWordHitList * hits);
 
 /** Add neighboring words to the lookup table in case of a position-specific 
  * matrix, using NeighborInfo structure.
@@ -201,16 +236,13 @@ Int2 RPSLookupTableNew(const BlastRPSInfo * info, BlastRPSLookupTable * *lut)
        lookup table in order to increase cache reuse */
 
     lookup->num_buckets = num_pssm_rows / RPS_BUCKET_SIZE + 1;
-    lookup->bucket_array = (RPSBucket *) malloc(lookup->num_buckets *
+
+    /* the lists of offset pairs are allocated when the first hit lands
+       in a bucket; most buckets of a large database are never used by a
+       given query, and a process should not have to commit memory for
+       all of them at startup */
+    lookup->bucket_array = (RPSBucket *) calloc(lookup->num_buckets,
                                                 sizeof(RPSBucket));
-    for (i = 0; i < lookup->num_buckets; i++) {
-        RPSBucket *bucket = lookup->bucket_array + i;
-        bucket->num_filled = 0;
-        bucket->num_alloc = 1000;
-        bucket->offset_pairs = (BlastOffsetPair *) malloc(bucket->num_alloc *
-                                                          sizeof
-                                                          (BlastOffsetPair));
-    }
 
     return 0;
 }
@@ -276,34 +308,45 @@ Int4 BlastAaLookupFinalize(BlastAaLookupTable * lookup, EBoneType bone_type)
     Int4 overflow_cells_needed = 0;
     Int4 overflow_cursor = 0;
     Int4 longest_chain = 0;
+    Int4 total_hits = 0;
     PV_ARRAY_TYPE *pv;
     AaLookupBackboneCell  *bbc;
     AaLookupSmallboneCell *sbc;
-#ifdef LOOKUP_VERBOSE
     Int4 backbone_occupancy = 0;
-    Int4 thick_backbone_occupancy = 0;
     Int4 num_overflows = 0;
+    size_t num_cells;
+#ifdef LOOKUP_VERBOSE
+    Int4 thick_backbone_occupancy = 0;
 #endif
 
+    /* the backbone sizes below are computed in size_t, after checking
+       that the table has a backbone at all */
+    if (lookup->backbone_size <= 0)
+        return -1;
+    num_cells = (size_t) lookup->backbone_size;
+
     /* find out how many cells need the overflow array */
     for (i = 0; i < lookup->backbone_size; i++) {
         if (lookup->thin_backbone[i]) {
-#ifdef LOOKUP_VERBOSE
             backbone_occupancy++;
-#endif
+            total_hits += lookup->thin_backbone[i][1];
             if (lookup->thin_backbone[i][1] > AA_HITS_PER_CELL){
-#ifdef LOOKUP_VERBOSE
                 ++num_overflows;
-#endif
                 overflow_cells_needed += lookup->thin_backbone[i][1];
             }
             if (lookup->thin_backbone[i][1] > longest_chain)
                 longest_chain = lookup->thin_backbone[i][1];
         }
     }
-    lookup->overflow_size = overflow_cells_needed;
     lookup->longest_chain = longest_chain;
 
+    /* a narrow backbone only pays off if most cells would overflow */
+    if (bone_type == eNarrowbone && (Int8)num_overflows * 100 <=
+               (Int8)backbone_occupancy * AA_NARROWBONE_OVERFLOW_PCT)
+        bone_type = eBackbone;
+    lookup->overflow_size = (bone_type == eNarrowbone) ? 
+                                total_hits : overflow_cells_needed;
+
 #ifdef LOOKUP_VERBOSE
     thick_backbone_occupancy =  backbone_occupancy - num_overflows;
     printf("backbone size: %d\n", lookup->backbone_size);
@@ -322,16 +365,41 @@ Int4 BlastAaLookupFinalize(BlastAaLookupTable * lookup, EBoneType bone_type)
     /* bone-dependent lookup table filling-up */
     lookup->bone_type = bone_type;
 
+    /* narrow backbone: offsets into one array holding every hit */
+    if(bone_type==eNarrowbone){
+      Int4 *offsets;
+      Int4 *dest;
+      lookup->thick_backbone = malloc((num_cells + 1) * sizeof(Int4));
+      ASSERT(lookup->thick_backbone != NULL);
+      offsets = (Int4 *) lookup->thick_backbone;
+      pv = lookup->pv = (PV_ARRAY_TYPE *) calloc(
+            (num_cells >> PV_ARRAY_BTS) + 1,
+             sizeof(PV_ARRAY_TYPE));
+      ASSERT(pv != NULL);
+      dest = (Int4 *) (lookup->overflow = malloc(total_hits * sizeof(Int4)));
+      ASSERT(lookup->overflow != NULL);
+      for (i = 0; i < lookup->backbone_size; i++) {
+        offsets[i] = overflow_cursor;
+        if (lookup->thin_backbone[i] ) {
+            PV_SET(pv, i, PV_ARRAY_BTS);
+            for (j=0; j <lookup->thin_backbone[i][1]; j++) 
+                dest[overflow_cursor++] = lookup->thin_backbone[i][j + 2];
+            sfree(lookup->thin_backbone[i]);
+            lookup->thin_backbone[i] = NULL;
+        }
+      }
+      offsets[lookup->backbone_size] = overflow_cursor;
+    } /* end of the narrow backbone */
     /* backbone using Int4 as storage unit */
-    if(bone_type==eBackbone){
+    else if(bone_type==eBackbone){
       /* allocate new lookup table */
       lookup->thick_backbone = 
-            calloc(lookup->backbone_size, sizeof(AaLookupBackboneCell));
+            calloc(num_cells, sizeof(AaLookupBackboneCell));
       ASSERT(lookup->thick_backbone != NULL);
       bbc = (AaLookupBackboneCell *) lookup->thick_backbone;
       /* allocate the pv_array */
       pv = lookup->pv = (PV_ARRAY_TYPE *) calloc(
-            (lookup->backbone_size >> PV_ARRAY_BTS) + 1,
+            (num_cells >> PV_ARRAY_BTS) + 1,
              sizeof(PV_ARRAY_TYPE));
       ASSERT(pv != NULL);
       /* allocate the overflow array */
@@ -373,12 +441,12 @@ Int4 BlastAaLookupFinalize(BlastAaLookupTable * lookup, EBoneType bone_type)
     else{
       /* allocate new lookup table */
       lookup->thick_backbone = 
-            calloc(lookup->backbone_size, sizeof(AaLookupSmallboneCell));
+            calloc(num_cells, sizeof(AaLookupSmallboneCell));
       ASSERT(lookup->thick_backbone != NULL);
       sbc = (AaLookupSmallboneCell *) lookup->thick_backbone;
       /* allocate the pv_array */
       pv = lookup->pv = (PV_ARRAY_TYPE *) calloc(
-            (lookup->backbone_size >> PV_ARRAY_BTS) + 1,
+            (num_cells >> PV_ARRAY_BTS) + 1,
              sizeof(PV_ARRAY_TYPE));
       ASSERT(pv != NULL);
       /* allocate the overflow array */
@@ -422,18 +490,129 @@ void BlastAaLookupIndexQuery(BlastAaLookupTable * lookup,
                              BlastSeqLoc * location, 
                              Int4 query_bias)
 {
+    BlastAaLookupIndexQuery_MT(lookup, matrix, query, location, 
+                               query_bias, 1);
+}
+
+void BlastAaLookupIndexQuery_MT(BlastAaLookupTable * lookup,
+                                Int4 ** matrix,
+                                BLAST_SequenceBlk * query,
+                                BlastSeqLoc * location, 
+                                Int4 query_bias,
+                                Int4 num_threads)
+{
+#if !defined(_OPENMP) || defined(LOOKUP_VERBOSE)
+    /* the statistics kept in verbose mode are not thread safe */
+    num_threads = 1;
+#endif
+    num_threads = MAX(num_threads, 1);
+
     if (lookup->use_pssm) {
-        s_AddPSSMNeighboringWords(lookup, matrix, query_bias, location);
+        s_AddPSSMNeighboringWords(lookup, matrix, query_bias, location,
+                                  num_threads);
     }
     else {
         ASSERT(query != NULL);
-        s_AddNeighboringWords(lookup, matrix, query, query_bias, location);
+        s_AddNeighboringWords(lookup, matrix, query, query_bias, location,
+                              num_threads);
+    }
+}
+
+/** Append a neighboring word to a list of lookup table hits.
+ * @param list The list [in][out]
+ * @param index The backbone cell of the word [in]
+ * @param offset_list Query offsets of the word, or NULL [in]
+ * @param query_bias Number added to the offsets, or the only query
+ *                   offset if offset_list is NULL [in]
+ */
+static NCBI_INLINE void s_AaWordHitListAdd(AaWordHitList * list,
+                                           Int4 index,
+                                           const Int4 * offset_list,
+                                           Int4 query_bias)
+{
+    if (list->num_hits == list->num_alloc) {
+        list->num_alloc = MAX(2 * list->num_alloc, 1024);
+        list->hits = (AaWordHit *)realloc(list->hits,
+                                    list->num_alloc * sizeof(AaWordHit));
+        ASSERT(list->hits != NULL);
+    }
+    list->hits[list->num_hits].index = index;
+    list->hits[list->num_hits].query_bias = query_bias;
+    list->hits[list->num_hits].offset_list = offset_list;
+    list->num_hits++;
+}
+
+/** Add the query offsets of one word to a lookup table, or save them 
+ * for later if the table is being built by several threads.
+ * @param lookup The lookup table [in][out]
+ * @param hits If not NULL, the word is appended here instead [in][out]
+ * @param word The word [in]
+ * @param offset_list Query offsets of the word, or NULL [in]
+ * @param query_bias Number added to the offsets, or the only query
+ *                   offset if offset_list is NULL [in]
+ */
+static NCBI_INLINE void s_AaLookupAddWord(BlastAaLookupTable * lookup,
+                                          AaWordHitList * hits,
+                                          const Uint1 * word,
+                                          const Int4 * offset_list,
+                                          Int4 query_bias)
+{
+    Int4 index = ComputeTableIndex(lookup->word_length, lookup->charsize,
+                                   word);
+
+    if (hits != NULL)
+        s_AaWordHitListAdd(hits, index, offset_list, query_bias);
+    else if (offset_list != NULL)
+        BlastLookupAddWordHitsAtIndex(lookup->thin_backbone, index, 
+                                      offset_list + 2, offset_list[1],
+                                      query_bias);
+    else
+        BlastLookupAddWordHitsAtIndex(lookup->thin_backbone, index,
+                                      &query_bias, 1, 0);
+}
+
+/** Add the words saved by several threads to a lookup table. Each thread
+ * adds the words whose backbone cells it owns, walking the lists in
+ * order, so that the table is identical to one built by a single thread.
+ * @param lookup The lookup table [in][out]
+ * @param hit_lists One list of words per thread [in]
+ * @param num_threads Number of threads [in]
+ */
+static void s_AaLookupAddSavedWords(BlastAaLookupTable * lookup,
+                                    AaWordHitList * hit_lists,
+                                    Int4 num_threads)
+{
+    Int4 t;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+#endif
+    for (t = 0; t < num_threads; t++) {
+        Int4 k, m;
+
+        for (k = 0; k < num_threads; k++) {
+            AaWordHit *hits = hit_lists[k].hits;
+
+            for (m = 0; m < hit_lists[k].num_hits; m++) {
+                if (LOOKUP_BUILD_OWNER(hits[m].index, num_threads) != t)
+                    continue;
+                if (hits[m].offset_list != NULL)
+                    BlastLookupAddWordHitsAtIndex(lookup->thin_backbone,
+                                     hits[m].index, hits[m].offset_list + 2,
+                                     hits[m].offset_list[1], 
+                                     hits[m].query_bias);
+                else
+                    BlastLookupAddWordHitsAtIndex(lookup->thin_backbone,
+                                     hits[m].index, &hits[m].query_bias, 
+                                     1, 0);
+            }
+        }
     }
 }
 
 static void s_AddNeighboringWords(BlastAaLookupTable * lookup, Int4 ** matrix,
                                   BLAST_SequenceBlk * query, Int4 query_bias,
-                                  BlastSeqLoc * location)
+                                  BlastSeqLoc * location, Int4 num_threads)
 {
     Int4 i, j;
     Int4 **exact_backbone;
@@ -457,27 +636,77 @@ static void s_AddNeighboringWords(BlastAaLookupTable * lookup, Int4 ** matrix,
        query words. The query bias is not used here, since the next stage
        will need real offsets into the query sequence */
 
-    BlastLookupIndexQueryExactMatches(exact_backbone, lookup->word_length,
+    BlastLookupIndexQueryExactMatches_MT(exact_backbone, lookup->word_length,
                                       lookup->charsize, lookup->word_length,
-                                      query, location);
+                                      query, location, num_threads);
 
     /* walk though the list of exact matches previously computed. Find
        neighboring words for entire lists at a time */
 
-    for (i = 0; i < lookup->backbone_size; i++) {
-        if (exact_backbone[i] != NULL) {
-            s_AddWordHits(lookup, matrix, query->sequence,
-                          exact_backbone[i], query_bias, row_max);
-            sfree(exact_backbone[i]);
+    if (num_threads == 1) {
+        for (i = 0; i < lookup->backbone_size; i++) {
+            if (exact_backbone[i] != NULL) {
+                s_AddWordHits(lookup, matrix, query->sequence,
+                              exact_backbone[i], query_bias, row_max, NULL);
+                sfree(exact_backbone[i]);
+            }
         }
     }
+    else {
+        /* Threads take turns finding the neighbors of consecutive chunks 
+           of distinct query words, then adding the neighbors they found
+           to the cells they own */
+
+        const Int4 kChunk = AA_BUILD_CHUNK_WORDS;
+        AaWordHitList *hit_lists = (AaWordHitList *)calloc(num_threads,
+                                                     sizeof(AaWordHitList));
+        Int4 *words = (Int4 *)malloc(lookup->backbone_size * sizeof(Int4));
+        Int4 num_words = 0;
+        Int4 first;
+
+        ASSERT(hit_lists && words);
+        for (i = 0; i < lookup->backbone_size; i++) {
+            if (exact_backbone[i] != NULL)
+                words[num_words++] = i;
+        }
+
+        for (first = 0; first < num_words; first += kChunk * num_threads) {
+            Int4 t;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+#endif
+            for (t = 0; t < num_threads; t++) {
+                Int4 k;
+                Int4 start = first + t * kChunk;
+                Int4 end = MIN(start + kChunk, num_words);
+
+                hit_lists[t].num_hits = 0;
+                for (k = start; k < end; k++) {
+                    s_AddWordHits(lookup, matrix, query->sequence,
+                                  exact_backbone[words[k]], query_bias, 
+                                  row_max, hit_lists + t);
+                }
+            }
+
+            s_AaLookupAddSavedWords(lookup, hit_lists, num_threads);
+        }
+
+        for (i = 0; i < num_words; i++)
+            sfree(exact_backbone[words[i]]);
+        for (i = 0; i < num_threads; i++)
+            sfree(hit_lists[i].hits);
+        sfree(hit_lists);
+        sfree(words);
+    }
 
     sfree(exact_backbone);
 }
 
 static void s_AddWordHits(BlastAaLookupTable * lookup, Int4 ** matrix,
                         Uint1 * query, Int4 * offset_list,
-                        Int4 query_bias, Int4 * row_max)
+                        Int4 query_bias, Int4 * row_max,
+                        AaWordHitList * hits)
 {
     Uint1 *w;
     Uint1 s[32];   /* larger than any possible wordsize */
@@ -508,11 +737,7 @@ static void s_AddWordHits(BlastAaLookupTable * lookup, Int4 ** matrix,
        the lookup table */
 
     if (lookup->threshold == 0 || score < lookup->threshold) {
-        for (i = 0; i < offset_list[1]; i++) {
-            BlastLookupAddWordHit(lookup->thin_backbone, lookup->word_length,
-                                  lookup->charsize, w,
-                                  query_bias + offset_list[i + 2]);
-        }
+        s_AaLookupAddWord(lookup, hits, w, offset_list, query_bias);
     } else {
 #ifdef LOOKUP_VERBOSE
         lookup->neighbor_matches -= offset_list[1];
@@ -537,6 +762,7 @@ static void s_AddWordHits(BlastAaLookupTable * lookup, Int4 ** matrix,
     info.offset_list = offset_list;
     info.threshold = lookup->threshold;
     info.query_bias = query_bias;
+    info.hits = hits;
 
     /* compute the largest possible score that any neighboring word can have; 
        this maximum will gradually be replaced by exact scores as subject
@@ -578,19 +804,13 @@ static void s_AddWordHitsCore(NeighborInfo * info, Int4 score,
 
         Int4 *offset_list = info->offset_list;
         Int4 query_bias = info->query_bias;
-        Int4 wordsize = info->wordsize;
-        Int4 charsize = info->charsize;
         BlastAaLookupTable *lookup = info->lookup;
-        Int4 j;
 
         for (i = 0; i < alphabet_size; i++) {
             if (score + row[i] >= threshold) {
                 subject_word[current_pos] = i;
-                for (j = 0; j < offset_list[1]; j++) {
-                    BlastLookupAddWordHit(lookup->thin_backbone, wordsize,
-                                          charsize, subject_word,
-                                          query_bias + offset_list[j + 2]);
-                }
+                s_AaLookupAddWord(lookup, info->hits, subject_word, 
+                                  offset_list, query_bias);
 #ifdef LOOKUP_VERBOSE
                 lookup->neighbor_matches += offset_list[1];
 #endif
@@ -611,9 +831,42 @@ static void s_AddWordHitsCore(NeighborInfo * info, Int4 score,
     }
 }
 
+/** Find the neighboring words of the query words starting at a list of
+ * offsets, using a position-specific matrix. Used when several threads
+ * build a lookup table.
+ * @param lookup The lookup table [in]
+ * @param matrix The position-specific matrix [in]
+ * @param query_bias Number added to each query offset [in]
+ * @param offsets Query offsets of the words [in]
+ * @param num_offsets Number of entries in offsets [in]
+ * @param hits The neighboring words found [out]
+ */
+static void s_AddPSSMWordHitsAtOffsets(BlastAaLookupTable * lookup,
+                                       Int4 ** matrix, Int4 query_bias,
+                                       const Int4 * offsets, 
+                                       Int4 num_offsets,
+                                       AaWordHitList * hits)
+{
+    Int4 i, j, k;
+    Int4 row_max[32];   /* larger than any possible wordsize */
+
+    for (k = 0; k < num_offsets; k++) {
+        Int4 **row = matrix + offsets[k];
+
+        for (i = 0; i < lookup->word_length; i++) {
+            row_max[i] = row[i][0];
+            for (j = 1; j < lookup->alphabet_size; j++)
+                row_max[i] = MAX(row_max[i], row[i][j]);
+        }
+        s_AddPSSMWordHits(lookup, row, offsets[k] + query_bias, row_max,
+                          hits);
+    }
+}
+
 static void s_AddPSSMNeighboringWords(BlastAaLookupTable * lookup, 
                                       Int4 ** matrix, Int4 query_bias, 
-                                      BlastSeqLoc * location)
+                                      BlastSeqLoc * location,
+                                      Int4 num_threads)
 {
     Int4 offset;
     Int4 i, j;
@@ -621,6 +874,57 @@ static void s_AddPSSMNeighboringWords(BlastAaLookupTable * lookup,
     Int4 *row_max;
     Int4 wordsize = lookup->word_length;
 
+    if (num_threads > 1) {
+        /* Threads take turns finding the neighbors of consecutive chunks 
+           of query words, then adding the neighbors they found to the 
+           cells they own */
+
+        const Int4 kChunk = AA_BUILD_CHUNK_WORDS;
+        AaWordHitList *hit_lists = (AaWordHitList *)calloc(num_threads,
+                                                     sizeof(AaWordHitList));
+        Int4 *offsets;
+        Int4 num_offsets = 0;
+        Int4 first;
+
+        for (loc = location; loc; loc = loc->next)
+            num_offsets += MAX(0, loc->ssr->right - wordsize + 2 - 
+                                  loc->ssr->left);
+        offsets = (Int4 *)malloc(MAX(num_offsets, 1) * sizeof(Int4));
+        ASSERT(hit_lists && offsets);
+        num_offsets = 0;
+        for (loc = location; loc; loc = loc->next) {
+            for (offset = loc->ssr->left; 
+                 offset <= loc->ssr->right - wordsize + 1; offset++)
+                offsets[num_offsets++] = offset;
+        }
+
+        for (first = 0; first < num_offsets; 
+                                first += kChunk * num_threads) {
+            Int4 t;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+#endif
+            for (t = 0; t < num_threads; t++) {
+                Int4 start = MIN(first + t * kChunk, num_offsets);
+                Int4 end = MIN(start + kChunk, num_offsets);
+
+                hit_lists[t].num_hits = 0;
+                s_AddPSSMWordHitsAtOffsets(lookup, matrix, query_bias,
+                                           offsets + start, end - start,
+                                           hit_lists + t);
+            }
+
+            s_AaLookupAddSavedWords(lookup, hit_lists, num_threads);
+        }
+
+        for (i = 0; i < num_threads; i++)
+            sfree(hit_lists[i].hits);
+        sfree(hit_lists);
+        sfree(offsets);
+        return;
+    }
+
     /* for PSSMs, we only have to track the maximum score of 'wordsize'
        matrix columns */
 
@@ -653,7 +957,8 @@ static void s_AddPSSMNeighboringWords(BlastAaLookupTable * lookup,
 
             /* find all neighboring words */
 
-            s_AddPSSMWordHits(lookup, row, offset + query_bias, row_max);
+            s_AddPSSMWordHits(lookup, row, offset + query_bias, row_max, 
+                              NULL);
 
             /* shift the list of maximum scores over by one, to make room for 
                the next maximum in the next loop iteration */
@@ -667,7 +972,8 @@ static void s_AddPSSMNeighboringWords(BlastAaLookupTable * lookup,
 }
 
 static void s_AddPSSMWordHits(BlastAaLookupTable * lookup, Int4 ** matrix,
-                              Int4 offset, Int4 * row_max)
+                              Int4 offset, Int4 * row_max,
+                              AaWordHitList * hits)
 {
     Uint1 s[32];   /* larger than any possible wordsize */
     Int4 score;
@@ -687,6 +993,7 @@ static void s_AddPSSMWordHits(BlastAaLookupTable * lookup, Int4 ** matrix,
     info.offset_list = NULL;
     info.threshold = lookup->threshold;
     info.query_bias = offset;
+    info.hits = hits;
 
     /* compute the largest possible score that any neighboring word can have; 
        this maximum will gradually be replaced by exact scores as subject
@@ -726,15 +1033,13 @@ static void s_AddPSSMWordHitsCore(NeighborInfo * info, Int4 score,
            enough score */
 
         Int4 offset = info->query_bias;
-        Int4 wordsize = info->wordsize;
-        Int4 charsize = info->charsize;
         BlastAaLookupTable *lookup = info->lookup;
 
         for (i = 0; i < alphabet_size; i++) {
             if (score + row[i] >= threshold) {
                 subject_word[current_pos] = i;
-                BlastLookupAddWordHit(lookup->thin_backbone, wordsize,
-                                      charsize, subject_word, offset);
+                s_AaLookupAddWord(lookup, info->hits, subject_word, 
+                                  NULL, offset);
 #ifdef LOOKUP_VERBOSE
                 lookup->neighbor_matches++;
 #endif
@@ -755,38 +1060,111 @@ static void s_AddPSSMWordHitsCore(NeighborInfo * info, Int4 score,
     }
 }
 
-/** Fetch next vacant cell from a bank.
+/** Number of query words whose neighbors one thread generates before
+ * the threads switch to adding them to the compressed lookup table */
+#ifndef COMPRESSED_BUILD_CHUNK_WORDS
+#define COMPRESSED_BUILD_CHUNK_WORDS 128
+#endif
+
+/** While building a compressed lookup table, backbone cells are dealt
+ * out to threads in blocks of 2^COMPRESSED_BUILD_OWNER_BITS cells */
+#define COMPRESSED_BUILD_OWNER_BITS 10
+
+/** Overflow cells handed out to one thread building a compressed
+ * lookup table */
+typedef struct CompressedOverflowCursor {
+    CompressedOverflowCell *bank; /**< bank cells are taken from */
+    Int4 num_used;                /**< occupied cells in the bank */
+} CompressedOverflowCursor;
+
+/** A neighboring word found for a query offset, not yet added to the
+ * compressed lookup table */
+typedef struct CompressedWordHit {
+    Int4 index;         /**< backbone cell of the word */
+    Int4 query_offset;  /**< query offset to add to the cell */
+} CompressedWordHit;
+
+/** Growable list of CompressedWordHit, in the order they were found */
+typedef struct CompressedWordHitList {
+    CompressedWordHit *hits;  /**< the hits */
+    Int4 num_hits;            /**< number of hits in the list */
+    Int4 num_alloc;           /**< allocated size of hits */
+} CompressedWordHitList;
+
+/** Append a hit to a list of compressed lookup table hits.
+ * @param list The list [in][out]
+ * @param index The hashtable index into which the query offset goes [in]
+ * @param query_offset Query offset to add [in]
+ */
+static NCBI_INLINE void s_CompressedWordHitListAdd(
+                                  CompressedWordHitList * list,
+                                  Int4 index,
+                                  Int4 query_offset)
+{
+    if (list->num_hits == list->num_alloc) {
+        list->num_alloc = MAX(2 * list->num_alloc, 1024);
+        list->hits = (CompressedWordHit *)realloc(list->hits,
+                           list->num_alloc * sizeof(CompressedWordHit));
+        ASSERT(list->hits != NULL);
+    }
+    list->hits[list->num_hits].index = index;
+    list->hits[list->num_hits].query_offset = query_offset;
+    list->num_hits++;
+}
+
+/** Fetch next vacant cell from a bank. Banks are shared between
+ * threads but each thread fills its own bank.
  * @param[in] lookup compressed protein lookup table
- * @return pointer to reserved cell
+ * @param[in] cursor the calling thread's current bank
+ * @return pointer to reserved cell, or NULL if the maximum number of
+ *         banks has been allocated
  */
 static CompressedOverflowCell* 
-s_CompressedListGetNewCell(BlastCompressedAaLookupTable * lookup)
+s_CompressedListGetNewCell(BlastCompressedAaLookupTable * lookup,
+                           CompressedOverflowCursor * cursor)
 {
-    if (lookup->curr_overflow_cell == 
-                        COMPRESSED_OVERFLOW_CELLS_IN_BANK) {
+    if (cursor->bank == NULL || 
+        cursor->num_used == COMPRESSED_OVERFLOW_CELLS_IN_BANK) {
         /* need a new bank */
-        Int4 bank_idx = lookup->curr_overflow_bank + 1;
-        lookup->overflow_banks[bank_idx] = (CompressedOverflowCell*) malloc(
+        CompressedOverflowCell *bank = (CompressedOverflowCell*) malloc(
                                            COMPRESSED_OVERFLOW_CELLS_IN_BANK *
                                            sizeof(CompressedOverflowCell));
-        ASSERT(bank_idx < COMPRESSED_OVERFLOW_MAX_BANKS);
-        ASSERT(lookup->overflow_banks[bank_idx]);
-        lookup->curr_overflow_bank++;
-        lookup->curr_overflow_cell = 0;
+        Boolean registered = FALSE;
+
+        if (bank == NULL)
+            return NULL;
+#ifdef _OPENMP
+#pragma omp critical(compressed_overflow_banks)
+#endif
+        {
+            if (lookup->curr_overflow_bank + 1 < 
+                                COMPRESSED_OVERFLOW_MAX_BANKS) {
+                lookup->overflow_banks[++lookup->curr_overflow_bank] = bank;
+                registered = TRUE;
+            }
+        }
+        if (!registered) {
+            sfree(bank);
+            return NULL;
+        }
+        cursor->bank = bank;
+        cursor->num_used = 0;
     }
 
-    return lookup->overflow_banks[lookup->curr_overflow_bank] +
-                               lookup->curr_overflow_cell++;
+    return cursor->bank + cursor->num_used++;
 }
 
 /** Add a single query offset to the compressed
  * alphabet protein lookup table
  * @param lookup The lookup table [in]
+ * @param cursor Where to take new overflow cells from [in][out]
  * @param index The hashtable index into which the query offset goes [in]
  * @param query_offset Query offset to add [in]
+ * @return 0 on success, -1 if no overflow cell could be allocated
  */
-static void s_CompressedLookupAddWordHit(
+static Int2 s_CompressedLookupAddWordHit(
                                   BlastCompressedAaLookupTable * lookup,
+                                  CompressedOverflowCursor * cursor,
                                   Int4 index,
                                   Int4 query_offset)
 {
@@ -805,7 +1183,9 @@ static void s_CompressedLookupAddWordHit(
         Int4 tmp_offsets[COMPRESSED_HITS_PER_BACKBONE_CELL-1];
   
         /* fetch next vacant cell */
-        new_cell = s_CompressedListGetNewCell(lookup);
+        new_cell = s_CompressedListGetNewCell(lookup, cursor);
+        if (new_cell == NULL)
+            return -1;
 
         /* this cell is always the end of the list */
         new_cell->next = NULL; 
@@ -845,7 +1225,9 @@ static void s_CompressedLookupAddWordHit(
         if (cell_index == 0 ) { /* can't be empty => it's full  */
 
             /* fetch next vacant cell */
-            new_cell = s_CompressedListGetNewCell(lookup);
+            new_cell = s_CompressedListGetNewCell(lookup, cursor);
+            if (new_cell == NULL)
+                return -1;
 
             /* shuffle the pointers */
             new_cell->next = backbone_cell->payload.overflow_list.head;
@@ -858,17 +1240,20 @@ static void s_CompressedLookupAddWordHit(
     }
 
     backbone_cell->num_used++;
+    return 0;
 }
 
-/** Add a single query offset to the compressed lookup table.
- * The index is computed using the letters in w[], which is 
+/** Add a single query offset to the list of hits for the compressed
+ * lookup table. The index is computed using the letters in w[], which is 
  * assumed to already be converted to the compressed alphabet
- * @param lookup Pointer to the lookup table. [in][out]
+ * @param lookup Pointer to the lookup table. [in]
+ * @param hits List the hit is appended to [in][out]
  * @param w Word to add [in]
  * @param query_offset The offset in the query where the word occurs [in]
  */
 static void s_CompressedLookupAddEncoded(
                                      BlastCompressedAaLookupTable * lookup,
+                                     CompressedWordHitList * hits,
                                      Uint1* w,
                                      Int4 query_offset)
 {
@@ -907,18 +1292,20 @@ static void s_CompressedLookupAddEncoded(
         index = w[0] + W6p1[w[1]] + W6p2[w[2]] + W6p3[w[3]] +
                        W6p4[w[4]] + W6p5[w[5]];
 
-    s_CompressedLookupAddWordHit(lookup, index, query_offset);
+    s_CompressedWordHitListAdd(hits, index, query_offset);
 }
 
-/** Add a single query offset to the compressed lookup table.
- * The index is computed using the letters in w[], which is 
+/** Add a single query offset to the list of hits for the compressed
+ * lookup table. The index is computed using the letters in w[], which is 
  * assumed to be in the standard alphabet (i.e. not compressed)
- * @param lookup Pointer to the lookup table. [in][out]
+ * @param lookup Pointer to the lookup table. [in]
+ * @param hits List the hit is appended to [in][out]
  * @param w word to add [in]
  * @param query_offset the offset in the query where the word occurs [in]
  */
 static void s_CompressedLookupAddUnencoded(
                                BlastCompressedAaLookupTable * lookup,
+                               CompressedWordHitList * hits,
                                Uint1* w,
                                Int4 query_offset)
 {
@@ -927,7 +1314,7 @@ static void s_CompressedLookupAddUnencoded(
                                           lookup->compressed_alphabet_size,
                                           &skip, lookup);
     if (skip == 0)
-        s_CompressedLookupAddWordHit(lookup, index, query_offset);
+        s_CompressedWordHitListAdd(hits, index, query_offset);
 }
 
 /** Structure containing information needed for adding neighboring words 
@@ -935,6 +1322,7 @@ static void s_CompressedLookupAddUnencoded(
  */
 typedef struct CompressedNeighborInfo {
     BlastCompressedAaLookupTable *lookup; /**< Lookup table */
+    CompressedWordHitList *hits; /**< where neighboring words are saved */
     Uint1 *query_word;   /**< the word whose neighbors we are computing */
     Uint1 *subject_word; /**< the computed neighboring word */
     Int4 compressed_alphabet_size;  /**< for use with compressed alphabet */
@@ -1037,7 +1425,7 @@ static void s_CompressedAddWordHitsCore(CompressedNeighborInfo * info,
         for (i = 0; i < compressed_alphabet_size && 
                (score + rowSorted[i] >= threshold); i++) {
             subject_word[current_pos] = charSorted[i];
-            s_CompressedLookupAddEncoded(lookup, subject_word, 
+            s_CompressedLookupAddEncoded(lookup, info->hits, subject_word, 
                                          query_offset);
 #ifdef LOOKUP_VERBOSE
             lookup->neighbor_matches++;
@@ -1095,7 +1483,7 @@ static void s_CompressedAddWordHits(CompressedNeighborInfo * info,
        the lookup table */
 
     if (lookup->threshold == 0 || score < lookup->threshold) {
-        s_CompressedLookupAddUnencoded(lookup, w, query_offset);
+        s_CompressedLookupAddUnencoded(lookup, info->hits, w, query_offset);
     } 
     else {
 #ifdef LOOKUP_VERBOSE
@@ -1129,54 +1517,149 @@ static void s_CompressedAddWordHits(CompressedNeighborInfo * info,
  * Index a query sequence; i.e. fill a lookup table with the offsets
  * of query words
  *
+ * The query words are taken in rounds of COMPRESSED_BUILD_CHUNK_WORDS
+ * per thread. In each round every thread first lists the neighboring
+ * words of its own chunk; then every thread walks all the lists, in
+ * query order, and adds the hits that fall into the backbone cells it
+ * owns. The hits of a cell therefore end up in the same order whatever
+ * the number of threads.
+ *
  * @param lookup The lookup table [in/modified]
  * @param compressed_matrix The substitution matrix [in]
  * @param query The query sequence [in]
  * @param location List of ranges of query offsets to examine 
  *                 for indexing [in]
+ * @param num_threads Number of threads to use [in]
+ * @return 0 on success, -1 if the overflow banks ran out
  */
-static void s_CompressedAddNeighboringWords(
+static Int4 s_CompressedAddNeighboringWords(
                                   BlastCompressedAaLookupTable * lookup,
                                   Int4 ** compressed_matrix,
                                   BLAST_SequenceBlk * query, 
-                                  BlastSeqLoc * location)
+                                  BlastSeqLoc * location,
+                                  Int4 num_threads)
 {
     Int4 i, j;
-    CompressedNeighborInfo info;
+    CompressedNeighborInfo *info;
+    CompressedWordHitList *hit_lists;
+    CompressedOverflowCursor *cursors;
     BlastSeqLoc *loc;
     Int4 offset;
+    Int4 *word_offsets;
+    Int4 num_words = 0;
+    Int4 first;
+    Int2 status = 0;
+    const Int4 kChunk = COMPRESSED_BUILD_CHUNK_WORDS;
 
     ASSERT(lookup->alphabet_size <= BLASTAA_SIZE);
 
+#ifdef _OPENMP
+    num_threads = MAX(num_threads, 1);
+#else
+    num_threads = 1;
+#endif
+    info = (CompressedNeighborInfo *)malloc(num_threads * 
+                                            sizeof(CompressedNeighborInfo));
+    hit_lists = (CompressedWordHitList *)calloc(num_threads, 
+                                            sizeof(CompressedWordHitList));
+    cursors = (CompressedOverflowCursor *)calloc(num_threads,
+                                            sizeof(CompressedOverflowCursor));
+    ASSERT(info && hit_lists && cursors);
+
     /* Determine the maximum possible score for each 
        row of the score matrix */
 
     for (i = 0; i < lookup->alphabet_size; i++) {
-        info.row_max[i] = compressed_matrix[i][0];
+        info[0].row_max[i] = compressed_matrix[i][0];
         for (j = 1; j < lookup->compressed_alphabet_size; j++)
-            info.row_max[i] = MAX(info.row_max[i], compressed_matrix[i][j]);
+            info[0].row_max[i] = MAX(info[0].row_max[i], 
+                                     compressed_matrix[i][j]);
     }
 
     /* Set up the structure of information to be used during the recursion */
-    info.lookup = lookup;
-    info.compressed_alphabet_size = lookup->compressed_alphabet_size;
-    info.wordsize = lookup->word_length;
-    info.matrix = compressed_matrix;
-    info.threshold = lookup->threshold;
-
-    s_loadSortedMatrix(&info); 
-
+    info[0].lookup = lookup;
+    info[0].compressed_alphabet_size = lookup->compressed_alphabet_size;
+    info[0].wordsize = lookup->word_length;
+    info[0].matrix = compressed_matrix;
+    info[0].threshold = lookup->threshold;
+
+    s_loadSortedMatrix(&info[0]); 
+
+    for (i = 0; i < num_threads; i++) {
+        if (i > 0)
+            info[i] = info[0];
+        info[i].hits = hit_lists + i;
+    }
 
-    /* Walk through the query and index all the words */
+    /* List the query offsets to index, in order */
 
+    for (loc = location; loc; loc = loc->next) {
+        num_words += MAX(0, loc->ssr->right - lookup->word_length + 2 -
+                            loc->ssr->left);
+    }
+    word_offsets = (Int4 *)malloc(MAX(num_words, 1) * sizeof(Int4));
+    ASSERT(word_offsets != NULL);
+    num_words = 0;
     for (loc = location; loc; loc = loc->next){
         Int4 from = loc->ssr->left;
         Int4 to = loc->ssr->right - lookup->word_length + 1;
 
-        for (offset = from; offset <= to; offset++){
-            s_CompressedAddWordHits(&info, query->sequence, offset);
+        for (offset = from; offset <= to; offset++)
+            word_offsets[num_words++] = offset;
+    }
+
+    /* Walk through the query and index all the words */
+
+    for (first = 0; first < num_words && status == 0; 
+                                    first += kChunk * num_threads) {
+        Int4 t;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+#endif
+        for (t = 0; t < num_threads; t++) {
+            Int4 k;
+            Int4 start = first + t * kChunk;
+            Int4 end = MIN(start + kChunk, num_words);
+
+            hit_lists[t].num_hits = 0;
+            for (k = start; k < end; k++) {
+                s_CompressedAddWordHits(&info[t], query->sequence, 
+                                        word_offsets[k]);
+            }
+        }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1) \
+                         reduction(|:status)
+#endif
+        for (t = 0; t < num_threads; t++) {
+            Int4 k, m;
+
+            for (k = 0; k < num_threads && status == 0; k++) {
+                CompressedWordHit *hits = hit_lists[k].hits;
+                for (m = 0; m < hit_lists[k].num_hits; m++) {
+                    if (((hits[m].index >> COMPRESSED_BUILD_OWNER_BITS) % 
+                                                     num_threads) != t)
+                        continue;
+                    if (s_CompressedLookupAddWordHit(lookup, cursors + t,
+                                                 hits[m].index,
+                                                 hits[m].query_offset)) {
+                        status = -1;
+                        break;
+                    }
+                }
+            }
         }
     }
+
+    for (i = 0; i < num_threads; i++)
+        sfree(hit_lists[i].hits);
+    sfree(hit_lists);
+    sfree(cursors);
+    sfree(info);
+    sfree(word_offsets);
+    return status;
 }
 
 /** Complete the construction of a compressed protein lookup table
@@ -1273,7 +1756,8 @@ Int4 BlastCompressedAaLookupTableNew(BLAST_SequenceBlk* query,
                                      BlastSeqLoc* locations,
                                      BlastCompressedAaLookupTable * *lut,
                                      const LookupTableOptions * opt,
-                                     BlastScoreBlk *sbp)
+                                     BlastScoreBlk *sbp,
+                                     Int4 num_threads)
 {
     Int4 i;
     SCompressedAlphabet* new_alphabet;
@@ -1325,10 +1809,7 @@ Int4 BlastCompressedAaLookupTableNew(BLAST_SequenceBlk* query,
                                          sizeof(CompressedOverflowCell *));
     ASSERT(lookup->backbone != NULL);
     ASSERT(lookup->overflow_banks != NULL);
-    /* there is no 'current overflow cell' that was previously 
-       allocated, so configure the allocator to start allocations
-       immediately */
-    lookup->curr_overflow_cell = COMPRESSED_OVERFLOW_CELLS_IN_BANK;
+    /* no overflow banks have been allocated yet */
     lookup->curr_overflow_bank = -1;
 
     /* copy the mapping from protein to compressed 
@@ -1351,13 +1832,52 @@ Int4 BlastCompressedAaLookupTableNew(BLAST_SequenceBlk* query,
 
     /* index the query and finish up */
 
-    s_CompressedAddNeighboringWords(lookup, new_alphabet->matrix->data, 
-                                    query, locations);
+    if (s_CompressedAddNeighboringWords(lookup, new_alphabet->matrix->data, 
+                                        query, locations, num_threads)) {
+        SCompressedAlphabetFree(new_alphabet);
+        return -1;
+    }
     s_CompressedLookupFinalize(lookup);
     SCompressedAlphabetFree(new_alphabet);
     return 0;
 }
 
+/** Search cost of the standard blastp lookup table, in picoseconds per
+ * (query residue x database residue); measured with BLOSUM62, word
+ * size 3 and threshold 11, including the extensions that follow */
+#define STANDARD_PAIR_COST_PS 180
+/** Same for the compressed table with the batch word size and threshold */
+#define COMPRESSED_PAIR_COST_PS 36
+/** Time to add one entry to a compressed lookup table, in picoseconds */
+#define COMPRESSED_HIT_BUILD_COST_PS 100000
+/** Fixed cost of allocating and scanning the compressed backbone, in
+ * picoseconds */
+#define COMPRESSED_FIXED_BUILD_COST_PS 1.0e11
+
+Boolean BlastCompressedAaLookupIsCheaper(Int8 query_length, Int8 db_length,
+                                         Int4 num_threads)
+{
+    double num_hits = (double)query_length * 
+                      COMPRESSED_BATCH_HITS_PER_RESIDUE;
+    double max_hits = (double)COMPRESSED_OVERFLOW_MAX_BANKS *
+                      COMPRESSED_OVERFLOW_CELLS_IN_BANK *
+                      COMPRESSED_HITS_PER_OVERFLOW_CELL;
+    double build_cost, saved_cost;
+
+    if (query_length <= 0 || db_length <= 0)
+        return FALSE;
+
+    /* leave room for partially filled overflow cells */
+    if (num_hits > 0.75 * max_hits)
+        return FALSE;
+
+    build_cost = COMPRESSED_FIXED_BUILD_COST_PS + 
+                 num_hits * COMPRESSED_HIT_BUILD_COST_PS / MAX(num_threads, 1);
+    saved_cost = (double)query_length * db_length *
+                 (STANDARD_PAIR_COST_PS - COMPRESSED_PAIR_COST_PS);
+    return (Boolean)(saved_cost > build_cost);
+}
+
 BlastCompressedAaLookupTable *BlastCompressedAaLookupTableDestruct(
                                  BlastCompressedAaLookupTable * lookup)
 {
@@ -87,9 +87,19 @@ typedef struct AaLookupSmallboneCell {
 /** types of cells */
 typedef enum {
     eBackbone  = 0,
-    eSmallbone = 1 
+    eSmallbone = 1,
+    eNarrowbone = 2  /**< no cells; the backbone is an Int4 array of
+                          offsets into one overflow array holding all hits */
 } EBoneType;
 
+/** A narrow backbone is only built if more than this percentage of the
+ * occupied cells would keep their hits in the overflow array; such cells
+ * cost two memory accesses either way, and the narrow backbone is four
+ * times smaller. Otherwise a normal backbone is built instead */
+#ifndef AA_NARROWBONE_OVERFLOW_PCT
+#define AA_NARROWBONE_OVERFLOW_PCT 50
+#endif
+
 /** The basic lookup table structure for blastp searches
  */
 typedef struct BlastAaLookupTable {
@@ -110,6 +120,7 @@ typedef struct BlastAaLookupTable {
     EBoneType bone_type;   /**< type of bone used:
                                 0:  normal backbone (using Int4)
                                 1:  small backbone  (using Uint2)
+                                2:  narrow backbone (offsets only)
                                 will be determined in Finalize call */
     void * thick_backbone; /**< may point to BackboneCell, SmallboneCell,
                                 or TinyboneCell. 
@@ -118,7 +129,11 @@ typedef struct BlastAaLookupTable {
                                 backbone to put at most 
                                 AA_HITS_PER_CELL hits on the 
                                 backbone, otherwise point to 
-                                some overflow storage  */
+                                some overflow storage. For a narrow
+                                backbone, an Int4 array of 
+                                backbone_size+1 offsets; the hits of
+                                cell i are overflow[offset[i]] up to
+                                overflow[offset[i+1]] */
     void * overflow;       /**< may point to Int4 or Uint2,
                                 the overflow array for the compacted 
                                 lookup table */
@@ -143,6 +158,9 @@ typedef struct BlastAaLookupTable {
  * into their final form
  *
  * @param lookup the lookup table [in]
+ * @param bone_type the backbone to build; eNarrowbone is replaced by
+ *        eBackbone unless more than AA_NARROWBONE_OVERFLOW_PCT percent
+ *        of the occupied cells would overflow [in]
  * @return Zero.
  */
 NCBI_XBLAST_EXPORT
@@ -183,6 +201,29 @@ void BlastAaLookupIndexQuery(BlastAaLookupTable* lookup,
 			     BlastSeqLoc* unmasked_regions,
                              Int4 query_bias);
 
+/** Same as BlastAaLookupIndexQuery, but the neighboring words are found
+ * by several threads. The threads work on consecutive chunks of query 
+ * words and add the words they found to the backbone cells each thread
+ * owns, so the resulting table is identical to a single-threaded build.
+ *
+ * @param lookup the lookup table [in/modified]
+ * @param matrix the substitution matrix [in]
+ * @param query the array of queries to index
+ * @param unmasked_regions a BlastSeqLoc* which points to a (list of) 
+ *                        integer pair(s) which specify the unmasked region(s) 
+ *                        of the query [in]
+ * @param query_bias number added to each offset put into lookup table 
+ *              (only used for RPS blast database creation, otherwise 0) [in]
+ * @param num_threads number of threads to use [in]
+ */
+NCBI_XBLAST_EXPORT
+void BlastAaLookupIndexQuery_MT(BlastAaLookupTable* lookup,
+                                Int4 ** matrix,
+                                BLAST_SequenceBlk* query,
+                                BlastSeqLoc* unmasked_regions,
+                                Int4 query_bias,
+                                Int4 num_threads);
+
 /* ------------ compressed alphabet protein blast defines ---------------*/
 
 /** number of query offsets to store in a backbone cell */
@@ -198,6 +239,11 @@ void BlastAaLookupIndexQuery(BlastAaLookupTable* lookup,
     needed; memory will run out before this is insufficient) */
 #define COMPRESSED_OVERFLOW_MAX_BANKS 1024
 
+/** Approximate number of lookup table entries per query residue in a
+    compressed table built with BLAST_WORDSIZE_COMPRESSED_BATCH and
+    BLAST_WORD_THRESHOLD_COMPRESSED_BATCH (measured with BLOSUM62) */
+#define COMPRESSED_BATCH_HITS_PER_RESIDUE 2800
+
 /** cell in list for holding query offsets */
 typedef struct CompressedOverflowCell {
     struct CompressedOverflowCell* next;     /**< pointer to next cell */
@@ -246,8 +292,7 @@ typedef struct BlastCompressedAaLookupTable {
     CompressedOverflowCell ** overflow_banks;   /**< array of batches of query
                                            offsets that are too numerous to
                                            fit in backbone cells */
-    Int4 curr_overflow_cell; /**< occupied cells in the current bank */
-    Int4 curr_overflow_bank; /**< current bank to fill-up */
+    Int4 curr_overflow_bank; /**< last bank allocated */
     PV_ARRAY_TYPE *pv;     /**< Presence vector bitfield; bit positions that
                                 are set indicate that the corresponding thick
                                 backbone cell contains hits */
@@ -273,13 +318,35 @@ typedef struct BlastCompressedAaLookupTable {
  * @param lut Pointer to the lookup table to be created [out]
  * @param opt Options for lookup table creation [in]
  * @param sbp pointer to score matrix information [in]
- * @return 0 if successful, nonzero on failure
+ * @param num_threads Number of threads used to index the query [in]
+ * @return 0 if successful, nonzero on failure (the table must still be
+ *         freed with BlastCompressedAaLookupTableDestruct)
  */
 Int4 BlastCompressedAaLookupTableNew(BLAST_SequenceBlk* query,
                                 BlastSeqLoc* locations,
                                 BlastCompressedAaLookupTable * *lut,
                                 const LookupTableOptions * opt,
-                                BlastScoreBlk *sbp);
+                                BlastScoreBlk *sbp,
+                                Int4 num_threads);
+
+/** Decide whether a blastp search of a query batch would be cheaper
+ * with a compressed alphabet lookup table than with the standard one.
+ * The compressed table has far fewer hits per subject word, but it is
+ * expensive to build: roughly COMPRESSED_BATCH_HITS_PER_RESIDUE table
+ * entries per query residue, each a random write. The standard table is
+ * cheap to build but its hits per subject word grow with the batch size.
+ * Both search costs grow with query length times database length, so
+ * the compressed table wins once the database is large enough to pay
+ * for the build. Batches whose estimated table would not fit in the
+ * overflow banks are never switched.
+ * @param query_length Total length of the query batch [in]
+ * @param db_length Total length of the database [in]
+ * @param num_threads Number of threads building the table [in]
+ * @return TRUE if the compressed table is expected to be cheaper
+ */
+NCBI_XBLAST_EXPORT
+Boolean BlastCompressedAaLookupIsCheaper(Int8 query_length, Int8 db_length,
+                                         Int4 num_threads);
 
 /** Free the compressed lookup table.
  *  @param lookup The lookup table structure to be freed
@@ -348,6 +415,10 @@ typedef struct RPSBackboneCell {
 /** The number of regions into which the concatenated RPS blast
     database is split via bucket sorting */
 #define RPS_BUCKET_SIZE 2048
+
+/** The number of offset pairs allocated for a bucket when it receives
+    its first hit */
+#define RPS_BUCKET_INIT_ALLOC 1000
                            
 
 /** structure used for bucket sorting offsets retrieved
@@ -37,6 +37,108 @@ static char const rcsid[] =
     "$Id: blast_aascan.c,v 1.16 2010/07/23 14:36:34 kazimird Exp $";
 #endif                          /* SKIP_DOXYGEN_PROCESSING */
 
+/** Number of lookup table hits whose backbone cells are prefetched before
+ * the hits in them are copied out. Must be a power of two.
+ */
+#ifndef AA_SCAN_PREFETCH_DEPTH
+#define AA_SCAN_PREFETCH_DEPTH 8
+#endif
+
+/** A subject word that is present in the lookup table but whose
+ * backbone cell has so far only been prefetched
+ */
+typedef struct AaScanPendingHit {
+    Int4 index;     /**< lookup table index of the word */
+    Int4 s_off;     /**< subject offset of the word */
+} AaScanPendingHit;
+
+/**
+ * Copy the hits of one normal backbone cell to the destination array.
+ *
+ * @param cell the backbone cell [in]
+ * @param ovfl the overflow array [in]
+ * @param s_off subject offset of the word [in]
+ * @param dest where to copy the hits [out]
+ * @param room how many hits dest can still hold [in]
+ * @return The number of hits copied, or -1 if they do not fit.
+ */
+static NCBI_INLINE Int4 s_AaCopyBackboneHits(const AaLookupBackboneCell * cell,
+                                 const Int4 * ovfl, Int4 s_off,
+                                 BlastOffsetPair * NCBI_RESTRICT dest,
+                                 Int4 room)
+{
+    Int4 i;
+    Int4 numhits = cell->num_used;
+    const Int4 *src;
+
+    ASSERT(numhits != 0);
+    if (numhits > room)
+        return -1;
+
+    if (numhits <= AA_HITS_PER_CELL)
+        /* hits live in thick_backbone */
+        src = cell->payload.entries;
+    else
+        /* hits live in overflow array */
+        src = ovfl + cell->payload.overflow_cursor;
+
+    for (i = 0; i < numhits; i++) {
+        dest[i].qs_offsets.q_off = src[i];
+        dest[i].qs_offsets.s_off = s_off;
+    }
+    return numhits;
+}
+
+/** same function for small lookup table */
+static NCBI_INLINE Int4 s_AaCopySmallboneHits(
+                                 const AaLookupSmallboneCell * cell,
+                                 const Uint2 * ovfl, Int4 s_off,
+                                 BlastOffsetPair * NCBI_RESTRICT dest,
+                                 Int4 room)
+{
+    Int4 i;
+    Int4 numhits = cell->num_used;
+    const Uint2 *src;
+
+    ASSERT(numhits != 0);
+    if (numhits > room)
+        return -1;
+
+    if (numhits <= AA_HITS_PER_CELL)
+        src = cell->payload.entries;
+    else
+        src = ovfl + cell->payload.overflow_cursor;
+
+    for (i = 0; i < numhits; i++) {
+        dest[i].qs_offsets.q_off = src[i];
+        dest[i].qs_offsets.s_off = s_off;
+    }
+    return numhits;
+}
+
+/** same function for narrow lookup table; the hits of cell 'index'
+ * lie between two consecutive backbone offsets
+ */
+static NCBI_INLINE Int4 s_AaCopyNarrowboneHits(const Int4 * backbone,
+                                 Int4 index, const Int4 * ovfl, Int4 s_off,
+                                 BlastOffsetPair * NCBI_RESTRICT dest,
+                                 Int4 room)
+{
+    Int4 i;
+    const Int4 *src = ovfl + backbone[index];
+    Int4 numhits = backbone[index + 1] - backbone[index];
+
+    ASSERT(numhits != 0);
+    if (numhits > room)
+        return -1;
+
+    for (i = 0; i < numhits; i++) {
+        dest[i].qs_offsets.q_off = src[i];
+        dest[i].qs_offsets.s_off = s_off;
+    }
+    return numhits;
+}
+
 /**
  * Scans the subject sequence from "offset" to the end of the sequence.
  * Copies at most array_size hits.
@@ -44,6 +146,13 @@ static char const rcsid[] =
  * If there isn't enough room to copy all the hits, return early, and update
  * "offset". 
  *
+ * Backbone cells are read in a different order than the presence vector:
+ * every word present in the table has its cell prefetched and is queued,
+ * and its hits are copied once AA_SCAN_PREFETCH_DEPTH more words have
+ * been queued (or the range ends). Hits come out in the same order as
+ * without the queue; when the destination fills up, scanning resumes
+ * from the oldest word still queued.
+ *
  * @param lookup_wrap the lookup table [in]
  * @param subject the subject sequence [in]
  * @param offset_pairs Array to which hits will be copied [out]
@@ -68,6 +177,8 @@ static Int4 s_BlastAaScanSubject(const LookupTableWrap * lookup_wrap,
     AaLookupBackboneCell *bbc;
     Int4 *ovfl;
     Int4 word_length;
+    AaScanPendingHit pending[AA_SCAN_PREFETCH_DEPTH];
+    Int4 head = 0, tail = 0;    /* oldest and next free queue entries */
 
     ASSERT(lookup_wrap->lut_type == eAaLookupTable);
     lookup = (BlastAaLookupTable *) lookup_wrap->lut;
@@ -91,43 +202,45 @@ static Int4 s_BlastAaScanSubject(const LookupTableWrap * lookup_wrap,
                                              lookup->charsize,
                                              lookup->mask, s, index);
 
-        /* if there are hits... */
+        /* if there are hits, start loading the cell and queue the word */
         if (PV_TEST(pv, index, PV_ARRAY_BTS)) {
-            numhits = bbc[index].num_used;
-
-            ASSERT(numhits != 0);
-
-            /* ...and there is enough space in the destination array, */
-            if (numhits <= (array_size - totalhits))
-                /* ...then copy the hits to the destination */
-            {
-                Int4 *src;
-                if (numhits <= AA_HITS_PER_CELL)
-                    /* hits live in thick_backbone */
-                    src = bbc[index].payload.entries;
-                else
-                    /* hits live in overflow array */
-                    src = &(ovfl[bbc[index].payload.overflow_cursor]);
-
-                /* copy the hits. */
-                {
-                    Int4 i;
-                    Int4 s_off = s - subject->sequence;
-                    for (i = 0; i < numhits; i++) {
-                        offset_pairs[i + totalhits].qs_offsets.q_off = src[i];
-                        offset_pairs[i + totalhits].qs_offsets.s_off = s_off;
-                    }
+            AaScanPendingHit *hit;
+
+            NCBI_PREFETCH(bbc + index);
+            hit = pending + (tail++ & (AA_SCAN_PREFETCH_DEPTH - 1));
+            hit->index = index;
+            hit->s_off = s - subject->sequence;
+
+            /* copy out the oldest queued word if the queue is full */
+            if (tail - head == AA_SCAN_PREFETCH_DEPTH) {
+                hit = pending + (head++ & (AA_SCAN_PREFETCH_DEPTH - 1));
+                numhits = s_AaCopyBackboneHits(bbc + hit->index, ovfl,
+                                               hit->s_off,
+                                               offset_pairs + totalhits,
+                                               array_size - totalhits);
+                if (numhits < 0) {
+                    /* not enough space in the destination array; 
+                       return early */
+                    s_range[1] = hit->s_off;
+                    return totalhits;
                 }
-
                 totalhits += numhits;
-            } else
-                /* not enough space in the destination array; return early */
-            {
-                s_range[1] = s - subject->sequence;
-                return totalhits;
             }
         }
     } /* end for */
+
+    /* drain the queue before moving to the next range */
+    for (; head != tail; head++) {
+        AaScanPendingHit *hit = pending + (head & (AA_SCAN_PREFETCH_DEPTH - 1));
+        numhits = s_AaCopyBackboneHits(bbc + hit->index, ovfl, hit->s_off,
+                                       offset_pairs + totalhits,
+                                       array_size - totalhits);
+        if (numhits < 0) {
+            s_range[1] = hit->s_off;
+            return totalhits;
+        }
+        totalhits += numhits;
+    }
     s_range[1] = s - subject->sequence;
     } /* end while */
 
@@ -154,6 +267,8 @@ static Int4 s_BlastSmallAaScanSubject(const LookupTableWrap * lookup_wrap,
     AaLookupSmallboneCell *bbc;
     Uint2 *ovfl;
     Int4 word_length;
+    AaScanPendingHit pending[AA_SCAN_PREFETCH_DEPTH];
+    Int4 head = 0, tail = 0;    /* oldest and next free queue entries */
 
     ASSERT(lookup_wrap->lut_type == eAaLookupTable);
     lookup = (BlastAaLookupTable *) lookup_wrap->lut;
@@ -177,43 +292,134 @@ static Int4 s_BlastSmallAaScanSubject(const LookupTableWrap * lookup_wrap,
                                              lookup->charsize,
                                              lookup->mask, s, index);
 
-        /* if there are hits... */
+        /* if there are hits, start loading the cell and queue the word */
         if (PV_TEST(pv, index, PV_ARRAY_BTS)) {
-            numhits = bbc[index].num_used;
+            AaScanPendingHit *hit;
+
+            NCBI_PREFETCH(bbc + index);
+            hit = pending + (tail++ & (AA_SCAN_PREFETCH_DEPTH - 1));
+            hit->index = index;
+            hit->s_off = s - subject->sequence;
+
+            if (tail - head == AA_SCAN_PREFETCH_DEPTH) {
+                hit = pending + (head++ & (AA_SCAN_PREFETCH_DEPTH - 1));
+                numhits = s_AaCopySmallboneHits(bbc + hit->index, ovfl,
+                                                hit->s_off,
+                                                offset_pairs + totalhits,
+                                                array_size - totalhits);
+                if (numhits < 0) {
+                    s_range[1] = hit->s_off;
+                    return totalhits;
+                }
+                totalhits += numhits;
+            }
+        }
+    } /* end for */
 
-            ASSERT(numhits != 0);
+    for (; head != tail; head++) {
+        AaScanPendingHit *hit = pending + (head & (AA_SCAN_PREFETCH_DEPTH - 1));
+        numhits = s_AaCopySmallboneHits(bbc + hit->index, ovfl, hit->s_off,
+                                        offset_pairs + totalhits,
+                                        array_size - totalhits);
+        if (numhits < 0) {
+            s_range[1] = hit->s_off;
+            return totalhits;
+        }
+        totalhits += numhits;
+    }
+    s_range[1] = s - subject->sequence;
 
-            /* ...and there is enough space in the destination array, */
-            if (numhits <= (array_size - totalhits))
-                /* ...then copy the hits to the destination */
-            {
-                Uint2 *src;
-                if (numhits <= AA_HITS_PER_CELL)
-                    /* hits live in thick_backbone */
-                    src = bbc[index].payload.entries;
-                else
-                    /* hits live in overflow array */
-                    src = &(ovfl[bbc[index].payload.overflow_cursor]);
-
-                /* copy the hits. */
-                {
-                    Int4 i;
-                    Int4 s_off = s - subject->sequence;
-                    for (i = 0; i < numhits; i++) {
-                        offset_pairs[i + totalhits].qs_offsets.q_off = src[i];
-                        offset_pairs[i + totalhits].qs_offsets.s_off = s_off;
-                    }
-                }
+    } /* end while */
+    /* if we get here, we fell off the end of the sequence */
+    return totalhits;
+}
+
+/** same function for narrow lookup table */
+static Int4 s_BlastNarrowAaScanSubject(const LookupTableWrap * lookup_wrap,
+                                 const BLAST_SequenceBlk * subject,
+                                 BlastOffsetPair * NCBI_RESTRICT offset_pairs,
+                                 Int4 array_size,
+                                 Int4 * s_range)
+{
+    Int4 index;
+    Uint1 *s = NULL;
+    Uint1 *s_first = NULL;
+    Uint1 *s_last = NULL;
+    Int4 numhits = 0;           /* number of hits found for a given subject
+                                   offset */
+    Int4 totalhits = 0;         /* cumulative number of hits found */
+    PV_ARRAY_TYPE *pv;
+    BlastAaLookupTable *lookup;
+    Int4 *backbone;
+    Int4 *ovfl;
+    Int4 word_length;
+    AaScanPendingHit pending[AA_SCAN_PREFETCH_DEPTH];
+    Int4 head = 0, tail = 0;    /* oldest and next free queue entries */
+
+    ASSERT(lookup_wrap->lut_type == eAaLookupTable);
+    lookup = (BlastAaLookupTable *) lookup_wrap->lut;
+    ASSERT(lookup->bone_type == eNarrowbone);
+    pv = lookup->pv;   
+    backbone = (Int4 *) lookup->thick_backbone;
+    ovfl = (Int4 *) lookup->overflow;
+    word_length = lookup->word_length;
+
+    while (s_DetermineScanningOffsets(subject, word_length, word_length, s_range)) {
+    s_first=subject->sequence + s_range[1];
+    s_last=subject->sequence + s_range[2];
 
+    /* prime the index */
+    index = ComputeTableIndex(word_length - 1,
+                              lookup->charsize, s_first);
+
+    for (s = s_first; s <= s_last; s++) {
+        /* compute the index value */
+        index = ComputeTableIndexIncremental(word_length, 
+                                             lookup->charsize,
+                                             lookup->mask, s, index);
+
+        /* if there are hits, start loading the cell and queue the word */
+        if (PV_TEST(pv, index, PV_ARRAY_BTS)) {
+            AaScanPendingHit *hit;
+
+            NCBI_PREFETCH(backbone + index);
+            hit = pending + (tail++ & (AA_SCAN_PREFETCH_DEPTH - 1));
+            hit->index = index;
+            hit->s_off = s - subject->sequence;
+
+            if (tail - head == AA_SCAN_PREFETCH_DEPTH) {
+                /* the offset of the word halfway along the queue has
+                   arrived by now; start loading its hits too */
+                hit = pending + ((head + AA_SCAN_PREFETCH_DEPTH / 2) & 
+                                 (AA_SCAN_PREFETCH_DEPTH - 1));
+                NCBI_PREFETCH(ovfl + backbone[hit->index]);
+
+                hit = pending + (head++ & (AA_SCAN_PREFETCH_DEPTH - 1));
+                numhits = s_AaCopyNarrowboneHits(backbone, hit->index, ovfl,
+                                                 hit->s_off,
+                                                 offset_pairs + totalhits,
+                                                 array_size - totalhits);
+                if (numhits < 0) {
+                    s_range[1] = hit->s_off;
+                    return totalhits;
+                }
                 totalhits += numhits;
-            } else
-                /* not enough space in the destination array; return early */
-            {
-                s_range[1] = s - subject->sequence;
-                return totalhits;
             }
         }
     } /* end for */
+
+    for (; head != tail; head++) {
+        AaScanPendingHit *hit = pending + (head & (AA_SCAN_PREFETCH_DEPTH - 1));
+        numhits = s_AaCopyNarrowboneHits(backbone, hit->index, ovfl,
+                                         hit->s_off,
+                                         offset_pairs + totalhits,
+                                         array_size - totalhits);
+        if (numhits < 0) {
+            s_range[1] = hit->s_off;
+            return totalhits;
+        }
+        totalhits += numhits;
+    }
     s_range[1] = s - subject->sequence;
 
     } /* end while */
@@ -221,9 +427,95 @@ static Int4 s_BlastSmallAaScanSubject(const LookupTableWrap * lookup_wrap,
     return totalhits;
 }
 
+/**
+ * Copy the hits of one compressed lookup table cell to the destination
+ * array.
+ *
+ * @param backbone_cell the backbone cell [in]
+ * @param s_off subject offset of the word [in]
+ * @param dest where to copy the hits [out]
+ * @param room how many hits dest can still hold [in]
+ * @return The number of hits copied, or -1 if they do not fit.
+ */
+static NCBI_INLINE Int4 s_CompressedCopyHits(
+                          const CompressedLookupBackboneCell * backbone_cell,
+                          Int4 s_off,
+                          BlastOffsetPair * NCBI_RESTRICT dest,
+                          Int4 room)
+{
+    Int4 i;
+    const Int4 *query_offsets;
+    Int4 numhits = backbone_cell->num_used;
+
+    if (numhits > room)
+        return -1;
+
+    if (numhits <= COMPRESSED_HITS_PER_BACKBONE_CELL) {
+       /* hits all live in the backbone */
+
+       query_offsets = backbone_cell->payload.query_offsets;
+       for (i = 0; i < numhits; i++) {
+          dest[i].qs_offsets.q_off = query_offsets[i];
+          dest[i].qs_offsets.s_off = s_off;
+       }
+    } 
+    else { 
+       /* hits are in the backbone cell and in the overflow list */
+       CompressedOverflowCell* curr_cell = 
+                           backbone_cell->payload.overflow_list.head;
+       /* we know the overflow list has at least one cell,
+          so it's safe to speculatively fetch the pointer
+          to further cells */
+       CompressedOverflowCell* next_cell = curr_cell->next;
+
+       /* the number of hits in the linked list of cells has
+          1 added to it; the extra hit was spilled from the
+          backbone when the list was first created */
+       Int4 first_cell_entries = (numhits -
+                            COMPRESSED_HITS_PER_BACKBONE_CELL) %
+                            COMPRESSED_HITS_PER_OVERFLOW_CELL + 1;
+
+       /* copy hits from backbone */
+       query_offsets = 
+                backbone_cell->payload.overflow_list.query_offsets;
+       for(i = 0; i < COMPRESSED_HITS_PER_BACKBONE_CELL - 1; i++) {
+          dest[i].qs_offsets.q_off = query_offsets[i];
+          dest[i].qs_offsets.s_off = s_off;
+       }
+     
+       /* handle the overflow list */
+     
+       /* first cell can be partially filled */
+       query_offsets = curr_cell->query_offsets;
+       dest += i;
+       for (i = 0; i < first_cell_entries; i++) {
+          dest[i].qs_offsets.q_off = query_offsets[i];
+          dest[i].qs_offsets.s_off = s_off;
+       }
+
+       /* handle the rest of the list */
+
+       if (next_cell != NULL) {
+          curr_cell = next_cell;
+          while (curr_cell != NULL) {
+             query_offsets = curr_cell->query_offsets;
+             curr_cell = curr_cell->next;    /* prefetch */
+             dest += i;
+             for (i = 0; i < COMPRESSED_HITS_PER_OVERFLOW_CELL; i++) {
+                dest[i].qs_offsets.q_off = query_offsets[i];
+                dest[i].qs_offsets.s_off = s_off;
+             }
+          }
+       }
+    }
+    return numhits;
+}
+
 /**
  * Scans the subject sequence from "offset" to the end of the sequence,
  * assuming a compressed protein alphabet
+ * Backbone cells are prefetched and read through the same queue as
+ * s_BlastAaScanSubject.
  * Copies at most array_size hits.
  * Returns the number of hits found.
  * If there isn't enough room to copy all the hits, return early, and update
@@ -261,6 +553,8 @@ static Int4 s_BlastCompressedAaScanSubject(
     Uint1 next_char;           /* prefetch variable */
     Int4 compressed_char;     /* translated letter */
     Int4 compressed_alphabet_size;
+    AaScanPendingHit pending[AA_SCAN_PREFETCH_DEPTH];
+    Int4 head = 0, tail = 0;  /* oldest and next free queue entries */
                
     ASSERT(lookup_wrap->lut_type == eCompressedAaLookupTable);
     lookup = (BlastCompressedAaLookupTable *) lookup_wrap->lut;
@@ -332,93 +626,43 @@ static Int4 s_BlastCompressedAaScanSubject(
        index = preshift + compressed_char;
        preshift = (Int4)((((Int8)( index )) * recip) >> 32);
 
-       /* if there are hits */
+       /* if there are hits, start loading the cell and queue the word */
        if (PV_TEST(pv, index, pv_array_bts)) {
-          Int4 s_off = s - subject->sequence;
-
-          CompressedLookupBackboneCell* backbone_cell = 
-                                        lookup->backbone + index;
-         
-          numhits = backbone_cell->num_used;
-         
-          /* and there is enough space in the destination array */
-          if (numhits <= (array_size - totalhits)) {
-           
-             /* copy the hits to the destination */
-           
-             Int4 i;
-             Int4 *query_offsets;
-             BlastOffsetPair *dest = offset_pairs + totalhits;
-           
-             if (numhits <= COMPRESSED_HITS_PER_BACKBONE_CELL) {
-                /* hits all live in the backbone */
-             
-                query_offsets = backbone_cell->payload.query_offsets;
-                for (i = 0; i < numhits; i++) {
-                   dest[i].qs_offsets.q_off = query_offsets[i];
-                   dest[i].qs_offsets.s_off = s_off;
-                }
-             } 
-             else { 
-                /* hits are in the backbone cell and in the overflow list */
-                CompressedOverflowCell* curr_cell = 
-                                    backbone_cell->payload.overflow_list.head;
-                /* we know the overflow list has at least one cell,
-                   so it's safe to speculatively fetch the pointer
-                   to further cells */
-                CompressedOverflowCell* next_cell = curr_cell->next;
-
-                /* the number of hits in the linked list of cells has
-                   1 added to it; the extra hit was spilled from the
-                   backbone when the list was first created */
-                Int4 first_cell_entries = (numhits -
-                                     COMPRESSED_HITS_PER_BACKBONE_CELL) %
-                                     COMPRESSED_HITS_PER_OVERFLOW_CELL + 1;
-
-                /* copy hits from backbone */
-                query_offsets = 
-                         backbone_cell->payload.overflow_list.query_offsets;
-                for(i = 0; i < COMPRESSED_HITS_PER_BACKBONE_CELL - 1; i++) {
-                   dest[i].qs_offsets.q_off = query_offsets[i];
-                   dest[i].qs_offsets.s_off = s_off;
-                }
-              
-                /* handle the overflow list */
-              
-                /* first cell can be partially filled */
-                query_offsets = curr_cell->query_offsets;
-                dest += i;
-                for (i = 0; i < first_cell_entries; i++) {
-                   dest[i].qs_offsets.q_off = query_offsets[i];
-                   dest[i].qs_offsets.s_off = s_off;
-                }
-
-                /* handle the rest of the list */
-
-                if (next_cell != NULL) {
-                   curr_cell = next_cell;
-                   while (curr_cell != NULL) {
-                      query_offsets = curr_cell->query_offsets;
-                      curr_cell = curr_cell->next;    /* prefetch */
-                      dest += i;
-                      for (i = 0; i < COMPRESSED_HITS_PER_OVERFLOW_CELL; i++) {
-                         dest[i].qs_offsets.q_off = query_offsets[i];
-                         dest[i].qs_offsets.s_off = s_off;
-                      }
-                   }
-                }
+          AaScanPendingHit *hit;
+
+          NCBI_PREFETCH(lookup->backbone + index);
+          hit = pending + (tail++ & (AA_SCAN_PREFETCH_DEPTH - 1));
+          hit->index = index;
+          hit->s_off = s - subject->sequence;
+
+          if (tail - head == AA_SCAN_PREFETCH_DEPTH) {
+             hit = pending + (head++ & (AA_SCAN_PREFETCH_DEPTH - 1));
+             numhits = s_CompressedCopyHits(lookup->backbone + hit->index,
+                                            hit->s_off,
+                                            offset_pairs + totalhits,
+                                            array_size - totalhits);
+             if (numhits < 0) {
+                 /* not enough space in the destination array */
+                 s_range[1] = hit->s_off;
+                 return totalhits;
              }
-
              totalhits += numhits;
-          } 
-          else
-              /* not enough space in the destination array */
-          {
-              s_range[1] = s - subject->sequence;
-              return totalhits;
           }
        }
     } /* end for */
+
+    for (; head != tail; head++) {
+        AaScanPendingHit *hit = pending + (head & (AA_SCAN_PREFETCH_DEPTH - 1));
+        numhits = s_CompressedCopyHits(lookup->backbone + hit->index,
+                                       hit->s_off,
+                                       offset_pairs + totalhits,
+                                       array_size - totalhits);
+        if (numhits < 0) {
+            s_range[1] = hit->s_off;
+            return totalhits;
+        }
+        totalhits += numhits;
+    }
     s_range[1] = s - subject->sequence;
     } /* end while */
 
@@ -437,7 +681,7 @@ static void s_AddToRPSBucket(RPSBucket * b, Uint4 q_off, Uint4 s_off)
     BlastOffsetPair *offset_pairs = b->offset_pairs;
     Int4 i = b->num_filled;
     if (i == b->num_alloc) {
-        b->num_alloc *= 2;
+        b->num_alloc = MAX(2 * b->num_alloc, RPS_BUCKET_INIT_ALLOC);
         offset_pairs = b->offset_pairs =
             (BlastOffsetPair *) realloc(b->offset_pairs,
                                         b->num_alloc *
@@ -570,6 +814,9 @@ void BlastChooseProteinScanSubject(LookupTableWrap *lookup_wrap)
         /* normal backbone */
         if(lut->bone_type == eBackbone)
            lut->scansub_callback = (void *)s_BlastAaScanSubject;
+        /* narrow bone */
+        else if(lut->bone_type == eNarrowbone)
+           lut->scansub_callback = (void *)s_BlastNarrowAaScanSubject;
         /* small bone*/
         else
            lut->scansub_callback = (void *)s_BlastSmallAaScanSubject;
@@ -46,6 +46,7 @@ BlastDiagnostics* Blast_DiagnosticsFree(BlastDiagnostics* diagnostics)
       sfree(diagnostics->ungapped_stat);
       sfree(diagnostics->gapped_stat);
       sfree(diagnostics->cutoffs);
+      sfree(diagnostics->arena_stat);
       if (diagnostics->mt_lock)
          diagnostics->mt_lock = MT_LOCK_Delete(diagnostics->mt_lock);
       sfree(diagnostics);
@@ -78,6 +79,10 @@ BlastDiagnostics* Blast_DiagnosticsCopy(const BlastDiagnostics* diagnostics)
     } else {
       sfree(diagnostics->cutoffs);
     }
+    if (diagnostics->arena_stat) {
+        memcpy((void*)retval->arena_stat, (void*)diagnostics->arena_stat,
+               sizeof(*retval->arena_stat));
+    }
     return retval;
 }
 
@@ -92,6 +97,8 @@ BlastDiagnostics* Blast_DiagnosticsInit()
       (BlastGappedStats*) calloc(1, sizeof(BlastGappedStats));
    diagnostics->cutoffs = 
       (BlastRawCutoffs*) calloc(1, sizeof(BlastRawCutoffs));
+   diagnostics->arena_stat = 
+      (BlastMemArenaStats*) calloc(1, sizeof(BlastMemArenaStats));
 
    return diagnostics;
 }
@@ -160,6 +167,9 @@ Blast_DiagnosticsUpdate(BlastDiagnostics* global, BlastDiagnostics* local)
       global->cutoffs->cutoff_score = local->cutoffs->cutoff_score;
    }
 
+   if (global->arena_stat && local->arena_stat)
+      BlastMemArenaStatsAdd(global->arena_stat, local->arena_stat);
+
    if (global->mt_lock) 
       MT_LOCK_Do(global->mt_lock, eMT_Unlock);
 }
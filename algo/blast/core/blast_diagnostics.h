@@ -34,6 +34,7 @@
 #define ALGO_BLAST_CORE__BLAST_DIAGNOSTICS__H
 
 #include <algo/blast/core/ncbi_std.h>
+#include <algo/blast/core/blast_memarena.h>
 #include <connect/ncbi_core.h>
 
 #ifdef __cplusplus
@@ -83,6 +84,8 @@ typedef struct BlastDiagnostics {
    BlastUngappedStats* ungapped_stat; /**< Ungapped extension counts */
    BlastGappedStats* gapped_stat; /**< Gapped extension counts */
    BlastRawCutoffs* cutoffs; /**< Various raw values for the cutoffs */
+   BlastMemArenaStats* arena_stat; /**< Allocations served by the per-thread
+                                      memory arenas */
    MT_LOCK mt_lock; /**< Mutex for updating diagnostics data in a 
                        multi-threaded search. */
 } BlastDiagnostics;
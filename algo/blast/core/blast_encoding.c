@@ -122,5 +122,71 @@ const char NCBISTDAA_TO_AMINOACID[BLASTAA_SIZE] = {
 'N','P','Q','R','S','T','V','W','X','Y','Z','U','*',
 'O', 'J'};
 
+const Uint1 NCBI2NA_TO_BLASTNA_BYTES[256][4] = {
+ {0,0,0,0}, {0,0,0,1}, {0,0,0,2}, {0,0,0,3},
+ {0,0,1,0}, {0,0,1,1}, {0,0,1,2}, {0,0,1,3},
+ {0,0,2,0}, {0,0,2,1}, {0,0,2,2}, {0,0,2,3},
+ {0,0,3,0}, {0,0,3,1}, {0,0,3,2}, {0,0,3,3},
+ {0,1,0,0}, {0,1,0,1}, {0,1,0,2}, {0,1,0,3},
+ {0,1,1,0}, {0,1,1,1}, {0,1,1,2}, {0,1,1,3},
+ {0,1,2,0}, {0,1,2,1}, {0,1,2,2}, {0,1,2,3},
+ {0,1,3,0}, {0,1,3,1}, {0,1,3,2}, {0,1,3,3},
+ {0,2,0,0}, {0,2,0,1}, {0,2,0,2}, {0,2,0,3},
+ {0,2,1,0}, {0,2,1,1}, {0,2,1,2}, {0,2,1,3},
+ {0,2,2,0}, {0,2,2,1}, {0,2,2,2}, {0,2,2,3},
+ {0,2,3,0}, {0,2,3,1}, {0,2,3,2}, {0,2,3,3},
+ {0,3,0,0}, {0,3,0,1}, {0,3,0,2}, {0,3,0,3},
+ {0,3,1,0}, {0,3,1,1}, {0,3,1,2}, {0,3,1,3},
+ {0,3,2,0}, {0,3,2,1}, {0,3,2,2}, {0,3,2,3},
+ {0,3,3,0}, {0,3,3,1}, {0,3,3,2}, {0,3,3,3},
+ {1,0,0,0}, {1,0,0,1}, {1,0,0,2}, {1,0,0,3},
+ {1,0,1,0}, {1,0,1,1}, {1,0,1,2}, {1,0,1,3},
+ {1,0,2,0}, {1,0,2,1}, {1,0,2,2}, {1,0,2,3},
+ {1,0,3,0}, {1,0,3,1}, {1,0,3,2}, {1,0,3,3},
+ {1,1,0,0}, {1,1,0,1}, {1,1,0,2}, {1,1,0,3},
+ {1,1,1,0}, {1,1,1,1}, {1,1,1,2}, {1,1,1,3},
+ {1,1,2,0}, {1,1,2,1}, {1,1,2,2}, {1,1,2,3},
+ {1,1,3,0}, {1,1,3,1}, {1,1,3,2}, {1,1,3,3},
+ {1,2,0,0}, {1,2,0,1}, {1,2,0,2}, {1,2,0,3},
+ {1,2,1,0}, {1,2,1,1}, {1,2,1,2}, {1,2,1,3},
+ {1,2,2,0}, {1,2,2,1}, {1,2,2,2}, {1,2,2,3},
+ {1,2,3,0}, {1,2,3,1}, {1,2,3,2}, {1,2,3,3},
+ {1,3,0,0}, {1,3,0,1}, {1,3,0,2}, {1,3,0,3},
+ {1,3,1,0}, {1,3,1,1}, {1,3,1,2}, {1,3,1,3},
+ {1,3,2,0}, {1,3,2,1}, {1,3,2,2}, {1,3,2,3},
+ {1,3,3,0}, {1,3,3,1}, {1,3,3,2}, {1,3,3,3},
+ {2,0,0,0}, {2,0,0,1}, {2,0,0,2}, {2,0,0,3},
+ {2,0,1,0}, {2,0,1,1}, {2,0,1,2}, {2,0,1,3},
+ {2,0,2,0}, {2,0,2,1}, {2,0,2,2}, {2,0,2,3},
+ {2,0,3,0}, {2,0,3,1}, {2,0,3,2}, {2,0,3,3},
+ {2,1,0,0}, {2,1,0,1}, {2,1,0,2}, {2,1,0,3},
+ {2,1,1,0}, {2,1,1,1}, {2,1,1,2}, {2,1,1,3},
+ {2,1,2,0}, {2,1,2,1}, {2,1,2,2}, {2,1,2,3},
+ {2,1,3,0}, {2,1,3,1}, {2,1,3,2}, {2,1,3,3},
+ {2,2,0,0}, {2,2,0,1}, {2,2,0,2}, {2,2,0,3},
+ {2,2,1,0}, {2,2,1,1}, {2,2,1,2}, {2,2,1,3},
+ {2,2,2,0}, {2,2,2,1}, {2,2,2,2}, {2,2,2,3},
+ {2,2,3,0}, {2,2,3,1}, {2,2,3,2}, {2,2,3,3},
+ {2,3,0,0}, {2,3,0,1}, {2,3,0,2}, {2,3,0,3},
+ {2,3,1,0}, {2,3,1,1}, {2,3,1,2}, {2,3,1,3},
+ {2,3,2,0}, {2,3,2,1}, {2,3,2,2}, {2,3,2,3},
+ {2,3,3,0}, {2,3,3,1}, {2,3,3,2}, {2,3,3,3},
+ {3,0,0,0}, {3,0,0,1}, {3,0,0,2}, {3,0,0,3},
+ {3,0,1,0}, {3,0,1,1}, {3,0,1,2}, {3,0,1,3},
+ {3,0,2,0}, {3,0,2,1}, {3,0,2,2}, {3,0,2,3},
+ {3,0,3,0}, {3,0,3,1}, {3,0,3,2}, {3,0,3,3},
+ {3,1,0,0}, {3,1,0,1}, {3,1,0,2}, {3,1,0,3},
+ {3,1,1,0}, {3,1,1,1}, {3,1,1,2}, {3,1,1,3},
+ {3,1,2,0}, {3,1,2,1}, {3,1,2,2}, {3,1,2,3},
+ {3,1,3,0}, {3,1,3,1}, {3,1,3,2}, {3,1,3,3},
+ {3,2,0,0}, {3,2,0,1}, {3,2,0,2}, {3,2,0,3},
+ {3,2,1,0}, {3,2,1,1}, {3,2,1,2}, {3,2,1,3},
+ {3,2,2,0}, {3,2,2,1}, {3,2,2,2}, {3,2,2,3},
+ {3,2,3,0}, {3,2,3,1}, {3,2,3,2}, {3,2,3,3},
+ {3,3,0,0}, {3,3,0,1}, {3,3,0,2}, {3,3,0,3},
+ {3,3,1,0}, {3,3,1,1}, {3,3,1,2}, {3,3,1,3},
+ {3,3,2,0}, {3,3,2,1}, {3,3,2,2}, {3,3,2,3},
+ {3,3,3,0}, {3,3,3,1}, {3,3,3,2}, {3,3,3,3}};
+
 const Uint1 kProtSentinel = NULLB;
 const Uint1 kNuclSentinel = 0xF;
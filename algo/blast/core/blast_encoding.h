@@ -70,6 +70,10 @@ NCBI_XBLAST_EXPORT extern const Uint1 NCBI4NA_TO_BLASTNA[];
 /** Translates between blastna and ncbi4na. */
 NCBI_XBLAST_EXPORT extern const Uint1 BLASTNA_TO_NCBI4NA[];
 
+/** Unpacks one byte of ncbi2na into its four bases, one base per byte
+ *  and in sequence order (so the result is also blastna) */
+NCBI_XBLAST_EXPORT extern const Uint1 NCBI2NA_TO_BLASTNA_BYTES[256][4];
+
 /** Translates between iupacna and blastna. */
 NCBI_XBLAST_EXPORT extern const Uint1 IUPACNA_TO_BLASTNA[];
 
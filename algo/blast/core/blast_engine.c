@@ -106,10 +106,20 @@ typedef struct BlastCoreAuxStruct {
                                      strand */
 } BlastCoreAuxStruct;
 
-/** Deallocates all memory in BlastCoreAuxStruct */
+/** Deallocates all memory in BlastCoreAuxStruct 
+ * @param aux_struct The structure to free [in]
+ * @param diagnostics If not NULL, the allocation counts of the per-thread
+ *                    arenas are added here [in][out]
+ */
 static BlastCoreAuxStruct* 
-s_BlastCoreAuxStructFree(BlastCoreAuxStruct* aux_struct)
+s_BlastCoreAuxStructFree(BlastCoreAuxStruct* aux_struct,
+                         BlastDiagnostics* diagnostics)
 {
+    if (diagnostics && diagnostics->arena_stat && 
+        aux_struct->init_hitlist && aux_struct->init_hitlist->arena) {
+        BlastMemArenaStatsAdd(diagnostics->arena_stat, 
+                              &aux_struct->init_hitlist->arena->stats);
+    }
     BlastExtendWordFree(aux_struct->ewp);
     BLAST_InitHitListFree(aux_struct->init_hitlist);
     sfree(aux_struct->offset_pairs);
@@ -920,6 +930,9 @@ s_BlastSetUpAuxStructures(const BlastSeqSrc* seq_src,
       (BlastOffsetPair*) malloc(offset_array_size * sizeof(BlastOffsetPair));
     
     aux_struct->init_hitlist = BLAST_InitHitListNew();
+    /* The ungapped data of initial hits live only until the next subject
+       chunk; carve them out of a per-thread arena instead of the heap */
+    aux_struct->init_hitlist->arena = BlastMemArenaNew(0);
     /* Pick which gapped alignment algorithm to use. */
     if (phi_lookup)
         aux_struct->GetGappedScore = PHIGetGappedScore;
@@ -1121,7 +1134,7 @@ BLAST_PreliminarySearchEngine(EBlastProgramType program_number,
             ext_params, gap_align, hit_params, hsp_stream, diagnostics,
             interrupt_search, progress_info);
        word_params = BlastInitialWordParametersFree(word_params);
-       s_BlastCoreAuxStructFree(aux_struct);
+       s_BlastCoreAuxStructFree(aux_struct, diagnostics);
        return status;
     }
 
@@ -1263,7 +1276,7 @@ BLAST_PreliminarySearchEngine(EBlastProgramType program_number,
     }
 
     word_params = BlastInitialWordParametersFree(word_params);
-    s_BlastCoreAuxStructFree(aux_struct);
+    s_BlastCoreAuxStructFree(aux_struct, diagnostics);
     return status;
 }
 
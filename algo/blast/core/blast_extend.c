@@ -111,6 +111,43 @@ static Int4 s_BlastDiagClear(BLAST_DiagTable * diag)
     return 0;
 }
 
+/* Description in blast_extend.h */
+Int2 BlastDiagCompactAlloc(BLAST_DiagCompact* table, Uint4 num_buckets)
+{
+    const size_t kAlign = DIAGCOMPACT_BUCKET_SIZE * sizeof(DiagCompactCell);
+    Uint1 *buffer;
+
+    ASSERT(table && num_buckets > 0 && (num_buckets & (num_buckets - 1)) == 0);
+
+    buffer = (Uint1 *) calloc((size_t)num_buckets * kAlign + kAlign, 1);
+    if (buffer == NULL)
+        return -1;
+
+    table->cells_buffer = buffer;
+    table->cells = (DiagCompactCell *)
+        (buffer + (kAlign - (size_t)buffer % kAlign) % kAlign);
+    table->num_buckets = num_buckets;
+    for (table->hash_shift = 32; num_buckets > 1; num_buckets >>= 1)
+        table->hash_shift--;
+    table->occupancy = 0;
+    table->generation = 1;
+    return 0;
+}
+
+/** Deallocate memory for the compact hash table structure.
+ * @param table The table to free [in]
+ * @return NULL
+ */
+static BLAST_DiagCompact *s_BlastDiagCompactFree(BLAST_DiagCompact * table)
+{
+    if (!table)
+        return NULL;
+
+    sfree(table->cells_buffer);
+    sfree(table);
+    return NULL;
+}
+
 /* Description in blast_extend.h */
 Int2 BlastExtendWordNew(Uint4 query_length,
                         const BlastInitialWordParameters * word_params,
@@ -137,6 +174,19 @@ Int2 BlastExtendWordNew(Uint4 query_length,
         ewp->hash_table->occupancy = 1;
         ewp->hash_table->window = word_params->options->window_size;
         ewp->hash_table->offset = word_params->options->window_size;
+    } else if (word_params->container_type == eDiagCompact) {
+        BLAST_DiagCompact *table = ewp->compact_table =
+            (BLAST_DiagCompact *) calloc(1, sizeof(BLAST_DiagCompact));
+
+        if (!table ||
+            BlastDiagCompactAlloc(table, DIAGCOMPACT_NUM_BUCKETS) != 0) {
+            sfree(table);
+            sfree(ewp);
+            *ewp_ptr = NULL;
+            return -1;
+        }
+        table->window = word_params->options->window_size;
+        table->offset = word_params->options->window_size;
     } else {                    /* container_type == eDiagArray */
 
         Boolean multiple_hits = (word_params->options->window_size > 0);
@@ -185,6 +235,18 @@ Blast_ExtendWordExit(Blast_ExtendWord * ewp, Int4 subject_length)
         } else {
             ewp->hash_table->offset += subject_length + ewp->hash_table->window;
         }
+    } else if (ewp->compact_table) {
+        BLAST_DiagCompact *table = ewp->compact_table;
+
+        /* Hits on the next subject never reach the current ones, so all
+           cells are dropped at once by moving to a new generation and
+           the offset never has to advance */
+        table->occupancy = 0;
+        if (++table->generation == 0) {
+            memset(table->cells, 0, (size_t)table->num_buckets *
+                   DIAGCOMPACT_BUCKET_SIZE * sizeof(DiagCompactCell));
+            table->generation = 1;
+        }
     }
     return 0;
 }
@@ -213,6 +275,7 @@ Blast_ExtendWord *BlastExtendWordFree(Blast_ExtendWord * ewp)
 
     s_BlastDiagTableFree(ewp->diag_table);
     s_BlastDiagHashFree(ewp->hash_table);
+    s_BlastDiagCompactFree(ewp->compact_table);
     sfree(ewp);
     return NULL;
 }
@@ -235,11 +298,24 @@ void BlastInitHitListReset(BlastInitHitList * init_hitlist)
 {
     Int4 index;
 
-    for (index = 0; index < init_hitlist->total; ++index)
-        sfree(init_hitlist->init_hsp_array[index].ungapped_data);
+    if (init_hitlist->arena) {
+        BlastMemArenaReset(init_hitlist->arena);
+    } else {
+        for (index = 0; index < init_hitlist->total; ++index)
+            sfree(init_hitlist->init_hsp_array[index].ungapped_data);
+    }
     init_hitlist->total = 0;
 }
 
+BlastUngappedData* 
+BlastInitHitListNewUngappedData(BlastInitHitList * init_hitlist)
+{
+    if (init_hitlist->arena)
+        return (BlastUngappedData *) 
+            BlastMemArenaAlloc(init_hitlist->arena, sizeof(BlastUngappedData));
+    return (BlastUngappedData *) malloc(sizeof(BlastUngappedData));
+}
+
 
 /** empty an init hitlist but do not deallocate the base structure
  * @param hi list of initial hits to clean [in][out]
@@ -248,6 +324,7 @@ static void s_BlastInitHitListClean(BlastInitHitList * hi)
 {
     BlastInitHitListReset(hi);
     sfree(hi->init_hsp_array);
+    hi->arena = BlastMemArenaFree(hi->arena);
 }
 
 void BlastInitHitListMove(BlastInitHitList * dst, 
@@ -261,6 +338,7 @@ void BlastInitHitListMove(BlastInitHitList * dst,
     memmove((void *)dst, (const void *)src, sizeof(BlastInitHitList));
     src->total = src->allocated = 0;
     src->init_hsp_array = 0;
+    src->arena = 0;
 }
 
 BlastInitHitList *BLAST_InitHitListFree(BlastInitHitList * init_hitlist)
@@ -367,7 +445,7 @@ BlastSaveInitHsp(BlastInitHitList * ungapped_hsps, Int4 q_start, Int4 s_start,
 {
     BlastUngappedData *ungapped_data = NULL;
 
-    ungapped_data = (BlastUngappedData *) malloc(sizeof(BlastUngappedData));
+    ungapped_data = BlastInitHitListNewUngappedData(ungapped_hsps);
 
     ungapped_data->q_start = q_start;
     ungapped_data->s_start = s_start;
@@ -42,6 +42,7 @@
 #include <algo/blast/core/ncbi_std.h>
 #include <algo/blast/core/blast_parameters.h>
 #include <algo/blast/core/lookup_wrap.h>
+#include <algo/blast/core/blast_memarena.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -53,6 +54,13 @@ extern "C" {
 /** Default hash chain length */
 #define DIAGHASH_CHAIN_LENGTH 256
 
+/** Number of cells in one BLAST_DiagCompact bucket; four 16-byte cells
+ * fill a 64-byte cache line */
+#define DIAGCOMPACT_BUCKET_SIZE 4
+
+/** Initial number of buckets in BLAST_DiagCompact (must be a power of 2) */
+#define DIAGCOMPACT_NUM_BUCKETS 1024
+
 /** Structure for keeping last hit information for a diagonal */
 typedef struct DiagStruct {
    Int4 last_hit   : 31; /**< Offset of the last hit */
@@ -69,6 +77,18 @@ typedef struct DiagHashCell {
    Int4  hit_len;        /**< The length of last hit */
    Uint4 next;           /**< Offset of next element in the chain */
 }  DiagHashCell;
+
+/** Cell of the open-addressed BLAST_DiagCompact table. A cell is in use
+ * only if its generation matches that of the table, so the whole table is
+ * emptied by bumping the table generation.
+ */
+typedef struct DiagCompactCell {
+   Int4 diag;            /**< This hit's diagonal */
+   Int4 level      : 31; /**< This hit's offset in the subject sequence */
+   Uint4 hit_saved : 1;  /**< Whether or not this hit has been saved */
+   Int4 hit_len;         /**< The length of last hit */
+   Uint4 generation;     /**< Table generation in which the cell was filled */
+} DiagCompactCell;
   
 /** Structure containing parameters needed for initial word extension.
  * Only one copy of this structure is needed, regardless of how many
@@ -104,13 +124,43 @@ typedef struct BLAST_DiagHash {
    Int4 offset;         /**< "offset" added to query and subject position so that "last_hit" doesn't have to be zeroed out every time. */
    Int4 window;         /**< The "window" size, within which two (or more) hits must be found in order to be extended. */
 } BLAST_DiagHash;
+
+/** Track initial word matches in an open-addressed hash table whose buckets
+ * are cache lines. A full bucket overflows into the following ones, and the
+ * table doubles when it gets crowded. Only the diagonals hit in the current
+ * subject are kept, so the table stays small regardless of the query
+ * length, and moving to the next subject costs O(1). Can be used in blastn.
+ */
+typedef struct BLAST_DiagCompact {
+   Uint4 num_buckets;   /**< Number of buckets (a power of 2) */
+   Uint4 occupancy;     /**< Number of cells in use */
+   Uint4 generation;    /**< Generation of the cells in use; never zero */
+   Uint4 hash_shift;    /**< 32 - log2(num_buckets), turns a 32-bit
+                             multiplicative hash into a bucket index */
+   DiagCompactCell *cells; /**< Cache line aligned array of
+                                num_buckets * DIAGCOMPACT_BUCKET_SIZE cells */
+   void *cells_buffer;  /**< Allocation that holds the cells array */
+   Int4 offset;         /**< "offset" added to query and subject position; stays equal to window since cells are dropped by changing the generation. */
+   Int4 window;         /**< The "window" size, within which two (or more) hits must be found in order to be extended. */
+} BLAST_DiagCompact;
    
 /** Structure for keeping initial word extension information */
 typedef struct Blast_ExtendWord {
    BLAST_DiagTable* diag_table; /**< Diagonal array and related parameters */
    BLAST_DiagHash* hash_table; /**< Hash table and related parameters */ 
+   BLAST_DiagCompact* compact_table; /**< Cache line bucketed hash table
+                                          and related parameters */
 } Blast_ExtendWord;
 
+/** Allocate the cells of a BLAST_DiagCompact table, aligned to a cache
+ * line. All cells are marked unused.
+ * @param table The table whose cells are (re)allocated [in] [out]
+ * @param num_buckets Number of buckets, a power of 2 [in]
+ * @return 0 on success, -1 if memory allocation failed
+ */
+NCBI_XBLAST_EXPORT
+Int2 BlastDiagCompactAlloc(BLAST_DiagCompact* table, Uint4 num_buckets);
+
 /** Initializes the word extension structure
  * @param query_length Length of the query sequence [in]
  * @param word_params Parameters for initial word extension [in]
@@ -161,6 +211,9 @@ typedef struct BlastInitHitList {
    BlastInitHSP* init_hsp_array; /**< Array of offset pairs, possibly with
                                       scores */
    Boolean do_not_reallocate; /**< Can the init_hsp_array be reallocated? */
+   BlastMemArena* arena; /**< If not NULL, the ungapped data of all hits are
+                            allocated here and released together when the
+                            list is reset; owned by the hit list */
 } BlastInitHitList;
 
 /** Allocate memory for the BlastInitHitList structure */
@@ -179,6 +232,15 @@ void BlastInitHitListMove(BlastInitHitList * dst,
 NCBI_XBLAST_EXPORT
 void BlastInitHitListReset(BlastInitHitList* init_hitlist);
 
+/** Allocate the ungapped data for a hit about to be saved in an initial
+ * hit list. The memory comes from the list's arena if it has one, and is
+ * released by BlastInitHitListReset either way.
+ * @param init_hitlist The list the hit will be saved in [in][out]
+ * @return The new, uninitialized structure
+ */
+NCBI_XBLAST_EXPORT
+BlastUngappedData* BlastInitHitListNewUngappedData(BlastInitHitList* init_hitlist);
+
 /** Free memory for the BlastInitList structure */
 NCBI_XBLAST_EXPORT
 BlastInitHitList* BLAST_InitHitListFree(BlastInitHitList* init_hitlist);
@@ -146,6 +146,8 @@ s_GapPurgeState(GapStateArrayStruct* state_struct)
 static SGreedyAlignMem* 
 s_BlastGreedyAlignsFree(SGreedyAlignMem* gamp)
 {
+   Int4 i;
+
    if (gamp->last_seq2_off) {
       sfree(gamp->last_seq2_off[0]);
       sfree(gamp->last_seq2_off);
@@ -159,6 +161,11 @@ s_BlastGreedyAlignsFree(SGreedyAlignMem* gamp)
    sfree(gamp->max_score);
    if (gamp->space)
       MBSpaceFree(gamp->space);
+   if (gamp->checkpoints) {
+      for (i = 0; i < gamp->checkpoints_allocated; i++)
+         sfree(gamp->checkpoints[i].rows);
+      sfree(gamp->checkpoints);
+   }
    sfree(gamp);
    return NULL;
 }
@@ -280,6 +287,8 @@ BLAST_GapAlignStructFree(BlastGapAlignStruct* gap_align)
       s_BlastGreedyAlignsFree(gap_align->greedy_align_mem);
    GapStateFree(gap_align->state_struct);
    sfree(gap_align->dp_mem);
+   BlastMemArenaFree(gap_align->arena);
+   Blast_IntervalTreeFree(gap_align->itree);
 
    sfree(gap_align);
    return NULL;
@@ -331,6 +340,7 @@ BLAST_GapAlignStructNew(const BlastScoringParameters* score_params,
 
    gap_align->fwd_prelim_tback = GapPrelimEditBlockNew();
    gap_align->rev_prelim_tback = GapPrelimEditBlockNew();
+   gap_align->arena = BlastMemArenaNew(0);
 
    return status;
 }
@@ -346,6 +356,21 @@ enum {
     SCRIPT_EXTEND_GAP_B  = 0x40  /**< continue a gap in B */
 };
 
+/** Double the size of an array allocated from the gapped alignment arena.
+ * The old copy is not released; it goes away with the next arena reset.
+ * @param arena The arena holding the array [in][out]
+ * @param array The array to grow [in]
+ * @param size Current size of the array in bytes [in]
+ * @return The new copy of the array
+ */
+static void*
+s_GapArenaGrow(BlastMemArena* arena, const void* array, size_t size)
+{
+    void* retval = BlastMemArenaAlloc(arena, 2 * size);
+    memcpy(retval, array, size);
+    return retval;
+}
+
 Int4
 ALIGN_EX(const Uint1* A, const Uint1* B, Int4 M, Int4 N, Int4* a_offset, 
 	Int4* b_offset, GapPrelimEditBlock *edit_block, 
@@ -422,8 +447,11 @@ ALIGN_EX(const Uint1* A, const Uint1* B, Int4 M, Int4 N, Int4* a_offset,
        Also make the number of edit script rows grow dynamically */
 
     edit_script_num_rows = 100;
-    edit_script = (Uint1**) malloc(sizeof(Uint1*) * edit_script_num_rows);
-    edit_start_offset = (Int4*) malloc(sizeof(Int4) * edit_script_num_rows);
+    BlastMemArenaReset(gap_align->arena);
+    edit_script = (Uint1**) BlastMemArenaAlloc(gap_align->arena,
+                                    sizeof(Uint1*) * edit_script_num_rows);
+    edit_start_offset = (Int4*) BlastMemArenaAlloc(gap_align->arena,
+                                    sizeof(Int4) * edit_script_num_rows);
 
     /* allocate storage for the first row of the traceback
        array. Because row elements correspond to gaps in A,
@@ -495,13 +523,12 @@ ALIGN_EX(const Uint1* A, const Uint1* B, Int4 M, Int4 N, Int4* a_offset,
                                         N + 3 - first_b_index);
 
         if (a_index == edit_script_num_rows) {
+            edit_script = (Uint1 **)s_GapArenaGrow(gap_align->arena, edit_script,
+                                        edit_script_num_rows * sizeof(Uint1 *));
+            edit_start_offset = (Int4 *)s_GapArenaGrow(gap_align->arena,
+                                        edit_start_offset,
+                                        edit_script_num_rows * sizeof(Int4));
             edit_script_num_rows = edit_script_num_rows * 2;
-            edit_script = (Uint1 **)realloc(edit_script, 
-                                            edit_script_num_rows *
-                                            sizeof(Uint1 *));
-            edit_start_offset = (Int4 *)realloc(edit_start_offset, 
-                                                edit_script_num_rows *
-                                                sizeof(Int4));
         }
 
         edit_script[a_index] = state_struct->state_array + 
@@ -702,8 +729,6 @@ ALIGN_EX(const Uint1* A, const Uint1* B, Int4 M, Int4 N, Int4* a_offset,
     }
     
  done:
-    sfree(edit_start_offset);
-    sfree(edit_script);
     return best_score;
 }
 
@@ -1382,8 +1407,11 @@ s_OutOfFrameAlignWithTraceback(const Uint1* A, const Uint1* B, Int4 M, Int4 N,
        Also make the number of edit script rows grow dynamically */
 
     edit_script_num_rows = 100;
-    edit_script = (Uint1**) malloc(sizeof(Uint1*) * edit_script_num_rows);
-    edit_start_offset = (Int4*) malloc(sizeof(Int4) * edit_script_num_rows);
+    BlastMemArenaReset(gap_align->arena);
+    edit_script = (Uint1**) BlastMemArenaAlloc(gap_align->arena,
+                                    sizeof(Uint1*) * edit_script_num_rows);
+    edit_start_offset = (Int4*) BlastMemArenaAlloc(gap_align->arena,
+                                    sizeof(Int4) * edit_script_num_rows);
 
     /* allocate storage for the first row of the traceback
        array. Because row elements correspond to gaps in A,
@@ -1474,13 +1502,12 @@ s_OutOfFrameAlignWithTraceback(const Uint1* A, const Uint1* B, Int4 M, Int4 N,
                                         N + 5 - first_b_index);
 
         if (a_index == edit_script_num_rows) {
+            edit_script = (Uint1 **)s_GapArenaGrow(gap_align->arena, edit_script,
+                                        edit_script_num_rows * sizeof(Uint1 *));
+            edit_start_offset = (Int4 *)s_GapArenaGrow(gap_align->arena,
+                                        edit_start_offset,
+                                        edit_script_num_rows * sizeof(Int4));
             edit_script_num_rows = edit_script_num_rows * 2;
-            edit_script = (Uint1 **)realloc(edit_script, 
-                                            edit_script_num_rows *
-                                            sizeof(Uint1 *));
-            edit_start_offset = (Int4 *)realloc(edit_start_offset, 
-                                                edit_script_num_rows *
-                                                sizeof(Int4));
         }
 
         edit_script[a_index] = state_struct->state_array + 
@@ -1895,8 +1922,6 @@ s_OutOfFrameAlignWithTraceback(const Uint1* A, const Uint1* B, Int4 M, Int4 N,
         GapPrelimEditBlockAdd(edit_block, (EGapAlignOpType)script, 1);
     }
 
-    sfree(edit_start_offset);
-    sfree(edit_script);
 
     if (!reversed)
         *b_offset -= 2;
@@ -3200,13 +3225,14 @@ Int2 BLAST_GetGappedScore (EBlastProgramType program_number,
 	 does not have a translated subject, so can't get here.) */
       ASSERT(program_number == eBlastTypeTblastn);
 
-      tree = Blast_IntervalTreeInit(0, query->length+1,
+      tree = Blast_IntervalTreeReinit(gap_align->itree, 0, query->length+1,
                                     0, 2*(subject->length + CODON_LENGTH)+1);
    }
    else {
-      tree = Blast_IntervalTreeInit(0, query->length+1,
+      tree = Blast_IntervalTreeReinit(gap_align->itree, 0, query->length+1,
                                     0, subject->length+1);
    }
+   gap_align->itree = tree;
    if (!tree)
      return BLASTERR_MEMORY;
 
@@ -3401,7 +3427,6 @@ Int2 BLAST_GetGappedScore (EBlastProgramType program_number,
       }
    }   
 
-   tree = Blast_IntervalTreeFree(tree);
    if (rpsblast_pssms) {
        gap_align->sbp->psi_matrix->pssm->data = rpsblast_pssms;
    }
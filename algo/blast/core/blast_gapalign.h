@@ -45,6 +45,7 @@
 #include <algo/blast/core/greedy_align.h>
 #include <algo/blast/core/blast_hits.h>
 #include <algo/blast/core/blast_diagnostics.h>
+#include <algo/blast/core/blast_itree.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -74,6 +75,11 @@ typedef struct BlastGapAlignStruct {
                                          gapped extension */
    BlastGapDP* dp_mem; /**< scratch structures for dynamic programming */
    Int4 dp_mem_alloc;  /**< current number of structures allocated */
+   BlastMemArena* arena; /**< scratch memory for the traceback row tables of
+                            one dynamic programming extension; reset as
+                            each extension starts */
+   BlastIntervalTree* itree; /**< tree for HSP containment tests, kept from
+                                one subject sequence to the next */
    BlastScoreBlk* sbp; /**< Pointer to the scoring information block */
    Int4 gap_x_dropoff; /**< X-dropoff parameter to use */
    Int4 query_start; /**< query start offset of current alignment */
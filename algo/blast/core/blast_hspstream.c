@@ -389,6 +389,8 @@ int BlastHSPStreamMerge(SSplitQueryBlk *squery_blk,
    
    Uint4 *query_list = NULL, *offset_list = NULL, num_contexts = 0;
    Int4 *context_list = NULL;
+   Uint4 *prev_offset_list = NULL, num_prev_contexts = 0;
+   Int4 *prev_context_list = NULL;
 
 
    if (!stream1 || !stream2) 
@@ -406,6 +408,13 @@ int BlastHSPStreamMerge(SSplitQueryBlk *squery_blk,
    SplitQueryBlk_GetQueryContextsForChunk(squery_blk, chunk_num, 
                                           &context_list, &num_contexts);
    SplitQueryBlk_GetContextOffsetsForChunk(squery_blk, chunk_num, &offset_list);
+   if (chunk_num > 0) {
+       SplitQueryBlk_GetQueryContextsForChunk(squery_blk, chunk_num - 1,
+                                              &prev_context_list,
+                                              &num_prev_contexts);
+       SplitQueryBlk_GetContextOffsetsForChunk(squery_blk, chunk_num - 1,
+                                               &prev_offset_list);
+   }
 
 #if defined(_DEBUG_VERBOSE)
    fprintf(stderr, "Chunk %d\n", chunk_num);
@@ -456,9 +465,25 @@ fprintf(stderr, "No hits to query %d\n", global_query);
 
        for (j = 0; j < contexts_per_query; j++) {
            Int4 local_context = i * contexts_per_query + j;
-           if (context_list[local_context] >= 0) {
-               split_points[context_list[local_context] % contexts_per_query] = 
+           Int4 global_context = context_list[local_context];
+           if (global_context < 0)
+               continue;
+
+           if (BLAST_ContextToFrame(stream2->program, global_context) >= 0) {
+               split_points[global_context % contexts_per_query] = 
                                 offset_list[local_context];
+           } else {
+               /* On a reverse strand the previous chunk lies to the right
+                  of this one, so the strip the two chunks share starts
+                  where the previous chunk's context starts */
+               Uint4 m;
+               for (m = 0; m < num_prev_contexts; m++) {
+                   if (prev_context_list[m] == global_context) {
+                       split_points[global_context % contexts_per_query] = 
+                                prev_offset_list[m];
+                       break;
+                   }
+               }
            }
        }
 
@@ -538,6 +563,8 @@ fprintf(stderr, "No hits to query %d\n", global_query);
    sfree(query_list);
    sfree(context_list);
    sfree(offset_list);
+   sfree(prev_context_list);
+   sfree(prev_offset_list);
 
    return kBlastHSPStream_Success;
 }
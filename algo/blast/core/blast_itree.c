@@ -181,6 +181,28 @@ Blast_IntervalTreeInit(Int4 q_start, Int4 q_end,
     return tree;
 }
 
+/* See blast_itree.h for description */
+BlastIntervalTree* 
+Blast_IntervalTreeReinit(BlastIntervalTree *tree, 
+                         Int4 q_start, Int4 q_end,
+                         Int4 s_start, Int4 s_end)
+{
+    SIntervalNode *root;
+
+    if (tree == NULL)
+        return Blast_IntervalTreeInit(q_start, q_end, s_start, s_end);
+
+    /* The root node is always the first in the pool, so only its
+       bounds need to change */
+    Blast_IntervalTreeReset(tree);
+    tree->s_min = s_start;
+    tree->s_max = s_end;
+    root = tree->nodes;
+    root->leftend = q_start;
+    root->rightend = q_end;
+    return tree;
+}
+
 /* See blast_itree.h for description */
 BlastIntervalTree* 
 Blast_IntervalTreeFree(BlastIntervalTree *tree)
@@ -99,6 +99,23 @@ BlastIntervalTree*
 Blast_IntervalTreeInit(Int4 q_start, Int4 q_end,
                        Int4 s_start, Int4 s_end);
 
+/** Prepare an interval tree for a new set of HSPs with new offset bounds,
+ *  keeping the node pool of the previous use. This allows one tree per
+ *  search thread to serve every subject sequence, instead of building and
+ *  growing a fresh tree for each. 
+ *  @param tree The tree to reuse; if NULL a new tree is allocated [in]
+ *  @param q_start Minimum query offset [in]
+ *  @param q_end Maximum query offset; for multiple concatenated 
+ *               queries, all sequences are combined [in]
+ *  @param s_start Minimum subject offset [in]
+ *  @param s_end Maximum subject offset [in]
+ *  @return The emptied tree, or NULL if a new tree could not be allocated
+ */
+BlastIntervalTree* 
+Blast_IntervalTreeReinit(BlastIntervalTree *tree, 
+                         Int4 q_start, Int4 q_end,
+                         Int4 s_start, Int4 s_end);
+
 /** Deallocate an interval tree structure
  *  @param tree The tree to deallocate [in]
  *  @return Always NULL
@@ -58,6 +58,10 @@ static char const rcsid[] =
 #include <algo/blast/composition_adjustment/matrix_frequency_data.h>
 #include <algo/blast/composition_adjustment/unified_pvalues.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 /* Define KAPPA_PRINT_DIAGNOSTICS to turn on printing of
  * diagnostic information from some routines. */
 
@@ -1993,6 +1997,503 @@ BLAST_SetupPartialFetching(EBlastProgramType program_number,
                            BlastSeqSrc* seq_src, 
                            const BlastHSPList** hsp_list,
                            Int4 num_hsplists);
+/** Number of matching sequences handed to each worker thread in one
+ * batch by Blast_RedoAlignmentCore_MT.  Matches are saved in batches,
+ * so this also bounds the work that is wasted when the search
+ * terminates early. */
+#define KAPPA_MATCHES_PER_THREAD 8
+
+
+/**
+ * The data used by one worker thread of Blast_RedoAlignmentCore_MT.
+ * Each worker owns every structure that is modified while a match is
+ * being realigned: the score matrix, which composition adjustment
+ * rewrites for every match, the gapped alignment structure, the
+ * workspace used by Newton's method and the sequence source.
+ */
+typedef struct BlastKappa_WorkerData {
+    BlastScoreBlk* sbp;        /**< the score block; for all but the
+                                    first worker this is a copy with a
+                                    private score matrix */
+    const BlastSeqSrc* seqSrc; /**< source of matching sequences; for
+                                    all but the first worker this is a
+                                    copy of the search's source */
+    BlastGapAlignStruct* gapAlign;  /**< gapped alignment structure */
+    /** data needed by the callbacks that compute gapped alignments */
+    BlastKappa_GappingParamsContext gapping_params_context;
+    Blast_RedoAlignParams * redo_align_params;  /**< parameters for
+                                                     redoing alignments */
+    Blast_CompositionWorkspace *NRrecord;  /**< fields needed for
+                                                computing an adjusted
+                                                matrix using Newton's
+                                                method */
+    Blast_ForbiddenRanges forbidden;  /**< forbidden ranges for each
+                                           database position (used in
+                                           Smith-Waterman alignments) */
+    BlastCompo_Alignment ** alignments;  /**< array of lists of
+                                              alignments for each query
+                                              to the current subject */
+} BlastKappa_WorkerData;
+
+
+/**
+ * The outcome of realigning one matching sequence.  Matches are
+ * realigned concurrently, but are saved in the order in which they
+ * were read from the HSP stream, so that the results are identical
+ * to those of a single-threaded search.
+ */
+typedef struct BlastKappa_MatchResult {
+    BlastHSPList* thisMatch;   /**< the preliminary alignments */
+    BlastHSPList** hsp_lists;  /**< the recomputed alignments of the match
+                                    with each query, or NULL */
+    double * bestEvalues;      /**< best e-value in each of hsp_lists */
+    Int4 * bestScores;         /**< best score in each of hsp_lists */
+    int status;                /**< nonzero if the realignment failed */
+} BlastKappa_MatchResult;
+
+
+/**
+ * Create a copy of a score block for use by one worker thread.  Only
+ * the score matrix that is adjusted for each match (the PSSM in a
+ * position-based search) is duplicated; all other fields are shared
+ * with the original and must not be freed through the copy.
+ *
+ * @param sbp       the score block to be copied
+ * @return the new copy, or NULL on failure
+ */
+static BlastScoreBlk*
+s_WorkerScoreBlkNew(const BlastScoreBlk* sbp)
+{
+    size_t i;
+    const SBlastScoreMatrix * orig_matrix;  /* the matrix to be copied */
+    SBlastScoreMatrix * matrix;             /* the private copy */
+    BlastScoreBlk * retval = malloc(sizeof(BlastScoreBlk));
+
+    if (retval == NULL) {
+        return NULL;
+    }
+    memcpy(retval, sbp, sizeof(BlastScoreBlk));
+    if (sbp->psi_matrix != NULL) {
+        retval->psi_matrix = malloc(sizeof(SPsiBlastScoreMatrix));
+        if (retval->psi_matrix == NULL) {
+            sfree(retval);
+            return NULL;
+        }
+        memcpy(retval->psi_matrix, sbp->psi_matrix,
+               sizeof(SPsiBlastScoreMatrix));
+        retval->psi_matrix->pssm = NULL;
+        orig_matrix = sbp->psi_matrix->pssm;
+    } else {
+        retval->matrix = NULL;
+        orig_matrix = sbp->matrix;
+    }
+    matrix = SBlastScoreMatrixNew(orig_matrix->ncols, orig_matrix->nrows);
+    if (matrix != NULL) {
+        for (i = 0;  i < orig_matrix->ncols;  i++) {
+            memcpy(matrix->data[i], orig_matrix->data[i],
+                   orig_matrix->nrows * sizeof(int));
+        }
+        if (matrix->freqs != NULL && orig_matrix->freqs != NULL) {
+            memcpy(matrix->freqs, orig_matrix->freqs,
+                   orig_matrix->ncols * sizeof(double));
+        }
+        matrix->lambda = orig_matrix->lambda;
+    }
+    if (retval->psi_matrix != NULL) {
+        retval->psi_matrix->pssm = matrix;
+    } else {
+        retval->matrix = matrix;
+    }
+    if (matrix == NULL) {
+        sfree(retval->psi_matrix);
+        sfree(retval);
+    }
+    return retval;
+}
+
+
+/**
+ * Free a score block created by s_WorkerScoreBlkNew.
+ *
+ * @param sbp       the score block to be freed
+ * @return NULL
+ */
+static BlastScoreBlk*
+s_WorkerScoreBlkFree(BlastScoreBlk* sbp)
+{
+    if (sbp != NULL) {
+        if (sbp->psi_matrix != NULL) {
+            SBlastScoreMatrixFree(sbp->psi_matrix->pssm);
+            sfree(sbp->psi_matrix);
+        } else {
+            SBlastScoreMatrixFree(sbp->matrix);
+        }
+        sfree(sbp);
+    }
+    return NULL;
+}
+
+
+/**
+ * Release the data associated with a BlastKappa_WorkerData.
+ *
+ * @param self          the worker to be released
+ * @param worker_index  the index of the worker; the first worker
+ *                      does not own its score block and sequence source
+ */
+static void
+s_WorkerDataRelease(BlastKappa_WorkerData * self, int worker_index)
+{
+    Blast_RedoAlignParamsFree(&self->redo_align_params);
+    if (self->gapAlign != NULL) {
+        self->gapAlign = BLAST_GapAlignStructFree(self->gapAlign);
+    }
+    Blast_ForbiddenRangesRelease(&self->forbidden);
+    Blast_CompositionWorkspaceFree(&self->NRrecord);
+    sfree(self->alignments);
+    if (worker_index > 0) {
+        self->sbp = s_WorkerScoreBlkFree(self->sbp);
+        self->seqSrc = BlastSeqSrcFree((BlastSeqSrc*) self->seqSrc);
+    }
+}
+
+
+/**
+ * Initialize the data needed by one worker thread of
+ * Blast_RedoAlignmentCore_MT.  The search parameters must already have
+ * been rescaled.
+ *
+ * @param self          the worker to be initialized
+ * @param worker_index  the index of the worker; the first worker uses
+ *                      the search's own score block and sequence source
+ * @param program_number the type of blast search being performed
+ * @param queryBlk      query sequence
+ * @param queryInfo     query information
+ * @param sbp           score block for this search
+ * @param seqSrc        source of the matching sequences
+ * @param scoringParams the (rescaled) scoring parameters
+ * @param extendParams  parameters used for extension
+ * @param hitParams     parameters used for saving hits
+ * @param localScalingFactor  the factor by which the search was scaled
+ * @return 0 on success, -1 on failure
+ */
+static int
+s_WorkerDataInit(BlastKappa_WorkerData * self,
+                 int worker_index,
+                 EBlastProgramType program_number,
+                 BLAST_SequenceBlk * queryBlk,
+                 BlastQueryInfo* queryInfo,
+                 BlastScoreBlk* sbp,
+                 const BlastSeqSrc* seqSrc,
+                 BlastScoringParameters* scoringParams,
+                 const BlastExtensionParameters* extendParams,
+                 const BlastHitSavingParameters* hitParams,
+                 double localScalingFactor)
+{
+    Boolean positionBased = (Boolean) (sbp->psi_matrix != NULL);
+    ECompoAdjustModes compo_adjust_mode =
+        (ECompoAdjustModes) extendParams->options->compositionBasedStats;
+    BlastKappa_GappingParamsContext * context =
+        &self->gapping_params_context;
+
+    memset(self, 0, sizeof(BlastKappa_WorkerData));
+    if (worker_index == 0) {
+        self->sbp = sbp;
+        self->seqSrc = seqSrc;
+    } else {
+        self->sbp = s_WorkerScoreBlkNew(sbp);
+        self->seqSrc = BlastSeqSrcCopy(seqSrc);
+        if (self->sbp == NULL || self->seqSrc == NULL) {
+            return -1;
+        }
+    }
+    if (BLAST_GapAlignStructNew(scoringParams, extendParams,
+                                BlastSeqSrcGetMaxSeqLen(self->seqSrc),
+                                self->sbp, &self->gapAlign) != 0) {
+        return -1;
+    }
+    context->gap_align = self->gapAlign;
+    context->scoringParams = scoringParams;
+    context->sbp = self->sbp;
+    context->localScalingFactor = localScalingFactor;
+    context->prog_number = program_number;
+    self->redo_align_params =
+        s_GetAlignParams(context, queryBlk, queryInfo, hitParams,
+                         extendParams);
+    if (self->redo_align_params == NULL) {
+        return -1;
+    }
+    if (extendParams->options->eTbackExt == eSmithWatermanTbck) {
+        if (Blast_ForbiddenRangesInitialize(&self->forbidden,
+                                            queryInfo->max_length) != 0) {
+            return -1;
+        }
+    }
+    if ((int) compo_adjust_mode > 1 && !positionBased) {
+        self->NRrecord = Blast_CompositionWorkspaceNew();
+        if (self->NRrecord == NULL ||
+            Blast_CompositionWorkspaceInit(self->NRrecord,
+                                           scoringParams->options->matrix)
+            != 0) {
+            return -1;
+        }
+    }
+    self->alignments =
+        calloc(queryInfo->num_queries, sizeof(BlastCompo_Alignment *));
+    if (self->alignments == NULL) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Release the alignments held by a BlastKappa_MatchResult, leaving the
+ * arrays in place so that the result may be reused.
+ *
+ * @param self          the result to be cleared
+ * @param numQueries    the number of queries in the search
+ */
+static void
+s_MatchResultClear(BlastKappa_MatchResult * self, int numQueries)
+{
+    int query_index;
+    for (query_index = 0;  query_index < numQueries;  query_index++) {
+        self->hsp_lists[query_index] =
+            Blast_HSPListFree(self->hsp_lists[query_index]);
+    }
+    self->thisMatch = Blast_HSPListFree(self->thisMatch);
+    self->status = 0;
+}
+
+
+/**
+ * Recompute the alignments of one matching sequence with every query,
+ * using the data structures of one worker thread.  The new alignments
+ * are left in the result; they are not yet saved.
+ *
+ * @param result             holds the match on entry and the new
+ *                           alignments on exit [in][out]
+ * @param worker             the data of the thread doing the work
+ * @param program_number     the type of blast search being performed
+ * @param queryBlk           query sequence
+ * @param queryInfo          query information
+ * @param query_info         query information needed by the composition
+ *                           adjustment library
+ * @param default_db_genetic_code  genetic code to use for translated
+ *                           subjects without another genetic code
+ * @param scoringParams      the (rescaled) scoring parameters
+ * @param hitParams          parameters used for saving hits
+ * @param localScalingFactor the factor by which the search was scaled
+ * @param compositionTestIndex  which test function is used to decide
+ *                           whether a composition-adjusted p-value is
+ *                           desired
+ * @param smithWaterman      if true, compute the alignments using the
+ *                           Smith-Waterman algorithm
+ * @param redoneMatches      the heaps of significant matches saved so
+ *                           far; only consulted by the Smith-Waterman
+ *                           algorithm
+ */
+static void
+s_RedoOneMatchInWorker(BlastKappa_MatchResult * result,
+                       BlastKappa_WorkerData * worker,
+                       EBlastProgramType program_number,
+                       BLAST_SequenceBlk * queryBlk,
+                       BlastQueryInfo* queryInfo,
+                       BlastCompo_QueryInfo * query_info,
+                       Int4 default_db_genetic_code,
+                       const BlastScoringParameters* scoringParams,
+                       const BlastHitSavingParameters* hitParams,
+                       double localScalingFactor,
+                       int compositionTestIndex,
+                       Boolean smithWaterman,
+                       BlastCompo_Heap * redoneMatches)
+{
+    int status_code = 0;
+    int query_index;
+    int numQueries = queryInfo->num_queries;
+    BlastHSPList* thisMatch = result->thisMatch;
+    BlastScoreBlk* sbp = worker->sbp;
+    BlastCompo_Alignment ** alignments = worker->alignments;
+    Boolean positionBased = (Boolean) (sbp->psi_matrix != NULL);
+    Int4 **matrix = positionBased ? sbp->psi_matrix->pssm->data
+                                  : sbp->matrix->data;
+    /* existing alignments for a match */
+    BlastCompo_Alignment * incoming_aligns = NULL;
+    /* the data for a matching database sequence */
+    BlastCompo_MatchingSequence matchingSeq = {0,};
+    Blast_KarlinBlk * kbp;
+    double pvalueForThisPair = (-1); /* p-value for this match
+                                        for composition; -1 == no adjustment*/
+    double LambdaRatio; /*lambda ratio*/
+    Uint1* genetic_code_string = GenCodeSingletonFind(default_db_genetic_code);
+
+    /* Get the sequence for this match */
+    if (BlastSeqSrcGetSupportsPartialFetching(worker->seqSrc)) {
+        BLAST_SetupPartialFetching(program_number,
+                                   (BlastSeqSrc*) worker->seqSrc,
+                                   (const BlastHSPList**)&thisMatch, 1);
+    }
+    status_code =
+        s_MatchingSequenceInitialize(&matchingSeq, program_number,
+                                     worker->seqSrc, default_db_genetic_code,
+                                     thisMatch->oid);
+    if (status_code != 0) {
+        goto match_cleanup;
+    }
+    incoming_aligns =
+        s_ResultHspToDistinctAlign(thisMatch->hsp_array, thisMatch->hspcnt,
+                                   queryInfo, localScalingFactor);
+    if (incoming_aligns == NULL) {
+        status_code = -1;
+        goto match_cleanup;
+    }
+    /* All alignments in thisMatch should be to the same query */
+    kbp = sbp->kbp_gap[thisMatch->query_index];
+    if (smithWaterman) {
+        status_code =
+            Blast_RedoOneMatchSmithWaterman(alignments,
+                                            worker->redo_align_params,
+                                            incoming_aligns,
+                                            thisMatch->hspcnt,
+                                            kbp->Lambda, kbp->logK,
+                                            &matchingSeq, query_info,
+                                            numQueries,
+                                            matrix, BLASTAA_SIZE,
+                                            worker->NRrecord,
+                                            &worker->forbidden,
+                                            redoneMatches,
+                                            &pvalueForThisPair,
+                                            compositionTestIndex,
+                                            &LambdaRatio);
+    } else {
+        status_code =
+            Blast_RedoOneMatch(alignments, worker->redo_align_params,
+                               incoming_aligns, thisMatch->hspcnt,
+                               kbp->Lambda, &matchingSeq,
+                               queryInfo->max_length, query_info,
+                               numQueries, matrix, BLASTAA_SIZE,
+                               worker->NRrecord, &pvalueForThisPair,
+                               compositionTestIndex,
+                               &LambdaRatio);
+    }
+    if (status_code != 0) {
+        goto match_cleanup;
+    }
+    for (query_index = 0;  query_index < numQueries;  query_index++) {
+        /* Loop over queries */
+        if( alignments[query_index] != NULL) { /* alignments were found */
+            /* a hitlist containing the newly-computed alignments */
+            BlastHSPList * hsp_list =
+                s_HSPListFromDistinctAlignments(&alignments[query_index],
+                                                matchingSeq.index,
+                                                queryInfo);
+            if (hsp_list == NULL) {
+                status_code = -1;
+                goto match_cleanup;
+            }
+            if (hsp_list->hspcnt > 1) {
+                s_HitlistReapContained(hsp_list->hsp_array,
+                                       &hsp_list->hspcnt);
+            }
+            status_code =
+                s_HitlistEvaluateAndPurge(&result->bestScores[query_index],
+                                          &result->bestEvalues[query_index],
+                                          hsp_list,
+                                          worker->seqSrc,
+                                          matchingSeq.length,
+                                          program_number,
+                                          queryInfo, query_index,
+                                          sbp, hitParams,
+                                          pvalueForThisPair, LambdaRatio,
+                                          matchingSeq.index);
+            if (status_code != 0) {
+                Blast_HSPListFree(hsp_list);
+                goto match_cleanup;
+            }
+            if (result->bestEvalues[query_index] <=
+                hitParams->options->expect_value) {
+                /* The best alignment may be significant; it is
+                 * prepared for saving here, rather than when it is
+                 * saved, so that the work is done concurrently. */
+                s_HSPListNormalizeScores(hsp_list,
+                                         kbp->Lambda, kbp->logK,
+                                         localScalingFactor);
+                s_ComputeNumIdentities(queryBlk, queryInfo, worker->seqSrc,
+                                       hsp_list, scoringParams->options,
+                                       genetic_code_string);
+            }
+            result->hsp_lists[query_index] = hsp_list;
+        } /* end if any alignments were found */
+    } /* end loop over queries */
+match_cleanup:
+    if (status_code != 0) {
+        for (query_index = 0;  query_index < numQueries;  query_index++) {
+            BlastCompo_AlignmentsFree(&alignments[query_index],
+                                      s_FreeEditScript);
+        }
+    }
+    s_MatchingSequenceRelease(&matchingSeq);
+    BlastCompo_AlignmentsFree(&incoming_aligns, NULL);
+    result->status = status_code;
+}
+
+
+/**
+ * Save the recomputed alignments of one matching sequence in the
+ * heaps of significant matches.  Alignments that are not saved are
+ * freed.
+ *
+ * @param result         the recomputed alignments [in][out]
+ * @param redoneMatches  a heap of significant matches for each query
+ * @param numQueries     the number of queries in the search
+ * @param hitParams      parameters used for saving hits
+ * @return 0 on success, -1 on failure
+ */
+static int
+s_SaveMatchResult(BlastKappa_MatchResult * result,
+                  BlastCompo_Heap * redoneMatches,
+                  int numQueries,
+                  const BlastHitSavingParameters* hitParams)
+{
+    int status_code = 0;
+    int query_index;
+
+    for (query_index = 0;  query_index < numQueries;  query_index++) {
+        BlastHSPList * hsp_list = result->hsp_lists[query_index];
+        double bestEvalue = result->bestEvalues[query_index];
+        Int4 bestScore = result->bestScores[query_index];
+        void * discardedAligns = NULL;
+
+        if (hsp_list == NULL) {
+            continue;
+        }
+        result->hsp_lists[query_index] = NULL;
+        if (bestEvalue <= hitParams->options->expect_value &&
+            BlastCompo_HeapWouldInsert(&redoneMatches[query_index],
+                                       bestEvalue, bestScore,
+                                       result->thisMatch->oid)) {
+            /* The best alignment is significant */
+            status_code =
+                BlastCompo_HeapInsert(&redoneMatches[query_index],
+                                      hsp_list, bestEvalue,
+                                      bestScore, result->thisMatch->oid,
+                                      &discardedAligns);
+            if (status_code == 0) {
+                hsp_list = NULL;
+            }
+            if (discardedAligns != NULL) {
+                Blast_HSPListFree(discardedAligns);
+            }
+        }
+        Blast_HSPListFree(hsp_list);
+        if (status_code != 0) {
+            break;
+        }
+    }
+    return status_code;
+}
+
 
 /**
  *  Recompute alignments for each match found by the gapped BLAST
@@ -2011,6 +2512,33 @@ Blast_RedoAlignmentCore(EBlastProgramType program_number,
                         const BlastHitSavingParameters* hitParams,
                         const PSIBlastOptions* psiOptions,
                         BlastHSPResults* results)
+{
+    return Blast_RedoAlignmentCore_MT(program_number, 1, queryBlk,
+                                      queryInfo, sbp, hsp_stream, seqSrc,
+                                      default_db_genetic_code, scoringParams,
+                                      extendParams, hitParams, psiOptions,
+                                      results);
+}
+
+
+/**
+ *  Recompute alignments for each match found by the gapped BLAST
+ *  algorithm, using several threads.
+ */
+Int2
+Blast_RedoAlignmentCore_MT(EBlastProgramType program_number,
+                           Int4 num_threads,
+                           BLAST_SequenceBlk * queryBlk,
+                           BlastQueryInfo* queryInfo,
+                           BlastScoreBlk* sbp,
+                           BlastHSPStream* hsp_stream,
+                           const BlastSeqSrc* seqSrc,
+                           Int4 default_db_genetic_code,
+                           BlastScoringParameters* scoringParams,
+                           const BlastExtensionParameters* extendParams,
+                           const BlastHitSavingParameters* hitParams,
+                           const PSIBlastOptions* psiOptions,
+                           BlastHSPResults* results)
 {
     int status_code = 0;                    /* return value code */
     /* the factor by which to scale the scoring system in order to
@@ -2020,49 +2548,41 @@ Blast_RedoAlignmentCore(EBlastProgramType program_number,
      * in the search structure in this routine, and then restored before
      * the routine exits. */
     BlastKappa_SavedParameters *savedParams = NULL;
-    /* forbidden ranges for each database position (used in
-     * Smith-Waterman alignments) */
-    Blast_ForbiddenRanges forbidden = {0,};
     /* a collection of alignments for each query sequence with
      * sequences from the database */
     BlastCompo_Heap * redoneMatches = NULL;
-    /* stores all fields needed for computing a compositionally
-     * adjusted score matrix using Newton's method */
-    Blast_CompositionWorkspace *NRrecord = NULL;
     /* loop index */
     int query_index;
     /* number of queries in the concatenated query */
     int numQueries = queryInfo->num_queries;
-    /* keeps track of gapped alignment params */
-    BlastGapAlignStruct* gapAlign = NULL;
     /* All alignments above this value will be reported, no matter how
      * many. */
     double inclusion_ethresh;
-    /* array of lists of alignments for each query to this subject */
-    BlastCompo_Alignment ** alignments = NULL;
 
     BlastCompo_QueryInfo * query_info = NULL;
-    Blast_RedoAlignParams * redo_align_params = NULL;
     Boolean positionBased = (Boolean) (sbp->psi_matrix != NULL);
     ECompoAdjustModes compo_adjust_mode =
         (ECompoAdjustModes) extendParams->options->compositionBasedStats;
     Boolean smithWaterman =
         (Boolean) (extendParams->options->eTbackExt == eSmithWatermanTbck);
-    /* alignment data for the current query-subject match */
-    BlastHSPList* thisMatch = NULL;
-    /* existing alignments for a match */
-    BlastCompo_Alignment * incoming_aligns = NULL;
     Int4      **matrix;                   /* score matrix */
-    BlastKappa_GappingParamsContext gapping_params_context;
-
-    double pvalueForThisPair = (-1); /* p-value for this match
-                                        for composition; -1 == no adjustment*/
-    double LambdaRatio; /*lambda ratio*/
     /* which test function do we use to see if a composition-adjusted
        p-value is desired; value needs to be passed in eventually*/
     int compositionTestIndex = extendParams->options->unifiedP;
-    Uint1* genetic_code_string = GenCodeSingletonFind(default_db_genetic_code);
-    Boolean perform_partial_fetch = BlastSeqSrcGetSupportsPartialFetching(seqSrc);
+    /* the data for each worker thread */
+    BlastKappa_WorkerData * workers = NULL;
+    int numWorkers = 1;      /* number of worker threads */
+    int worker_index;        /* loop index */
+    /* matches that are realigned concurrently */
+    BlastKappa_MatchResult * batch = NULL;
+    int batchCapacity = 0;   /* the maximum number of matches in batch */
+    int batchSize;           /* the number of matches in batch */
+    int match_index;         /* loop index */
+    /* have all matches that are to be realigned been read */
+    Boolean done = FALSE;
+    /* are the matches of the current batch still being saved; false
+       once the remaining matches are unlikely to be significant */
+    Boolean saving;
 
     ASSERT(program_number == eBlastTypeBlastp ||
            program_number == eBlastTypeTblastn ||
@@ -2096,6 +2616,14 @@ Blast_RedoAlignmentCore(EBlastProgramType program_number,
         !Blast_FrequencyDataIsAvailable(scoringParams->options->matrix)) {
         return -1;   /* Unsupported matrix */
     }
+#ifdef _OPENMP
+    /* The Smith-Waterman algorithm consults the heaps of saved matches
+       while it computes alignments, so it must see every match saved
+       before it; it always runs on a single thread. */
+    if (num_threads > 1 && !smithWaterman) {
+        numWorkers = num_threads;
+    }
+#endif
     /*****************/
     inclusion_ethresh = (psiOptions /* this can be NULL for CBl2Seq */
                          ? psiOptions->inclusion_ethresh 
@@ -2128,37 +2656,26 @@ Blast_RedoAlignmentCore(EBlastProgramType program_number,
     }
     s_RescaleSearch(sbp, scoringParams, queryInfo->num_queries,
                     localScalingFactor);
-    status_code =
-        BLAST_GapAlignStructNew(scoringParams, extendParams,
-                                BlastSeqSrcGetMaxSeqLen(seqSrc), sbp,
-                                &gapAlign);
-    if (status_code != 0) {
-        return (Int2) status_code;
-    }
-    gapping_params_context.gap_align = gapAlign;
-    gapping_params_context.scoringParams = scoringParams;
-    gapping_params_context.sbp = sbp;
-    gapping_params_context.localScalingFactor = localScalingFactor;
-    gapping_params_context.prog_number = program_number;
-    redo_align_params =
-        s_GetAlignParams(&gapping_params_context, queryBlk, queryInfo, 
-                         hitParams, extendParams);
-    if (redo_align_params == NULL) {
+    workers = calloc(numWorkers, sizeof(BlastKappa_WorkerData));
+    if (workers == NULL) {
         status_code = -1;
         goto function_cleanup;
     }
-    query_info = s_GetQueryInfo(queryBlk->sequence, queryInfo);
-    if (query_info == NULL) {
-        status_code = -1;
-        goto function_cleanup;
-    }
-    if(smithWaterman) {
+    for (worker_index = 0;  worker_index < numWorkers;  worker_index++) {
         status_code =
-            Blast_ForbiddenRangesInitialize(&forbidden, queryInfo->max_length);
+            s_WorkerDataInit(&workers[worker_index], worker_index,
+                             program_number, queryBlk, queryInfo, sbp,
+                             seqSrc, scoringParams, extendParams,
+                             hitParams, localScalingFactor);
         if (status_code != 0) {
             goto function_cleanup;
         }
     }
+    query_info = s_GetQueryInfo(queryBlk->sequence, queryInfo);
+    if (query_info == NULL) {
+        status_code = -1;
+        goto function_cleanup;
+    }
     redoneMatches = calloc(numQueries, sizeof(BlastCompo_Heap));
     if (redoneMatches == NULL) {
         status_code = -1;
@@ -2173,169 +2690,92 @@ Blast_RedoAlignmentCore(EBlastProgramType program_number,
             goto function_cleanup;
         }
     }
-    if( (int) compo_adjust_mode > 1 && !positionBased ) {
-        NRrecord = Blast_CompositionWorkspaceNew();
-        status_code =
-            Blast_CompositionWorkspaceInit(NRrecord,
-                                           scoringParams->options->matrix);
-        if (status_code != 0) {
-            goto function_cleanup;
-        }
-    }
-    alignments = calloc(numQueries, sizeof(BlastCompo_Alignment *));
-    if (alignments == NULL) {
+    /* A single worker realigns one match at a time, exactly as the
+       matches are read */
+    batchCapacity =
+        numWorkers > 1 ? numWorkers * KAPPA_MATCHES_PER_THREAD : 1;
+    batch = calloc(batchCapacity, sizeof(BlastKappa_MatchResult));
+    if (batch == NULL) {
         status_code = -1;
         goto function_cleanup;
     }
-    while (BlastHSPStreamRead(hsp_stream, &thisMatch) != kBlastHSPStream_Eof) {
-        /* for all matching sequences */
-        Blast_KarlinBlk * kbp;
-
-        /* the data for a matching database sequence */
-        BlastCompo_MatchingSequence matchingSeq = {0,};
-        if(thisMatch->hsp_array == NULL) {
-            continue;
-        }
-        if (BlastCompo_EarlyTermination(thisMatch->best_evalue,
-                                        redoneMatches, numQueries)) {
-            Blast_HSPListFree(thisMatch);
-            break;
-        }
-        /* Get the sequence for this match */
-        if (perform_partial_fetch) {
-            BLAST_SetupPartialFetching(program_number, (BlastSeqSrc*)seqSrc, 
-                                       (const BlastHSPList**)&thisMatch, 1);
-        }
-
-        status_code =
-            s_MatchingSequenceInitialize(&matchingSeq, program_number,
-                                         seqSrc, default_db_genetic_code,
-                                         thisMatch->oid);
-        if (status_code != 0) {
-            goto match_loop_cleanup;
-        }
-        incoming_aligns =
-            s_ResultHspToDistinctAlign(thisMatch->hsp_array, thisMatch->hspcnt,
-                                       queryInfo, localScalingFactor);
-        if (incoming_aligns == NULL) {
+    for (match_index = 0;  match_index < batchCapacity;  match_index++) {
+        BlastKappa_MatchResult * result = &batch[match_index];
+        result->hsp_lists  = calloc(numQueries, sizeof(BlastHSPList*));
+        result->bestEvalues = calloc(numQueries, sizeof(double));
+        result->bestScores  = calloc(numQueries, sizeof(Int4));
+        if (result->hsp_lists == NULL || result->bestEvalues == NULL ||
+            result->bestScores == NULL) {
             status_code = -1;
-            goto match_loop_cleanup;
+            goto function_cleanup;
         }
-        /* All alignments in thisMatch should be to the same query */
-        kbp = sbp->kbp_gap[thisMatch->query_index];
-        if (smithWaterman) {
-            status_code =
-                Blast_RedoOneMatchSmithWaterman(alignments,
-                                                redo_align_params,
-                                                incoming_aligns,
-                                                thisMatch->hspcnt,
-                                                kbp->Lambda, kbp->logK,
-                                                &matchingSeq, query_info,
-                                                numQueries,
-                                                matrix, BLASTAA_SIZE,
-                                                NRrecord, &forbidden,
-                                                redoneMatches,
-                                                &pvalueForThisPair,
-                                                compositionTestIndex,
-                                                &LambdaRatio);
-        } else {
-            status_code =
-                Blast_RedoOneMatch(alignments, redo_align_params,
-                                   incoming_aligns, thisMatch->hspcnt,
-                                   kbp->Lambda, &matchingSeq,
-                                   queryInfo->max_length, query_info,
-                                   numQueries, matrix, BLASTAA_SIZE,
-                                   NRrecord, &pvalueForThisPair,
-                                   compositionTestIndex,
-                                   &LambdaRatio);
+    }
+    while ( !done ) {
+        /* Read the next batch of matching sequences */
+        BlastHSPList* thisMatch = NULL;
+        batchSize = 0;
+        while (batchSize < batchCapacity &&
+               BlastHSPStreamRead(hsp_stream, &thisMatch)
+               != kBlastHSPStream_Eof) {
+            if(thisMatch->hsp_array == NULL) {
+                thisMatch = Blast_HSPListFree(thisMatch);
+                continue;
+            }
+            if (BlastCompo_EarlyTermination(thisMatch->best_evalue,
+                                            redoneMatches, numQueries)) {
+                /* Once the heaps are filled to the cutoff, they stay
+                 * filled, so no later match needs to be read. */
+                thisMatch = Blast_HSPListFree(thisMatch);
+                done = TRUE;
+                break;
+            }
+            batch[batchSize++].thisMatch = thisMatch;
         }
-        if (status_code != 0) {
-            goto match_loop_cleanup;
+        if (batchSize < batchCapacity) {
+            done = TRUE;
         }
-        for (query_index = 0;  query_index < numQueries;  query_index++) {
-            /* Loop over queries */
-            if( alignments[query_index] != NULL) { /* alignments were found */
-                double bestEvalue;   /* best e-value among alignments in the
-                                        hitlist */
-                Int4 bestScore;      /* best score among alignments in
-                                        the hitlist */
-                /* a hitlist containing the newly-computed alignments */
-                BlastHSPList * hsp_list = NULL;
-                void * discardedAligns = NULL;
-                hsp_list =
-                    s_HSPListFromDistinctAlignments(&alignments[query_index],
-                                                    matchingSeq.index,
-                                                    queryInfo);
-                if (hsp_list == NULL) {
-                    status_code = -1;
-                    goto match_loop_cleanup;
-                }
-                if (hsp_list->hspcnt > 1) {
-                    s_HitlistReapContained(hsp_list->hsp_array,
-                                           &hsp_list->hspcnt);
-                }
-                status_code =
-                    s_HitlistEvaluateAndPurge(&bestScore, &bestEvalue,
-                                              hsp_list,
-                                              seqSrc,
-                                              matchingSeq.length,
-                                              program_number,
-                                              queryInfo, query_index,
-                                              sbp, hitParams,
-                                              pvalueForThisPair, LambdaRatio,
-                                              matchingSeq.index);
-                if (status_code != 0) {
-                    goto query_loop_cleanup;
-                }
-                if (bestEvalue <= hitParams->options->expect_value &&
-                    BlastCompo_HeapWouldInsert(&redoneMatches[query_index],
-                                               bestEvalue, bestScore,
-                                               thisMatch->oid)) {
-                    /* The best alignment is significant */
-                    s_HSPListNormalizeScores(hsp_list,
-                                             kbp->Lambda, kbp->logK,
-                                             localScalingFactor);
-                     s_ComputeNumIdentities(queryBlk, queryInfo, seqSrc,
-                                           hsp_list, scoringParams->options,
- 						genetic_code_string);
-                    status_code =
-                        BlastCompo_HeapInsert(&redoneMatches[query_index],
-                                              hsp_list, bestEvalue,
-                                              bestScore, thisMatch->oid,
-                                              &discardedAligns);
-                    if (status_code == 0) {
-                        hsp_list = NULL;
-                    } else {
-                        goto query_loop_cleanup;
-                    }
-                    if (discardedAligns != NULL) {
-                        Blast_HSPListFree(discardedAligns);
-                    }
-                }
-query_loop_cleanup:
-                Blast_HSPListFree(hsp_list);
-                if (status_code != 0) {
-                    goto match_loop_cleanup;
+        /* Realign the matches concurrently */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(numWorkers) schedule(dynamic, 1)
+#endif
+        for (match_index = 0;  match_index < batchSize;  match_index++) {
+            BlastKappa_WorkerData * worker = &workers[0];
+#ifdef _OPENMP
+            worker = &workers[omp_get_thread_num()];
+#endif
+            s_RedoOneMatchInWorker(&batch[match_index], worker,
+                                   program_number, queryBlk, queryInfo,
+                                   query_info, default_db_genetic_code,
+                                   scoringParams, hitParams,
+                                   localScalingFactor, compositionTestIndex,
+                                   smithWaterman, redoneMatches);
+        }
+        /* Save the new alignments in the order in which the matches
+           were read */
+        saving = TRUE;
+        for (match_index = 0;  match_index < batchSize;  match_index++) {
+            BlastKappa_MatchResult * result = &batch[match_index];
+            if (status_code == 0 && saving && match_index > 0 &&
+                BlastCompo_EarlyTermination(result->thisMatch->best_evalue,
+                                            redoneMatches, numQueries)) {
+                saving = FALSE;
+                done = TRUE;
+            }
+            if (status_code == 0 && saving) {
+                status_code = result->status;
+                if (status_code == 0) {
+                    status_code = s_SaveMatchResult(result, redoneMatches,
+                                                    numQueries, hitParams);
                 }
-            } /* end if any alignments were found */
-        } /* end loop over queries */
-match_loop_cleanup:
-        if (status_code != 0) {
-            for (query_index = 0;  query_index < numQueries;  query_index++) {
-                BlastCompo_AlignmentsFree(&alignments[query_index],
-                                          s_FreeEditScript);
             }
+            s_MatchResultClear(result, numQueries);
         }
-        s_MatchingSequenceRelease(&matchingSeq);
-        thisMatch = Blast_HSPListFree(thisMatch);
-        BlastCompo_AlignmentsFree(&incoming_aligns, NULL);
         if (status_code != 0) {
             goto function_cleanup;
         }
     }
     /* end for all matching sequences */
 function_cleanup:
-    sfree(alignments);
     if (status_code == 0) {
         s_FillResultsFromCompoHeaps(results, redoneMatches,
                                     hitParams->options->hitlist_size);
@@ -2344,24 +2784,33 @@ function_cleanup:
             s_ClearHeap(&redoneMatches[0]);
         }
     }
+    if (batch != NULL) {
+        for (match_index = 0;  match_index < batchCapacity;  match_index++) {
+            if (batch[match_index].hsp_lists != NULL) {
+                s_MatchResultClear(&batch[match_index], numQueries);
+            }
+            sfree(batch[match_index].hsp_lists);
+            sfree(batch[match_index].bestEvalues);
+            sfree(batch[match_index].bestScores);
+        }
+        sfree(batch);
+    }
     free(query_info);
-    Blast_RedoAlignParamsFree(&redo_align_params);
     if (redoneMatches != NULL) {
         for (query_index = 0;  query_index < numQueries;  query_index++) {
             BlastCompo_HeapRelease(&redoneMatches[query_index]);
         }
         sfree(redoneMatches); redoneMatches = NULL;
     }
-    if (smithWaterman) {
-        Blast_ForbiddenRangesRelease(&forbidden);
-    }
-    if (gapAlign != NULL) {
-        gapAlign = BLAST_GapAlignStructFree(gapAlign);
+    if (workers != NULL) {
+        for (worker_index = 0;  worker_index < numWorkers;  worker_index++) {
+            s_WorkerDataRelease(&workers[worker_index], worker_index);
+        }
+        sfree(workers);
     }
     s_RestoreSearch(sbp, scoringParams, savedParams, queryBlk->length,
                     positionBased, compo_adjust_mode);
     s_SavedParametersFree(&savedParams);
-    Blast_CompositionWorkspaceFree(&NRrecord);
 
     return (Int2) status_code;
 }
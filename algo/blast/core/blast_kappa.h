@@ -87,6 +87,34 @@ Blast_RedoAlignmentCore(EBlastProgramType program_number,
                   const PSIBlastOptions* psiOptions,
                   BlastHSPResults* results);
 
+/** Multi-threaded version of Blast_RedoAlignmentCore.  The matches are
+ *  realigned concurrently, each thread using its own copy of the
+ *  score matrix and its own alignment workspaces, but are saved in the
+ *  order in which they are read from hsp_stream, so the results are
+ *  identical to those of Blast_RedoAlignmentCore.  Threads are only
+ *  used if the library is compiled with OpenMP support, and never for
+ *  Smith-Waterman tracebacks.
+ * @param program_number the type of blast search being performed [in]
+ * @param num_threads number of threads to use [in]
+ * @sa Blast_RedoAlignmentCore for the remaining parameters
+ * @return 0 on success, otherwise failure.
+*/
+NCBI_XBLAST_EXPORT
+Int2
+Blast_RedoAlignmentCore_MT(EBlastProgramType program_number,
+                  Int4 num_threads,
+                  BLAST_SequenceBlk * queryBlk,
+                  BlastQueryInfo* query_info,
+                  BlastScoreBlk* sbp,
+                  BlastHSPStream* hsp_stream,
+                  const BlastSeqSrc* seqSrc,
+                  Int4 db_genetic_code,
+                  BlastScoringParameters* scoringParams,
+                  const BlastExtensionParameters* extendParams,
+                  const BlastHitSavingParameters* hitParams,
+                  const PSIBlastOptions* psiOptions,
+                  BlastHSPResults* results);
+
 #ifdef __cplusplus
 
 }
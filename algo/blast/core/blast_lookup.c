@@ -35,58 +35,103 @@ static char const rcsid[] =
     "$Id: blast_lookup.c,v 1.62 2006/11/22 19:39:04 papadopo Exp $";
 #endif                          /* SKIP_DOXYGEN_PROCESSING */
 
-void BlastLookupAddWordHit(Int4 **backbone, Int4 wordsize,
-                           Int4 charsize, Uint1* seq,
-                           Int4 query_offset)
+/** Make room for more query offsets in one cell of a generic lookup table
+ *
+ * @param backbone The current list of hashtable cells [in][out]
+ * @param index The cell to update [in]
+ * @param num_new Number of offsets that will be added [in]
+ * @return The chain of the cell, with room for num_new more offsets
+ */
+static Int4 * s_LookupReserveChain(Int4 **backbone, Int4 index, 
+                                   Int4 num_new)
 {
-    Int4 index;
     Int4 *chain = NULL;
     Int4 chain_size = 0;        /* total number of elements in the chain */
     Int4 hits_in_chain = 0;     /* number of occupied elements in the chain,
                                    not including the zeroth and first
                                    positions */
 
-    /* compute the backbone cell to update */
-
-    index = ComputeTableIndex(wordsize, charsize, seq);
-
     /* if backbone cell is null, initialize a new chain */
     if (backbone[index] == NULL) {
         chain_size = 8;
+        while (num_new + 2 > chain_size)
+            chain_size *= 2;
         hits_in_chain = 0;
         chain = (Int4 *) malloc(chain_size * sizeof(Int4));
         ASSERT(chain != NULL);
         chain[0] = chain_size;
         chain[1] = hits_in_chain;
         backbone[index] = chain;
-    } else {
-        /* otherwise, use the existing chain */
-        chain = backbone[index];
-        chain_size = chain[0];
-        hits_in_chain = chain[1];
-    }
+        return chain;
+    } 
+
+    /* otherwise, use the existing chain */
+    chain = backbone[index];
+    chain_size = chain[0];
+    hits_in_chain = chain[1];
 
     /* if the chain is full, allocate more room */
-    if ((hits_in_chain + 2) == chain_size) {
-        chain_size = chain_size * 2;
+    if ((hits_in_chain + num_new + 2) > chain_size) {
+        while (hits_in_chain + num_new + 2 > chain_size)
+            chain_size = chain_size * 2;
         chain = (Int4 *) realloc(chain, chain_size * sizeof(Int4));
         ASSERT(chain != NULL);
 
         backbone[index] = chain;
         chain[0] = chain_size;
     }
+    return chain;
+}
 
-    /* add the hit */
+void BlastLookupAddWordHit(Int4 **backbone, Int4 wordsize,
+                           Int4 charsize, Uint1* seq,
+                           Int4 query_offset)
+{
+    Int4 *chain;
+
+    /* compute the backbone cell to update, and add the hit */
+
+    chain = s_LookupReserveChain(backbone, 
+                                 ComputeTableIndex(wordsize, charsize, seq), 
+                                 1);
     chain[chain[1] + 2] = query_offset;
     chain[1]++;
 }
 
-void BlastLookupIndexQueryExactMatches(Int4 **backbone,
-                                      Int4 word_length,
-                                      Int4 charsize,
-                                      Int4 lut_word_length,
-                                      BLAST_SequenceBlk * query,
-                                      BlastSeqLoc * locations)
+void BlastLookupAddWordHitsAtIndex(Int4 **backbone, Int4 index,
+                                   const Int4 *offsets, Int4 num_offsets,
+                                   Int4 query_bias)
+{
+    Int4 i;
+    Int4 *chain = s_LookupReserveChain(backbone, index, num_offsets);
+    Int4 *dest = chain + chain[1] + 2;
+
+    for (i = 0; i < num_offsets; i++)
+        dest[i] = query_bias + offsets[i];
+    chain[1] += num_offsets;
+}
+
+/** Add the query offsets of the words in a list of locations to a
+ *  generic lookup table, skipping words whose backbone cells belong to
+ *  another thread
+ *
+ * @param backbone The current list of hashtable cells [in][out]
+ * @param word_length Number of letters in a word [in]
+ * @param charsize Number of bits in one letter [in]
+ * @param lut_word_length Width of the lookup table in letters [in]
+ * @param query The query sequence [in]
+ * @param locations What locations on the query sequence to index? [in]
+ * @param thread_id Cells owned by this thread are updated [in]
+ * @param num_threads Number of threads building the table [in]
+ */
+static void s_LookupIndexQueryExactMatches(Int4 **backbone,
+                                           Int4 word_length,
+                                           Int4 charsize,
+                                           Int4 lut_word_length,
+                                           BLAST_SequenceBlk * query,
+                                           BlastSeqLoc * locations,
+                                           Int4 thread_id,
+                                           Int4 num_threads)
 {
     BlastSeqLoc *loc;
     Int4 offset;
@@ -106,33 +151,65 @@ void BlastLookupIndexQueryExactMatches(Int4 **backbone,
 
         /* Indexing proceeds from the start point to the last offset
            such that a full lookup table word can be created. word_target
-           points to the letter beyond which indexing is allowed */
+           points to the letter beyond which indexing is allowed. The
+           last word is handled at offset 'to + 1', without loading *seq */
         seq = query->sequence + from;
         word_target = seq + lut_word_length;
 
-        for (offset = from; offset <= to; offset++, seq++) {
+        for (offset = from; offset <= to + 1; offset++, seq++) {
 
             if (seq >= word_target) {
-                BlastLookupAddWordHit(backbone, 
-                                      lut_word_length, charsize,
-                                      seq - lut_word_length, 
-                                      offset - lut_word_length);
+                Int4 index = ComputeTableIndex(lut_word_length, charsize,
+                                               seq - lut_word_length);
+                if (num_threads == 1 || 
+                    LOOKUP_BUILD_OWNER(index, num_threads) == thread_id) {
+                    Int4 *chain = s_LookupReserveChain(backbone, index, 1);
+                    chain[chain[1] + 2] = offset - lut_word_length;
+                    chain[1]++;
+                }
             }
 
             /* if the current word contains an ambiguity, skip all the
                words that would contain that ambiguity */
-            if (*seq & invalid_mask)
+            if (offset <= to && (*seq & invalid_mask))
                 word_target = seq + lut_word_length + 1;
         }
+    }
+}
 
-        /* handle the last word, without loading *seq */
-        if (seq >= word_target) {
-            BlastLookupAddWordHit(backbone, 
-                                  lut_word_length, charsize,
-                                  seq - lut_word_length, 
-                                  offset - lut_word_length);
-        }
+void BlastLookupIndexQueryExactMatches(Int4 **backbone,
+                                      Int4 word_length,
+                                      Int4 charsize,
+                                      Int4 lut_word_length,
+                                      BLAST_SequenceBlk * query,
+                                      BlastSeqLoc * locations)
+{
+    s_LookupIndexQueryExactMatches(backbone, word_length, charsize,
+                                   lut_word_length, query, locations, 0, 1);
+}
 
+void BlastLookupIndexQueryExactMatches_MT(Int4 **backbone,
+                                          Int4 word_length,
+                                          Int4 charsize,
+                                          Int4 lut_word_length,
+                                          BLAST_SequenceBlk * query,
+                                          BlastSeqLoc * locations,
+                                          Int4 num_threads)
+{
+    Int4 t;
+
+#ifdef _OPENMP
+    num_threads = MAX(num_threads, 1);
+#else
+    num_threads = 1;
+#endif
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+#endif
+    for (t = 0; t < num_threads; t++) {
+        s_LookupIndexQueryExactMatches(backbone, word_length, charsize,
+                                       lut_word_length, query, locations, 
+                                       t, num_threads);
     }
 }
-
@@ -56,6 +56,19 @@ extern "C" {
       ( lookup[(index) >> (shift)] &                    \
         ((PV_ARRAY_TYPE)1 << ((index) & PV_ARRAY_MASK)) )
 
+/** While several threads build one lookup table, backbone cells are dealt
+ *  out to the threads in blocks of 2^LOOKUP_BUILD_OWNER_BITS cells; each 
+ *  thread only modifies the cells it owns, so that every cell receives its 
+ *  query offsets in the same order as a single-threaded build
+ */
+#define LOOKUP_BUILD_OWNER_BITS 6
+
+/** Thread responsible for one backbone cell during a multi-threaded
+ *  lookup table build
+ */
+#define LOOKUP_BUILD_OWNER(index, num_threads) \
+    (((index) >> LOOKUP_BUILD_OWNER_BITS) % (num_threads))
+
 /** Add a single query offset to a generic lookup table
  *
  * @param backbone The current list of hashtable cells [in][out]
@@ -85,6 +98,40 @@ void BlastLookupIndexQueryExactMatches(Int4 **backbone,
                                        BLAST_SequenceBlk * query,
                                        BlastSeqLoc * locations);
 
+/** Add a list of query offsets to one cell of a generic lookup table
+ *
+ * @param backbone The current list of hashtable cells [in][out]
+ * @param index The cell to update [in]
+ * @param offsets The query offsets to add [in]
+ * @param num_offsets Number of entries in offsets [in]
+ * @param query_bias Number added to each offset [in]
+ */
+void BlastLookupAddWordHitsAtIndex(Int4 **backbone, Int4 index,
+                                   const Int4 *offsets, Int4 num_offsets,
+                                   Int4 query_bias);
+
+/** Same as BlastLookupIndexQueryExactMatches, but the backbone is filled
+ *  by num_threads threads. Each thread scans all of the locations and
+ *  adds the words whose cells it owns (see LOOKUP_BUILD_OWNER), so the
+ *  resulting table is identical to a single-threaded build
+ *
+ * @param backbone The current list of hashtable cells [in][out]
+ * @param word_length Number of letters in a word [in]
+ * @param charsize Number of bits in one letter [in]
+ * @param lut_word_length Width of the lookup table in letters
+ *                      (must be <= word_length) [in]
+ * @param query The query sequence [in]
+ * @param locations What locations on the query sequence to index? [in]
+ * @param num_threads Number of threads to use [in]
+ */
+void BlastLookupIndexQueryExactMatches_MT(Int4 **backbone,
+                                          Int4 word_length,
+                                          Int4 charsize,
+                                          Int4 lut_word_length,
+                                          BLAST_SequenceBlk * query,
+                                          BlastSeqLoc * locations,
+                                          Int4 num_threads);
+
 /** Given a word, compute its index value from scratch.
  *
  * @param wordsize length of the word, in residues [in]
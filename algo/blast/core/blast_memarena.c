@@ -0,0 +1,170 @@
+/* $Id$
+ * ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+/** @file blast_memarena.c
+ * Resettable memory arenas for short-lived per-subject BLAST structures
+ */
+
+#ifndef SKIP_DOXYGEN_PROCESSING
+static char const rcsid[] =
+    "$Id$";
+#endif /* SKIP_DOXYGEN_PROCESSING */
+
+#include <algo/blast/core/blast_memarena.h>
+#include <algo/blast/core/blast_def.h>
+
+/** Alignment of every block handed out by an arena; large enough for
+    any of the structures the engine keeps there */
+#define MEMARENA_ALIGN 8
+
+/** Size of a chunk header, rounded so that the data following it is
+    aligned */
+#define MEMARENA_HEADER_SIZE \
+    ((sizeof(BlastMemArenaChunk) + MEMARENA_ALIGN - 1) & ~(MEMARENA_ALIGN - 1))
+
+/** Get a new chunk from the heap and make it the head of the arena.
+ * @param arena The arena to grow [in][out]
+ * @param size Minimum number of usable bytes in the chunk [in]
+ * @return The new chunk, or NULL if out of memory
+ */
+static BlastMemArenaChunk*
+s_MemArenaAddChunk(BlastMemArena* arena, size_t size)
+{
+    BlastMemArenaChunk* chunk =
+        (BlastMemArenaChunk*) malloc(MEMARENA_HEADER_SIZE + size);
+
+    if (chunk == NULL)
+        return NULL;
+
+    chunk->size = size;
+    chunk->next = arena->head;
+    arena->head = chunk;
+    arena->used = 0;
+    arena->stats.mallocs++;
+    return chunk;
+}
+
+BlastMemArena* BlastMemArenaNew(size_t chunk_size)
+{
+    BlastMemArena* arena = (BlastMemArena*) calloc(1, sizeof(BlastMemArena));
+
+    if (arena == NULL)
+        return NULL;
+
+    if (chunk_size == 0)
+        chunk_size = BLAST_MEMARENA_CHUNK_SIZE;
+
+    if (s_MemArenaAddChunk(arena, chunk_size) == NULL) {
+        sfree(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+/** Free the chunks of an arena.
+ * @param arena The arena to empty [in][out]
+ */
+static void
+s_MemArenaFreeChunks(BlastMemArena* arena)
+{
+    BlastMemArenaChunk* chunk = arena->head;
+
+    while (chunk) {
+        BlastMemArenaChunk* next = chunk->next;
+        sfree(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->used = 0;
+}
+
+BlastMemArena* BlastMemArenaFree(BlastMemArena* arena)
+{
+    if (arena == NULL)
+        return NULL;
+
+    s_MemArenaFreeChunks(arena);
+    sfree(arena);
+    return NULL;
+}
+
+void* BlastMemArenaAlloc(BlastMemArena* arena, size_t size)
+{
+    BlastMemArenaChunk* chunk = arena->head;
+    void* retval;
+
+    size = (size + MEMARENA_ALIGN - 1) & ~(size_t)(MEMARENA_ALIGN - 1);
+
+    if (chunk == NULL || arena->used + size > chunk->size) {
+        size_t new_size = chunk ? 2 * chunk->size : BLAST_MEMARENA_CHUNK_SIZE;
+        chunk = s_MemArenaAddChunk(arena, MAX(new_size, size));
+        if (chunk == NULL)
+            return NULL;
+    }
+
+    retval = (Uint1*)chunk + MEMARENA_HEADER_SIZE + arena->used;
+    arena->used += size;
+    arena->total += size;
+    arena->stats.allocs++;
+    return retval;
+}
+
+void BlastMemArenaReset(BlastMemArena* arena)
+{
+    if (arena == NULL)
+        return;
+
+    arena->stats.resets++;
+    if ((Int8)arena->total > arena->stats.max_bytes)
+        arena->stats.max_bytes = (Int8)arena->total;
+
+    if (arena->head && arena->head->next) {
+        /* The arena overflowed its first chunk since the last reset;
+           consolidate so the next round fits in one chunk */
+        size_t size = 0;
+        BlastMemArenaChunk* chunk;
+        for (chunk = arena->head; chunk; chunk = chunk->next)
+            size += chunk->size;
+        s_MemArenaFreeChunks(arena);
+        s_MemArenaAddChunk(arena, size);
+    }
+
+    arena->used = 0;
+    arena->total = 0;
+}
+
+void BlastMemArenaStatsAdd(BlastMemArenaStats* total,
+                           const BlastMemArenaStats* stats)
+{
+    if (total == NULL || stats == NULL)
+        return;
+
+    total->allocs += stats->allocs;
+    total->mallocs += stats->mallocs;
+    total->resets += stats->resets;
+    total->max_bytes = MAX(total->max_bytes, stats->max_bytes);
+}
@@ -0,0 +1,123 @@
+/* $Id$
+ * ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+/** @file blast_memarena.h
+ * Resettable memory arenas for short-lived per-subject BLAST structures.
+ *
+ * An arena hands out memory from large chunks and releases all of it at
+ * once when it is reset, so that structures living only as long as one
+ * subject sequence (or one gapped extension) do not each cost a malloc
+ * and a free. An arena is never shared between threads; every search
+ * thread owns its own. Memory obtained from an arena must never be passed
+ * to free(), and nothing allocated from it may outlive the next reset:
+ * anything that has to survive, e.g. HSPs written to a BlastHSPStream,
+ * must be allocated from the heap.
+ */
+
+#ifndef ALGO_BLAST_CORE__BLAST_MEMARENA__H
+#define ALGO_BLAST_CORE__BLAST_MEMARENA__H
+
+#include <algo/blast/core/ncbi_std.h>
+#include <algo/blast/core/blast_export.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Default size in bytes of the first chunk of an arena */
+#ifndef BLAST_MEMARENA_CHUNK_SIZE
+#define BLAST_MEMARENA_CHUNK_SIZE 16384
+#endif
+
+/** Allocation counts of one or more memory arenas */
+typedef struct BlastMemArenaStats {
+   Int8 allocs; /**< Number of requests served by an arena */
+   Int8 mallocs; /**< Number of chunks the arena obtained from the heap;
+                    allocs - mallocs heap allocations were avoided */
+   Int8 resets; /**< Number of times the arena was reset */
+   Int8 max_bytes; /**< Largest number of bytes in use between two resets */
+} BlastMemArenaStats;
+
+/** One contiguous block of arena memory */
+typedef struct BlastMemArenaChunk {
+   struct BlastMemArenaChunk* next; /**< Previously filled chunk */
+   size_t size; /**< Usable bytes following this header */
+} BlastMemArenaChunk;
+
+/** A per-thread, resettable bump allocator */
+typedef struct BlastMemArena {
+   BlastMemArenaChunk* head; /**< Chunk currently being carved up; earlier
+                                 chunks are chained through next */
+   size_t used; /**< Bytes of the head chunk handed out */
+   size_t total; /**< Bytes handed out since the last reset, all chunks */
+   BlastMemArenaStats stats; /**< Allocation counters */
+} BlastMemArena;
+
+/** Create a new arena.
+ * @param chunk_size Size of the first chunk in bytes; 0 selects
+ *                   BLAST_MEMARENA_CHUNK_SIZE [in]
+ * @return The new arena, or NULL if out of memory
+ */
+NCBI_XBLAST_EXPORT
+BlastMemArena* BlastMemArenaNew(size_t chunk_size);
+
+/** Free an arena and all memory allocated from it.
+ * @param arena The arena to free [in]
+ * @return NULL
+ */
+NCBI_XBLAST_EXPORT
+BlastMemArena* BlastMemArenaFree(BlastMemArena* arena);
+
+/** Allocate uninitialized, suitably aligned memory from an arena.
+ * @param arena The arena to allocate from [in][out]
+ * @param size Number of bytes requested [in]
+ * @return Pointer to the memory, or NULL if out of memory
+ */
+NCBI_XBLAST_EXPORT
+void* BlastMemArenaAlloc(BlastMemArena* arena, size_t size);
+
+/** Release everything allocated from an arena since the previous reset.
+ * If the arena had to grow beyond one chunk, its chunks are replaced by a
+ * single chunk big enough for all of them, so that in steady state an
+ * arena never touches the heap.
+ * @param arena The arena to reset [in][out]
+ */
+NCBI_XBLAST_EXPORT
+void BlastMemArenaReset(BlastMemArena* arena);
+
+/** Add one set of arena counters to a running total.
+ * @param total The totals to update [in][out]
+ * @param stats The counters to add; may be NULL [in]
+ */
+NCBI_XBLAST_EXPORT
+void BlastMemArenaStatsAdd(BlastMemArenaStats* total,
+                           const BlastMemArenaStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* !ALGO_BLAST_CORE__BLAST_MEMARENA__H */
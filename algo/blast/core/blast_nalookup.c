@@ -380,7 +380,8 @@ Int4 BlastSmallNaLookupTableNew(BLAST_SequenceBlk* query,
                            BlastSmallNaLookupTable * *lut,
                            const LookupTableOptions * opt, 
                            const QuerySetUpOptions* query_options,
-                           Int4 lut_width)
+                           Int4 lut_width,
+                           Int4 num_threads)
 {
     Int4 status = 0;
     Int4 **thin_backbone;
@@ -399,11 +400,11 @@ Int4 BlastSmallNaLookupTableNew(BLAST_SequenceBlk* query,
     thin_backbone = (Int4 **) calloc(lookup->backbone_size, sizeof(Int4 *));
     ASSERT(thin_backbone != NULL);
 
-    BlastLookupIndexQueryExactMatches(thin_backbone,
+    BlastLookupIndexQueryExactMatches_MT(thin_backbone,
                                       lookup->word_length,
                                       BITS_PER_NUC,
                                       lookup->lut_word_length,
-                                      query, locations);
+                                      query, locations, num_threads);
     if (locations && 
         lookup->word_length > lookup->lut_word_length && 
         s_HasMaskAtHashEnabled(query_options)) {
@@ -550,7 +551,8 @@ Int4 BlastNaLookupTableNew(BLAST_SequenceBlk* query,
                            BlastNaLookupTable * *lut,
                            const LookupTableOptions * opt, 
                            const QuerySetUpOptions* query_options,
-                           Int4 lut_width)
+                           Int4 lut_width,
+                           Int4 num_threads)
 {
     Int4 **thin_backbone;
     BlastNaLookupTable *lookup = *lut =
@@ -568,11 +570,11 @@ Int4 BlastNaLookupTableNew(BLAST_SequenceBlk* query,
     thin_backbone = (Int4 **) calloc(lookup->backbone_size, sizeof(Int4 *));
     ASSERT(thin_backbone != NULL);
 
-    BlastLookupIndexQueryExactMatches(thin_backbone,
+    BlastLookupIndexQueryExactMatches_MT(thin_backbone,
                                       lookup->word_length,
                                       BITS_PER_NUC,
                                       lookup->lut_word_length,
-                                      query, locations);
+                                      query, locations, num_threads);
     if (locations && 
         lookup->word_length > lookup->lut_word_length && 
         s_HasMaskAtHashEnabled(query_options)) {
@@ -642,85 +644,54 @@ s_GetDiscTemplateType(Int4 weight, Uint1 length,
    return eDiscTemplateContiguous; /* All unsupported cases default to 0 */
 }
 
-/** Fills in the hashtable and next_pos fields of BlastMBLookupTable*
- * for the discontiguous case.
+/** The calculation of the longest chain can be cpu intensive for 
+ *  long queries or sets of queries. So we use a helper array to 
+ *  keep track of this, but compress it by this much so it stays in
+ *  cache. Hence we only end up with a conservative (high) estimate for 
+ *  longest_chain, but this does not seem to affect the overall 
+ *  performance of the rest of the program.
+ */
+#define MB_HELPER_COMPRESSION_BITS 11
+
+/** Number of consecutive megablast hashtable cells that one thread fills
+ *  while several threads build the table. Cells sharing a PV array word
+ *  or a helper array entry always belong to the same thread.
+ * @param mb_lt the megablast lookup table [in]
+ * @return log2 of the number of cells
+ */
+static Int4 s_MBOwnerShift(const BlastMBLookupTable* mb_lt)
+{
+   return MAX(MB_HELPER_COMPRESSION_BITS, mb_lt->pv_array_bts);
+}
+
+/** Add the words of the query to a discontiguous megablast lookup table,
+ *  skipping words whose hashtable cells belong to another thread.
  *
  * @param query the query sequence [in]
  * @param location locations on the query to be indexed in table [in]
- * @param mb_lt the (already allocated) megablast lookup 
- *              table structure [in|out]
- * @param lookup_options specifies the word_size and template options [in]
- * @return zero on success, negative number on failure. 
+ * @param mb_lt the megablast lookup table [in|out]
+ * @param helper_array estimates of the chain lengths for the first
+ *                     template [in|out]
+ * @param helper_array2 estimates of the chain lengths for the second
+ *                     template, if any [in|out]
+ * @param thread_id cells owned by this thread are filled [in]
+ * @param num_threads number of threads filling the table [in]
  */
-
-static Int2 
-s_FillDiscMBTable(BLAST_SequenceBlk* query, BlastSeqLoc* location,
-        BlastMBLookupTable* mb_lt,
-        const LookupTableOptions* lookup_options)
-
+static void
+s_IndexDiscMBWords(BLAST_SequenceBlk* query, BlastSeqLoc* location,
+        BlastMBLookupTable* mb_lt, Uint4* helper_array, 
+        Uint4* helper_array2, Int4 thread_id, Int4 num_threads)
 {
    BlastSeqLoc* loc;
-   EDiscTemplateType template_type;
-   EDiscTemplateType second_template_type = eDiscTemplateContiguous;
-   const Boolean kTwoTemplates = 
-      (lookup_options->mb_template_type == eMBWordTwoTemplates);
-   PV_ARRAY_TYPE *pv_array=NULL;
-   Int4 pv_array_bts;
+   const EDiscTemplateType template_type = mb_lt->template_type;
+   const EDiscTemplateType second_template_type = 
+                                            mb_lt->second_template_type;
+   const Boolean kTwoTemplates = mb_lt->two_templates;
+   const Int4 template_length = mb_lt->template_length;
+   const Int4 kOwnerShift = s_MBOwnerShift(mb_lt);
+   PV_ARRAY_TYPE *pv_array = mb_lt->pv_array;
+   Int4 pv_array_bts = mb_lt->pv_array_bts;
    Int4 index;
-   Int4 template_length;
-   /* The calculation of the longest chain can be cpu intensive for 
-      long queries or sets of queries. So we use a helper_array to 
-      keep track of this, but compress it by kCompressionFactor so 
-      it stays in cache.  Hence we only end up with a conservative 
-      (high) estimate for longest_chain, but this does not seem to 
-      affect the overall performance of the rest of the program. */
-   Uint4 longest_chain;
-   Uint4* helper_array = NULL;     /* Helps to estimate longest chain. */
-   Uint4* helper_array2 = NULL;    /* Helps to estimate longest chain. */
-   const Int4 kCompressionFactor=2048; /* compress helper_array by this much */
-
-   ASSERT(mb_lt);
-   ASSERT(lookup_options->mb_template_length > 0);
-
-   mb_lt->next_pos = (Int4 *)calloc(query->length + 1, sizeof(Int4));
-   helper_array = (Uint4*) calloc(mb_lt->hashsize/kCompressionFactor, 
-                                  sizeof(Uint4));
-   if (mb_lt->next_pos == NULL || helper_array == NULL)
-      return -1;
-
-   template_type = s_GetDiscTemplateType(lookup_options->word_size,
-                      lookup_options->mb_template_length, 
-                      (EDiscWordType)lookup_options->mb_template_type);
-
-   ASSERT(template_type != eDiscTemplateContiguous);
-
-   mb_lt->template_type = template_type;
-   mb_lt->two_templates = kTwoTemplates;
-   /* For now leave only one possibility for the second template.
-      Note that the intention here is to select both the coding
-      and the optimal templates for one combination of word size
-      and template length. */
-   if (kTwoTemplates) {
-      /* Use the temporaray to avoid annoying ICC warning. */
-      int temp_int = template_type + 1;
-      second_template_type = 
-           mb_lt->second_template_type = (EDiscTemplateType) temp_int;
-
-      mb_lt->hashtable2 = (Int4*)calloc(mb_lt->hashsize, sizeof(Int4));
-      mb_lt->next_pos2 = (Int4*)calloc(query->length + 1, sizeof(Int4));
-      helper_array2 = (Uint4*) calloc(mb_lt->hashsize/kCompressionFactor, 
-                                      sizeof(Uint4));
-      if (mb_lt->hashtable2 == NULL ||
-          mb_lt->next_pos2 == NULL ||
-          helper_array2 == NULL)
-         return -1;
-   }
-
-   mb_lt->discontiguous = TRUE;
-   mb_lt->template_length = lookup_options->mb_template_length;
-   template_length = lookup_options->mb_template_length;
-   pv_array = mb_lt->pv_array;
-   pv_array_bts = mb_lt->pv_array_bts;
 
    for (loc = location; loc; loc = loc->next) {
       Int4 from;
@@ -765,17 +736,20 @@ s_FillDiscMBTable(BLAST_SequenceBlk* query, BlastSeqLoc* location,
             and add 'index' at that position */
 
          ecode1 = ComputeDiscontiguousIndex(accum, template_type);
-         if (mb_lt->hashtable[ecode1] == 0) {
+         if (num_threads == 1 ||
+             ((ecode1 >> kOwnerShift) % num_threads) == thread_id) {
+            if (mb_lt->hashtable[ecode1] == 0) {
 #ifdef LOOKUP_VERBOSE
-            mb_lt->num_unique_pos_added++;
+               mb_lt->num_unique_pos_added++;
 #endif
-            PV_SET(pv_array, ecode1, pv_array_bts);
-         }
-         else {
-            helper_array[ecode1/kCompressionFactor]++; 
+               PV_SET(pv_array, ecode1, pv_array_bts);
+            }
+            else {
+               helper_array[ecode1 >> MB_HELPER_COMPRESSION_BITS]++; 
+            }
+            mb_lt->next_pos[index] = mb_lt->hashtable[ecode1];
+            mb_lt->hashtable[ecode1] = index;
          }
-         mb_lt->next_pos[index] = mb_lt->hashtable[ecode1];
-         mb_lt->hashtable[ecode1] = index;
 
          if (!kTwoTemplates)
             continue;
@@ -783,6 +757,10 @@ s_FillDiscMBTable(BLAST_SequenceBlk* query, BlastSeqLoc* location,
          /* repeat for the second template, if applicable */
          
          ecode2 = ComputeDiscontiguousIndex(accum, second_template_type);
+         if (num_threads > 1 &&
+             ((ecode2 >> kOwnerShift) % num_threads) != thread_id)
+            continue;
+
          if (mb_lt->hashtable2[ecode2] == 0) {
 #ifdef LOOKUP_VERBOSE
             mb_lt->num_unique_pos_added++;
@@ -790,22 +768,97 @@ s_FillDiscMBTable(BLAST_SequenceBlk* query, BlastSeqLoc* location,
             PV_SET(pv_array, ecode2, pv_array_bts);
          }
          else {
-            helper_array2[ecode2/kCompressionFactor]++; 
+            helper_array2[ecode2 >> MB_HELPER_COMPRESSION_BITS]++; 
          }
          mb_lt->next_pos2[index] = mb_lt->hashtable2[ecode2];
          mb_lt->hashtable2[ecode2] = index;
       }
    }
+}
+
+/** Fills in the hashtable and next_pos fields of BlastMBLookupTable*
+ * for the discontiguous case.
+ *
+ * @param query the query sequence [in]
+ * @param location locations on the query to be indexed in table [in]
+ * @param mb_lt the (already allocated) megablast lookup 
+ *              table structure [in|out]
+ * @param lookup_options specifies the word_size and template options [in]
+ * @param num_threads number of threads to use [in]
+ * @return zero on success, negative number on failure. 
+ */
+
+static Int2 
+s_FillDiscMBTable(BLAST_SequenceBlk* query, BlastSeqLoc* location,
+        BlastMBLookupTable* mb_lt,
+        const LookupTableOptions* lookup_options,
+        Int4 num_threads)
+
+{
+   EDiscTemplateType template_type;
+   const Boolean kTwoTemplates = 
+      (lookup_options->mb_template_type == eMBWordTwoTemplates);
+   const Int4 kHelperSize = mb_lt->hashsize >> MB_HELPER_COMPRESSION_BITS;
+   Int4 index;
+   Int4 t;
+   Uint4 longest_chain;
+   Uint4* helper_array = NULL;     /* Helps to estimate longest chain. */
+   Uint4* helper_array2 = NULL;    /* Helps to estimate longest chain. */
+
+   ASSERT(mb_lt);
+   ASSERT(lookup_options->mb_template_length > 0);
+
+   mb_lt->next_pos = (Int4 *)calloc(query->length + 1, sizeof(Int4));
+   helper_array = (Uint4*) calloc(kHelperSize, sizeof(Uint4));
+   if (mb_lt->next_pos == NULL || helper_array == NULL)
+      return -1;
+
+   template_type = s_GetDiscTemplateType(lookup_options->word_size,
+                      lookup_options->mb_template_length, 
+                      (EDiscWordType)lookup_options->mb_template_type);
+
+   ASSERT(template_type != eDiscTemplateContiguous);
+
+   mb_lt->template_type = template_type;
+   mb_lt->two_templates = kTwoTemplates;
+   /* For now leave only one possibility for the second template.
+      Note that the intention here is to select both the coding
+      and the optimal templates for one combination of word size
+      and template length. */
+   if (kTwoTemplates) {
+      /* Use the temporaray to avoid annoying ICC warning. */
+      int temp_int = template_type + 1;
+      mb_lt->second_template_type = (EDiscTemplateType) temp_int;
+
+      mb_lt->hashtable2 = (Int4*)calloc(mb_lt->hashsize, sizeof(Int4));
+      mb_lt->next_pos2 = (Int4*)calloc(query->length + 1, sizeof(Int4));
+      helper_array2 = (Uint4*) calloc(kHelperSize, sizeof(Uint4));
+      if (mb_lt->hashtable2 == NULL ||
+          mb_lt->next_pos2 == NULL ||
+          helper_array2 == NULL)
+         return -1;
+   }
+
+   mb_lt->discontiguous = TRUE;
+   mb_lt->template_length = lookup_options->mb_template_length;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+#endif
+   for (t = 0; t < num_threads; t++) {
+      s_IndexDiscMBWords(query, location, mb_lt, helper_array, 
+                         helper_array2, t, num_threads);
+   }
 
    longest_chain = 2;
-   for (index = 0; index < mb_lt->hashsize / kCompressionFactor; index++)
+   for (index = 0; index < kHelperSize; index++)
        longest_chain = MAX(longest_chain, helper_array[index]);
    mb_lt->longest_chain = longest_chain;
    sfree(helper_array);
 
    if (kTwoTemplates) {
       longest_chain = 2;
-      for (index = 0; index < mb_lt->hashsize / kCompressionFactor; index++)
+      for (index = 0; index < kHelperSize; index++)
          longest_chain = MAX(longest_chain, helper_array2[index]);
       mb_lt->longest_chain += longest_chain;
       sfree(helper_array2);
@@ -813,56 +866,33 @@ s_FillDiscMBTable(BLAST_SequenceBlk* query, BlastSeqLoc* location,
    return 0;
 }
 
-/** Fills in the hashtable and next_pos fields of BlastMBLookupTable*
- * for the contiguous case.
+/** Add the words of the query to a contiguous megablast lookup table,
+ *  skipping words whose hashtable cells belong to another thread.
  *
  * @param query the query sequence [in]
  * @param location locations on the query to be indexed in table [in]
- * @param mb_lt the (already allocated) megablast lookup table structure [in|out]
- * @return zero on success, negative number on failure. 
+ * @param mb_lt the megablast lookup table [in|out]
+ * @param helper_array estimates of the chain lengths [in|out]
+ * @param thread_id cells owned by this thread are filled [in]
+ * @param num_threads number of threads filling the table [in]
  */
-
-static Int2 
-s_FillContigMBTable(BLAST_SequenceBlk* query, 
-        BlastSeqLoc* location,
-        BlastMBLookupTable* mb_lt) 
-
+static void
+s_IndexContigMBWords(BLAST_SequenceBlk* query, BlastSeqLoc* location,
+        BlastMBLookupTable* mb_lt, Uint4* helper_array,
+        Int4 thread_id, Int4 num_threads)
 {
    BlastSeqLoc* loc;
    /* 12-mers (or perhaps 8-mers) are used to build the lookup table 
       and this is what kLutWordLength specifies. */
    const Int4 kLutWordLength = mb_lt->lut_word_length;
    const Int4 kLutMask = mb_lt->hashsize - 1;
+   const Int4 kOwnerShift = s_MBOwnerShift(mb_lt);
    /* The user probably specified a much larger word size (like 28) 
       and this is what full_word_size is. */
    Int4 full_word_size = mb_lt->word_length;
    Int4 index;
-   PV_ARRAY_TYPE *pv_array;
-   Int4 pv_array_bts;
-   /* The calculation of the longest chain can be cpu intensive for 
-      long queries or sets of queries. So we use a helper_array to 
-      keep track of this, but compress it by kCompressionFactor so 
-      it stays in cache.  Hence we only end up with a conservative 
-      (high) estimate for longest_chain, but this does not seem to 
-      affect the overall performance of the rest of the program. */
-   const Int4 kCompressionFactor=2048; /* compress helper_array by this much */
-   Uint4 longest_chain;
-   Uint4* helper_array;
-
-
-   ASSERT(mb_lt);
-
-   mb_lt->next_pos = (Int4 *)calloc(query->length + 1, sizeof(Int4));
-   if (mb_lt->next_pos == NULL)
-      return -1;
-
-   pv_array = mb_lt->pv_array;
-   pv_array_bts = mb_lt->pv_array_bts;
-
-   helper_array = (Uint4*) calloc(mb_lt->hashsize/kCompressionFactor, 
-                                  sizeof(Uint4));
-   if (helper_array == NULL)
-	return -1;
+   PV_ARRAY_TYPE *pv_array = mb_lt->pv_array;
+   Int4 pv_array_bts = mb_lt->pv_array_bts;
 
    for (loc = location; loc; loc = loc->next) {
       /* We want index to be always pointing to the start of the word.
@@ -903,6 +933,9 @@ s_FillContigMBTable(BLAST_SequenceBlk* query,
          ecode = ((ecode << BITS_PER_NUC) & kLutMask) + val;
          if (seq < pos) 
             continue;
+         if (num_threads > 1 && 
+             ((ecode >> kOwnerShift) % num_threads) != thread_id)
+            continue;
 
 #ifdef LOOKUP_VERBOSE
          mb_lt->num_words_added++;
@@ -914,15 +947,57 @@ s_FillContigMBTable(BLAST_SequenceBlk* query,
             PV_SET(pv_array, ecode, pv_array_bts);
          }
          else {
-            helper_array[ecode/kCompressionFactor]++; 
+            helper_array[ecode >> MB_HELPER_COMPRESSION_BITS]++; 
          }
          mb_lt->next_pos[index] = mb_lt->hashtable[ecode];
          mb_lt->hashtable[ecode] = index;
       }
    }
+}
+
+/** Fills in the hashtable and next_pos fields of BlastMBLookupTable*
+ * for the contiguous case.
+ *
+ * @param query the query sequence [in]
+ * @param location locations on the query to be indexed in table [in]
+ * @param mb_lt the (already allocated) megablast lookup table structure [in|out]
+ * @param num_threads number of threads to use [in]
+ * @return zero on success, negative number on failure. 
+ */
+
+static Int2 
+s_FillContigMBTable(BLAST_SequenceBlk* query, 
+        BlastSeqLoc* location,
+        BlastMBLookupTable* mb_lt,
+        Int4 num_threads) 
+
+{
+   const Int4 kHelperSize = mb_lt->hashsize >> MB_HELPER_COMPRESSION_BITS;
+   Int4 index;
+   Int4 t;
+   Uint4 longest_chain;
+   Uint4* helper_array;
+
+   ASSERT(mb_lt);
+
+   mb_lt->next_pos = (Int4 *)calloc(query->length + 1, sizeof(Int4));
+   if (mb_lt->next_pos == NULL)
+      return -1;
+
+   helper_array = (Uint4*) calloc(kHelperSize, sizeof(Uint4));
+   if (helper_array == NULL)
+	return -1;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+#endif
+   for (t = 0; t < num_threads; t++) {
+      s_IndexContigMBWords(query, location, mb_lt, helper_array, 
+                           t, num_threads);
+   }
 
    longest_chain = 2;
-   for (index = 0; index < mb_lt->hashsize / kCompressionFactor; index++)
+   for (index = 0; index < kHelperSize; index++)
        longest_chain = MAX(longest_chain, helper_array[index]);
 
    mb_lt->longest_chain = longest_chain;
@@ -937,7 +1012,8 @@ Int2 BlastMBLookupTableNew(BLAST_SequenceBlk* query, BlastSeqLoc* location,
         const LookupTableOptions* lookup_options,
         const QuerySetUpOptions* query_options,
         Int4 approx_table_entries,
-        Int4 lut_width)
+        Int4 lut_width,
+        Int4 num_threads)
 {
    Int4 pv_size;
    Int2 status = 0;
@@ -959,6 +1035,12 @@ Int2 BlastMBLookupTableNew(BLAST_SequenceBlk* query, BlastSeqLoc* location,
    }
     
    ASSERT(lut_width >= 9);
+#if !defined(_OPENMP) || defined(LOOKUP_VERBOSE)
+   /* the statistics kept in verbose mode are not thread safe */
+   num_threads = 1;
+#endif
+   num_threads = MAX(num_threads, 1);
+
    mb_lt->word_length = lookup_options->word_size;
    mb_lt->lut_word_length = lut_width;
    mb_lt->hashsize = 1 << (BITS_PER_NUC * mb_lt->lut_word_length);
@@ -1005,12 +1087,13 @@ Int2 BlastMBLookupTableNew(BLAST_SequenceBlk* query, BlastSeqLoc* location,
    if (lookup_options->mb_template_length > 0) {
         /* discontiguous megablast */
         mb_lt->scan_step = 1;
-        status = s_FillDiscMBTable(query, location, mb_lt, lookup_options);
+        status = s_FillDiscMBTable(query, location, mb_lt, lookup_options,
+                                   num_threads);
    }
    else {
         /* contiguous megablast */
         mb_lt->scan_step = mb_lt->word_length - mb_lt->lut_word_length + 1;
-        status = s_FillContigMBTable(query, location, mb_lt);
+        status = s_FillContigMBTable(query, location, mb_lt, num_threads);
    }
 
    if (status > 0) {
@@ -86,6 +86,7 @@ typedef struct BlastSmallNaLookupTable {
  * @param opt Options for lookup table creation [in]
  * @param query_options query options used to get filtering options [in]
  * @param lut_width The number of nucleotides in one lookup table word [in]
+ * @param num_threads Number of threads used to index the query [in]
  * @return 0 if successful, nonzero on failure
  */
 Int4 BlastSmallNaLookupTableNew(BLAST_SequenceBlk* query,
@@ -93,7 +94,8 @@ Int4 BlastSmallNaLookupTableNew(BLAST_SequenceBlk* query,
                                 BlastSmallNaLookupTable * *lut,
                                 const LookupTableOptions * opt,
                                 const QuerySetUpOptions* query_options,
-                                Int4 lut_width);
+                                Int4 lut_width,
+                                Int4 num_threads);
 
 /** Free a small nucleotide lookup table.
  *  @param lookup The lookup table structure to be freed
@@ -162,6 +164,7 @@ typedef struct BlastNaLookupTable {
  * @param opt Options for lookup table creation [in]
  * @param query_options query options used to get filtering options [in]
  * @param lut_width The number of nucleotides in one lookup table word [in]
+ * @param num_threads Number of threads used to index the query [in]
  * @return 0 if successful, nonzero on failure
  */
 Int4 BlastNaLookupTableNew(BLAST_SequenceBlk* query,
@@ -169,7 +172,8 @@ Int4 BlastNaLookupTableNew(BLAST_SequenceBlk* query,
                            BlastNaLookupTable * *lut,
                            const LookupTableOptions * opt,
                            const QuerySetUpOptions* query_options,
-                           Int4 lut_width);
+                           Int4 lut_width,
+                           Int4 num_threads);
 
 /** Free a nucleotide lookup table.
  *  @param lookup The lookup table structure to be freed
@@ -277,13 +281,17 @@ typedef struct BlastMBLookupTable {
  * @param approx_table_entries An upper bound on the number of words
  *        that must be added to the lookup table [in]
  * @param lut_width The number of nucleotides in one lookup table word [in]
+ * @param num_threads Number of threads used to index the query; each
+ *        thread fills its own blocks of hashtable cells, so the table 
+ *        does not depend on the number of threads [in]
  */
 Int2 BlastMBLookupTableNew(BLAST_SequenceBlk* query, BlastSeqLoc* location,
                            BlastMBLookupTable** mb_lt_ptr,
                            const LookupTableOptions* lookup_options,
                            const QuerySetUpOptions* query_options,
                            Int4 approx_table_entries,
-                           Int4 lut_width);
+                           Int4 lut_width,
+                           Int4 num_threads);
 
 /** 
  * Deallocate memory used by the Mega BLAST lookup table
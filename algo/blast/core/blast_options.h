@@ -69,6 +69,9 @@ extern "C" {
                                           megablast; for discontig megablast
                                           the word size is explicitly 
                                           overridden) */
+#define BLAST_WORDSIZE_COMPRESSED_BATCH 6 /**< word size of the compressed
+                                          alphabet lookup table chosen for
+                                          large blastp searches */
 
 /** Default matrix name: BLOSUM62 */
 #define BLAST_DEFAULT_MATRIX "BLOSUM62"
@@ -104,6 +107,9 @@ extern "C" {
                                           (tblastn/rpstblastn) */
 #define BLAST_WORD_THRESHOLD_TBLASTX 13 /**< default threshold (tblastx) */
 #define BLAST_WORD_THRESHOLD_MEGABLAST 0 /**< default threshold (megablast) */
+#define BLAST_WORD_THRESHOLD_COMPRESSED_BATCH 21 /**< threshold of the
+                                         compressed alphabet lookup table
+                                         chosen for large blastp searches */
 
 /** default dropoff for ungapped extension; ungapped extensions
  *  will stop when the score for the extension has dropped from
@@ -186,6 +192,13 @@ typedef struct LookupTableOptions {
    Int4 mb_template_type; /**< Type of a discontiguous word template */
    char* phi_pattern;  /**< PHI-BLAST pattern */
    EBlastProgramType program_number; /**< indicates blastn, blastp, etc. */
+   Boolean compressed_batches; /**< let a blastp database search switch to
+                                    a compressed alphabet lookup table
+                                    (BLAST_WORDSIZE_COMPRESSED_BATCH,
+                                    BLAST_WORD_THRESHOLD_COMPRESSED_BATCH)
+                                    when BlastCompressedAaLookupIsCheaper
+                                    says so. This trades some sensitivity
+                                    for speed */
 } LookupTableOptions;
 
 /** Options for dust algorithm, applies only to nucl.-nucl. comparisons.
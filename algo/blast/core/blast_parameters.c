@@ -173,7 +173,9 @@ BlastInitialWordParametersNew(EBlastProgramType program_number,
    Int4 context;
    const int kQueryLenForHashTable = 8000; /* For blastn, use hash table rather 
                                            than diag array for any query longer 
-                                           than this */
+                                           than this; past this length the
+                                           diag array no longer stays in
+                                           cache */
 
    /* If parameters pointer is NULL, there is nothing to fill, 
       so don't do anything */
@@ -227,7 +229,7 @@ BlastInitialWordParametersNew(EBlastProgramType program_number,
    if (program_number == eBlastTypeBlastn &&
       (query_info->contexts[query_info->last_context].query_offset +
             query_info->contexts[query_info->last_context].query_length) > kQueryLenForHashTable)
-       p->container_type = eDiagHash;
+       p->container_type = eDiagCompact;
    else
        p->container_type = eDiagArray;
 
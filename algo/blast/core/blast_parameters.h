@@ -86,6 +86,8 @@ typedef enum ESeedContainerType {
     eDiagArray,         /**< use diagonal structures with array of last hits
                            and levels. */
     eDiagHash,          /**< use hash table (blastn only) */
+    eDiagCompact,       /**< use cache line bucketed hash table with
+                           constant time reset (blastn only) */
     eMaxContainerType   /**< maximum value for this enumeration */
 } ESeedContainerType;
 
@@ -236,7 +238,7 @@ BlastInitialWordParametersFree(BlastInitialWordParameters* parameters);
  * raw x_dropoff from the bit x_dropoff and puts it into
  * the x_dropoff field of BlastInitialWordParameters*.
  * The container type is also set.  For blastn queries over a certain
- * length eDiagHash is set, otherwise it's eDiagArray.
+ * length eDiagCompact is set, otherwise it's eDiagArray.
  * The extension method is also set via a call to s_GetBestExtensionMethod
  *
  * @param program_number Type of BLAST program [in]
@@ -855,16 +855,19 @@ _PSIValidateMSA(const _PSIMsa* msa, Boolean ignore_unaligned_positions)
 
 /** Remove those sequences which are identical to the query sequence 
  * @param msa multiple sequence alignment data structure [in]
+ * @param aligned_spans span of the aligned positions of each sequence [in]
  */
 static void
-s_PSIPurgeSelfHits(_PSIPackedMsa* msa);
+s_PSIPurgeSelfHits(_PSIPackedMsa* msa, const SSeqRange* aligned_spans);
 
 /** Keeps only one copy of any aligned sequences which are >kPSINearIdentical%
  * identical to one another
  * @param msa multiple sequence alignment data structure [in]
+ * @param aligned_spans span of the aligned positions of each sequence [in]
  */
 static void
-s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa);
+s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa,
+                                  const SSeqRange* aligned_spans);
 
 /** This function compares the sequences in the msa->cell
  * structure indexed by sequence_index1 and seq_index2. If it finds aligned 
@@ -872,14 +875,17 @@ s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa);
  * it removes the sequence identified by seq_index2.
  * FIXME: needs more descriptive name 
  * @param msa multiple sequence alignment data structure [in]
+ * @param aligned_spans span of the aligned positions of each sequence; 
+ * these may be wider than the actual spans, but not narrower [in]
  * @param seq_index1 index of the sequence of interest [in]
  * @param seq_index2 index of the sequence of interest [in]
  * @param max_percent_identity percent identity needed to drop sequence
- * identified by seq_index2 from the multiple sequence alignment data structure
- * [in]
+ * identified by seq_index2 from the multiple sequence alignment data 
+ * structure; must be greater than zero [in]
  */
 static void
 s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
+                            const SSeqRange* aligned_spans,
                             Uint4 seq_index1,
                             Uint4 seq_index2,
                             double max_percent_identity);
@@ -889,30 +895,60 @@ s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
 int
 _PSIPurgeBiasedSegments(_PSIPackedMsa* msa)
 {
+    SSeqRange* aligned_spans = NULL;  /* span of the aligned positions of 
+                                         each sequence */
+    Uint4 s = 0;                      /* index on sequences */
+    Uint4 p = 0;                      /* index on positions */
+
     if ( !msa ) {
         return PSIERR_BADPARAM;
     }
 
-    s_PSIPurgeSelfHits(msa);
-    s_PSIPurgeNearIdenticalAlignments(msa);
+    /* Positions where neither sequence of a pair is aligned do not change
+     * the outcome of comparing the pair, so only the positions between the
+     * first and the last aligned position of each sequence are examined. 
+     * Purging only shrinks these spans, so they are computed once. */
+    aligned_spans = (SSeqRange*) malloc((msa->dimensions->num_seqs + 1) *
+                                        sizeof(SSeqRange));
+    if ( !aligned_spans ) {
+        return PSIERR_OUTOFMEM;
+    }
+    for (s = 0; s < msa->dimensions->num_seqs + 1; s++) {
+        const _PSIPackedMsaCell* seq = msa->data[s];
+
+        aligned_spans[s].left = msa->dimensions->query_length;
+        aligned_spans[s].right = -1;
+        for (p = 0; p < msa->dimensions->query_length; p++) {
+            if (seq[p].is_aligned) {
+                aligned_spans[s].left = MIN(aligned_spans[s].left, (Int4)p);
+                aligned_spans[s].right = p;
+            }
+        }
+    }
+
+    s_PSIPurgeSelfHits(msa, aligned_spans);
+    s_PSIPurgeNearIdenticalAlignments(msa, aligned_spans);
 
+    sfree(aligned_spans);
     return PSI_SUCCESS;
 }
 
 static void
-s_PSIPurgeSelfHits(_PSIPackedMsa* msa)
+s_PSIPurgeSelfHits(_PSIPackedMsa* msa, const SSeqRange* aligned_spans)
 {
     Uint4 s = 0;        /* index on sequences */
 
     ASSERT(msa);
 
     for (s = kQueryIndex + 1; s < msa->dimensions->num_seqs + 1; s++) {
-        s_PSIPurgeSimilarAlignments(msa, kQueryIndex, s, kPSIIdentical);
+        s_PSIPurgeSimilarAlignments(msa, aligned_spans, kQueryIndex, s, 
+                                    kPSIIdentical);
     }
 }
 
 static void
-s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa)
+s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa,
+                                  const SSeqRange* aligned_spans)
 {
     Uint4 i = 0;
     Uint4 j = 0;
@@ -924,7 +960,8 @@ s_PSIPurgeNearIdenticalAlignments(_PSIPackedMsa* msa)
             /* N.B.: The order of comparison of sequence pairs is deliberate,
              * tests on real data indicated that this approach allowed more
              * sequences to be purged */
-            s_PSIPurgeSimilarAlignments(msa, j, (i + j), kPSINearIdentical);
+            s_PSIPurgeSimilarAlignments(msa, aligned_spans, j, (i + j), 
+                                        kPSINearIdentical);
         }
     }
 }
@@ -1126,6 +1163,7 @@ _handleEitherAlignedNeitherX(_PSIAlignmentTraits* traits,
 
 static void
 s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
+                            const SSeqRange* aligned_spans,
                             Uint4 seq_index1,
                             Uint4 seq_index2,
                             double max_percent_identity)
@@ -1134,10 +1172,15 @@ s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
     const Uint1 kXResidue = AMINOACID_TO_NCBISTDAA['X'];
     _EPSIPurgeFsmState state = eCounting;   /* initial state of the fsm */
     _PSIAlignmentTraits traits;
-    const Uint4 kQueryLength = msa->dimensions->query_length;
+    const SSeqRange* span1 = &aligned_spans[seq_index1];
+    const SSeqRange* span2 = &aligned_spans[seq_index2];
+    Int4 first = 0;                 /* first position to examine */
+    Int4 last = 0;                  /* last position to examine */
     _PSIPackedMsaCell* seq1 = 0;    /* array of cells for sequence 1 in MSA */
     _PSIPackedMsaCell* seq2 = 0;    /* array of cells for sequence 2 in MSA */
-    Uint4 p = 0;                    /* position on alignment */
+    Int4 p = 0;                     /* position on alignment */
+
+    ASSERT(max_percent_identity > 0.0);
 
     /* Nothing to do if sequences are the same or not selected for further
        processing */
@@ -1147,13 +1190,35 @@ s_PSIPurgeSimilarAlignments(_PSIPackedMsa* msa,
         return;
     }
 
-    _PSIResetAlignmentTraits(&traits, p);
-    seq1 = msa->data[seq_index1];
-    seq2 = msa->data[seq_index2];
+    /* Identical residues are only counted where both sequences are aligned;
+     * if their aligned spans do not overlap, no region can be purged */
+    if (span1->right < span2->left || span2->right < span1->left) {
+        return;
+    }
+
+    /* The fsm only leaves its resting state at a position where either
+     * sequence is aligned; before the first such position it rests (or, if
+     * that position is the first one, it is still in its initial state),
+     * and after the last one it only needs to evaluate the last region.
+     * When seq_index1 is the query, only the other sequence's aligned
+     * positions drive the fsm. */
+    first = span2->left;
+    last = span2->right;
+    if (seq_index1 != kQueryIndex) {
+        first = MIN(first, span1->left);
+        last = MAX(last, span1->right);
+    }
+    if (first > 0) {
+        state = eResting;
+    }
+
+    _PSIResetAlignmentTraits(&traits, first);
+    seq1 = msa->data[seq_index1] + first;
+    seq2 = msa->data[seq_index2] + first;
 
     /* Examine each position of the aligned sequences and use the fsm to
      * determine if a region of the alignment should be purged */
-    for (p = 0; p < kQueryLength; p++, seq1++, seq2++) {
+    for (p = first; p <= last; p++, seq1++, seq2++) {
 
         /* Indicates if the position in seq_index1 currently being examined is 
          * aligned. In the special case for seq_index1 == kQueryIndex, this 
@@ -1407,9 +1472,29 @@ _PSIComputeAlignedRegionLengths(const _PSIMsa* msa,
 
 /****************************************************************************/
 
+/** Bit set in the entries of the column-major copy of the multiple sequence
+ * alignment for those residues which are aligned; the remaining bits hold the
+ * residue */
+#define PSI_COLUMN_ALIGNED_BIT 0x80
+
+/** Extracts the residue from an entry of the column-major copy of the 
+ * multiple sequence alignment */
+#define PSI_COLUMN_RESIDUE(entry) ((entry) & ~PSI_COLUMN_ALIGNED_BIT)
+
+/** Builds a column-major copy of the residues and aligned flags of the 
+ * multiple sequence alignment, one byte per cell, so that the sequence 
+ * weights calculation scans contiguous memory for each query position.
+ * @param msa multiple sequence alignment data structure [in]
+ * @return matrix indexed by [position][sequence] or NULL if out of memory;
+ * it should be deallocated with _PSIDeallocateMatrix
+ */
+static Uint1**
+s_PSIPackMsaColumns(const _PSIMsa* msa);
+
 /** Populates the array aligned_sequences with the indices of the sequences
  * which are part of the multiple sequence alignment at the request position
  * @param msa multiple sequence alignment data structure [in]
+ * @param columns column-major copy of msa (see s_PSIPackMsaColumns) [in]
  * @param position position of interest [in]
  * @param aligned_sequences array which will contain the indices of the
  * sequences aligned at the requested position. This array must have size
@@ -1419,6 +1504,7 @@ _PSIComputeAlignedRegionLengths(const _PSIMsa* msa,
 static void
 _PSIGetAlignedSequencesForPosition(
     const _PSIMsa* msa, 
+    const Uint1** columns,
     Uint4 position,
     SDynamicUint4Array* aligned_sequences);
 
@@ -1426,6 +1512,7 @@ _PSIGetAlignedSequencesForPosition(
  * Henikoff's algorithm presented in "Position-based sequence weights". 
  * Skipped optimization about identical previous sets.
  * @param msa multiple sequence alignment data structure [in]
+ * @param columns column-major copy of msa (see s_PSIPackMsaColumns) [in]
  * @param aligned_blocks aligned regions' extents [in]
  * @param position position of the query to calculate the sequence weights for
  * [in]
@@ -1437,6 +1524,7 @@ _PSIGetAlignedSequencesForPosition(
 static void
 _PSICalculateNormalizedSequenceWeights(
     const _PSIMsa* msa,
+    const Uint1** columns,
     const _PSIAlignedBlock* aligned_blocks,
     Uint4 position,
     const SDynamicUint4Array* aligned_seqs,
@@ -1444,6 +1532,7 @@ _PSICalculateNormalizedSequenceWeights(
 
 /** Calculate the weighted observed sequence weights
  * @param msa multiple sequence alignment data structure [in]
+ * @param columns column-major copy of msa (see s_PSIPackMsaColumns) [in]
  * @param position position of the query to calculate the sequence weights for
  * [in]
  * @param aligned_seqs array containing the indices of the sequences 
@@ -1454,6 +1543,7 @@ _PSICalculateNormalizedSequenceWeights(
 static void
 _PSICalculateMatchWeights(
     const _PSIMsa* msa,
+    const Uint1** columns,
     Uint4 position,
     const SDynamicUint4Array* aligned_seqs,
     _PSISequenceWeights* seq_weights);
@@ -1502,6 +1592,7 @@ _PSIComputeSequenceWeights(const _PSIMsa* msa,                      /* [in] */
     SDynamicUint4Array* prev_pos_aligned_seqs = 0; /* list of indices of 
                                        sequences for the previous position in 
                                        the query (i.e.: column in MSA). */
+    Uint1** columns = NULL;         /* column-major copy of msa */
     Uint4 kQueryLength = 0;         /* length of the query */
     Uint4 pos = 0;                  /* position index */
     int retval = PSI_SUCCESS;       /* return value */
@@ -1513,7 +1604,10 @@ _PSIComputeSequenceWeights(const _PSIMsa* msa,                      /* [in] */
 
     aligned_seqs = DynamicUint4ArrayNewEx(msa->dimensions->num_seqs + 1);
     prev_pos_aligned_seqs = DynamicUint4Array_Dup(aligned_seqs);
-    if ( !aligned_seqs || !prev_pos_aligned_seqs ) {
+    columns = s_PSIPackMsaColumns(msa);
+    if ( !aligned_seqs || !prev_pos_aligned_seqs || !columns ) {
+        DynamicUint4ArrayFree(aligned_seqs);
+        DynamicUint4ArrayFree(prev_pos_aligned_seqs);
         return PSIERR_OUTOFMEM;
     }
     kQueryLength = msa->dimensions->query_length;
@@ -1527,7 +1621,8 @@ _PSIComputeSequenceWeights(const _PSIMsa* msa,                      /* [in] */
         }
 
         DynamicUint4Array_Copy(prev_pos_aligned_seqs, aligned_seqs);
-        _PSIGetAlignedSequencesForPosition(msa, pos, aligned_seqs);
+        _PSIGetAlignedSequencesForPosition(msa, (const Uint1**) columns, pos,
+                                           aligned_seqs);
         ASSERT(msa->num_matching_seqs[pos] == aligned_seqs->num_used);
         if (aligned_seqs->num_used <= kExpectedNumMatchingSeqs) {
             continue;
@@ -1539,7 +1634,9 @@ _PSIComputeSequenceWeights(const _PSIMsa* msa,                      /* [in] */
             memset((void*)seq_weights->row_sigma, 0,
                    sizeof(double)*(msa->dimensions->num_seqs+1));
 
-            _PSICalculateNormalizedSequenceWeights(msa, aligned_blocks, pos, 
+            _PSICalculateNormalizedSequenceWeights(msa, 
+                                                   (const Uint1**) columns,
+                                                   aligned_blocks, pos, 
                                                    aligned_seqs, seq_weights);
         } else {
             int index;
@@ -1554,11 +1651,13 @@ _PSIComputeSequenceWeights(const _PSIMsa* msa,                      /* [in] */
         seq_weights->posNumParticipating[pos] = aligned_seqs->num_used;
 
         /* Uses seq_weights->norm_seq_weights to populate match_weights */
-        _PSICalculateMatchWeights(msa, pos, aligned_seqs, seq_weights);
+        _PSICalculateMatchWeights(msa, (const Uint1**) columns, pos, 
+                                  aligned_seqs, seq_weights);
     }
 
     DynamicUint4ArrayFree(aligned_seqs);
     DynamicUint4ArrayFree(prev_pos_aligned_seqs);
+    _PSIDeallocateMatrix((void**) columns, kQueryLength);
 
     /* Check that the sequence weights add up to 1 in each column */
     retval = _PSICheckSequenceWeights(msa, seq_weights, 
@@ -1578,9 +1677,37 @@ _PSIComputeSequenceWeights(const _PSIMsa* msa,                      /* [in] */
     return retval;
 }
 
+static Uint1**
+s_PSIPackMsaColumns(const _PSIMsa* msa)
+{
+    const Uint4 kNumSeqs = msa->dimensions->num_seqs + 1;
+    Uint1** retval = NULL;
+    Uint4 s = 0;            /* index on sequences */
+    Uint4 p = 0;            /* index on positions */
+
+    ASSERT(msa);
+
+    retval = (Uint1**) _PSIAllocateMatrix(msa->dimensions->query_length,
+                                          kNumSeqs, sizeof(Uint1));
+    if ( !retval ) {
+        return NULL;
+    }
+
+    for (s = 0; s < kNumSeqs; s++) {
+        const _PSIMsaCell* seq = msa->cell[s];
+        for (p = 0; p < msa->dimensions->query_length; p++) {
+            ASSERT((seq[p].letter & PSI_COLUMN_ALIGNED_BIT) == 0);
+            retval[p][s] = (Uint1) (seq[p].letter | 
+                (seq[p].is_aligned ? PSI_COLUMN_ALIGNED_BIT : 0));
+        }
+    }
+    return retval;
+}
+
 static void
 _PSICalculateNormalizedSequenceWeights(
     const _PSIMsa* msa,
+    const Uint1** columns,
     const _PSIAlignedBlock* aligned_blocks, /* [in] */
     Uint4 position,                        /* [in] */
     const SDynamicUint4Array* aligned_seqs,             /* [in] */
@@ -1626,6 +1753,12 @@ _PSICalculateNormalizedSequenceWeights(
         Uint4 num_distinct_residues_for_column = 0; 
         Uint4 num_local_std_letters = 0; 
 
+        /* Contribution of each residue found in column i to row_sigma */
+        double residue_weight_for_column[BLASTAA_SIZE];
+        Uint4 r = 0;
+
+        const Uint1* column = columns[i];
+
         /* Assert that the alignment extents have sane values */
         ASSERT(i < msa->dimensions->query_length);
 
@@ -1633,7 +1766,7 @@ _PSICalculateNormalizedSequenceWeights(
          * corresponding to position */
         for (asi = 0; asi < aligned_seqs->num_used; asi++) {
             const Uint4 kSeqIdx = aligned_seqs->data[asi];
-            const Uint1 kResidue = msa->cell[kSeqIdx][i].letter;
+            const Uint1 kResidue = PSI_COLUMN_RESIDUE(column[kSeqIdx]);
 
             if (residue_counts_for_column[kResidue] == 0) {
                 num_distinct_residues_for_column++;
@@ -1652,19 +1785,27 @@ _PSICalculateNormalizedSequenceWeights(
             distinct_residues_found = TRUE;
         }
 
+        /* This is a modified version of the Henikoff's idea in
+         * "Position-based sequence weights" paper. The modification
+         * consists in using the alignment extents. The contribution depends
+         * only on the residue, so it is computed once per residue found. */
+        for (r = 0; r < BLASTAA_SIZE; r++) {
+            if (residue_counts_for_column[r] != 0) {
+                residue_weight_for_column[r] = 
+                    (1.0 / (double) 
+                     (residue_counts_for_column[r] * 
+                      num_distinct_residues_for_column) );
+            }
+        }
+
         /* Calculate row_sigma, an intermediate value to calculate the
          * normalized sequence weights */
         for (asi = 0; asi < aligned_seqs->num_used; asi++) {
             const Uint4 seq_idx = aligned_seqs->data[asi];
-            const Uint1 residue = msa->cell[seq_idx][i].letter;
+            const Uint1 residue = PSI_COLUMN_RESIDUE(column[seq_idx]);
 
-            /* This is a modified version of the Henikoff's idea in
-             * "Position-based sequence weights" paper. The modification
-             * consists in using the alignment extents. */
             seq_weights->row_sigma[seq_idx] += 
-                (1.0 / (double) 
-                 (residue_counts_for_column[residue] * 
-                  num_distinct_residues_for_column) );
+                residue_weight_for_column[residue];
         }
     }
 
@@ -1706,11 +1847,13 @@ _PSICalculateNormalizedSequenceWeights(
 static void
 _PSICalculateMatchWeights(
     const _PSIMsa* msa,  /* [in] */
+    const Uint1** columns,              /* [in] */
     Uint4 position,                     /* [in] */
     const SDynamicUint4Array* aligned_seqs,          /* [in] */
     _PSISequenceWeights* seq_weights)    /* [out] */
 {
     const Uint1 kGapResidue = AMINOACID_TO_NCBISTDAA['-'];
+    const Uint1* column = columns[position];
     Uint4 asi = 0;   /* index into array of aligned sequences */
 
     ASSERT(msa);
@@ -1719,7 +1862,7 @@ _PSICalculateMatchWeights(
 
     for (asi = 0; asi < aligned_seqs->num_used; asi++) {
         const Uint4 seq_idx = aligned_seqs->data[asi];
-        const Uint1 residue = msa->cell[seq_idx][position].letter;
+        const Uint1 residue = PSI_COLUMN_RESIDUE(column[seq_idx]);
 
         seq_weights->match_weights[position][residue] += 
             seq_weights->norm_seq_weights[seq_idx];
@@ -1734,12 +1877,14 @@ _PSICalculateMatchWeights(
 
 static void
 _PSIGetAlignedSequencesForPosition(const _PSIMsa* msa, 
+                                   const Uint1** columns,
                                    Uint4 position,
                                    SDynamicUint4Array* aligned_sequences)
 {
 #ifdef PSI_IGNORE_GAPS_IN_COLUMNS
     const Uint1 kGapResidue = AMINOACID_TO_NCBISTDAA['-'];
 #endif
+    const Uint1* column = columns[position];
     Uint4 i = 0;
 
     ASSERT(msa);
@@ -1750,10 +1895,10 @@ _PSIGetAlignedSequencesForPosition(const _PSIMsa* msa,
     for (i = 0; i < msa->dimensions->num_seqs + 1; i++) {
 
 #ifdef PSI_IGNORE_GAPS_IN_COLUMNS
-        if (msa->cell[i][position].is_aligned &&
-            msa->cell[i][position].letter != kGapResidue) {
+        if ((column[i] & PSI_COLUMN_ALIGNED_BIT) &&
+            PSI_COLUMN_RESIDUE(column[i]) != kGapResidue) {
 #else
-        if (msa->cell[i][position].is_aligned) {
+        if (column[i] & PSI_COLUMN_ALIGNED_BIT) {
 #endif
             DynamicUint4Array_Append(aligned_sequences, i);
         }
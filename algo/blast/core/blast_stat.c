@@ -704,11 +704,7 @@ static const array_of_8 blastn_values_5_4[] = {
     {  8, 6, 0.146, 0.039, 0.11, 1.3, -29, 76 }
 };
 
-/** Deallocates SBlastScoreMatrix structure
- * @param matrix structure to deallocate [in]
- * @return NULL
- */
-static SBlastScoreMatrix*
+SBlastScoreMatrix*
 SBlastScoreMatrixFree(SBlastScoreMatrix* matrix)
 {
     if ( !matrix ) {
@@ -730,13 +726,7 @@ SBlastScoreMatrixFree(SBlastScoreMatrix* matrix)
     return NULL;
 }
 
-/** Allocates a new SBlastScoreMatrix structure of the specified dimensions.
- * @param ncols number of columns [in]
- * @param nrows number of rows [in]
- * @return NULL in case of memory allocation failure, else new
- * SBlastScoreMatrix structure
- */
-static SBlastScoreMatrix*
+SBlastScoreMatrix*
 SBlastScoreMatrixNew(size_t ncols, size_t nrows)
 {
     SBlastScoreMatrix* retval = NULL;
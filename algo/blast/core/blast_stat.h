@@ -154,6 +154,24 @@ typedef struct SPsiBlastScoreMatrix {
                                   PSSM */
 } SPsiBlastScoreMatrix;
 
+/** Allocates a new SBlastScoreMatrix structure of the specified dimensions.
+ * @param ncols number of columns [in]
+ * @param nrows number of rows [in]
+ * @return NULL in case of memory allocation failure, else new
+ * SBlastScoreMatrix structure
+ */
+NCBI_XBLAST_EXPORT
+SBlastScoreMatrix*
+SBlastScoreMatrixNew(size_t ncols, size_t nrows);
+
+/** Deallocates SBlastScoreMatrix structure
+ * @param matrix structure to deallocate [in]
+ * @return NULL
+ */
+NCBI_XBLAST_EXPORT
+SBlastScoreMatrix*
+SBlastScoreMatrixFree(SBlastScoreMatrix* matrix);
+
 /** Allocates a new SPsiBlastScoreMatrix structure of dimensions ncols by
  * BLASTAA_SIZE.
  * @param ncols number of columns (i.e.: query length) [in]
@@ -438,9 +438,11 @@ Blast_TracebackFromHSPList(EBlastProgramType program_number,
       is zero only for translated subject sequences, whose maximum
       length is bounded by the length of the first frame */
 
-   tree = Blast_IntervalTreeInit(0, query_blk->length + 1,
+   tree = Blast_IntervalTreeReinit(gap_align->itree, 
+                                 0, query_blk->length + 1,
                                  0, (subject_length > 0 ? subject_length :
                                  subject_blk->length / CODON_LENGTH) + 1);
+   gap_align->itree = tree;
    
    for (index=0; index < num_initial_hsps; index++) {
       hsp = hsp_array[index];
@@ -737,8 +739,6 @@ Blast_TracebackFromHSPList(EBlastProgramType program_number,
        }
    }
    
-   tree = Blast_IntervalTreeFree(tree);
-   
    /* Free the local query_info structure, if necessary (RPS tblastn only) */
    if (query_info != query_info_in)
       sfree(query_info);
@@ -1276,6 +1276,32 @@ BLAST_ComputeTraceback(EBlastProgramType program_number,
                        BlastHSPResults** results_out, 
                        TInterruptFnPtr interrupt_search, 
                        SBlastProgress* progress_info)
+{
+   return BLAST_ComputeTraceback_MT(program_number, hsp_stream, query,
+                                    query_info, seq_src, gap_align,
+                                    score_params, ext_params, hit_params,
+                                    eff_len_params, db_options, psi_options,
+                                    rps_info, pattern_blk, results_out,
+                                    interrupt_search, progress_info, 1);
+}
+
+Int2 
+BLAST_ComputeTraceback_MT(EBlastProgramType program_number, 
+                       BlastHSPStream* hsp_stream, BLAST_SequenceBlk* query, 
+                       BlastQueryInfo* query_info, const BlastSeqSrc* seq_src, 
+                       BlastGapAlignStruct* gap_align, 
+                       BlastScoringParameters* score_params,
+                       const BlastExtensionParameters* ext_params,
+                       BlastHitSavingParameters* hit_params,
+                       BlastEffectiveLengthsParameters* eff_len_params,
+                       const BlastDatabaseOptions* db_options,
+                       const PSIBlastOptions* psi_options, 
+                       const BlastRPSInfo* rps_info, 
+                       SPHIPatternSearchBlk* pattern_blk,
+                       BlastHSPResults** results_out, 
+                       TInterruptFnPtr interrupt_search, 
+                       SBlastProgress* progress_info,
+                       Int4 num_threads)
 {
    Int2 status = 0;
    BlastHSPResults* results = NULL;
@@ -1310,10 +1336,11 @@ BLAST_ComputeTraceback(EBlastProgramType program_number,
       /* FIXME partial sequence fetching/translation could lead to fence hit
          and seg fault */
       status =
-          Blast_RedoAlignmentCore(program_number, query, query_info, sbp,
-                                  hsp_stream, seq_src, default_db_genetic_code,
-                                  score_params, ext_params, hit_params, 
-                                  psi_options, results);
+          Blast_RedoAlignmentCore_MT(program_number, num_threads, query,
+                                     query_info, sbp, hsp_stream, seq_src,
+                                     default_db_genetic_code, score_params,
+                                     ext_params, hit_params, psi_options,
+                                     results);
    } else {
       Int4 i;
       BlastSeqSrcGetSeqArg seq_arg;
@@ -1544,8 +1571,12 @@ Blast_RunTracebackSearch(EBlastProgramType program,
           hsp_stream, rps_info, pattern_blk, results, NULL, NULL);
 }
 
-Int2 
-Blast_RunTracebackSearchWithInterrupt(EBlastProgramType program, 
+/** Sets up the internal traceback parameters and runs the traceback stage
+ * on the given number of threads.
+ * @sa Blast_RunTracebackSearchWithInterrupt, BLAST_ComputeTraceback_MT
+ */
+static Int2 
+s_RunTracebackSearch(EBlastProgramType program, 
    BLAST_SequenceBlk* query, BlastQueryInfo* query_info, 
    const BlastSeqSrc* seq_src, const BlastScoringOptions* score_options,
    const BlastExtensionOptions* ext_options,
@@ -1555,7 +1586,8 @@ Blast_RunTracebackSearchWithInterrupt(EBlastProgramType program,
    const PSIBlastOptions* psi_options, BlastScoreBlk* sbp,
    BlastHSPStream* hsp_stream, const BlastRPSInfo* rps_info,
    SPHIPatternSearchBlk* pattern_blk, BlastHSPResults** results,
-   TInterruptFnPtr interrupt_search,  SBlastProgress* progress_info)
+   TInterruptFnPtr interrupt_search,  SBlastProgress* progress_info,
+   Int4 num_threads)
 {
    Int2 status = 0;
    BlastScoringParameters* score_params = NULL; /**< Scoring parameters */
@@ -1577,10 +1609,11 @@ Blast_RunTracebackSearchWithInterrupt(EBlastProgramType program,
    BlastHSPStreamClose(hsp_stream);
 
    status = 
-      BLAST_ComputeTraceback(program, hsp_stream, query, query_info,
+      BLAST_ComputeTraceback_MT(program, hsp_stream, query, query_info,
                              seq_src, gap_align, score_params, ext_params, 
                              hit_params, eff_len_params, db_options, psi_options,
-                             rps_info, pattern_blk, results, interrupt_search, progress_info);
+                             rps_info, pattern_blk, results, interrupt_search, progress_info,
+                             num_threads);
 
    /* Do not destruct score block here */
    gap_align->sbp = NULL;
@@ -1592,3 +1625,41 @@ Blast_RunTracebackSearchWithInterrupt(EBlastProgramType program,
    eff_len_params = BlastEffectiveLengthsParametersFree(eff_len_params);
    return status;
 }
+
+Int2 
+Blast_RunTracebackSearchWithInterrupt(EBlastProgramType program, 
+   BLAST_SequenceBlk* query, BlastQueryInfo* query_info, 
+   const BlastSeqSrc* seq_src, const BlastScoringOptions* score_options,
+   const BlastExtensionOptions* ext_options,
+   const BlastHitSavingOptions* hit_options,
+   const BlastEffectiveLengthsOptions* eff_len_options,
+   const BlastDatabaseOptions* db_options, 
+   const PSIBlastOptions* psi_options, BlastScoreBlk* sbp,
+   BlastHSPStream* hsp_stream, const BlastRPSInfo* rps_info,
+   SPHIPatternSearchBlk* pattern_blk, BlastHSPResults** results,
+   TInterruptFnPtr interrupt_search,  SBlastProgress* progress_info)
+{
+   return s_RunTracebackSearch(program, query, query_info, seq_src,
+          score_options, ext_options, hit_options, eff_len_options,
+          db_options, psi_options, sbp, hsp_stream, rps_info, pattern_blk,
+          results, interrupt_search, progress_info, 1);
+}
+
+Int2 
+Blast_RunTracebackSearchMT(EBlastProgramType program, 
+   BLAST_SequenceBlk* query, BlastQueryInfo* query_info, 
+   const BlastSeqSrc* seq_src, const BlastScoringOptions* score_options,
+   const BlastExtensionOptions* ext_options,
+   const BlastHitSavingOptions* hit_options,
+   const BlastEffectiveLengthsOptions* eff_len_options,
+   const BlastDatabaseOptions* db_options, 
+   const PSIBlastOptions* psi_options, BlastScoreBlk* sbp,
+   BlastHSPStream* hsp_stream, const BlastRPSInfo* rps_info,
+   SPHIPatternSearchBlk* pattern_blk, BlastHSPResults** results,
+   Int4 num_threads)
+{
+   return s_RunTracebackSearch(program, query, query_info, seq_src,
+          score_options, ext_options, hit_options, eff_len_options,
+          db_options, psi_options, sbp, hsp_stream, rps_info, pattern_blk,
+          results, NULL, NULL, num_threads);
+}
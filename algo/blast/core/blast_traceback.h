@@ -139,6 +139,28 @@ BLAST_ComputeTraceback(EBlastProgramType program_number,
    SPHIPatternSearchBlk* pattern_blk, BlastHSPResults** results,
    TInterruptFnPtr interrupt_search, SBlastProgress* progress_info);
 
+/** Multi-threaded version of BLAST_ComputeTraceback; at present only the
+ * composition-based statistics stage (Blast_RedoAlignmentCore_MT) uses 
+ * more than one thread.
+ * @param num_threads Number of threads to use [in]
+ * @sa BLAST_ComputeTraceback for the remaining parameters
+ * @return nonzero indicates failure, otherwise zero
+ */
+NCBI_XBLAST_EXPORT
+Int2 
+BLAST_ComputeTraceback_MT(EBlastProgramType program_number, 
+   BlastHSPStream* hsp_stream, BLAST_SequenceBlk* query, 
+   BlastQueryInfo* query_info, const BlastSeqSrc* seq_src, 
+   BlastGapAlignStruct* gap_align, BlastScoringParameters* score_params,
+   const BlastExtensionParameters* ext_params,
+   BlastHitSavingParameters* hit_params,
+   BlastEffectiveLengthsParameters* eff_len_params,
+   const BlastDatabaseOptions* db_options,
+   const PSIBlastOptions* psi_options, const BlastRPSInfo* rps_info, 
+   SPHIPatternSearchBlk* pattern_blk, BlastHSPResults** results,
+   TInterruptFnPtr interrupt_search, SBlastProgress* progress_info,
+   Int4 num_threads);
+
 /** Entry point from the API level to perform the traceback stage of a BLAST 
  * search, given the source of HSP lists, obtained from the preliminary stage. 
  * The parameters internal to the engine are calculated here independently of 
@@ -213,6 +235,24 @@ Blast_RunTracebackSearchWithInterrupt(EBlastProgramType program,
    SPHIPatternSearchBlk* pattern_blk, BlastHSPResults** results,
    TInterruptFnPtr interrupt_search, SBlastProgress* progress_info);
 
+/** Same as Blast_RunTracebackSearch, but the traceback may use several
+ * threads (@sa BLAST_ComputeTraceback_MT).
+ * @param num_threads Number of threads to use [in]
+ */
+NCBI_XBLAST_EXPORT
+Int2 
+Blast_RunTracebackSearchMT(EBlastProgramType program, 
+   BLAST_SequenceBlk* query, BlastQueryInfo* query_info, 
+   const BlastSeqSrc* seq_src, const BlastScoringOptions* score_options,
+   const BlastExtensionOptions* ext_options,
+   const BlastHitSavingOptions* hit_options,
+   const BlastEffectiveLengthsOptions* eff_len_options,
+   const BlastDatabaseOptions* db_options, 
+   const PSIBlastOptions* psi_options, BlastScoreBlk* sbp,
+   BlastHSPStream* hsp_stream, const BlastRPSInfo* rps_info, 
+   SPHIPatternSearchBlk* pattern_blk, BlastHSPResults** results,
+   Int4 num_threads);
+
 #ifdef __cplusplus
 }
 #endif
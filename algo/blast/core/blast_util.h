@@ -54,6 +54,149 @@ extern "C" {
 /** Macro to extract base N from a byte x (N >= 0, N < 4) */
 #define NCBI2NA_UNPACK_BASE(x, N) (((x)>>(2*(N))) & NCBI2NA_MASK)
 
+/* Exact nucleotide matches can be counted eight bases at a time when the
+   compiler provides bit scans and the byte order is known; otherwise 
+   bases are compared one at a time */
+#if defined(__GNUC__) && \
+    (defined(IS_LITTLE_ENDIAN) || defined(IS_BIG_ENDIAN))
+
+/** Defined if the word-wide exact match counters are used */
+#define BLAST_NA_WORD_MATCH 1
+
+/** Bits set in a word of eight blastna bases if any of them is ambiguous */
+#define BLAST_NA_AMBIG_MASK8 0xfcfcfcfcfcfcfcfcULL
+
+#ifdef IS_LITTLE_ENDIAN
+/** Number of zero bytes at the start of a nonzero word, in memory order */
+#define BLAST_NA_LEADING_ZERO_BYTES(x) (__builtin_ctzll(x) >> 3)
+/** Number of zero bytes at the end of a nonzero word, in memory order */
+#define BLAST_NA_TRAILING_ZERO_BYTES(x) (__builtin_clzll(x) >> 3)
+#else
+/** Number of zero bytes at the start of a nonzero word, in memory order */
+#define BLAST_NA_LEADING_ZERO_BYTES(x) (__builtin_clzll(x) >> 3)
+/** Number of zero bytes at the end of a nonzero word, in memory order */
+#define BLAST_NA_TRAILING_ZERO_BYTES(x) (__builtin_ctzll(x) >> 3)
+#endif
+
+/** Unpack eight consecutive bases of an ncbi2na sequence, one base per
+ *  byte in sequence order. Reads the three bytes starting at the byte
+ *  that contains the first base.
+ * @param seq The packed sequence [in]
+ * @param start Offset of the first base [in]
+ * @return The unpacked bases
+ */
+static NCBI_INLINE Uint8 BlastNaUnpackEight(const Uint1* seq, Int4 start)
+{
+    const Uint1* p = seq + start / COMPRESSION_RATIO;
+    Uint4 bits = ((Uint4)p[0] << 16) | ((Uint4)p[1] << 8) | p[2];
+    Uint8 retval;
+
+    bits = (bits >> (8 - 2 * (start % COMPRESSION_RATIO))) & 0xffff;
+    memcpy(&retval, NCBI2NA_TO_BLASTNA_BYTES[bits >> 8], 4);
+    memcpy((Uint1*)&retval + 4, NCBI2NA_TO_BLASTNA_BYTES[bits & 0xff], 4);
+    return retval;
+}
+
+/** Unpack the eight bases of an ncbi2na sequence that end at a given
+ *  offset, one base per byte in sequence order. Reads the three bytes
+ *  ending at the byte that contains the last base.
+ * @param seq The packed sequence [in]
+ * @param end Offset of the last base [in]
+ * @return The unpacked bases
+ */
+static NCBI_INLINE Uint8 BlastNaUnpackEightEndingAt(const Uint1* seq, 
+                                                    Int4 end)
+{
+    const Uint1* p = seq + end / COMPRESSION_RATIO - 2;
+    Uint4 bits = ((Uint4)p[0] << 16) | ((Uint4)p[1] << 8) | p[2];
+    Uint8 retval;
+
+    bits = (bits >> (2 * (3 - end % COMPRESSION_RATIO))) & 0xffff;
+    memcpy(&retval, NCBI2NA_TO_BLASTNA_BYTES[bits >> 8], 4);
+    memcpy((Uint1*)&retval + 4, NCBI2NA_TO_BLASTNA_BYTES[bits & 0xff], 4);
+    return retval;
+}
+
+#endif /* BLAST_NA_WORD_MATCH */
+
+/** Count the bases that match exactly between an uncompressed nucleotide
+ *  sequence and an ncbi2na sequence, going forward. Ambiguous bases in 
+ *  the uncompressed sequence never match.
+ * @param seq1 The uncompressed sequence, starting at the first base 
+ *             to compare [in]
+ * @param seq2 The packed sequence [in]
+ * @param seq2_start Offset in seq2 of the first base to compare [in]
+ * @param len Maximum number of bases to compare; all of them must
+ *            be valid in both sequences [in]
+ * @return The number of matching bases
+ */
+static NCBI_INLINE Int4 BlastNaExactMatchLength(const Uint1* seq1,
+                                                const Uint1* seq2,
+                                                Int4 seq2_start, Int4 len)
+{
+    Int4 i = 0;
+
+#ifdef BLAST_NA_WORD_MATCH
+    /* the unpacking reads up to four bases past the end of the 
+       eight being compared */
+    for (; i + 12 <= len; i += 8) {
+        Uint8 q, diff;
+        memcpy(&q, seq1 + i, 8);
+        diff = (q ^ BlastNaUnpackEight(seq2, seq2_start + i)) | 
+               (q & BLAST_NA_AMBIG_MASK8);
+        if (diff != 0)
+            return i + BLAST_NA_LEADING_ZERO_BYTES(diff);
+    }
+#endif
+    for (; i < len; i++) {
+        Int4 s = seq2_start + i;
+        if (seq1[i] != NCBI2NA_UNPACK_BASE(seq2[s / COMPRESSION_RATIO],
+                                          3 - s % COMPRESSION_RATIO))
+            break;
+    }
+    return i;
+}
+
+/** Count the bases that match exactly between an uncompressed nucleotide
+ *  sequence and an ncbi2na sequence, going backward. Ambiguous bases in 
+ *  the uncompressed sequence never match.
+ * @param seq1_end The uncompressed sequence, pointing one past the first
+ *                 base to compare [in]
+ * @param seq2 The packed sequence [in]
+ * @param seq2_end Offset in seq2 one past the first base to compare [in]
+ * @param len Maximum number of bases to compare; all of them must
+ *            be valid in both sequences [in]
+ * @return The number of matching bases
+ */
+static NCBI_INLINE Int4 BlastNaExactMatchLengthReverse(const Uint1* seq1_end,
+                                                       const Uint1* seq2,
+                                                       Int4 seq2_end, 
+                                                       Int4 len)
+{
+    Int4 i = 0;
+
+#ifdef BLAST_NA_WORD_MATCH
+    /* the unpacking reads up to four bases before the eight being
+       compared */
+    for (; i + 12 <= len; i += 8) {
+        Uint8 q, diff;
+        memcpy(&q, seq1_end - i - 8, 8);
+        diff = (q ^ BlastNaUnpackEightEndingAt(seq2, seq2_end - i - 1)) | 
+               (q & BLAST_NA_AMBIG_MASK8);
+        if (diff != 0)
+            return i + BLAST_NA_TRAILING_ZERO_BYTES(diff);
+    }
+#endif
+    for (; i < len; i++) {
+        Int4 s = seq2_end - 1 - i;
+        if (seq1_end[-1 - i] != 
+                    NCBI2NA_UNPACK_BASE(seq2[s / COMPRESSION_RATIO],
+                                        3 - s % COMPRESSION_RATIO))
+            break;
+    }
+    return i;
+}
+
 
 /** Deallocate memory only for the sequence in the sequence block */
 NCBI_XBLAST_EXPORT
@@ -326,10 +326,28 @@ static Int4 s_FindFirstMismatch(const Uint1 *seq1, const Uint1 *seq2,
        sentry value cannot appear in the query, so detection only
        needs to be done at exit from the subject-query matching loop.
        For uncompressed sequences, ambiguities in the query (i.e. seq1)
-       always count as mismatches */
+       always count as mismatches. Runs of matches are counted eight
+       bases at a time where possible */
     
     if (reverse) {
         if (rem == 4) {
+#ifdef BLAST_NA_WORD_MATCH
+            /* compare eight bases at a time until a word differs */
+            while (seq1_index + 8 <= len1 && seq2_index + 8 <= len2) {
+                Uint8 w1, w2, diff;
+                memcpy(&w1, seq1 + len1 - 8 - seq1_index, 8);
+                memcpy(&w2, seq2 + len2 - 8 - seq2_index, 8);
+                diff = (w1 ^ w2) | (w1 & BLAST_NA_AMBIG_MASK8);
+                if (diff != 0) {
+                    Int4 run = BLAST_NA_TRAILING_ZERO_BYTES(diff);
+                    seq1_index += run;
+                    seq2_index += run;
+                    break;
+                }
+                seq1_index += 8;
+                seq2_index += 8;
+            }
+#endif
             while (seq1_index < len1 && seq2_index < len2 && 
                    seq1[len1-1 - seq1_index] < 4 &&
                    seq1[len1-1 - seq1_index] == seq2[len2-1 - seq2_index]) {
@@ -342,17 +360,32 @@ static Int4 s_FindFirstMismatch(const Uint1 *seq1, const Uint1 *seq2,
                 *fence_hit = TRUE;
             }
         } else {
-            while (seq1_index < len1 && seq2_index < len2 && 
-                seq1[len1-1 - seq1_index] == 
-                NCBI2NA_UNPACK_BASE(seq2[(len2-1-seq2_index) / 4],
-                                     3 - (len2-1-seq2_index) % 4)) {
-                ++seq1_index;
-                ++seq2_index;
-            }
+            Int4 run = BlastNaExactMatchLengthReverse(seq1 + len1 - seq1_index,
+                                                seq2, len2 - seq2_index,
+                                                MIN(len1 - seq1_index,
+                                                    len2 - seq2_index));
+            seq1_index += run;
+            seq2_index += run;
         }
     } 
     else {
         if (rem == 4) {
+#ifdef BLAST_NA_WORD_MATCH
+            while (seq1_index + 8 <= len1 && seq2_index + 8 <= len2) {
+                Uint8 w1, w2, diff;
+                memcpy(&w1, seq1 + seq1_index, 8);
+                memcpy(&w2, seq2 + seq2_index, 8);
+                diff = (w1 ^ w2) | (w1 & BLAST_NA_AMBIG_MASK8);
+                if (diff != 0) {
+                    Int4 run = BLAST_NA_LEADING_ZERO_BYTES(diff);
+                    seq1_index += run;
+                    seq2_index += run;
+                    break;
+                }
+                seq1_index += 8;
+                seq2_index += 8;
+            }
+#endif
             while (seq1_index < len1 && seq2_index < len2 && 
                    seq1[seq1_index] < 4 &&
                    seq1[seq1_index] == seq2[seq2_index]) {
@@ -366,13 +399,12 @@ static Int4 s_FindFirstMismatch(const Uint1 *seq1, const Uint1 *seq2,
             }
         } 
         else {
-            while (seq1_index < len1 && seq2_index < len2 && 
-                seq1[seq1_index] == 
-                NCBI2NA_UNPACK_BASE(seq2[(seq2_index + rem) / 4],
-                                     3 - (seq2_index + rem) % 4)) {
-                ++seq1_index;
-                ++seq2_index;
-            }
+            Int4 run = BlastNaExactMatchLength(seq1 + seq1_index, seq2,
+                                               seq2_index + rem,
+                                               MIN(len1 - seq1_index,
+                                                   len2 - seq2_index));
+            seq1_index += run;
+            seq2_index += run;
         }
     }
 
@@ -380,6 +412,332 @@ static Int4 s_FindFirstMismatch(const Uint1 *seq1, const Uint1 *seq2,
 }
 
 
+/** Quantities that stay fixed while the traceback table of one greedy
+    extension is computed, needed to compute any row of the table */
+typedef struct SGreedyAlignInfo {
+    const Uint1* seq1;      /**< First sequence (always uncompressed) */
+    const Uint1* seq2;      /**< Second sequence */
+    Int4 len1;              /**< Length of seq1 */
+    Int4 len2;              /**< Length of seq2 */
+    Boolean reverse;        /**< Whether the extension is backwards */
+    Uint1 rem;              /**< Offset within a byte of seq2[0], or 4 if
+                                 seq2 is uncompressed */
+    Boolean* fence_hit;     /**< Set if a sentinel is found in seq2 */
+    Int4 diag_origin;       /**< Diagonal of the initial run of matches */
+    Int4* max_score;        /**< Best score for each distance */
+    Int4 xdrop_offset;      /**< How far back in max_score to look */
+    Int4 xdrop_threshold;   /**< X-dropoff value */
+    Int4 match_cost;        /**< Match score */
+    Int4 mismatch_cost;     /**< Mismatch penalty */
+    Int4 score_common_factor; /**< Score of one unit of distance (affine) */
+    Int4 op_cost;           /**< Distance of a mismatch (affine) */
+    Int4 gap_open_extend;   /**< Distance of opening a gap (affine) */
+    Int4 gap_extend;        /**< Distance of extending a gap (affine) */
+    Int4 max_penalty;       /**< Largest of the above distances (affine) */
+    Int4* diag_lower;       /**< Lowest diagonal for each distance (affine) */
+    Int4* diag_upper;       /**< Highest diagonal for each distance (affine) */
+} SGreedyAlignInfo;
+
+/** Make room for one more checkpoint in the greedy alignment memory
+    @param aux_data Structure containing the checkpoints [in][out]
+    @param num_cells Number of SGreedyOffset structures to reserve
+                     for saved rows [in]
+    @return The new checkpoint, or NULL if memory ran out
+*/
+static SGreedyState*
+s_GreedyCheckpointNew(SGreedyAlignMem* aux_data, Int4 num_cells)
+{
+    SGreedyState* state;
+
+    if (aux_data->num_checkpoints == aux_data->checkpoints_allocated) {
+        Int4 new_alloc = MAX(8, 2 * aux_data->checkpoints_allocated);
+        SGreedyState* new_checkpoints = (SGreedyState*)realloc(
+                                      aux_data->checkpoints,
+                                      new_alloc * sizeof(SGreedyState));
+        if (new_checkpoints == NULL)
+            return NULL;
+        memset(new_checkpoints + aux_data->checkpoints_allocated, 0,
+               (new_alloc - aux_data->checkpoints_allocated) * 
+               sizeof(SGreedyState));
+        aux_data->checkpoints = new_checkpoints;
+        aux_data->checkpoints_allocated = new_alloc;
+    }
+
+    state = aux_data->checkpoints + aux_data->num_checkpoints;
+    num_cells = MAX(num_cells, 1);
+    if (state->rows_allocated < num_cells) {
+        SGreedyOffset* new_rows = (SGreedyOffset*)realloc(state->rows,
+                                         num_cells * sizeof(SGreedyOffset));
+        if (new_rows == NULL)
+            return NULL;
+        state->rows = new_rows;
+        state->rows_allocated = num_cells;
+    }
+    aux_data->num_checkpoints++;
+    return state;
+}
+
+/** Copy the row of a non-affine traceback table saved at a checkpoint
+    back into the memory pool
+    @param aux_data Structure containing the memory pool [in][out]
+    @param last_seq2_off The traceback table [in][out]
+    @param checkpoint The checkpoint to restore [in]
+    @param tback_cells Number of structures in use in the pool [in][out]
+*/
+static void
+s_GreedyRestoreRow(SGreedyAlignMem* aux_data, Int4** last_seq2_off,
+                   const SGreedyState* checkpoint, Int4* tback_cells)
+{
+    /* the next distance reads the row at the diagonals it examines
+       and one diagonal on either side */
+    Int4 row_lower = checkpoint->diag_lower - 1;
+    Int4 row_len = checkpoint->diag_upper - checkpoint->diag_lower + 3;
+    Int4 num_cells = (row_len + 2) / 3;
+    Int4* row = (Int4*) s_GetMBSpace(aux_data->space, num_cells);
+
+    memcpy(row, checkpoint->rows, row_len * sizeof(Int4));
+    last_seq2_off[checkpoint->dist] = row - row_lower;
+    *tback_cells += num_cells;
+}
+
+/** Allocate the row of a non-affine traceback table for distance d+1.
+    If the rows in the memory pool would then exceed 
+    GREEDY_MAX_TBACK_CELLS structures, first save the row for distance d
+    in a checkpoint and discard all rows in the pool
+    @param aux_data Structure containing the memory pool [in][out]
+    @param last_seq2_off The traceback table [in][out]
+    @param d The last distance computed [in]
+    @param state Bounds on diagonals to examine for distance d+1 [in]
+    @param tback_cells Number of structures in use in the pool [in][out]
+    @param save_checkpoint If FALSE, rows are never discarded [in]
+*/
+static void
+s_GreedyNewRow(SGreedyAlignMem* aux_data, Int4** last_seq2_off, Int4 d,
+               const SGreedyState* state, Int4* tback_cells,
+               Boolean save_checkpoint)
+{
+    /* The allocator provides SGreedyOffset structures which are 3 times
+       larger than Int4, so divide requested amount by 3 */
+    Int4 num_cells = (state->diag_upper - state->diag_lower + 7) / 3;
+
+    if (save_checkpoint && *tback_cells > 0 && 
+        *tback_cells + num_cells > GREEDY_MAX_TBACK_CELLS) {
+        Int4 row_len = state->diag_upper - state->diag_lower + 3;
+        SGreedyState* checkpoint = s_GreedyCheckpointNew(aux_data,
+                                                         (row_len + 2) / 3);
+
+        /* if no checkpoint can be saved, keep every row */
+        if (checkpoint != NULL) {
+            checkpoint->dist = d;
+            checkpoint->diag_lower = state->diag_lower;
+            checkpoint->diag_upper = state->diag_upper;
+            checkpoint->end1_diag = state->end1_diag;
+            checkpoint->end2_diag = state->end2_diag;
+            checkpoint->num_nonempty_dist = 0;
+            memcpy(checkpoint->rows, 
+                   last_seq2_off[d] + state->diag_lower - 1,
+                   row_len * sizeof(Int4));
+
+            s_RefreshMBSpace(aux_data->space);
+            *tback_cells = 0;
+            s_GreedyRestoreRow(aux_data, last_seq2_off, checkpoint, 
+                               tback_cells);
+        }
+    }
+
+    /* move the origin for this row backwards */
+    last_seq2_off[d + 1] = (Int4*) s_GetMBSpace(aux_data->space, num_cells);
+    last_seq2_off[d + 1] = last_seq2_off[d + 1] - state->diag_lower + 2;
+    *tback_cells += num_cells;
+}
+
+/** Compute the row of a non-affine traceback table for one distance
+    @param info The sequences and parameters of the alignment [in]
+    @param last_seq2_off The traceback table [in][out]
+    @param d The distance to compute [in]
+    @param state On input, bounds on diagonals to examine. On output,
+                 the bounds narrowed to the diagonals that achieve
+                 distance d [in][out]
+    @param seed Longest run of exact matches, updated if a longer one 
+                is found. Not used if NULL [in][out]
+    @param curr_seq2_index Offset into seq2 of the alignment with 
+                           distance d that covers the most of both 
+                           sequences [out]
+    @param curr_diag Diagonal of that alignment [out]
+    @return Sum of the seq1 and seq2 extents of that alignment
+*/
+static Int4
+s_GreedyAlignDist(const SGreedyAlignInfo* info, Int4** last_seq2_off, 
+                  Int4 d, SGreedyState* state, SGreedySeed* seed,
+                  Int4* curr_seq2_index, Int4* curr_diag)
+{
+    Int4 seq1_index;
+    Int4 seq2_index;
+    Int4 index;
+    Int4 k;
+    Int4 xdrop_score;
+    Int4 curr_extent = 0;
+    Int4 diag_origin = info->diag_origin;
+    Int4 tmp_diag_lower = state->diag_lower;
+    Int4 tmp_diag_upper = state->diag_upper;
+
+    *curr_seq2_index = 0;
+    *curr_diag = 0;
+
+    /* assign impossible seq2 offsets to any diagonals that
+       are not in the range (diag_lower,diag_upper).
+       These will serve as sentinel values for the
+       inner loop */
+
+    last_seq2_off[d - 1][state->diag_lower-1] = kInvalidOffset;
+    last_seq2_off[d - 1][state->diag_lower] = kInvalidOffset;
+    last_seq2_off[d - 1][state->diag_upper] = kInvalidOffset;
+    last_seq2_off[d - 1][state->diag_upper+1] = kInvalidOffset;
+
+    /* compute the score for distance d that corresponds to
+       the X-dropoff criterion */
+
+    xdrop_score = info->max_score[d - info->xdrop_offset] + 
+                  (info->match_cost + info->mismatch_cost) * d - 
+                  info->xdrop_threshold;
+    xdrop_score = (Int4)ceil((double)xdrop_score / (info->match_cost / 2)); 
+
+    /* for each diagonal of interest */
+
+    for (k = tmp_diag_lower; k <= tmp_diag_upper; k++) {
+
+        /* find the largest offset into seq2 that increases
+           the distance from d-1 to d (i.e. keeps the alignment
+           from getting worse for as long as possible), then 
+           choose the offset into seq1 that will keep the
+           resulting diagonal fixed at k 
+         
+           Note that this requires kInvalidOffset+1 to be smaller
+           than any valid offset into seq2, i.e. to be negative */
+
+        seq2_index = MAX(last_seq2_off[d - 1][k + 1], 
+                         last_seq2_off[d - 1][k    ]) + 1;
+        seq2_index = MAX(seq2_index, last_seq2_off[d - 1][k - 1]);
+        seq1_index = seq2_index + k - diag_origin;
+
+        if (seq2_index < 0 || seq1_index + seq2_index < xdrop_score) {
+
+            /* if no valid diagonal can reach distance d, or the 
+               X-dropoff test fails, narrow the range of diagonals
+               to test and skip to the next diagonal */
+
+            if (k == state->diag_lower)
+                state->diag_lower++;
+            else
+                last_seq2_off[d][k] = kInvalidOffset;
+            continue;
+        }
+        state->diag_upper = k;
+        
+        /* slide down diagonal k until a mismatch 
+           occurs. As long as only matches are encountered,
+           the current distance d will not change */
+
+        index = s_FindFirstMismatch(info->seq1, info->seq2, 
+                                    info->len1, info->len2, 
+                                    seq1_index, seq2_index,
+                                    info->fence_hit, info->reverse, 
+                                    info->rem);
+
+        if (seed != NULL && index > seed->match_length) {
+            seed->start_q = seq1_index;
+            seed->start_s = seq2_index;
+            seed->match_length = index;
+        }
+        seq1_index += index;
+        seq2_index += index;
+
+        /* set the new largest seq2 offset that achieves
+           distance d on diagonal k */
+
+        last_seq2_off[d][k] = seq2_index;
+
+        /* since all values of k are constrained to have the
+           same distance d, the value of k which maximizes the
+           alignment score is the one that covers the most
+           of seq1 and seq2 */
+
+        if (seq1_index + seq2_index > curr_extent) {
+            curr_extent = seq1_index + seq2_index;
+            *curr_seq2_index = seq2_index;
+            *curr_diag = k;
+        }
+
+        /* clamp the bounds on diagonals to avoid walking off
+           either sequence. Because the bounds increase by at
+           most one for each distance, diag_lower and diag_upper
+           can each be of size at most max_diags+2 */
+
+        if (seq2_index == info->len2) {
+            state->diag_lower = k + 1; 
+            state->end2_diag = TRUE;
+        }
+        if (seq1_index == info->len1) {
+            state->diag_upper = k - 1; 
+            state->end1_diag = TRUE;
+        }
+    }   /* end loop over diagonals */
+
+    return curr_extent;
+}
+
+/** Recompute the rows of a non-affine traceback table that were 
+    discarded, from the checkpoint before a given one up to the
+    distance of the given checkpoint
+    @param info The sequences and parameters of the alignment [in]
+    @param aux_data Structure containing the memory pool and
+                    the checkpoints [in][out]
+    @param last_seq2_off The traceback table [in][out]
+    @param segment Index of the checkpoint that ends the rows 
+                   to recompute [in]
+*/
+static void
+s_GreedyRecomputeRows(const SGreedyAlignInfo* info, 
+                      SGreedyAlignMem* aux_data, Int4** last_seq2_off,
+                      Int4 segment)
+{
+    SGreedyState state;
+    Int4 d, first_d;
+    Int4 last_d = aux_data->checkpoints[segment].dist;
+    Int4 tback_cells = 0;
+    Int4 curr_seq2_index, curr_diag;
+
+    s_RefreshMBSpace(aux_data->space);
+
+    if (segment == 0) {
+        /* start over from distance zero; the first two rows
+           are preallocated and never discarded */
+        state.dist = 0;
+        state.diag_lower = info->diag_origin - 1;
+        state.diag_upper = info->diag_origin + 1;
+        state.end1_diag = state.end2_diag = FALSE;
+    }
+    else {
+        state = aux_data->checkpoints[segment - 1];
+        s_GreedyRestoreRow(aux_data, last_seq2_off, &state, &tback_cells);
+        s_GreedyNewRow(aux_data, last_seq2_off, state.dist, &state,
+                       &tback_cells, FALSE);
+    }
+
+    first_d = state.dist + 1;
+    for (d = first_d; d <= last_d; d++) {
+        s_GreedyAlignDist(info, last_seq2_off, d, &state, NULL, 
+                          &curr_seq2_index, &curr_diag);
+        if (!state.end2_diag)
+            state.diag_lower--; 
+        if (!state.end1_diag)
+            state.diag_upper++;
+        if (d < last_d)
+            s_GreedyNewRow(aux_data, last_seq2_off, d, &state,
+                           &tback_cells, FALSE);
+    }
+}
+
 /** see greedy_align.h for description */
 Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
                        const Uint1* seq2, Int4 len2,
@@ -394,8 +752,6 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
     Int4 seq2_index;
     Int4 index;
     Int4 d;
-    Int4 k;
-    Int4 diag_lower, diag_upper;
     Int4 max_dist;
     Int4 diag_origin;
     Int4 best_dist;
@@ -403,8 +759,10 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
     Int4** last_seq2_off;
     Int4* max_score;
     Int4 xdrop_offset;
-    Int4 longest_match_run;
-    Boolean end1_reached, end2_reached;
+    SGreedyState dist_state;
+    SGreedyAlignInfo info;
+    Int4 tback_cells;
+    Int4 segment;
     SMBSpace* mem_pool;
  
     /* ordinary dynamic programming alignment, for each offset
@@ -470,7 +828,7 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
 
     seed->start_q = 0;
     seed->start_s = 0;
-    seed->match_length = longest_match_run = index;
+    seed->match_length = index;
 
     if (index == len1 || index == len2) {
         /* Return the number of differences, which is zero here */
@@ -492,6 +850,8 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
     else { 
         s_RefreshMBSpace(mem_pool);
     }
+    aux_data->num_checkpoints = 0;
+    tback_cells = 0;
     
     /* set up the array of per-distance maximum scores. There
        are max_diags + xdrop_offset distances to track, the first
@@ -500,121 +860,41 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
     max_score = aux_data->max_score + xdrop_offset;
     for (index = 0; index < xdrop_offset; index++)
         aux_data->max_score[index] = 0;
+
+    info.seq1 = seq1;
+    info.seq2 = seq2;
+    info.len1 = len1;
+    info.len2 = len2;
+    info.reverse = reverse;
+    info.rem = rem;
+    info.fence_hit = fence_hit;
+    info.diag_origin = diag_origin;
+    info.max_score = max_score;
+    info.xdrop_offset = xdrop_offset;
+    info.xdrop_threshold = xdrop_threshold;
+    info.match_cost = match_cost;
+    info.mismatch_cost = mismatch_cost;
     
     /* fill in the initial offsets of the distance matrix */
 
     last_seq2_off[0][diag_origin] = seq1_index;
     max_score[0] = seq1_index * match_cost;
-    diag_lower = diag_origin - 1;
-    diag_upper = diag_origin + 1;
-    end1_reached = end2_reached = FALSE;
+    dist_state.dist = 0;
+    dist_state.diag_lower = diag_origin - 1;
+    dist_state.diag_upper = diag_origin + 1;
+    dist_state.end1_diag = dist_state.end2_diag = FALSE;
 
     /* for each distance */
 
     for (d = 1; d <= max_dist; d++) {
-        Int4 xdrop_score;
         Int4 curr_score;
-        Int4 curr_extent = 0;
-        Int4 curr_seq2_index = 0;
-        Int4 curr_diag = 0;
-        Int4 tmp_diag_lower = diag_lower;
-        Int4 tmp_diag_upper = diag_upper;
-
-        /* assign impossible seq2 offsets to any diagonals that
-           are not in the range (diag_lower,diag_upper).
-           These will serve as sentinel values for the
-           inner loop */
-
-        last_seq2_off[d - 1][diag_lower-1] = kInvalidOffset;
-        last_seq2_off[d - 1][diag_lower] = kInvalidOffset;
-        last_seq2_off[d - 1][diag_upper] = kInvalidOffset;
-        last_seq2_off[d - 1][diag_upper+1] = kInvalidOffset;
-
-        /* compute the score for distance d that corresponds to
-           the X-dropoff criterion */
-
-        xdrop_score = max_score[d - xdrop_offset] + 
-                      (match_cost + mismatch_cost) * d - xdrop_threshold;
-        xdrop_score = (Int4)ceil((double)xdrop_score / (match_cost / 2)); 
-
-        /* for each diagonal of interest */
-
-        for (k = tmp_diag_lower; k <= tmp_diag_upper; k++) {
-
-            /* find the largest offset into seq2 that increases
-               the distance from d-1 to d (i.e. keeps the alignment
-               from getting worse for as long as possible), then 
-               choose the offset into seq1 that will keep the
-               resulting diagonal fixed at k 
-             
-               Note that this requires kInvalidOffset+1 to be smaller
-               than any valid offset into seq2, i.e. to be negative */
-
-            seq2_index = MAX(last_seq2_off[d - 1][k + 1], 
-                             last_seq2_off[d - 1][k    ]) + 1;
-            seq2_index = MAX(seq2_index, last_seq2_off[d - 1][k - 1]);
-            seq1_index = seq2_index + k - diag_origin;
-
-            if (seq2_index < 0 || seq1_index + seq2_index < xdrop_score) {
-
-                /* if no valid diagonal can reach distance d, or the 
-                   X-dropoff test fails, narrow the range of diagonals
-                   to test and skip to the next diagonal */
-
-                if (k == diag_lower)
-                    diag_lower++;
-                else
-                    last_seq2_off[d][k] = kInvalidOffset;
-                continue;
-            }
-            diag_upper = k;
-            
-            /* slide down diagonal k until a mismatch 
-               occurs. As long as only matches are encountered,
-               the current distance d will not change */
-
-            index = s_FindFirstMismatch(seq1, seq2, len1, len2, 
-                                        seq1_index, seq2_index,
-                                        fence_hit, reverse, rem);
-
-            if (index > longest_match_run) {
-                seed->start_q = seq1_index;
-                seed->start_s = seq2_index;
-                seed->match_length = longest_match_run = index;
-            }
-            seq1_index += index;
-            seq2_index += index;
-
-            /* set the new largest seq2 offset that achieves
-               distance d on diagonal k */
+        Int4 curr_extent;
+        Int4 curr_seq2_index;
+        Int4 curr_diag;
 
-            last_seq2_off[d][k] = seq2_index;
-
-            /* since all values of k are constrained to have the
-               same distance d, the value of k which maximizes the
-               alignment score is the one that covers the most
-               of seq1 and seq2 */
-
-            if (seq1_index + seq2_index > curr_extent) {
-                curr_extent = seq1_index + seq2_index;
-                curr_seq2_index = seq2_index;
-                curr_diag = k;
-            }
-
-            /* clamp the bounds on diagonals to avoid walking off
-               either sequence. Because the bounds increase by at
-               most one for each distance, diag_lower and diag_upper
-               can each be of size at most max_diags+2 */
-
-            if (seq2_index == len2) {
-                diag_lower = k + 1; 
-                end2_reached = TRUE;
-            }
-            if (seq1_index == len1) {
-                diag_upper = k - 1; 
-                end1_reached = TRUE;
-            }
-        }   /* end loop over diagonals */
+        curr_extent = s_GreedyAlignDist(&info, last_seq2_off, d, 
+                                        &dist_state, seed, 
+                                        &curr_seq2_index, &curr_diag);
 
         /* compute the maximum score possible for distance d */
 
@@ -638,7 +918,7 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
         /* alignment has finished if the lower and upper bounds
            on diagonals to check have converged to each other */
 
-        if (diag_lower > diag_upper)
+        if (dist_state.diag_lower > dist_state.diag_upper)
             break;
 
         /* set up for the next distance to examine. Because the 
@@ -646,10 +926,10 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
            diag_lower and diag_upper can each be of size at 
            most max_diags+2 */
 
-        if (!end2_reached)
-            diag_lower--; 
-        if (!end1_reached)
-            diag_upper++;
+        if (!dist_state.end2_diag)
+            dist_state.diag_lower--; 
+        if (!dist_state.end1_diag)
+            dist_state.diag_upper++;
 
         /* if no traceback is specified, the next row of
            last_seq2_off can reuse previously allocated memory */
@@ -664,18 +944,11 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
         else {
 
             /* traceback requires all rows of last_seq2_off to be saved,
-               so a new row must be allocated. The allocator provides 
-               SThreeVal structures which are 3 times larger than Int4, 
-               so divide requested amount by 3 */
-
-            /** @todo FIXME Should make allocator more general */
-
-            last_seq2_off[d + 1] = (Int4*) s_GetMBSpace(mem_pool, 
-                                     (diag_upper - diag_lower + 7) / 3);
+               so a new row must be allocated; if too many rows are
+               saved, a checkpoint replaces the older ones */
 
-            /* move the origin for this row backwards */
-
-            last_seq2_off[d + 1] = last_seq2_off[d + 1] - diag_lower + 2;
+            s_GreedyNewRow(aux_data, last_seq2_off, d, &dist_state,
+                           &tback_cells, TRUE);
         }
     }   /* end loop over distinct distances */
 
@@ -688,6 +961,7 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
     d = best_dist; 
     seq1_index = *seq1_align_len;
     seq2_index = *seq2_align_len; 
+    segment = aux_data->num_checkpoints;
 
     /* for all positive distances */
     
@@ -698,6 +972,16 @@ Int4 BLAST_GreedyAlign(const Uint1* seq1, Int4 len1,
         Int4 new_diag;
         Int4 new_seq2_index;
 
+        /* the rows of the table below the last checkpoint still 
+           in use were discarded; compute them again */
+
+        if (segment > 0 && d <= aux_data->checkpoints[segment - 1].dist) {
+            while (segment > 0 && 
+                   d <= aux_data->checkpoints[segment - 1].dist)
+                segment--;
+            s_GreedyRecomputeRows(&info, aux_data, last_seq2_off, segment);
+        }
+
         /* retrieve the value of the diagonal after the next
            traceback operation. best_diag starts off with the
            value computed during the alignment process */
@@ -750,6 +1034,395 @@ done:
     return best_dist;
 }
 
+
+/** Copy the rows of an affine traceback table saved at a checkpoint
+    back into the memory pool
+    @param info The sequences and parameters of the alignment [in]
+    @param aux_data Structure containing the memory pool [in][out]
+    @param last_seq2_off The traceback table [in][out]
+    @param checkpoint The checkpoint to restore [in]
+    @param tback_cells Number of structures in use in the pool [in][out]
+*/
+static void
+s_AffineGreedyRestoreRows(const SGreedyAlignInfo* info,
+                          SGreedyAlignMem* aux_data, 
+                          SGreedyOffset** last_seq2_off,
+                          const SGreedyState* checkpoint, 
+                          Int4* tback_cells)
+{
+    SGreedyOffset* saved = checkpoint->rows;
+    Int4 d;
+
+    /* later distances read the previous max_penalty rows, and only
+       within the final bounds on diagonals for each row. Rows in the
+       preallocated arrays are never discarded */
+
+    for (d = MAX(checkpoint->dist + 1 - info->max_penalty, 
+                 info->max_penalty + 1); d <= checkpoint->dist; d++) {
+        Int4 num_cells = info->diag_upper[d] - info->diag_lower[d] + 1;
+        SGreedyOffset* row;
+
+        if (num_cells <= 0)
+            continue;
+        row = s_GetMBSpace(aux_data->space, num_cells);
+        memcpy(row, saved, num_cells * sizeof(SGreedyOffset));
+        last_seq2_off[d] = row - info->diag_lower[d];
+        saved += num_cells;
+        *tback_cells += num_cells;
+    }
+}
+
+/** Allocate the row of an affine traceback table for distance d.
+    If the rows in the memory pool would then exceed 
+    GREEDY_MAX_TBACK_CELLS structures, first save the rows that
+    later distances need in a checkpoint and discard all rows in the pool
+    @param info The sequences and parameters of the alignment [in]
+    @param aux_data Structure containing the memory pool [in][out]
+    @param last_seq2_off The traceback table [in][out]
+    @param d The distance to compute next [in]
+    @param state Bounds on diagonals to examine for distance d [in]
+    @param tback_cells Number of structures in use in the pool [in][out]
+    @param save_checkpoint If FALSE, rows are never discarded [in]
+*/
+static void
+s_AffineGreedyNewRow(const SGreedyAlignInfo* info, 
+                     SGreedyAlignMem* aux_data, 
+                     SGreedyOffset** last_seq2_off, Int4 d,
+                     const SGreedyState* state, Int4* tback_cells,
+                     Boolean save_checkpoint)
+{
+    Int4 num_cells = state->diag_upper - state->diag_lower + 1;
+
+    if (save_checkpoint && *tback_cells > 0 && 
+        *tback_cells + num_cells > GREEDY_MAX_TBACK_CELLS) {
+        Int4 first_row = MAX(d - info->max_penalty, info->max_penalty + 1);
+        Int4 saved_cells = 0;
+        Int4 i;
+        SGreedyState* checkpoint;
+
+        for (i = first_row; i < d; i++)
+            saved_cells += MAX(info->diag_upper[i] - info->diag_lower[i] + 1,
+                               0);
+        checkpoint = s_GreedyCheckpointNew(aux_data, saved_cells);
+
+        /* if no checkpoint can be saved, keep every row */
+        if (checkpoint != NULL) {
+            SGreedyOffset* saved = checkpoint->rows;
+
+            checkpoint->dist = d - 1;
+            checkpoint->diag_lower = state->diag_lower;
+            checkpoint->diag_upper = state->diag_upper;
+            checkpoint->end1_diag = state->end1_diag;
+            checkpoint->end2_diag = state->end2_diag;
+            checkpoint->num_nonempty_dist = state->num_nonempty_dist;
+            for (i = first_row; i < d; i++) {
+                Int4 row_cells = info->diag_upper[i] - 
+                                 info->diag_lower[i] + 1;
+                if (row_cells > 0) {
+                    memcpy(saved, last_seq2_off[i] + info->diag_lower[i],
+                           row_cells * sizeof(SGreedyOffset));
+                    saved += row_cells;
+                }
+            }
+
+            s_RefreshMBSpace(aux_data->space);
+            *tback_cells = 0;
+            s_AffineGreedyRestoreRows(info, aux_data, last_seq2_off,
+                                      checkpoint, tback_cells);
+        }
+    }
+
+    last_seq2_off[d] = s_GetMBSpace(aux_data->space, num_cells) - 
+                       state->diag_lower;
+    if (num_cells > 0)
+        *tback_cells += num_cells;
+}
+
+/** Compute the row of an affine traceback table for one distance
+    @param info The sequences and parameters of the alignment [in]
+    @param last_seq2_off The traceback table [in][out]
+    @param d The distance to compute [in]
+    @param state On input, bounds on diagonals to examine. On output,
+                 the bounds narrowed to the diagonals that achieve
+                 distance d [in][out]
+    @param seed Longest run of exact matches, updated if a longer one 
+                is found. Not used if NULL [in][out]
+    @param curr_seq2_index Offset into seq2 of the alignment with 
+                           distance d that covers the most of both 
+                           sequences [out]
+    @param curr_diag Diagonal of that alignment [out]
+    @return Sum of the seq1 and seq2 extents of that alignment
+*/
+static Int4
+s_AffineGreedyAlignDist(const SGreedyAlignInfo* info, 
+                        SGreedyOffset** last_seq2_off, Int4 d, 
+                        SGreedyState* state, SGreedySeed* seed,
+                        Int4* curr_seq2_index, Int4* curr_diag)
+{
+    Int4 seq1_index;
+    Int4 seq2_index;
+    Int4 index;
+    Int4 k;
+    Int4 xdrop_score;
+    Int4 curr_extent = 0;
+    Int4 diag_origin = info->diag_origin;
+    Int4 op_cost = info->op_cost;
+    Int4 gap_open_extend = info->gap_open_extend;
+    Int4 gap_extend = info->gap_extend;
+    const Int4* diag_lower = info->diag_lower;
+    const Int4* diag_upper = info->diag_upper;
+    Int4 tmp_diag_lower = state->diag_lower;
+    Int4 tmp_diag_upper = state->diag_upper;
+
+    *curr_seq2_index = 0;
+    *curr_diag = 0;
+
+    /* compute the score for distance d that corresponds to
+       the X-dropoff criterion */
+
+    xdrop_score = info->max_score[d - info->xdrop_offset] + 
+                  info->score_common_factor * d - info->xdrop_threshold;
+    xdrop_score = (Int4)ceil((double)xdrop_score / (info->match_cost / 2));
+    if (xdrop_score < 0) 
+        xdrop_score = 0;
+
+    /* for each valid diagonal */
+
+    for (k = tmp_diag_lower; k <= tmp_diag_upper; k++) {
+
+        /* As with the non-affine algorithm, the object is
+           to find the largest offset into seq2 that can
+           achieve distance d from diagonal k. Here, however,
+           contributions are possible from distances < d-1 */
+
+        /* begin by assuming the best offset comes from opening
+           a gap in seq1. Since opening a gap costs gap_open_extend,
+           use the offset associated with a match from that
+           far back in the table. Do not use diagonal k+1 if
+           it was not valid back then */
+
+        seq2_index = kInvalidOffset;
+        if (k + 1 <= diag_upper[d - gap_open_extend] && 
+            k + 1 >= diag_lower[d - gap_open_extend]) {
+            seq2_index = last_seq2_off[d - gap_open_extend][k+1].match_off;
+        }
+
+        /* Replace with the offset derived from extending a gap
+           in seq1, if that is larger */
+
+        if (k + 1 <= diag_upper[d - gap_extend] && 
+            k + 1 >= diag_lower[d - gap_extend] &&
+            seq2_index < last_seq2_off[d - gap_extend][k+1].delete_off) {
+            seq2_index = last_seq2_off[d - gap_extend][k+1].delete_off;
+        }
+
+        /* save the index; if it was valid, a deletion 
+           (= gap in seq1) means seq2 offset slips by one */
+
+        if (seq2_index == kInvalidOffset)
+            last_seq2_off[d][k].delete_off = kInvalidOffset;
+        else
+            last_seq2_off[d][k].delete_off = seq2_index + 1;
+
+        /* repeat the process assuming a gap is opened or
+           extended in seq2. Gaps in seq2 do not change seq2_index */
+
+        seq2_index = kInvalidOffset;
+        if (k - 1 <= diag_upper[d - gap_open_extend] && 
+            k - 1 >= diag_lower[d - gap_open_extend]) {
+            seq2_index = last_seq2_off[d - gap_open_extend][k-1].match_off;
+        }
+        if (k - 1 <= diag_upper[d - gap_extend] && 
+            k - 1 >= diag_lower[d - gap_extend] &&
+            seq2_index < last_seq2_off[d - gap_extend][k-1].insert_off) {
+            seq2_index = last_seq2_off[d - gap_extend][k-1].insert_off;
+        }
+        last_seq2_off[d][k].insert_off = seq2_index;
+        
+        /* Compare the greater of the two previous answers with
+           the offset associated with a match on diagonal k. */
+
+        seq2_index = MAX(last_seq2_off[d][k].insert_off, 
+                         last_seq2_off[d][k].delete_off);
+        if (k <= diag_upper[d - op_cost] && 
+            k >= diag_lower[d - op_cost]) {
+            seq2_index = MAX(seq2_index, 
+                             last_seq2_off[d - op_cost][k].match_off + 1);
+        }
+        
+        /* choose the offset into seq1 so as to remain on diagonal k */
+
+        seq1_index = seq2_index + k - diag_origin;
+
+        /* perform the X-dropoff test; if it fails, or no
+           previous cell can contribute to the current one,
+           give up and try the next diagonal, adjusting the
+           bounds on diagonals for distance d */
+
+        if (seq2_index < 0 || seq1_index + seq2_index < xdrop_score) {
+            if (k == state->diag_lower)
+                state->diag_lower++;
+            else
+                last_seq2_off[d][k].match_off = kInvalidOffset;
+            continue;
+        }
+        state->diag_upper = k;
+
+        /* slide down diagonal k until a mismatch 
+           occurs. As long as only matches are encountered,
+           the current distance d will not change */
+
+        index = s_FindFirstMismatch(info->seq1, info->seq2, 
+                                    info->len1, info->len2, 
+                                    seq1_index, seq2_index,
+                                    info->fence_hit, info->reverse, 
+                                    info->rem);
+
+        if (seed != NULL && index > seed->match_length) {
+            seed->start_q = seq1_index;
+            seed->start_s = seq2_index;
+            seed->match_length = index;
+        }
+        seq1_index += index;
+        seq2_index += index;
+
+        /* since all values of k are constrained to have the
+           same distance d, the value of k which maximizes the
+           alignment score is the one that covers the most
+           of seq1 and seq2 */
+
+        last_seq2_off[d][k].match_off = seq2_index;
+        if (seq1_index + seq2_index > curr_extent) {
+            curr_extent = seq1_index + seq2_index;
+            *curr_seq2_index = seq2_index;
+            *curr_diag = k;
+        }
+
+        /* clamp the bounds on diagonals to avoid walking off
+           either sequence */
+
+        if (seq1_index == info->len1) {
+            state->diag_upper = k; 
+            state->end1_diag = k - 1;
+        }
+        if (seq2_index == info->len2) {
+            state->diag_lower = k; 
+            state->end2_diag = k + 1;
+        }
+    }  /* end loop over diagonals */
+
+    return curr_extent;
+}
+
+/** Save the bounds on diagonals for distance d of an affine greedy
+    alignment, and compute the bounds to examine for distance d+1
+    @param info The sequences and parameters of the alignment [in]
+    @param d The distance just computed [in]
+    @param state On input, the bounds on diagonals that achieve
+                 distance d. On output, bounds on diagonals to
+                 examine for distance d+1 [in][out]
+*/
+static void
+s_AffineGreedyNextDist(SGreedyAlignInfo* info, Int4 d, SGreedyState* state)
+{
+    const Int4 kInvalidDiag = 100000000; /* larger than any valid diag. */
+    Int4* diag_lower = info->diag_lower;
+    Int4* diag_upper = info->diag_upper;
+
+    /* save the bounds on diagonals to examine for distance d.
+       Note that in the non-affine case the alignment could stop
+       if these bounds converged to each other. Here, however,
+       it's possible for distances less than d to continue the
+       alignment even if no diagonals are available at distance d.
+       Hence we can only stop if max_penalty consecutive ranges
+       of diagonals are empty */
+
+    if (state->diag_lower <= state->diag_upper) {
+        state->num_nonempty_dist++;
+        diag_lower[d] = state->diag_lower; 
+        diag_upper[d] = state->diag_upper;
+    } 
+    else {
+        diag_lower[d] = kInvalidDiag; 
+        diag_upper[d] = -kInvalidDiag;
+    }
+
+    if (diag_lower[d - info->max_penalty] <= diag_upper[d - info->max_penalty]) 
+        state->num_nonempty_dist--;
+
+    /* compute the range of diagonals to test for the next
+       value of d. These must be conservative, in that any
+       diagonal that could possibly contribute must be allowed.
+       The bounds can each be of size at most scaled_max_diags+2; 
+       they can also represent an empty range, in which case the 
+       next value of d will never improve the best score */
+
+    d++;
+    state->diag_lower = MIN(diag_lower[d - info->gap_open_extend], 
+                            diag_lower[d - info->gap_extend]) - 1;
+    state->diag_lower = MIN(state->diag_lower, diag_lower[d - info->op_cost]);
+
+    if (state->end2_diag > 0) 
+        state->diag_lower = MAX(state->diag_lower, state->end2_diag);
+
+    state->diag_upper = MAX(diag_upper[d - info->gap_open_extend], 
+                            diag_upper[d - info->gap_extend]) + 1;
+    state->diag_upper = MAX(state->diag_upper,
+                            diag_upper[d - info->op_cost]);
+
+    if (state->end1_diag > 0) 
+        state->diag_upper = MIN(state->diag_upper, state->end1_diag);
+}
+
+/** Recompute the rows of an affine traceback table that were 
+    discarded, from the checkpoint before a given one up to the
+    distance of the given checkpoint
+    @param info The sequences and parameters of the alignment [in]
+    @param aux_data Structure containing the memory pool and
+                    the checkpoints [in][out]
+    @param last_seq2_off The traceback table [in][out]
+    @param segment Index of the checkpoint that ends the rows 
+                   to recompute [in]
+*/
+static void
+s_AffineGreedyRecomputeRows(SGreedyAlignInfo* info, 
+                            SGreedyAlignMem* aux_data, 
+                            SGreedyOffset** last_seq2_off, Int4 segment)
+{
+    SGreedyState state;
+    Int4 d, first_d;
+    Int4 last_d = aux_data->checkpoints[segment].dist;
+    Int4 tback_cells = 0;
+    Int4 curr_seq2_index, curr_diag;
+
+    s_RefreshMBSpace(aux_data->space);
+
+    if (segment == 0) {
+        /* start over from distance zero; the first max_penalty+1
+           rows are preallocated and never discarded */
+        state.dist = 0;
+        state.diag_lower = info->diag_origin - 1;
+        state.diag_upper = info->diag_origin + 1;
+        state.end1_diag = state.end2_diag = 0;
+        state.num_nonempty_dist = 1;
+    }
+    else {
+        state = aux_data->checkpoints[segment - 1];
+        s_AffineGreedyRestoreRows(info, aux_data, last_seq2_off, &state,
+                                  &tback_cells);
+    }
+
+    first_d = state.dist + 1;
+    for (d = first_d; d <= last_d; d++) {
+        if (d > info->max_penalty)
+            s_AffineGreedyNewRow(info, aux_data, last_seq2_off, d, &state,
+                                 &tback_cells, FALSE);
+        s_AffineGreedyAlignDist(info, last_seq2_off, d, &state, NULL, 
+                                &curr_seq2_index, &curr_diag);
+        s_AffineGreedyNextDist(info, d, &state);
+    }
+}
+
 /** See greedy_align.h for description */
 Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1, 
                               const Uint1* seq2, Int4 len2,
@@ -765,17 +1438,14 @@ Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1,
     Int4 seq2_index;
     Int4 index;
     Int4 d;
-    Int4 k;
     Int4 max_dist;
     Int4 scaled_max_dist;
     Int4 diag_origin;
     Int4 best_dist;
     Int4 best_diag;
-    Int4 longest_match_run;
     SGreedyOffset** last_seq2_off;
     Int4* max_score;
     Int4 xdrop_offset;
-    Int4 end1_diag, end2_diag;
     SMBSpace* mem_pool;
 
     Int4 op_cost;
@@ -788,10 +1458,11 @@ Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1,
 
     Int4 *diag_lower; 
     Int4 *diag_upper;
-    Int4 curr_diag_lower; 
-    Int4 curr_diag_upper;
 
-    Int4 num_nonempty_dist;
+    SGreedyState dist_state;
+    SGreedyAlignInfo info;
+    Int4 tback_cells;
+    Int4 segment;
     const Int4 kInvalidDiag = 100000000; /* larger than any valid diag. index */
  
     /* make sure bits of match_score don't disappear if it
@@ -885,7 +1556,7 @@ Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1,
 
     seed->start_q = 0;
     seed->start_s = 0;
-    seed->match_length = longest_match_run = index;
+    seed->match_length = index;
 
     if (index == len1 || index == len2) {
         /* return the score of the run of matches */
@@ -906,6 +1577,8 @@ Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1,
     else { 
         s_RefreshMBSpace(mem_pool);
     }
+    aux_data->num_checkpoints = 0;
+    tback_cells = 0;
 
     /* set up the array of per-distance maximum scores. There
        are scaled_max_dist + xdrop_offset distances to track, 
@@ -936,6 +1609,27 @@ Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1,
     }
     diag_lower += max_penalty;
     diag_upper += max_penalty; 
+
+    info.seq1 = seq1;
+    info.seq2 = seq2;
+    info.len1 = len1;
+    info.len2 = len2;
+    info.reverse = reverse;
+    info.rem = rem;
+    info.fence_hit = fence_hit;
+    info.diag_origin = diag_origin;
+    info.max_score = max_score;
+    info.xdrop_offset = xdrop_offset;
+    info.xdrop_threshold = xdrop_threshold;
+    info.match_cost = match_score;
+    info.mismatch_cost = mismatch_score;
+    info.score_common_factor = score_common_factor;
+    info.op_cost = op_cost;
+    info.gap_open_extend = gap_open_extend;
+    info.gap_extend = gap_extend;
+    info.max_penalty = max_penalty;
+    info.diag_lower = diag_lower;
+    info.diag_upper = diag_upper;
     
     /* fill in the statistics for distance zero, i.e. the initial
        run of exact matches */
@@ -949,155 +1643,25 @@ Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1,
 
     /* set up for distance 1 */
 
-    curr_diag_lower = diag_origin - 1;
-    curr_diag_upper = diag_origin + 1;
-    end1_diag = 0;
-    end2_diag = 0;
-    num_nonempty_dist = 1;
+    dist_state.dist = 0;
+    dist_state.diag_lower = diag_origin - 1;
+    dist_state.diag_upper = diag_origin + 1;
+    dist_state.end1_diag = 0;
+    dist_state.end2_diag = 0;
+    dist_state.num_nonempty_dist = 1;
     d = 1;
 
     /* for each distance */
 
     while (d <= scaled_max_dist) {
-        Int4 xdrop_score;
         Int4 curr_score;
-        Int4 curr_extent = 0;
-        Int4 curr_seq2_index = 0;
-        Int4 curr_diag = 0;
-        Int4 tmp_diag_lower = curr_diag_lower;
-        Int4 tmp_diag_upper = curr_diag_upper;
-
-        /* compute the score for distance d that corresponds to
-           the X-dropoff criterion */
-
-        xdrop_score = max_score[d - xdrop_offset] + 
-                      score_common_factor * d - xdrop_threshold;
-        xdrop_score = (Int4)ceil((double)xdrop_score / match_score_half);
-        if (xdrop_score < 0) 
-            xdrop_score = 0;
-
-        /* for each valid diagonal */
-
-        for (k = tmp_diag_lower; k <= tmp_diag_upper; k++) {
-
-            /* As with the non-affine algorithm, the object is
-               to find the largest offset into seq2 that can
-               achieve distance d from diagonal k. Here, however,
-               contributions are possible from distances < d-1 */
-
-            /* begin by assuming the best offset comes from opening
-               a gap in seq1. Since opening a gap costs gap_open_extend,
-               use the offset associated with a match from that
-               far back in the table. Do not use diagonal k+1 if
-               it was not valid back then */
-
-            seq2_index = kInvalidOffset;
-            if (k + 1 <= diag_upper[d - gap_open_extend] && 
-                k + 1 >= diag_lower[d - gap_open_extend]) {
-                seq2_index = last_seq2_off[d - gap_open_extend][k+1].match_off;
-            }
-
-            /* Replace with the offset derived from extending a gap
-               in seq1, if that is larger */
-
-            if (k + 1 <= diag_upper[d - gap_extend] && 
-                k + 1 >= diag_lower[d - gap_extend] &&
-                seq2_index < last_seq2_off[d - gap_extend][k+1].delete_off) {
-                seq2_index = last_seq2_off[d - gap_extend][k+1].delete_off;
-            }
-
-            /* save the index; if it was valid, a deletion 
-               (= gap in seq1) means seq2 offset slips by one */
-
-            if (seq2_index == kInvalidOffset)
-                last_seq2_off[d][k].delete_off = kInvalidOffset;
-            else
-                last_seq2_off[d][k].delete_off = seq2_index + 1;
-
-            /* repeat the process assuming a gap is opened or
-               extended in seq2. Gaps in seq2 do not change seq2_index */
-
-            seq2_index = kInvalidOffset;
-            if (k - 1 <= diag_upper[d - gap_open_extend] && 
-                k - 1 >= diag_lower[d - gap_open_extend]) {
-                seq2_index = last_seq2_off[d - gap_open_extend][k-1].match_off;
-            }
-            if (k - 1 <= diag_upper[d - gap_extend] && 
-                k - 1 >= diag_lower[d - gap_extend] &&
-                seq2_index < last_seq2_off[d - gap_extend][k-1].insert_off) {
-                seq2_index = last_seq2_off[d - gap_extend][k-1].insert_off;
-            }
-            last_seq2_off[d][k].insert_off = seq2_index;
-            
-            /* Compare the greater of the two previous answers with
-               the offset associated with a match on diagonal k. */
-
-            seq2_index = MAX(last_seq2_off[d][k].insert_off, 
-                             last_seq2_off[d][k].delete_off);
-            if (k <= diag_upper[d - op_cost] && 
-                k >= diag_lower[d - op_cost]) {
-                seq2_index = MAX(seq2_index, 
-                                 last_seq2_off[d - op_cost][k].match_off + 1);
-            }
-            
-            /* choose the offset into seq1 so as to remain on diagonal k */
-
-            seq1_index = seq2_index + k - diag_origin;
+        Int4 curr_extent;
+        Int4 curr_seq2_index;
+        Int4 curr_diag;
 
-            /* perform the X-dropoff test; if it fails, or no
-               previous cell can contribute to the current one,
-               give up and try the next diagonal, adjusting the
-               bounds on diagonals for distance d */
-
-            if (seq2_index < 0 || seq1_index + seq2_index < xdrop_score) {
-                if (k == curr_diag_lower)
-                    curr_diag_lower++;
-                else
-                    last_seq2_off[d][k].match_off = kInvalidOffset;
-                continue;
-            }
-            curr_diag_upper = k;
-
-            /* slide down diagonal k until a mismatch 
-               occurs. As long as only matches are encountered,
-               the current distance d will not change */
-
-            index = s_FindFirstMismatch(seq1, seq2, len1, len2, 
-                                        seq1_index, seq2_index,
-                                        fence_hit, reverse, rem);
-
-            if (index > longest_match_run) {
-                seed->start_q = seq1_index;
-                seed->start_s = seq2_index;
-                seed->match_length = longest_match_run = index;
-            }
-            seq1_index += index;
-            seq2_index += index;
-
-            /* since all values of k are constrained to have the
-               same distance d, the value of k which maximizes the
-               alignment score is the one that covers the most
-               of seq1 and seq2 */
-
-            last_seq2_off[d][k].match_off = seq2_index;
-            if (seq1_index + seq2_index > curr_extent) {
-                curr_extent = seq1_index + seq2_index;
-                curr_seq2_index = seq2_index;
-                curr_diag = k;
-            }
-
-            /* clamp the bounds on diagonals to avoid walking off
-               either sequence */
-
-            if (seq1_index == len1) {
-                curr_diag_upper = k; 
-                end1_diag = k - 1;
-            }
-            if (seq2_index == len2) {
-                curr_diag_lower = k; 
-                end2_diag = k + 1;
-            }
-        }  /* end loop over diagonals */
+        curr_extent = s_AffineGreedyAlignDist(&info, last_seq2_off, d, 
+                                              &dist_state, seed, 
+                                              &curr_seq2_index, &curr_diag);
 
         /* compute the maximum score possible for distance d */
 
@@ -1117,53 +1681,14 @@ Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1,
             max_score[d] = max_score[d - 1];
         }
 
-        /* save the bounds on diagonals to examine for distance d.
-           Note that in the non-affine case the alignment could stop
-           if these bounds converged to each other. Here, however,
-           it's possible for distances less than d to continue the
-           alignment even if no diagonals are available at distance d.
-           Hence we can only stop if max_penalty consecutive ranges
-           of diagonals are empty */
-
-        if (curr_diag_lower <= curr_diag_upper) {
-            num_nonempty_dist++;
-            diag_lower[d] = curr_diag_lower; 
-            diag_upper[d] = curr_diag_upper;
-        } 
-        else {
-            diag_lower[d] = kInvalidDiag; 
-            diag_upper[d] = -kInvalidDiag;
-        }
-
-        if (diag_lower[d - max_penalty] <= diag_upper[d - max_penalty]) 
-            num_nonempty_dist--;
+        /* save the bounds on diagonals for distance d and set up
+           the bounds for the next distance. The alignment stops 
+           when max_penalty consecutive ranges are empty */
 
-        if (num_nonempty_dist == 0) 
+        s_AffineGreedyNextDist(&info, d, &dist_state);
+        if (dist_state.num_nonempty_dist == 0) 
             break;
-        
-        /* compute the range of diagonals to test for the next
-           value of d. These must be conservative, in that any
-           diagonal that could possibly contribute must be allowed.
-           curr_diag_lower and curr_diag_upper can each be of size at 
-           most scaled_max_diags+2; they can also represent an 
-           empty range, in which case the next value of d will never
-           improve the best score */
-
         d++;
-        curr_diag_lower = MIN(diag_lower[d - gap_open_extend], 
-                              diag_lower[d - gap_extend]) - 1;
-        curr_diag_lower = MIN(curr_diag_lower, diag_lower[d - op_cost]);
-
-        if (end2_diag > 0) 
-            curr_diag_lower = MAX(curr_diag_lower, end2_diag);
-
-        curr_diag_upper = MAX(diag_upper[d - gap_open_extend], 
-                              diag_upper[d - gap_extend]) + 1;
-        curr_diag_upper = MAX(curr_diag_upper,
-                              diag_upper[d - op_cost]);
-
-        if (end1_diag > 0) 
-            curr_diag_upper = MIN(curr_diag_upper, end1_diag);
 
         if (d > max_penalty) {
             if (edit_block == NULL) {
@@ -1176,11 +1701,11 @@ Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1,
             else {
 
                 /* traceback requires all rows of last_seq2_off to be saved,
-                   so a new row must be allocated */
+                   so a new row must be allocated; if too many rows are
+                   saved, a checkpoint replaces the older ones */
 
-                last_seq2_off[d] = s_GetMBSpace(mem_pool, 
-                                   curr_diag_upper - curr_diag_lower + 1) - 
-                                   curr_diag_lower;
+                s_AffineGreedyNewRow(&info, aux_data, last_seq2_off, d,
+                                     &dist_state, &tback_cells, TRUE);
             }
         }
     }  /* end loop over distances */
@@ -1193,8 +1718,22 @@ Int4 BLAST_AffineGreedyAlign (const Uint1* seq1, Int4 len1,
         d = best_dist; 
         seq2_index = *seq2_align_len; 
         state = eGapAlignSub;
+        segment = aux_data->num_checkpoints;
 
         while (d > 0) {
+
+            /* the rows of the table below the last checkpoint still 
+               in use were discarded; compute them again */
+
+            if (segment > 0 && 
+                d <= aux_data->checkpoints[segment - 1].dist) {
+                while (segment > 0 && 
+                       d <= aux_data->checkpoints[segment - 1].dist)
+                    segment--;
+                s_AffineGreedyRecomputeRows(&info, aux_data, last_seq2_off,
+                                            segment);
+            }
+
             if (state == eGapAlignSub) {
                 /* substitution */
                 Int4 new_seq2_index;
@@ -49,6 +49,14 @@ extern "C" {
 /** The largest distance to be examined for an optimal alignment */
 #define GREEDY_MAX_COST 1000
 
+/** The largest number of SGreedyOffset structures that may hold rows
+    of the traceback table at one time. Longer alignments save the
+    state of the table at checkpoints, discard older rows, and later
+    recompute the traceback in chunks between checkpoints */
+#ifndef GREEDY_MAX_TBACK_CELLS
+#define GREEDY_MAX_TBACK_CELLS 1000000
+#endif
+
 /* ----- pool allocator ----- */
 
 /** Bookkeeping structure for greedy alignment. When aligning
@@ -85,6 +93,23 @@ SMBSpace* MBSpaceNew(int num_space_arrays);
 NCBI_XBLAST_EXPORT
 void MBSpaceFree(SMBSpace* sp);
 
+/** State of a greedy alignment after all rows of the traceback table
+    up to some distance have been computed. Enough is saved to
+    recompute the rows for larger distances */
+typedef struct SGreedyState {
+    Int4 dist;              /**< last distance whose row is complete */
+    Int4 diag_lower;        /**< lowest diagonal to examine next */
+    Int4 diag_upper;        /**< highest diagonal to examine next */
+    Int4 end1_diag;         /**< bound on diagonals from reaching the end
+                                 of the first sequence (for non-affine
+                                 alignments, nonzero if it was reached) */
+    Int4 end2_diag;         /**< same for the end of the second sequence */
+    Int4 num_nonempty_dist; /**< number of recent distances with a nonempty
+                                 range of diagonals (affine only) */
+    SGreedyOffset* rows;    /**< copies of the rows needed to continue */
+    Int4 rows_allocated;    /**< number of structures allocated in rows */
+} SGreedyState;
+
 /** All auxiliary memory needed for the greedy extension algorithm. */
 typedef struct SGreedyAlignMem {
    Int4** last_seq2_off;              /**< 2-D array of distances */
@@ -94,6 +119,10 @@ typedef struct SGreedyAlignMem {
    Int4* diag_bounds;                 /**< bounds on ranges of diagonals */
    SMBSpace* space;                   /**< local memory pool for 
                                            SGreedyOffset structs */
+   SGreedyState* checkpoints;         /**< states saved when rows of the
+                                           traceback were discarded */
+   Int4 num_checkpoints;              /**< number of checkpoints in use */
+   Int4 checkpoints_allocated;        /**< number of checkpoints allocated */
 } SGreedyAlignMem;
 
 /** Structure for locating high-scoring seeds for greedy alignment */
@@ -96,6 +96,8 @@ typedef struct LinkHSPStruct {
    Int4 q_end_trim;        /**< End of trimmed HSP in query */
    Int4 s_offset_trim;     /**< Start of trimmed hsp in subject */
    Int4 s_end_trim;        /**< End of trimmed HSP in subject */
+   Int4 helper_index;      /**< Position of this HSP in the array of helper
+                              structures */
 } LinkHSPStruct;
 
 /** The helper array contains the info used frequently in the inner 
@@ -107,12 +109,39 @@ typedef struct LinkHelpStruct {
   Int4 q_off_trim;            /**< query start of trimmed HSP */
   Int4 s_off_trim;            /**< subject start of trimmed HSP */
   Int4 sum[eOrderingMethods]; /**< raw score of linked set containing HSP(?) */
-  Int4 maxsum1;               /**< threshold for stopping link attempts (?) */
-  Int4 next_larger;           /**< offset into array of HelpStructs containing
-                                   HSP with higher score, used in bailout
-                                   calculations */
+  Int4 s_rank;                /**< position of the HSP in order of increasing
+                                   s_off_trim */
 } LinkHelpStruct;
 
+/** Binary indexed tree used to find, among the HSPs already processed in a
+ * linking pass, the one with the highest sum whose trimmed subject offset 
+ * exceeds a given value. Positions in the tree are ranks of s_off_trim in
+ * decreasing order, starting at 1. Ties in the sum are resolved in favor of
+ * the HSP with the larger index into the array of helper structures.
+ */
+typedef struct LinkSumTree {
+  Int4 size;                  /**< number of positions in the tree */
+  Int4* sum;                  /**< best sum for each node */
+  Int4* helper_index;         /**< helper array index of the HSP with that
+                                   sum, 0 if there is none */
+} LinkSumTree;
+
+/** Segment tree keeping track of the HSP with the highest sum among those 
+ * remaining in the list being linked, so that the best HSP can be found 
+ * without walking the list after each linked set is removed. Leaves
+ * correspond to indices into the array of helper structures, starting at 2;
+ * ties in the sum are resolved in favor of the larger index, i.e. of the HSP
+ * further down the list. Node 1 is the root.
+ */
+typedef struct LinkMaxTree {
+  Int4 num_leaves;            /**< number of leaves, a power of 2 */
+  Int4 num_used;              /**< number of leaves filled by the last call to
+                                   s_LinkMaxTreeRebuild */
+  Int4* sum;                  /**< best sum for each node */
+  Int4* helper_index;         /**< helper array index of the HSP with that
+                                   sum, 0 if there is none */
+} LinkMaxTree;
+
 /** Callback used by qsort to sort a list of HSPs, encapsulated in
  *  LinkHSPStruct structures, in order of increasing query start offset.
  *  The subject start offset of HSPs is used as a tiebreaker, and no HSPs
@@ -406,6 +435,222 @@ s_LinkHSPStructReset(LinkHSPStruct* lhsp)
    return lhsp;
 }
 
+/** Callback used by qsort to sort a list of HSPs, encapsulated in
+ *  LinkHSPStruct structures, in order of increasing trimmed subject start
+ *  offset. No HSPs may be NULL.
+ *  @param v1 first HSP in list [in]
+ *  @param v2 second HSP in list [in]
+ *  @return -1, 0, or 1 depending on HSPs
+*/
+static int
+s_FwdCompareHSPsSubjectTrim(const void* v1, const void* v2)
+{
+   const LinkHSPStruct* h1 = *((LinkHSPStruct**) v1);
+   const LinkHSPStruct* h2 = *((LinkHSPStruct**) v2);
+
+   if (h1->s_offset_trim < h2->s_offset_trim)
+      return -1;
+   if (h1->s_offset_trim > h2->s_offset_trim)
+      return 1;
+   return 0;
+}
+
+/** Find the first HSP in an array of helper structures, sorted in order of
+ * decreasing query offset, whose query offset is <= a specified value. 
+ * Entries 0 and 1 of the helper array are end markers and are not searched.
+ * @param lh_helper Array of helper structures [in]
+ * @param size Number of elements of the array to search [in]
+ * @param offset The target offset to search for [in]
+ * @return The smallest index >= 2 of an HSP whose query offset is <= 
+ *         'offset', or 'size' if there is no such HSP
+ */
+static Int4
+s_LinkHelperOffsetBinarySearch(const LinkHelpStruct* lh_helper, Int4 size,
+                               Int4 offset)
+{
+   Int4 index, begin, end;
+
+   begin = 2;
+   end = MAX(size, begin);
+   while (begin < end) {
+      index = (begin + end) / 2;
+
+      if (lh_helper[index].ptr->hsp->query.offset <= offset)
+          end = index;
+      else
+          begin = index + 1;
+   }
+
+   return end;
+}
+
+/** Find the first HSP, in order of increasing trimmed subject offset, whose
+ * trimmed subject offset is greater than a specified value.
+ * @param lh_helper Array of helper structures [in]
+ * @param s_order Indices into lh_helper, sorted by s_off_trim [in]
+ * @param size Number of elements in s_order [in]
+ * @param offset The target offset to search for [in]
+ * @return The smallest index into s_order of an HSP whose trimmed subject 
+ *         offset is > 'offset', or 'size' if there is no such HSP
+ */
+static Int4
+s_LinkHelperSubjectBinarySearch(const LinkHelpStruct* lh_helper, 
+                                const Int4* s_order, Int4 size, Int4 offset)
+{
+   Int4 index, begin, end;
+
+   begin = 0;
+   end = size;
+   while (begin < end) {
+      index = (begin + end) / 2;
+
+      if (lh_helper[s_order[index]].s_off_trim > offset)
+          end = index;
+      else
+          begin = index + 1;
+   }
+
+   return end;
+}
+
+/** Empty a LinkSumTree and set the number of positions in use
+ * @param tree The tree [in/modified]
+ * @param size Number of positions; must not exceed the allocated size [in]
+ */
+static void
+s_LinkSumTreeReset(LinkSumTree* tree, Int4 size)
+{
+   tree->size = size;
+   memset(tree->sum, 0, (size + 1) * sizeof(Int4));
+   memset(tree->helper_index, 0, (size + 1) * sizeof(Int4));
+}
+
+/** Add an HSP to a LinkSumTree
+ * @param tree The tree [in/modified]
+ * @param position Position of the HSP in the tree, starting at 1 [in]
+ * @param sum Sum of the HSP [in]
+ * @param helper_index Index of the HSP into the array of helper structures [in]
+ */
+static void
+s_LinkSumTreeInsert(LinkSumTree* tree, Int4 position, Int4 sum, 
+                    Int4 helper_index)
+{
+   for ( ; position <= tree->size; position += position & -position) {
+      if (sum > tree->sum[position] || 
+          (sum == tree->sum[position] && 
+           helper_index > tree->helper_index[position])) {
+         tree->sum[position] = sum;
+         tree->helper_index[position] = helper_index;
+      }
+   }
+}
+
+/** Find the HSP with the best sum among positions 1 to 'position' of a 
+ * LinkSumTree
+ * @param tree The tree [in]
+ * @param position Last position to examine [in]
+ * @param sum Best sum found, 0 if none [out]
+ * @param helper_index Index of the HSP with that sum, 0 if none [out]
+ */
+static void
+s_LinkSumTreeQuery(const LinkSumTree* tree, Int4 position, Int4* sum, 
+                   Int4* helper_index)
+{
+   *sum = 0;
+   *helper_index = 0;
+   for ( ; position > 0; position -= position & -position) {
+      if (tree->sum[position] > *sum ||
+          (tree->sum[position] == *sum && 
+           tree->helper_index[position] > *helper_index)) {
+         *sum = tree->sum[position];
+         *helper_index = tree->helper_index[position];
+      }
+   }
+}
+
+/** Allocate the node arrays of a LinkMaxTree
+ * @param tree The tree [in/modified]
+ * @param size Maximum number of leaves [in]
+ */
+static void
+s_LinkMaxTreeInit(LinkMaxTree* tree, Int4 size)
+{
+   tree->num_leaves = 1;
+   while (tree->num_leaves < size)
+      tree->num_leaves *= 2;
+   tree->num_used = 0;
+   tree->sum = (Int4*) malloc(2 * tree->num_leaves * sizeof(Int4));
+   tree->helper_index = (Int4*) calloc(2 * tree->num_leaves, sizeof(Int4));
+   for (size = 0; size < 2 * tree->num_leaves; size++)
+      tree->sum[size] = INT4_MIN;
+}
+
+/** Recompute a node of a LinkMaxTree from its children
+ * @param tree The tree [in/modified]
+ * @param node The node [in]
+ */
+static NCBI_INLINE void
+s_LinkMaxTreeUpdateNode(LinkMaxTree* tree, Int4 node)
+{
+   Int4 left = 2 * node;
+   Int4 right = left + 1;
+   Int4 best = (tree->sum[right] >= tree->sum[left] ? right : left);
+
+   tree->sum[node] = tree->sum[best];
+   tree->helper_index[node] = tree->helper_index[best];
+}
+
+/** Fill a LinkMaxTree with the sums of the HSPs in an array of helper 
+ * structures
+ * @param tree The tree [in/modified]
+ * @param lh_helper Array of helper structures; the HSPs are at positions 2
+ *                  to num_hsps+1 [in]
+ * @param num_hsps Number of HSPs [in]
+ * @param index Ordering method whose sums are used [in]
+ */
+static void
+s_LinkMaxTreeRebuild(LinkMaxTree* tree, const LinkHelpStruct* lh_helper,
+                     Int4 num_hsps, ELinkOrderingMethod index)
+{
+   Int4 i;
+   Int4 begin = tree->num_leaves;
+   Int4 end = begin + MAX(num_hsps, tree->num_used);
+
+   ASSERT(num_hsps <= tree->num_leaves);
+   for (i = 0; i < num_hsps; i++) {
+      tree->sum[begin + i] = lh_helper[i + 2].ptr->hsp_link.sum[index];
+      tree->helper_index[begin + i] = i + 2;
+   }
+   for ( ; i < tree->num_used; i++) {
+      tree->sum[begin + i] = INT4_MIN;
+      tree->helper_index[begin + i] = 0;
+   }
+   tree->num_used = num_hsps;
+
+   while (begin > 1) {
+      begin /= 2;
+      end = (end + 1) / 2;
+      for (i = begin; i < end; i++)
+         s_LinkMaxTreeUpdateNode(tree, i);
+   }
+}
+
+/** Change the sum of an HSP in a LinkMaxTree
+ * @param tree The tree [in/modified]
+ * @param helper_index Index of the HSP into the array of helper structures [in]
+ * @param sum New sum of the HSP, INT4_MIN to remove it from the tree [in]
+ */
+static void
+s_LinkMaxTreeUpdate(LinkMaxTree* tree, Int4 helper_index, Int4 sum)
+{
+   Int4 node = tree->num_leaves + helper_index - 2;
+
+   tree->sum[node] = sum;
+   tree->helper_index[node] = (sum == INT4_MIN ? 0 : helper_index);
+   for (node /= 2; node > 0; node /= 2)
+      s_LinkMaxTreeUpdateNode(tree, node);
+}
+
 /** Perform even gap linking on a list of HSPs 
  * @param program_number The blast program that generated the HSPs [in]
  * @param hsp_list List of HSPs to link [in/modified]
@@ -445,6 +690,21 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
  	Int4 first_pass, use_current_max; 
 	LinkHelpStruct *lh_helper=0;
    Int4 lh_helper_size;
+   Int4 scratch_size;     /* size of the index arrays below */
+   LinkHSPStruct** s_sorted_hsps; /* HSPs of the current frame, sorted by 
+                                     s_offset_trim */
+   Int4 num_s_sorted;
+   Int4* s_order;         /* helper array indices sorted by s_off_trim */
+   Int4 num_s_order;
+   Int4* query_head;      /* for each helper array index k, the HSPs whose
+                             large gap links are looked up when the pass
+                             reaches k */
+   Int4* query_next;      /* next HSP in the same list of query_head */
+   Int4* query_sum;       /* best sum found for those HSPs */
+   Int4* query_index;     /* and the helper array index where it was found */
+   LinkSumTree sum_tree;
+   LinkMaxTree max_tree[eOrderingMethods]; /* best sums of the remaining
+                                              HSPs */
 	Int4 query_context; /* AM: to support query concatenation. */
    const Boolean kTranslatedQuery = Blast_QueryIsTranslated(program_number);
    LinkHSPStruct** link_hsp_array;
@@ -458,6 +718,21 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
    lh_helper = (LinkHelpStruct *) 
       calloc(lh_helper_size, sizeof(LinkHelpStruct));
 
+   /* The index arrays only address the HSPs at positions 2 to hspcnt+1
+      of lh_helper, so they are sized to the HSP list rather than to 
+      lh_helper */
+   scratch_size = hsp_list->hspcnt + 5;
+   s_order = (Int4*) calloc(scratch_size, sizeof(Int4));
+   query_head = (Int4*) calloc(scratch_size, sizeof(Int4));
+   query_next = (Int4*) calloc(scratch_size, sizeof(Int4));
+   query_sum = (Int4*) calloc(scratch_size, sizeof(Int4));
+   query_index = (Int4*) calloc(scratch_size, sizeof(Int4));
+   sum_tree.sum = (Int4*) calloc(scratch_size + 1, sizeof(Int4));
+   sum_tree.helper_index = (Int4*) calloc(scratch_size + 1, sizeof(Int4));
+   sum_tree.size = 0;
+   s_LinkMaxTreeInit(&max_tree[eLinkSmallGaps], scratch_size);
+   s_LinkMaxTreeInit(&max_tree[eLinkLargeGaps], scratch_size);
+
 	if (gapped_calculation) 
 		kbp = sbp->kbp_gap;
 	else
@@ -480,6 +755,8 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
 
    link_hsp_array = 
       (LinkHSPStruct**) malloc(total_number_of_hsps*sizeof(LinkHSPStruct*));
+   s_sorted_hsps = 
+      (LinkHSPStruct**) malloc(total_number_of_hsps*sizeof(LinkHSPStruct*));
    for (index = 0; index < total_number_of_hsps; ++index) {
       link_hsp_array[index] = (LinkHSPStruct*) calloc(1, sizeof(LinkHSPStruct));
       link_hsp_array[index]->hsp = hsp_array[index];
@@ -578,8 +855,6 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
       lh_helper[0].ptr = hp_start;
       lh_helper[0].q_off_trim = 0;
       lh_helper[0].s_off_trim = 0;
-      lh_helper[0].maxsum1  = -10000;
-      lh_helper[0].next_larger  = 0;
       
       /* lh_helper[0]  = empty     = additional end marker
        * lh_helper[1]  = hsp_start = empty entry used in original code
@@ -588,13 +863,16 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
        */
       first_pass=1;    /* do full search */
       path_changed=1;
-      for (H=hp_start->next; H!=NULL; H=H->next) 
+      for (H=hp_start->next, i=0; H!=NULL; H=H->next, i++) {
          H->hsp_link.changed=1;
+         s_sorted_hsps[i] = H;
+      }
+      num_s_sorted = i;
+      qsort(s_sorted_hsps, num_s_sorted, sizeof(LinkHSPStruct*),
+            s_FwdCompareHSPsSubjectTrim);
 
       while (number_of_hsps > 0)
       {
-         Int4 max[3];
-         max[0]=max[1]=max[2]=-10000;
          /* Initialize the 'best' parameter */
          best[0] = best[1] = NULL;
          
@@ -607,34 +885,13 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
           */
          use_current_max=0;
          if (!first_pass){
-            Int4 max0,max1;
-            /* Find the current max sums */
-            if(!ignore_small_gaps){
-               max0 = -cutoff[0];
-               max1 = -cutoff[1];
-               for (H=hp_start->next; H!=NULL; H=H->next) {
-                  Int4 sum0=H->hsp_link.sum[0];
-                  Int4 sum1=H->hsp_link.sum[1];
-                  if(sum0>=max0)
-                  {
-                     max0=sum0;
-                     best[0]=H;
-                  }
-                  if(sum1>=max1)
-                  {
-                     max1=sum1;
-                     best[1]=H;
-                  }
-               }
-            } else {
-               maxscore = -cutoff[1];
-               for (H=hp_start->next; H!=NULL; H=H->next) {
-                  Int4  sum=H->hsp_link.sum[1];
-                  if(sum>=maxscore)
-                  {
-                     maxscore=sum;
-                     best[1]=H;
-                  }
+            /* Find the current max sums; the last HSP in the list with the
+               max sum is chosen */
+            for (index = (ignore_small_gaps ? 1 : 0); index < eOrderingMethods;
+                 index++) {
+               if (max_tree[index].sum[1] >= -cutoff[index]) {
+                  best[index] = 
+                     lh_helper[max_tree[index].helper_index[1]].ptr;
                }
             }
             if(path_changed==0){
@@ -663,7 +920,6 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
           */
          if(!use_current_max){
             for (H=hp_start,H_index=1; H!=NULL; H=H->next,H_index++) {
-               Int4 s_frame = H->hsp->subject.frame;
                Int4 s_off_t = H->s_offset_trim;
                Int4 q_off_t = H->q_offset_trim;
                lh_helper[H_index].ptr = H;
@@ -671,26 +927,22 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
                lh_helper[H_index].s_off_trim = s_off_t;
                for(i=0;i<eOrderingMethods;i++)
                   lh_helper[H_index].sum[i] = H->hsp_link.sum[i];
-               max[SIGN(s_frame)+1]=
-                  MAX(max[SIGN(s_frame)+1],H->hsp_link.sum[1]);
-               lh_helper[H_index].maxsum1 =max[SIGN(s_frame)+1];					   
-               
-               /* set next_larger to link back to closest entry with a sum1 
-                  larger than this */
-               {
-                  Int4 cur_sum=lh_helper[H_index].sum[1];
-                  Int4 prev = H_index-1;
-                  Int4 prev_sum = lh_helper[prev].sum[1];
-                  while((cur_sum>=prev_sum) && (prev>0)){
-                     prev=lh_helper[prev].next_larger;
-                     prev_sum = lh_helper[prev].sum[1];
-                  }
-                  lh_helper[H_index].next_larger = prev;
-               }
+               H->helper_index = H_index;
                H->linked_to = 0;
             }
-            
-            lh_helper[1].maxsum1 = -10000;
+
+            /* Drop the HSPs removed since the last pass from the subject
+               offset index and rank the remaining ones */
+            for (i = 0, num_s_order = 0; i < num_s_sorted; i++) {
+               H2 = s_sorted_hsps[i];
+               if (H2->linked_to == -1000)
+                  continue;
+               s_sorted_hsps[num_s_order] = H2;
+               s_order[num_s_order] = H2->helper_index;
+               lh_helper[H2->helper_index].s_rank = num_s_order;
+               num_s_order++;
+            }
+            num_s_sorted = num_s_order;
             
             /****** loop iter for index = 0  **************************/
             if(!ignore_small_gaps)
@@ -709,46 +961,42 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
                      Int4 H_sub_etrim = H->s_end_trim;
                      Int4 H_q_et_gap = H_query_etrim+window_size;
                      Int4 H_s_et_gap = H_sub_etrim+window_size;
+                     Int4 H_hsp_index = 0;
                      
-                     /* We only walk down hits with the same frame sign */
-                     /* for (H2=H->prev; H2!=NULL; H2=H2->prev,H2_index--) */
-                     for (H2_index=H_index-1; H2_index>1; H2_index=H2_index-1) 
+                     /* Candidates must start within the window following
+                      * the end of H in both sequences and precede H in the 
+                      * list; look them up by subject offset, which is 
+                      * usually much more selective than the query offset */
+                     for (i = s_LinkHelperSubjectBinarySearch(lh_helper, 
+                                 s_order, num_s_order, H_sub_etrim);
+                          i < num_s_order; i++) 
                      {
-                        Int4 b1,b2,b4,b5;
                         Int4 q_off_t,s_off_t,sum;
                         
-                        /* s_frame = lh_helper[H2_index].s_frame; */
-                        q_off_t = lh_helper[H2_index].q_off_trim;
+                        H2_index = s_order[i];
                         s_off_t = lh_helper[H2_index].s_off_trim;
-                        
-                        /* combine tests to reduce mispredicts -cfj */
-                        b1 = q_off_t <= H_query_etrim;
-                        b2 = s_off_t <= H_sub_etrim;
-                        sum = lh_helper[H2_index].sum[index];
-                        
-                        
-                        b4 = ( q_off_t > H_q_et_gap ) ;
-                        b5 = ( s_off_t > H_s_et_gap ) ;
-                        
-                        /* list is sorted by q_off, so q_off should only increase.
-                         * q_off_t can only differ from q_off by trim_size
-                         * So once q_off_t is large enough (ie it exceeds limit 
-                         * by trim_size), we can stop.  -cfj 
-                         */
-                        if(q_off_t > (H_q_et_gap+trim_size))
+                        if (s_off_t > H_s_et_gap)
                            break;
                         
-                        if (b1|b2|b5|b4) continue;
+                        q_off_t = lh_helper[H2_index].q_off_trim;
+                        sum = lh_helper[H2_index].sum[index];
+                        if (H2_index >= H_index || q_off_t <= H_query_etrim ||
+                            q_off_t > H_q_et_gap || sum <= 0)
+                           continue;
                         
-                        if (sum>H_hsp_sum) 
+                        /* Of two candidates with equal sums, prefer the one
+                           closer to H in the list */
+                        if (sum > H_hsp_sum || 
+                            (sum == H_hsp_sum && H2_index > H_hsp_index)) 
                         {
                            H2=lh_helper[H2_index].ptr; 
                            H_hsp_num=H2->hsp_link.num[index];
                            H_hsp_sum=H2->hsp_link.sum[index];
                            H_hsp_xsum=H2->hsp_link.xsum[index];
                            H_hsp_link=H2;
+                           H_hsp_index=H2_index;
                         }
-                     } /* end for H2... */
+                     } /* end for i... */
                   }
                   { 
                      Int4 score=H->hsp->score;
@@ -775,6 +1023,36 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
             /****** loop iter for index = 1  **************************/
             index=1;
             maxscore = -cutoff[index];
+
+            /* The HSPs H can be linked to are those that precede it in the
+             * list and whose trimmed starts are past the trimmed end of H in
+             * both sequences. Since the list is sorted by decreasing query
+             * offset, all of the HSPs before position k, the first one whose
+             * query offset is not past the trimmed query end of H, qualify
+             * in the query; the best of those that also qualify in the 
+             * subject is looked up in sum_tree as soon as the pass reaches 
+             * position k, and the few HSPs from k onwards are examined
+             * directly. First find the HSPs that need to look for a link
+             * and schedule their lookups. */
+            for (i = 2; i < number_of_hsps + 2; i++)
+               query_head[i] = 0;
+            H_index = 2;
+            for (H=hp_start->next; H!=NULL; H=H->next,H_index++) 
+            {
+               /* If the best choice last time has not been changed, then it
+                  is still the best choice */
+               H2 = H->hsp_link.link[index];
+               H->hsp_link.changed = 
+                  first_pass || (H2 != NULL && H2->hsp_link.changed != 0);
+               if (H->hsp_link.changed && H->hsp->score > cutoff[index]) {
+                  Int4 k = s_LinkHelperOffsetBinarySearch(lh_helper, H_index,
+                                                          H->q_end_trim);
+                  query_next[H_index] = query_head[k];
+                  query_head[k] = H_index;
+               }
+            }
+
+            s_LinkSumTreeReset(&sum_tree, num_s_order);
             H_index = 2;
             for (H=hp_start->next; H!=NULL; H=H->next,H_index++) 
             {
@@ -783,9 +1061,17 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
                double H_hsp_xsum=0.0;
                LinkHSPStruct* H_hsp_link=NULL;
                
-               H->hsp_link.changed=1;
+               /* sum_tree now holds the HSPs before H */
+               for (i = query_head[H_index]; i != 0; i = query_next[i]) {
+                  Int4 rank = 
+                     s_LinkHelperSubjectBinarySearch(lh_helper, s_order, 
+                        num_s_order, lh_helper[i].ptr->s_end_trim);
+                  s_LinkSumTreeQuery(&sum_tree, num_s_order - rank,
+                                     &query_sum[i], &query_index[i]);
+               }
+
                H2 = H->hsp_link.link[index];
-               if ((!first_pass) && ((H2==0) || (H2->hsp_link.changed==0)))
+               if (!H->hsp_link.changed)
                {
                   /* If the best choice last time has not been changed, then 
                      it is still the best choice, so no need to walk down list.
@@ -796,65 +1082,37 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
                      H_hsp_xsum=H2->hsp_link.xsum[index];
                   }
                   H_hsp_link=H2;
-                  H->hsp_link.changed=0;
                } else if (H->hsp->score > cutoff[index]) {
                   Int4 H_query_etrim = H->q_end_trim;
                   Int4 H_sub_etrim = H->s_end_trim;
-                  
+                  Int4 H2_end;
 
-                  /* Here we look at what was the best choice last time, if it's
-                   * still around, and set this to the initial choice. By
-                   * setting the best score to a (potentially) large value
-                   * initially, we can reduce the number of hsps checked. 
-                   */
-                  
-                  /* Currently we set the best score to a value just less than
-                   * the real value. This is not really necessary, but doing
-                   * this ensures that in the case of a tie, we make the same
-                   * selection the original code did.
-                   */
-                  
-                  if(!first_pass&&H2&&H2->linked_to>=0){
-                     if(1){
-                        /* We set this to less than the real value to keep the
-                           original ordering in case of ties. */
-                        H_hsp_sum=H2->hsp_link.sum[index]-1;
-                     }else{
-                        H_hsp_num=H2->hsp_link.num[index];
-                        H_hsp_sum=H2->hsp_link.sum[index];
-                        H_hsp_xsum=H2->hsp_link.xsum[index];
-                        H_hsp_link=H2;
-                     }
+                  if (query_sum[H_index] > 0) {
+                     H2 = lh_helper[query_index[H_index]].ptr;
+
+                     H_hsp_num=H2->hsp_link.num[index];
+                     H_hsp_sum=H2->hsp_link.sum[index];
+                     H_hsp_xsum=H2->hsp_link.xsum[index];
+                     H_hsp_link=H2;
                   }
-                  
-                  /* We now only walk down hits with the same frame sign */
-                  /* for (H2=H->prev; H2!=NULL; H2=H2->prev,H2_index--) */
-                  for (H2_index=H_index-1; H2_index>1;)
+
+                  /* Examine the HSPs from position k onwards whose trimmed
+                   * query offset, at most trim_size past their query 
+                   * offset, can still be past the trimmed query end of H. 
+                   * These are closer to H in the list than the one found
+                   * above, so they are preferred in case of a tie. */
+                  H2_end = s_LinkHelperOffsetBinarySearch(lh_helper, H_index,
+                                                 H_query_etrim - trim_size);
+                  for (H2_index = s_LinkHelperOffsetBinarySearch(lh_helper, 
+                                     H_index, H_query_etrim);
+                       H2_index < H2_end; H2_index++)
                   {
-                     Int4 b0,b1,b2;
-                     Int4 q_off_t,s_off_t,sum,next_larger;
                      LinkHelpStruct * H2_helper=&lh_helper[H2_index];
-                     sum = H2_helper->sum[index];
-                     next_larger = H2_helper->next_larger;
-                     
-                     s_off_t = H2_helper->s_off_trim;
-                     q_off_t = H2_helper->q_off_trim;
-                     
-                     b0 = sum <= H_hsp_sum;
-                     
-                     /* Compute the next H2_index */
-                     H2_index--;
-                     if(b0){	 /* If this sum is too small to beat H_hsp_sum, advance to a larger sum */
-                        H2_index=next_larger;
-                     }
-
-                     /* combine tests to reduce mispredicts -cfj */
-                     b1 = q_off_t <= H_query_etrim;
-                     b2 = s_off_t <= H_sub_etrim;
-                     
-                     if(0) if(H2_helper->maxsum1<=H_hsp_sum)break;
+                     Int4 sum = H2_helper->sum[index];
                      
-                     if (!(b0|b1|b2) )
+                     if (H2_helper->q_off_trim > H_query_etrim && 
+                         H2_helper->s_off_trim > H_sub_etrim &&
+                         sum > 0 && sum >= H_hsp_sum)
                      {
                         H2 = H2_helper->ptr;
                         
@@ -876,17 +1134,10 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
                   H->hsp_link.num[index] = H_hsp_num+1;
                   H->hsp_link.link[index] = H_hsp_link;
                   lh_helper[H_index].sum[index] = new_sum;
-                  lh_helper[H_index].maxsum1 = MAX(lh_helper[H_index-1].maxsum1, new_sum);
-                  /* Update this entry's 'next_larger' field */
-                  {
-                     Int4 cur_sum=lh_helper[H_index].sum[1];
-                     Int4 prev = H_index-1;
-                     Int4 prev_sum = lh_helper[prev].sum[1];
-                     while((cur_sum>=prev_sum) && (prev>0)){
-                        prev=lh_helper[prev].next_larger;
-                        prev_sum = lh_helper[prev].sum[1];
-                     }
-                     lh_helper[H_index].next_larger = prev;
+                  if (new_sum > 0) {
+                     s_LinkSumTreeInsert(&sum_tree, 
+                        num_s_order - lh_helper[H_index].s_rank, 
+                        new_sum, H_index);
                   }
                   
                   if (new_sum >= maxscore) 
@@ -901,6 +1152,13 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
             }
             path_changed=0;
             first_pass=0;
+
+            if (!ignore_small_gaps) {
+               s_LinkMaxTreeRebuild(&max_tree[eLinkSmallGaps], lh_helper,
+                                    number_of_hsps, eLinkSmallGaps);
+            }
+            s_LinkMaxTreeRebuild(&max_tree[eLinkLargeGaps], lh_helper,
+                                 number_of_hsps, eLinkLargeGaps);
          }
          /********************************/
          if (!ignore_small_gaps)
@@ -911,6 +1169,9 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
                comparison above. */
             best[0]->hsp_link.sum[0] +=
                (best[0]->hsp_link.num[0])*cutoff[0];
+            s_LinkMaxTreeUpdate(&max_tree[eLinkSmallGaps], 
+                                best[0]->helper_index, 
+                                best[0]->hsp_link.sum[0]);
 
             prob[0] = BLAST_SmallGapSumE(window_size,
                          best[0]->hsp_link.num[0], best[0]->hsp_link.xsum[0],
@@ -946,6 +1207,9 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
             /* We only consider the case of big gaps. */
             best[1]->hsp_link.sum[1] +=
                (best[1]->hsp_link.num[1])*cutoff[1];
+            s_LinkMaxTreeUpdate(&max_tree[eLinkLargeGaps], 
+                                best[1]->helper_index, 
+                                best[1]->hsp_link.sum[1]);
 
             prob[1] = BLAST_LargeGapSumE(
                          best[1]->hsp_link.num[1],
@@ -972,6 +1236,12 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
          {
             if (H->linked_to>1) path_changed=1;
             H->linked_to=-1000;
+            if (!ignore_small_gaps) {
+               s_LinkMaxTreeUpdate(&max_tree[eLinkSmallGaps], 
+                                   H->helper_index, INT4_MIN);
+            }
+            s_LinkMaxTreeUpdate(&max_tree[eLinkLargeGaps], H->helper_index, 
+                                INT4_MIN);
             H->hsp_link.changed=1;
             /* record whether this is part of a linked set. */
             H->linked_set = linked_set;
@@ -1090,7 +1360,19 @@ s_BlastEvenGapLinkHSPs(EBlastProgramType program_number, BlastHSPList* hsp_list,
       H = H2;
    }
    sfree(link_hsp_array);
+   sfree(s_sorted_hsps);
    sfree(lh_helper);
+   sfree(s_order);
+   sfree(query_head);
+   sfree(query_next);
+   sfree(query_sum);
+   sfree(query_index);
+   sfree(sum_tree.sum);
+   sfree(sum_tree.helper_index);
+   for (index = 0; index < eOrderingMethods; index++) {
+      sfree(max_tree[index].sum);
+      sfree(max_tree[index].helper_index);
+   }
 
    return 0;
 }
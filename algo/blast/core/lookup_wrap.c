@@ -55,6 +55,18 @@ Int2 LookupTableWrapInit(BLAST_SequenceBlk* query,
         BlastSeqLoc* lookup_segments, BlastScoreBlk* sbp, 
         LookupTableWrap** lookup_wrap_ptr, const BlastRPSInfo *rps_info,
         Blast_Message* *error_msg)
+{
+   return LookupTableWrapInit_MT(query, lookup_options, query_options,
+                                 lookup_segments, sbp, lookup_wrap_ptr,
+                                 rps_info, error_msg, 1);
+}
+
+Int2 LookupTableWrapInit_MT(BLAST_SequenceBlk* query, 
+        const LookupTableOptions* lookup_options,	
+        const QuerySetUpOptions* query_options,
+        BlastSeqLoc* lookup_segments, BlastScoreBlk* sbp, 
+        LookupTableWrap** lookup_wrap_ptr, const BlastRPSInfo *rps_info,
+        Blast_Message* *error_msg, Int4 num_threads)
 {
    Int2 status = 0;
    LookupTableWrap* lookup_wrap;
@@ -82,18 +94,26 @@ Int2 LookupTableWrapInit(BLAST_SequenceBlk* query,
        BlastAaLookupTableNew(lookup_options, (BlastAaLookupTable* *)
                              &lookup_wrap->lut);
        ((BlastAaLookupTable*)lookup_wrap->lut)->use_pssm = has_pssm;
-       BlastAaLookupIndexQuery( (BlastAaLookupTable*) lookup_wrap->lut, matrix, 
-                                 query, lookup_segments, 0);
-       /* if query length less than 64k, we can save cache by using small bone */
-       bone_type = ( query->length >= INT2_MAX*2) ? eBackbone: eSmallbone;      
+       BlastAaLookupIndexQuery_MT( (BlastAaLookupTable*) lookup_wrap->lut, 
+                                   matrix, query, lookup_segments, 0, 
+                                   num_threads);
+       /* if query length less than 64k, we can save cache by using small bone;
+          larger queries get a narrow bone if most of their cells overflow */
+       bone_type = ( query->length >= INT2_MAX*2) ? eNarrowbone: eSmallbone;      
        BlastAaLookupFinalize((BlastAaLookupTable*) lookup_wrap->lut, bone_type);
        }
       break;
 
    case eCompressedAaLookupTable:
-      BlastCompressedAaLookupTableNew(query, lookup_segments,
+      status = BlastCompressedAaLookupTableNew(query, lookup_segments,
                          (BlastCompressedAaLookupTable* *) &(lookup_wrap->lut), 
-                         lookup_options, sbp);
+                         lookup_options, sbp, num_threads);
+      if (status != 0) {
+         Blast_MessageWrite(error_msg, eBlastSevError, kBlastMessageNoContext,
+              "Compressed alphabet lookup table is too large; "
+              "use a higher threshold or fewer queries per batch");
+         status = BLASTERR_MEMORY;
+      }
       break;
 
    case eIndexedMBLookupTable:
@@ -120,23 +140,26 @@ Int2 LookupTableWrapInit(BLAST_SequenceBlk* query,
              BlastMBLookupTableNew(query, lookup_segments, 
                                (BlastMBLookupTable* *) &(lookup_wrap->lut), 
                                lookup_options, query_options,
-                               num_table_entries, lut_width);
+                               num_table_entries, lut_width, num_threads);
           }
           else if (lookup_wrap->lut_type == eSmallNaLookupTable) {
              status = BlastSmallNaLookupTableNew(query, lookup_segments,
                             (BlastSmallNaLookupTable* *) &(lookup_wrap->lut), 
-                             lookup_options, query_options, lut_width);
+                             lookup_options, query_options, lut_width,
+                             num_threads);
              if (status != 0) {
                 lookup_wrap->lut_type = eNaLookupTable;
                 status = BlastNaLookupTableNew(query, lookup_segments,
                             (BlastNaLookupTable* *) &(lookup_wrap->lut), 
-                             lookup_options, query_options, lut_width);
+                             lookup_options, query_options, lut_width,
+                             num_threads);
              }
           }
           else {
              BlastNaLookupTableNew(query, lookup_segments,
                             (BlastNaLookupTable* *) &(lookup_wrap->lut), 
-                             lookup_options, query_options, lut_width);
+                             lookup_options, query_options, lut_width,
+                             num_threads);
           }
       }
       break;
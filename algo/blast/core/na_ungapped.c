@@ -155,28 +155,23 @@ s_NuclUngappedExtendExact(BLAST_SequenceBlk * query,
                           Int4 q_off, Int4 s_off, Int4 X,
                           BlastUngappedData * ungapped_data)
 {
-    Uint1 *q;
+    Uint1 *q = query->sequence;
+    Uint1 *subject0 = subject->sequence;
     Int4 sum, score;
-    Uint1 ch;
-    Uint1 *subject0, *sf, *q_beg, *q_end, *s, *start;
-    Int2 remainder, base;
-    Int4 q_avail, s_avail;
-
-    base = 3 - (s_off % 4);
-
-    subject0 = subject->sequence;
-    q_avail = query->length - q_off;
-    s_avail = subject->length - s_off;
-
-    q = q_beg = q_end = query->sequence + q_off;
-    s = subject0 + s_off / COMPRESSION_RATIO;
-    if (q_off < s_off) {
-        start = subject0 + (s_off - q_off) / COMPRESSION_RATIO;
-        remainder = 3 - ((s_off - q_off) % COMPRESSION_RATIO);
-    } else {
-        start = subject0;
-        remainder = 3;
-    }
+    Int4 q_pos, s_pos, q_beg, q_end;
+    Int4 s_min, s_end;
+    Int4 q_avail = query->length - q_off;
+    Int4 s_avail = subject->length - s_off;
+    Int4 match = matrix[0][0];
+    Boolean skip_runs;
+
+    /* runs of exact matches can be scored in one step if every
+       match has the same positive score */
+    skip_runs = (match > 0 && matrix[1][1] == match &&
+                 matrix[2][2] == match && matrix[3][3] == match);
+
+    s_min = (q_off < s_off) ? s_off - q_off : 0;
+    s_end = (q_avail < s_avail) ? s_off + q_avail : subject->length;
 
     score = 0;
     sum = 0;
@@ -187,19 +182,38 @@ s_NuclUngappedExtendExact(BLAST_SequenceBlk * query,
    the loop.  The reason that X is guaranteed to become negative is because
    there is a sentinel at the beginning of the query sequence, so if you hit
    that you get a big negative value.
+
+   Each exact run adds the same amount to sum as scoring its bases
+   one at a time: sum only grows along the run, so the X-dropoff test
+   cannot fire inside it, and if sum becomes positive the extension
+   reaches the end of the run.
 */
 
     /* extend to the left */
-    while ((s > start) || (s == start && base < remainder)) {
-        if (base == 3) {
-            s--;
-            base = 0;
-        } else {
-            ++base;
+    q_pos = q_beg = q_off;
+    s_pos = s_off;
+    while (s_pos > s_min) {
+        if (skip_runs) {
+            Int4 run = BlastNaExactMatchLengthReverse(q + q_pos, subject0,
+                                                      s_pos, s_pos - s_min);
+            if (run > 0) {
+                q_pos -= run;
+                s_pos -= run;
+                if ((sum += run * match) > 0) {
+                    q_beg = q_pos;
+                    score += sum;
+                    sum = 0;
+                }
+                if (s_pos == s_min)
+                    break;
+            }
         }
-        ch = *s;
-        if ((sum += matrix[*--q][NCBI2NA_UNPACK_BASE(ch, base)]) > 0) {
-            q_beg = q;
+        q_pos--;
+        s_pos--;
+        if ((sum += matrix[q[q_pos]][NCBI2NA_UNPACK_BASE(
+                          subject0[s_pos / COMPRESSION_RATIO],
+                          3 - s_pos % COMPRESSION_RATIO)]) > 0) {
+            q_beg = q_pos;
             score += sum;
             sum = 0;
         } else if (sum < X) {
@@ -207,36 +221,41 @@ s_NuclUngappedExtendExact(BLAST_SequenceBlk * query,
         }
     }
 
-    ungapped_data->q_start = q_beg - query->sequence;
-    ungapped_data->s_start = s_off - (q_off - ungapped_data->q_start);
-
-    if (q_avail < s_avail) {
-        sf = subject0 + (s_off + q_avail) / COMPRESSION_RATIO;
-        remainder = 3 - ((s_off + q_avail) % COMPRESSION_RATIO);
-    } else {
-        sf = subject0 + (subject->length) / COMPRESSION_RATIO;
-        remainder = 3 - ((subject->length) % COMPRESSION_RATIO);
-    }
+    ungapped_data->q_start = q_beg;
+    ungapped_data->s_start = s_off - (q_off - q_beg);
 
     /* extend to the right */
-    q = query->sequence + q_off;
-    s = subject0 + s_off / COMPRESSION_RATIO;
+    q_pos = q_end = q_off;
+    s_pos = s_off;
     sum = 0;
-    base = 3 - (s_off % COMPRESSION_RATIO);
 
-    while (s < sf || (s == sf && base > remainder)) {
-        ch = *s;
-        if ((sum += matrix[*q++][NCBI2NA_UNPACK_BASE(ch, base)]) > 0) {
-            q_end = q;
+    while (s_pos < s_end) {
+        if (skip_runs) {
+            Int4 run = BlastNaExactMatchLength(q + q_pos, subject0,
+                                               s_pos, s_end - s_pos);
+            if (run > 0) {
+                q_pos += run;
+                s_pos += run;
+                if ((sum += run * match) > 0) {
+                    q_end = q_pos;
+                    score += sum;
+                    sum = 0;
+                }
+                if (s_pos == s_end)
+                    break;
+            }
+        }
+        if ((sum += matrix[q[q_pos]][NCBI2NA_UNPACK_BASE(
+                          subject0[s_pos / COMPRESSION_RATIO],
+                          3 - s_pos % COMPRESSION_RATIO)]) > 0) {
+            q_end = q_pos + 1;
             score += sum;
             sum = 0;
-        } else if (sum < X)
+        } else if (sum < X) {
             break;
-        if (base == 0) {
-            base = 3;
-            s++;
-        } else
-            base--;
+        }
+        q_pos++;
+        s_pos++;
     }
 
     ungapped_data->length = q_end - q_beg;
@@ -274,6 +293,7 @@ s_NuclUngappedExtend(BLAST_SequenceBlk * query,
     Int4 i, len;
     Uint1 *new_q;
     Int4 q_ext, s_ext;
+    Boolean skip_runs = (score_table[0] > 0);
 
     /* The left extension begins behind (q_ext,s_ext); this is the first
        4-base boundary after s_off. */
@@ -294,6 +314,19 @@ s_NuclUngappedExtend(BLAST_SequenceBlk * query,
         Uint1 s_byte = s[-1];
         Uint1 q_byte = (q[-4] << 6) | (q[-3] << 4) | (q[-2] << 2) | q[-1];
 
+        if (q_byte == s_byte && skip_runs) {
+            /* score all but the last of a run of matching bytes at once */
+            Int4 run = BlastNaExactMatchLengthReverse(q, s_start,
+                                   (s - s_start) * COMPRESSION_RATIO,
+                                   (len - i) * COMPRESSION_RATIO) / 
+                                   COMPRESSION_RATIO;
+            if (run > 1) {
+                s -= run - 1;
+                q -= COMPRESSION_RATIO * (run - 1);
+                i += run - 1;
+                sum += (run - 1) * score_table[0];
+            }
+        }
         sum += score_table[q_byte ^ s_byte];
         if (sum > 0) {
             new_q = q - 4;
@@ -324,6 +357,18 @@ s_NuclUngappedExtend(BLAST_SequenceBlk * query,
         Uint1 s_byte = s[0];
         Uint1 q_byte = (q[0] << 6) | (q[1] << 4) | (q[2] << 2) | q[3];
 
+        if (q_byte == s_byte && skip_runs) {
+            Int4 run = BlastNaExactMatchLength(q, s_start,
+                                   (s - s_start) * COMPRESSION_RATIO,
+                                   (len - i) * COMPRESSION_RATIO) / 
+                                   COMPRESSION_RATIO;
+            if (run > 1) {
+                s += run - 1;
+                q += COMPRESSION_RATIO * (run - 1);
+                i += run - 1;
+                sum += (run - 1) * score_table[0];
+            }
+        }
         sum += score_table[q_byte ^ s_byte];
         if (sum > 0) {
             new_q = q + 3;
@@ -450,6 +495,220 @@ static NCBI_INLINE Int4 s_BlastDiagHashInsert(BLAST_DiagHash * table,
     return 1;
 }
 
+/** Home bucket of a diagonal in BLAST_DiagCompact. Diagonals are spread
+ * with a multiplicative hash, so that the defunct entries reused on
+ * insertion belong to distant diagonals rather than to neighbouring ones.
+ * @param table The hash table [in]
+ * @param diag The diagonal [in]
+ * @return Index of the first bucket to probe
+ */
+static NCBI_INLINE Uint4 s_BlastDiagCompactBucket(const BLAST_DiagCompact * table,
+                                                  Int4 diag)
+{
+    return ((Uint4) diag * 0x9E3779B1) >> table->hash_shift;
+}
+
+/**
+ * Find the hit information associated with a given diagonal in
+ * BLAST_DiagCompact. Cells of a bucket are filled in order and are never
+ * emptied individually, so probing stops at the first unused cell.
+ * @param table The hash table [in]
+ * @param diag The diagonal to be retrieved [in]
+ * @param level The offset of the last hit on the specified diagonal [out]
+ * @param hit_saved Whether or not the last hit on the specified diagonal was saved [out]
+ * @param hit_length length of the last hit on the specified diagonal [out]
+ * @return 1 if successful, 0 if no hit was found on the specified diagonal.
+ */
+static NCBI_INLINE Int4 s_BlastDiagCompactRetrieve(BLAST_DiagCompact * table,
+                                                   Int4 diag, Int4 * level,
+                                                   Int4 * hit_len,
+                                                   Int4 * hit_saved)
+{
+    const Uint4 kMask = table->num_buckets - 1;
+    const Uint4 kGeneration = table->generation;
+    Uint4 bucket = s_BlastDiagCompactBucket(table, diag);
+
+    for (;;) {
+        DiagCompactCell *cell = table->cells + 
+                                bucket * DIAGCOMPACT_BUCKET_SIZE;
+        Int4 i;
+        for (i = 0; i < DIAGCOMPACT_BUCKET_SIZE; i++, cell++) {
+            if (cell->generation != kGeneration)
+                return 0;
+            if (cell->diag == diag) {
+                *level = cell->level;
+                *hit_len = cell->hit_len;
+                *hit_saved = cell->hit_saved;
+                return 1;
+            }
+        }
+        bucket = (bucket + 1) & kMask;
+    }
+}
+
+/**
+ * Double the number of buckets in BLAST_DiagCompact, dropping defunct 
+ * entries while moving the rest.
+ * @param table The hash table [in] [out]
+ * @param s_off Needed to clean up defunct entries [in]
+ * @param window_size Needed to clean up defunct entries [in]
+ * @return 1 if successful, 0 if memory allocation failed.
+ */
+static Int4 s_BlastDiagCompactGrow(BLAST_DiagCompact * table,
+                                   Int4 s_off, Int4 window_size)
+{
+    BLAST_DiagCompact old = *table;
+    const Uint4 kNumCells = old.num_buckets * DIAGCOMPACT_BUCKET_SIZE;
+    Uint4 i;
+
+    if (BlastDiagCompactAlloc(table, 2 * old.num_buckets) != 0) {
+        *table = old;
+        return 0;
+    }
+
+    for (i = 0; i < kNumCells; i++) {
+        DiagCompactCell *cell = old.cells + i;
+        DiagCompactCell *dest;
+        Uint4 bucket;
+
+        if (cell->generation != old.generation ||
+            s_off - cell->level > window_size)
+            continue;
+
+        bucket = s_BlastDiagCompactBucket(table, cell->diag);
+        for (;;) {
+            DiagCompactCell *end;
+            dest = table->cells + bucket * DIAGCOMPACT_BUCKET_SIZE;
+            end = dest + DIAGCOMPACT_BUCKET_SIZE;
+            while (dest < end && dest->generation == table->generation)
+                dest++;
+            if (dest < end)
+                break;
+            bucket = (bucket + 1) & (table->num_buckets - 1);
+        }
+        *dest = *cell;
+        dest->generation = table->generation;
+        table->occupancy++;
+    }
+
+    sfree(old.cells_buffer);
+    return 1;
+}
+
+/**
+ * Attempt to store information associated with diagonal diag in
+ * BLAST_DiagCompact. Reuses a defunct entry along the probe sequence if the
+ * diagonal is not present, and grows the table once three quarters of
+ * its cells are in use.
+ * @param table The hash table [in]
+ * @param diag The diagonal to be stored [in]
+ * @param level The offset of the hit to be stored [in]
+ * @param len The length of the hit to be stored [in]
+ * @param hit_saved Whether or not this hit was stored [in]
+ * @param s_off Needed to clean up defunct entries [in]
+ * @param window_size Needed to clean up defunct entries [in]
+ * @return 1 if successful, 0 if memory allocation failed.
+ */
+static NCBI_INLINE Int4 s_BlastDiagCompactInsert(BLAST_DiagCompact * table,
+                                                 Int4 diag, Int4 level,
+                                                 Int4 len,
+                                                 Int4 hit_saved,
+                                                 Int4 s_off,
+                                                 Int4 window_size)
+{
+    const Uint4 kMask = table->num_buckets - 1;
+    const Uint4 kGeneration = table->generation;
+    Uint4 bucket = s_BlastDiagCompactBucket(table, diag);
+    DiagCompactCell *stale = NULL;
+    DiagCompactCell *cell = NULL;
+
+    for (;;) {
+        DiagCompactCell *end;
+        cell = table->cells + bucket * DIAGCOMPACT_BUCKET_SIZE;
+        end = cell + DIAGCOMPACT_BUCKET_SIZE;
+        for (; cell < end; cell++) {
+            if (cell->generation != kGeneration)
+                break;
+            /* if we find what we're looking for, save into it */
+            if (cell->diag == diag) {
+                cell->level = level;
+                cell->hit_len = len;
+                cell->hit_saved = hit_saved;
+                return 1;
+            }
+            /* remember the first stale hit in case diag is not present */
+            if (stale == NULL && s_off - cell->level > window_size)
+                stale = cell;
+        }
+        if (cell < end)
+            break;
+        bucket = (bucket + 1) & kMask;
+    }
+
+    if (stale) {
+        cell = stale;
+    } else if (4 * (table->occupancy + 1) > 
+               3 * DIAGCOMPACT_BUCKET_SIZE * table->num_buckets) {
+        if (!s_BlastDiagCompactGrow(table, s_off, window_size))
+            return 0;
+        return s_BlastDiagCompactInsert(table, diag, level, len, hit_saved,
+                                        s_off, window_size);
+    } else {
+        cell->generation = kGeneration;
+        table->occupancy++;
+    }
+
+    cell->diag = diag;
+    cell->level = level;
+    cell->hit_len = len;
+    cell->hit_saved = hit_saved;
+    return 1;
+}
+
+/** Retrieve the last hit on a diagonal from whichever hash table the word
+ * extension structure uses; see s_BlastDiagHashRetrieve.
+ * @param ewp Word extension structure [in]
+ * @param diag The diagonal to be retrieved [in]
+ * @param level The offset of the last hit on the specified diagonal [out]
+ * @param hit_len length of the last hit on the specified diagonal [out]
+ * @param hit_saved Whether or not the last hit was saved [out]
+ * @return 1 if successful, 0 if no hit was found on the specified diagonal.
+ */
+static NCBI_INLINE Int4 s_BlastDiagMapRetrieve(Blast_ExtendWord * ewp,
+                                               Int4 diag, Int4 * level,
+                                               Int4 * hit_len,
+                                               Int4 * hit_saved)
+{
+    if (ewp->compact_table)
+        return s_BlastDiagCompactRetrieve(ewp->compact_table, diag, level,
+                                          hit_len, hit_saved);
+    return s_BlastDiagHashRetrieve(ewp->hash_table, diag, level,
+                                   hit_len, hit_saved);
+}
+
+/** Store the last hit on a diagonal into whichever hash table the word
+ * extension structure uses; see s_BlastDiagHashInsert.
+ * @param ewp Word extension structure [in] [out]
+ * @param diag The diagonal to be stored [in]
+ * @param level The offset of the hit to be stored [in]
+ * @param len The length of the hit to be stored [in]
+ * @param hit_saved Whether or not this hit was stored [in]
+ * @param s_off Needed to clean up defunct entries [in]
+ * @param window_size Needed to clean up defunct entries [in]
+ * @return 1 if successful, 0 if memory allocation failed.
+ */
+static NCBI_INLINE Int4 s_BlastDiagMapInsert(Blast_ExtendWord * ewp,
+                                             Int4 diag, Int4 level,
+                                             Int4 len, Int4 hit_saved,
+                                             Int4 s_off, Int4 window_size)
+{
+    if (ewp->compact_table)
+        return s_BlastDiagCompactInsert(ewp->compact_table, diag, level,
+                                        len, hit_saved, s_off, window_size);
+    return s_BlastDiagHashInsert(ewp->hash_table, diag, level, len,
+                                 hit_saved, s_off, window_size);
+}
+
 /** Test to see if seed->q_off exists in lookup table
  * @param lookup_wrap The lookup table wrap structure [in]
  * @param subject Subject sequence data [in]
@@ -731,7 +990,7 @@ s_BlastnDiagTableExtendInitialHit(BLAST_SequenceBlk * query,
 
             if (off_found || ungapped_data->score >= cutoffs->cutoff_score) {
                 BlastUngappedData *final_data =
-                    (BlastUngappedData *) malloc(sizeof(BlastUngappedData));
+                    BlastInitHitListNewUngappedData(init_hitlist);
                 *final_data = *ungapped_data;
                 BLAST_SaveInitialHit(init_hitlist, q_off, s_off, final_data);
                 s_end_pos = ungapped_data->length + ungapped_data->s_start
@@ -770,7 +1029,8 @@ s_BlastnDiagTableExtendInitialHit(BLAST_SequenceBlk * query,
  * @param word_lut_length The length of the lookup table word [in]
  * @param word_params The parameters related to initial word extension [in]
  * @param matrix the substitution matrix for ungapped extension [in]
- * @param hash_table Structure containing initial hits [in] [out]
+ * @param ewp Word extension structure whose hash table (BLAST_DiagHash
+ *            or BLAST_DiagCompact) contains initial hits [in] [out]
  * @param init_hitlist The structure containing information about all 
  *                     initial hits [in] [out]
  * @return 1 if hit was extended, 0 if not
@@ -786,7 +1046,7 @@ s_BlastnDiagHashExtendInitialHit(BLAST_SequenceBlk * query,
                                const LookupTableWrap * lut,
                                const BlastInitialWordParameters * word_params,
                                Int4 ** matrix,
-                               BLAST_DiagHash * hash_table,
+                               Blast_ExtendWord * ewp,
                                BlastInitHitList * init_hitlist)
 {
     Int4 diag;
@@ -803,13 +1063,15 @@ s_BlastnDiagHashExtendInitialHit(BLAST_SequenceBlk * query,
     Boolean off_found = FALSE;
     Int4 Delta = MIN(word_params->options->scan_range, window_size - word_length);
     Int4 rc;
+    Int4 offset = ewp->compact_table ? ewp->compact_table->offset
+                                     : ewp->hash_table->offset;
 
     diag = s_off - q_off;
     s_end = s_off + word_length;
-    s_off_pos = s_off + hash_table->offset;
-    s_end_pos = s_end + hash_table->offset;
+    s_off_pos = s_off + offset;
+    s_end_pos = s_end + offset;
 
-    rc = s_BlastDiagHashRetrieve(hash_table, diag, &last_hit, &s_l, &hit_saved);
+    rc = s_BlastDiagMapRetrieve(ewp, diag, &last_hit, &s_l, &hit_saved);
 
     /* if there is no record in hashtable, we set last_hit to be a very negative number */
     if(!rc)  last_hit = 0;
@@ -839,7 +1101,7 @@ s_BlastnDiagHashExtendInitialHit(BLAST_SequenceBlk * query,
                 Int4 off_s_end = 0;
                 Int4 off_s_l = 0;
                 Int4 off_hit_saved = 0;
-                Int4 off_rc = s_BlastDiagHashRetrieve(hash_table, diag + delta, 
+                Int4 off_rc = s_BlastDiagMapRetrieve(ewp, diag + delta, 
                               &off_s_end, &off_s_l, &off_hit_saved);
                 if ( off_rc
                   && off_s_l
@@ -848,7 +1110,7 @@ s_BlastnDiagHashExtendInitialHit(BLAST_SequenceBlk * query,
                      off_found = TRUE;
                      break;
                 }
-                off_rc = s_BlastDiagHashRetrieve(hash_table, diag - delta, 
+                off_rc = s_BlastDiagMapRetrieve(ewp, diag - delta, 
                               &off_s_end, &off_s_l, &off_hit_saved);
                 if ( off_rc
                   && off_s_l
@@ -900,11 +1162,11 @@ s_BlastnDiagHashExtendInitialHit(BLAST_SequenceBlk * query,
 
             if (off_found || ungapped_data->score >= cutoffs->cutoff_score) {
                 BlastUngappedData *final_data =
-                    (BlastUngappedData *) malloc(sizeof(BlastUngappedData));
+                    BlastInitHitListNewUngappedData(init_hitlist);
                 *final_data = *ungapped_data;
                 BLAST_SaveInitialHit(init_hitlist, q_off, s_off, final_data);
                 s_end_pos = ungapped_data->length + ungapped_data->s_start 
-                          + hash_table->offset;
+                          + offset;
             } else {
                 hit_ready = 0;
             }
@@ -914,7 +1176,7 @@ s_BlastnDiagHashExtendInitialHit(BLAST_SequenceBlk * query,
         }
     } 
     
-    s_BlastDiagHashInsert(hash_table, diag, s_end_pos, 
+    s_BlastDiagMapInsert(ewp, diag, s_end_pos, 
                           (hit_ready) ? 0 : s_end_pos - s_off_pos,
                           hit_ready, s_off_pos, window_size + Delta + 1);
 
@@ -968,7 +1230,7 @@ s_BlastNaExtendDirect(const BlastOffsetPair * offset_pairs, Int4 num_hits,
         word_length = lut->word_length;
     }
 
-    if (word_params->container_type == eDiagHash) {
+    if (word_params->container_type != eDiagArray) {
         for (; index < num_hits; ++index) {
             Int4 s_offset = offset_pairs[index].qs_offsets.s_off;
             Int4 q_offset = offset_pairs[index].qs_offsets.q_off;
@@ -980,7 +1242,7 @@ s_BlastNaExtendDirect(const BlastOffsetPair * offset_pairs, Int4 num_hits,
                                                 word_length, word_length,
                                                 lookup_wrap,
                                                 word_params, matrix,
-                                                ewp->hash_table,
+                                                ewp,
                                                 init_hitlist);
         }
     } 
@@ -1118,7 +1380,7 @@ s_BlastNaExtend(const BlastOffsetPair * offset_pairs, Int4 num_hits,
            extend from the first match of the hit to one beyond the last
            match */
 
-        if (word_params->container_type == eDiagHash) {
+        if (word_params->container_type != eDiagArray) {
             hits_extended += s_BlastnDiagHashExtendInitialHit(query, subject, 
                                                 q_offset, s_offset,  
                                                 masked_locations, 
@@ -1126,7 +1388,7 @@ s_BlastNaExtend(const BlastOffsetPair * offset_pairs, Int4 num_hits,
                                                 word_length, lut_word_length,
                                                 lookup_wrap,
                                                 word_params, matrix,
-                                                ewp->hash_table,
+                                                ewp,
                                                 init_hitlist);
         } else {
             hits_extended += s_BlastnDiagTableExtendInitialHit(query, subject, 
@@ -1264,7 +1526,7 @@ s_BlastNaExtendAligned(const BlastOffsetPair * offset_pairs, Int4 num_hits,
         /* check the diagonal on which the hit lies. The boundaries extend
            from the first match of the hit to one beyond the last match */
 
-        if (word_params->container_type == eDiagHash) {
+        if (word_params->container_type != eDiagArray) {
             hits_extended += s_BlastnDiagHashExtendInitialHit(query, subject, 
                                                 q_offset, s_offset,  
                                                 masked_locations, 
@@ -1272,7 +1534,7 @@ s_BlastNaExtendAligned(const BlastOffsetPair * offset_pairs, Int4 num_hits,
                                                 word_length, lut_word_length,
                                                 lookup_wrap,
                                                 word_params, matrix,
-                                                ewp->hash_table,
+                                                ewp,
                                                 init_hitlist);
         } else {
             hits_extended += s_BlastnDiagTableExtendInitialHit(query, subject, 
@@ -1400,7 +1662,7 @@ s_BlastSmallNaExtendAlignedOneByte(const BlastOffsetPair * offset_pairs,
         q_offset -= ext_left;
         s_offset -= ext_left;
         
-        if (word_params->container_type == eDiagHash) {
+        if (word_params->container_type != eDiagArray) {
             hits_extended += s_BlastnDiagHashExtendInitialHit(query, subject,
                                                 q_offset, s_offset,  
                                                 lut->masked_locations, 
@@ -1408,7 +1670,7 @@ s_BlastSmallNaExtendAlignedOneByte(const BlastOffsetPair * offset_pairs,
                                                 word_length, lut_word_length,
                                                 lookup_wrap,
                                                 word_params, matrix,
-                                                ewp->hash_table,
+                                                ewp,
                                                 init_hitlist);
         }
         else {
@@ -1529,7 +1791,7 @@ s_BlastSmallNaExtend(const BlastOffsetPair * offset_pairs, Int4 num_hits,
         q_offset -= ext_left;
         s_offset -= ext_left;
         
-        if (word_params->container_type == eDiagHash) {
+        if (word_params->container_type != eDiagArray) {
             hits_extended += s_BlastnDiagHashExtendInitialHit(query, subject, 
                                                 q_offset, s_offset,  
                                                 lut->masked_locations, 
@@ -1537,7 +1799,7 @@ s_BlastSmallNaExtend(const BlastOffsetPair * offset_pairs, Int4 num_hits,
                                                 word_length, lut_word_length,
                                                 lookup_wrap,
                                                 word_params, matrix,
-                                                ewp->hash_table,
+                                                ewp,
                                                 init_hitlist);
         } else {
             hits_extended += s_BlastnDiagTableExtendInitialHit(query, subject, 
@@ -1710,7 +1972,7 @@ Int2 MB_IndexedWordFinder(
 
                     if( dummy_ungapped_data.score >= cutoffs->cutoff_score ) {
                         ungapped_data = 
-                            (BlastUngappedData *)malloc(sizeof(BlastUngappedData));
+                            BlastInitHitListNewUngappedData(init_hitlist);
                         *ungapped_data = dummy_ungapped_data;
                         if( new_hsp != hsp ) *new_hsp = *hsp;
                         new_hsp->ungapped_data = ungapped_data;
@@ -81,6 +81,17 @@ extern "C" {
 #define NCBI_INLINE inline
 #endif
 
+/* cache prefetch hint -- compiler dependent; a no-op where unsupported */
+#ifndef NCBI_PREFETCH
+#if defined(__GNUC__)
+/** Ask the processor to start loading the cache line holding addr */
+#define NCBI_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+/** Ask the processor to start loading the cache line holding addr */
+#define NCBI_PREFETCH(addr)
+#endif
+#endif
+
 #ifdef _MSC_VER
 #define strcasecmp _stricmp
 #define strdup _strdup
@@ -41,6 +41,7 @@
 
 #include <ncbi.h>
 #include <objall.h>
+#include <ncbithr.h>
 #include <objsset.h>
 #include <objsub.h>
 #include <objfdef.h>
@@ -523,7 +524,8 @@ NLM_EXTERN void FF_Add_NCBI_Base_URL (
 
 /* public function to get URLs for collaboration-approved db_xrefs */
 
-static Boolean links_loaded = FALSE;
+static Boolean   links_loaded = FALSE;
+static TNlmMutex links_mutex = NULL;
 
 NLM_EXTERN CharPtr asn2gnbk_dbxref (
   DbtagPtr dbt
@@ -557,8 +559,12 @@ NLM_EXTERN CharPtr asn2gnbk_dbxref (
   if ( ffstring == NULL ) return NULL;
 
   if (! links_loaded) {
-    InitWWW (ajp);
-    links_loaded = TRUE;
+    NlmMutexLockEx (&links_mutex);
+    if (! links_loaded) {
+      InitWWW (ajp);
+      links_loaded = TRUE;
+    }
+    NlmMutexUnlock (links_mutex);
   }
   ajp->www = TRUE;
 
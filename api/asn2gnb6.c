@@ -41,6 +41,7 @@
 
 #include <ncbi.h>
 #include <objall.h>
+#include <ncbithr.h>
 #include <objsset.h>
 #include <objsub.h>
 #include <objfdef.h>
@@ -2096,8 +2097,9 @@ static Boolean FlatVirtLoc (
   return FALSE;
 }
 
-static Uint1    id_order [NUM_SEQID];
-static Boolean  order_initialized = FALSE;
+static Uint1      id_order [NUM_SEQID];
+static Boolean    order_initialized = FALSE;
+static TNlmMutex  id_order_mutex = NULL;
 
 static CharPtr lim_str [5] = { "", ">","<", ">", "<" };
 
@@ -2676,6 +2678,7 @@ NLM_EXTERN CharPtr FFFlatLoc (
 
   ffstring = FFGetString(ajp);
 
+  NlmMutexLockEx (&id_order_mutex);
   if (! order_initialized) {
     id_order [SEQID_GENBANK] = num++;
     id_order [SEQID_EMBL] = num++;
@@ -2698,6 +2701,7 @@ NLM_EXTERN CharPtr FFFlatLoc (
     id_order [SEQID_GIIM] = num++;
     order_initialized = TRUE;
   }
+  NlmMutexUnlock (id_order_mutex);
 
   if (masterStyle) {
 
@@ -3561,6 +3565,7 @@ static ValNodePtr      ic_code_list = NULL;
 static IcCodePtr PNTR  ic_code_data = NULL;
 static Int4            ic_code_len = 0;
 static Boolean         ic_code_loaded = FALSE;
+static TNlmMutex       ic_code_mutex = NULL;
 
 static int LIBCALLBACK SortVnpByInstCode (VoidPtr ptr1, VoidPtr ptr2)
 
@@ -3681,9 +3686,9 @@ static CharPtr FullNameFromInstCode (CharPtr code)
 
   if (StringHasNoText (code)) return NULL;
 
-  if (ic_code_data == NULL) {
-    SetupInstCodeNameTable ();
-  }
+  NlmMutexLockEx (&ic_code_mutex);
+  SetupInstCodeNameTable ();
+  NlmMutexUnlock (ic_code_mutex);
   if (ic_code_data == NULL) return NULL;
 
   L = 0;
@@ -2107,21 +2107,33 @@ NLM_EXTERN BioseqPtr LIBCALL BioseqCopyEx (SeqIdPtr newid, BioseqPtr oldbsp, Int
             seqtype = Seq_code_iupacna;
         }
         newbsp->seq_data_type = seqtype;
-        bsp = BSNew(len);
-        if (bsp == NULL) goto erret;
-
-        newbsp->seq_data = (SeqDataPtr) bsp;
-        spp = SeqPortNew(oldbsp, from, to, strand, seqtype);
-        if (spp == NULL) goto erret;
-
-        for (i = 0; i < len; i++)
+        if (oldbsp->seq_data_type == seqtype && oldbsp->seq_data != NULL &&
+            strand != Seq_strand_minus && strand != Seq_strand_both_rev &&
+            to < BSLen ((ByteStorePtr) oldbsp->seq_data))
         {
-            residue = SeqPortGetResidue(spp);
-            if (! IS_residue(residue)) goto erret;
-            BSPutByte(bsp, residue);
+            /* same one byte alphabet, share the residues with oldbsp */
+            bsp = BSSlice ((ByteStorePtr) oldbsp->seq_data, from, len);
+            if (bsp == NULL) goto erret;
+            newbsp->seq_data = (SeqDataPtr) bsp;
         }
+        else
+        {
+            bsp = BSNew(len);
+            if (bsp == NULL) goto erret;
 
-        SeqPortFree(spp);
+            newbsp->seq_data = (SeqDataPtr) bsp;
+            spp = SeqPortNew(oldbsp, from, to, strand, seqtype);
+            if (spp == NULL) goto erret;
+
+            for (i = 0; i < len; i++)
+            {
+                residue = SeqPortGetResidue(spp);
+                if (! IS_residue(residue)) goto erret;
+                BSPutByte(bsp, residue);
+            }
+
+            SeqPortFree(spp);
+        }
         handled = TRUE;
     }
 
@@ -5131,7 +5143,6 @@ SeqEdGetNextFeature
   SMFeatItemPtr       item;
   Int4                num = 0;
   ObjMgrDataPtr       omdp;
-  ObjMgrPtr           omp;
   Uint1               seqfeattype;
 
   if (context == NULL) return NULL;
@@ -5140,14 +5151,7 @@ SeqEdGetNextFeature
 
   if (curr == NULL) {
     if (bsp == NULL) return NULL;
-    omdp = (ObjMgrDataPtr) bsp->omdp;
-    if (omdp == NULL) 
-    {
-      omp = ObjMgrWriteLock ();
-      omdp = ObjMgrFindByData (omp, bsp);
-      ObjMgrUnlock ();
-      bsp->omdp = (Pointer) omdp;    
-    }
+    omdp = SeqMgrGetOmdpForBioseq (bsp);
     if (omdp == NULL || omdp->datatype != OBJ_BIOSEQ) return NULL;
 
     context->omdp = (Pointer) omdp;
@@ -6837,18 +6841,10 @@ NLM_EXTERN void SeqEdReindexAffectedFeatures (Int4 shift_start, Int4 shift_amt,
 {
   ObjMgrDataPtr       omdp;
   BioseqExtraPtr      bspextra;
-  ObjMgrPtr           omp;
 
   if (bsp == NULL) return;
   
-  omdp = (ObjMgrDataPtr) bsp->omdp;
-  if (omdp == NULL) 
-  {
-    omp = ObjMgrWriteLock ();
-    omdp = ObjMgrFindByData (omp, bsp);
-    ObjMgrUnlock ();
-    bsp->omdp = (Pointer) omdp;    
-  }
+  omdp = SeqMgrGetOmdpForBioseq (bsp);
   if (omdp == NULL || omdp->datatype != OBJ_BIOSEQ) return;
 
   bspextra = (BioseqExtraPtr) omdp->extradata;
@@ -6862,7 +6858,6 @@ NLM_EXTERN void SeqEdReindexFeature (SeqFeatPtr sfp, BioseqPtr bsp)
 {
   ObjMgrDataPtr       omdp;
   BioseqExtraPtr      bspextra;
-  ObjMgrPtr           omp;
   Int4                i;
   SeqLocPtr           this_slp;
   SMFeatItemPtr       item = NULL;
@@ -6871,14 +6866,7 @@ NLM_EXTERN void SeqEdReindexFeature (SeqFeatPtr sfp, BioseqPtr bsp)
   Int4                left, right;
 
   if (sfp == NULL || bsp == NULL) return;
-  omdp = (ObjMgrDataPtr) bsp->omdp;
-  if (omdp == NULL) 
-  {
-    omp = ObjMgrWriteLock ();
-    omdp = ObjMgrFindByData (omp, bsp);
-    ObjMgrUnlock ();
-    bsp->omdp = (Pointer) omdp;    
-  }
+  omdp = SeqMgrGetOmdpForBioseq (bsp);
   if (omdp == NULL || omdp->datatype != OBJ_BIOSEQ) return;
 
   bspextra = (BioseqExtraPtr) omdp->extradata;
@@ -7185,21 +7173,13 @@ SeqEdFixFeatureIndexForFeatureLocAdjust
 {
   ObjMgrDataPtr       omdp;
   BioseqExtraPtr      bspextra;
-  ObjMgrPtr           omp;
   SMFeatItemPtr       item;
   Int4                i, j;
   Int4                left, right;
   
   if (bsp == NULL || sfp == NULL) return;
   
-  omdp = (ObjMgrDataPtr) bsp->omdp;
-  if (omdp == NULL) 
-  {
-    omp = ObjMgrWriteLock ();
-    omdp = ObjMgrFindByData (omp, bsp);
-    ObjMgrUnlock ();
-    bsp->omdp = (Pointer) omdp;    
-  }
+  omdp = SeqMgrGetOmdpForBioseq (bsp);
   if (omdp == NULL || omdp->datatype != OBJ_BIOSEQ) return;
 
   bspextra = (BioseqExtraPtr) omdp->extradata;
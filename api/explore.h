@@ -664,6 +664,27 @@ NLM_EXTERN Uint2 LIBCALL SeqMgrIndexFeaturesExEx (
   ValNodePtr extra
 );
 
+/*****************************************************************************
+*
+*   SeqMgrIndexFeaturesLazy records features on each bioseq but defers sorting
+*     them until the bioseq is first explored, and if region is not NULL skips
+*     features on the region's bioseq that do not overlap it
+*   SeqMgrSetLazyFeatureIndexing makes SeqMgrIndexFeatures and its variants
+*     defer sorting in the same way, for programs that read large records but
+*     only visit some of their bioseqs
+*
+*****************************************************************************/
+
+NLM_EXTERN Uint2 LIBCALL SeqMgrIndexFeaturesLazy (
+  Uint2 entityID,
+  Pointer ptr,
+  SeqLocPtr region
+);
+
+NLM_EXTERN void LIBCALL SeqMgrSetLazyFeatureIndexing (
+  Boolean lazy
+);
+
 /*****************************************************************************
 *
 *   If indexed with dorevfeats TRUE, SeqMgrExploreFeaturesRev presents features
@@ -294,47 +294,18 @@ NLM_EXTERN CharPtr LIBCALL FFPrint (FFPrintArrayPtr pap, Int4 index, Int4 pap_si
 /**********************************************************/
 static ByteStorePtr BSAppend(ByteStorePtr to, ByteStorePtr from)
 {
-    Nlm_BSUnitPtr tobup;
-    Nlm_BSUnitPtr frombup;
-
     if(from == NULL)
         return(to);
 
     if(to == NULL)
-    {
-        to = MemNew(sizeof(Nlm_ByteStore));
-        to->totlen = 0;
-        to->chain = NULL;
-    }
-
-    to->seekptr = 0;
-    to->chain_offset = 0;
-
-    if(to->chain != NULL)
-        for(tobup = to->chain; tobup->next != NULL; tobup = tobup->next)
-            continue;
-    else
-        tobup = NULL;
-
-    for(frombup = from->chain; frombup != NULL; frombup = frombup->next)
-    {
-        to->totlen += frombup->len;
-        if(tobup == NULL)
-        {
-            to->chain = MemNew(sizeof(Nlm_BSUnit));
-            tobup = to->chain;
-        }
-        else
-        {
-            tobup->next = MemNew(sizeof(Nlm_BSUnit));
-            tobup = tobup->next;
-        }
-        tobup->str = MemNew(frombup->len);
-        MemCpy(tobup->str, frombup->str, frombup->len);
-        tobup->len = frombup->len;
-        tobup->len_avail = frombup->len_avail;
-    }
-    to->curchain = to->chain;
+        to = BSNew(0);
+
+    /* the appended pieces share storage with from
+     */
+    BSSeek(to, 0, SEEK_END);
+    BSSeek(from, 0, SEEK_SET);
+    BSInsertFromBS(to, from, BSLen(from));
+    BSSeek(to, 0, SEEK_SET);
     return(to);
 }
 
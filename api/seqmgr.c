@@ -327,7 +327,7 @@ NLM_EXTERN SeqEntryPtr LIBCALL SeqEntrySetScope(SeqEntryPtr sep)
                 smp->num_scope--;
                 j = smp->num_scope - i;  /* number to move */
                 if (j)  /* not last one */
-                    MemCopy(smsp, (smsp+1), (size_t)(j * sizeof(SMScope)));
+                    MemMove(smsp, (smsp+1), (size_t)(j * sizeof(SMScope)));
             }
             goto ret;    /* all done */
         }
@@ -2762,7 +2762,7 @@ NLM_EXTERN Boolean LIBCALL CountGapsInDeltaSeq (BioseqPtr bsp, Int4Ptr num_segs,
     SeqLitPtr slp;
     IntFuzzPtr ifp;
     Boolean unk;
-    static Char tmp[128];
+    Char tmp[128];
     Int2 diff, blen;
 
     if (bsp == NULL) return retval;
@@ -3712,11 +3712,21 @@ static ObjMgrDataPtr SeqMgrGetOmdpForPointer (Pointer ptr)
   return omdp;
 }
 
+/* lazy feature indexing states, kept in BioseqExtra.pendingIndex */
+
+#define LAZY_INDEX_NONE    0  /* sorted arrays built, or not indexed */
+#define LAZY_INDEX_HELD    1  /* featsByID built, rest of entity still being indexed */
+#define LAZY_INDEX_PENDING 2  /* sorted arrays to be built on first access */
+#define LAZY_INDEX_BUSY    3  /* sorted arrays being built */
+
+static void FinishLazyFeatureIndex (BioseqPtr bsp, ObjMgrDataPtr omdp);
+
 NLM_EXTERN ObjMgrDataPtr SeqMgrGetOmdpForBioseq (BioseqPtr bsp)
 
 {
-  ObjMgrDataPtr  omdp = NULL;
-  ObjMgrPtr      omp;
+  BioseqExtraPtr  bspextra;
+  ObjMgrDataPtr   omdp = NULL;
+  ObjMgrPtr       omp;
 
   if (bsp == NULL) return NULL;
   omp = ObjMgrWriteLock ();
@@ -3726,6 +3736,16 @@ NLM_EXTERN ObjMgrDataPtr SeqMgrGetOmdpForBioseq (BioseqPtr bsp)
     bsp->omdp = (Pointer) omdp;
   }
   ObjMgrUnlock ();
+
+  /* lazily indexed bioseq gets its sorted feature arrays on first access */
+
+  if (omdp != NULL && omdp->datatype == OBJ_BIOSEQ) {
+    bspextra = (BioseqExtraPtr) omdp->extradata;
+    if (bspextra != NULL && bspextra->pendingIndex >= LAZY_INDEX_PENDING) {
+      FinishLazyFeatureIndex (bsp, omdp);
+    }
+  }
+
   return omdp;
 }
 
@@ -3807,6 +3827,13 @@ static Boolean SeqMgrClearBioseqExtraData (ObjMgrDataPtr omdp)
   bspextra->orgsByPos = MemFree (bspextra->orgsByPos);
   bspextra->operonsByPos = MemFree (bspextra->operonsByPos);
 
+  bspextra->genesByRight = MemFree (bspextra->genesByRight);
+  bspextra->mRNAsByRight = MemFree (bspextra->mRNAsByRight);
+  bspextra->CDSsByRight = MemFree (bspextra->CDSsByRight);
+  bspextra->pubsByRight = MemFree (bspextra->pubsByRight);
+  bspextra->orgsByRight = MemFree (bspextra->orgsByRight);
+  bspextra->operonsByRight = MemFree (bspextra->operonsByRight);
+
   bspextra->genesByLocusTag = MemFree (bspextra->genesByLocusTag);
 
   /* free list of descriptor information */
@@ -3885,6 +3912,10 @@ static Boolean SeqMgrClearBioseqExtraData (ObjMgrDataPtr omdp)
   bspextra->numfids = 0;
   bspextra->numsegs = 0;
 
+  bspextra->pendingIndex = LAZY_INDEX_NONE;
+  bspextra->pendingRevFeats = FALSE;
+  bspextra->pendingBaseItemID = 0;
+
   bspextra->min = INT4_MAX;
   bspextra->processed = UINT1_MAX;
   bspextra->blocksize = 50;
@@ -5113,6 +5144,8 @@ typedef struct extraindex {
   Uint4           adpcount;
   Int4            seqlitid;
   Boolean         flip;
+  SeqLocPtr       region;
+  BioseqPtr       regionbsp;
 } ExtraIndex, PNTR ExtraIndexPtr;
 
 static void SetDescriptorCounts (ValNodePtr sdp, ExtraIndexPtr exindx, Pointer thisitem, Uint2 thistype)
@@ -6169,6 +6202,11 @@ static Boolean RecordFeaturesInBioseqs (GatherObjectPtr gop)
 
   exindx->lastbsp = bsp;
 
+  /* indexing limited to a region skips features on that bioseq outside of it */
+
+  if (bsp == exindx->regionbsp && exindx->region != NULL &&
+      SeqLocCompare (sfp->location, exindx->region) == SLC_NO_MATCH) return TRUE;
+
   RecordFeatureOnBioseq (gop, bsp, sfp, exindx, usingLocalBsp, special_case, small_gen_set, FALSE);
 
   /* for small genome set, index mixed-chromosome features on other chromosomes as misc_features for visibility */
@@ -7086,18 +7124,100 @@ static void IndexSegmentedParts (SeqEntryPtr sep, BioseqPtr PNTR lastsegbsp)
 
 /*****************************************************************************
 *
-*   IndexRecordedFeatures callback builds sorted arrays of features and genes
+*   BuildRightEndTree makes an implicit binary tree over a xxxByPos array,
+*     where each node holds the largest right end of the features beneath it,
+*     so PrevOverlappingItem can skip whole runs of features that end before
+*     a location without walking the overlap hierarchy one link at a time
+*   Element 0 holds the number of leaves, leaves start at that offset
 *
 *****************************************************************************/
 
-static void IndexRecordedFeatures (SeqEntryPtr sep, Boolean dorevfeats, Uint4 baseItemID)
+static Int4Ptr BuildRightEndTree (SMFeatItemPtr PNTR array, Int4 num)
+
+{
+  SMFeatItemPtr  item;
+  Int4           i;
+  Int4           size;
+  Int4Ptr        tree;
+
+  if (array == NULL || num < 2) return NULL;
+
+  size = 1;
+  while (size < num) {
+    size *= 2;
+  }
+
+  tree = (Int4Ptr) MemNew (sizeof (Int4) * (size_t) (size * 2));
+  if (tree == NULL) return NULL;
+
+  for (i = 0; i < size; i++) {
+    item = NULL;
+    if (i < num) {
+      item = array [i];
+    }
+    if (item != NULL) {
+      tree [size + i] = item->right;
+    } else {
+      tree [size + i] = INT4_MIN;
+    }
+  }
+  for (i = size - 1; i > 0; i--) {
+    tree [i] = MAX (tree [2 * i], tree [2 * i + 1]);
+  }
+  tree [0] = size;
+
+  return tree;
+}
+
+/* returns the highest index below pos whose feature ends at or after left, or -1 */
+
+static Int4 PrevOverlappingItem (Int4Ptr tree, Int4 pos, Int4 left)
+
+{
+  Int4  node;
+  Int4  size;
+
+  if (tree == NULL || pos < 1) return -1;
+  size = tree [0];
+  if (pos > size) {
+    pos = size;
+  }
+
+  node = size + pos - 1;
+  if (tree [node] >= left) return pos - 1;
+
+  /* climb until a left sibling subtree has a qualifying feature */
+
+  while (node > 1 && ((node & 1) == 0 || tree [node - 1] < left)) {
+    node /= 2;
+  }
+  if (node <= 1) return -1;
+  node--;
+
+  /* then descend to its rightmost qualifying leaf */
+
+  while (node < size) {
+    if (tree [2 * node + 1] >= left) {
+      node = 2 * node + 1;
+    } else {
+      node = 2 * node;
+    }
+  }
+
+  return node - size;
+}
+
+/*****************************************************************************
+*
+*   SortRecordedFeatures builds sorted arrays of features and genes on a Bioseq
+*     from its featsByID array
+*
+*****************************************************************************/
+
+static void SortRecordedFeatures (BioseqPtr bsp, BioseqExtraPtr bspextra, Boolean dorevfeats, Uint4 baseItemID)
 
 {
-  BioseqPtr           bsp;
-  BioseqExtraPtr      bspextra;
-  BioseqSetPtr        bssp;
   SeqFeatPtr          cds;
-  SMFeatBlockPtr      curr;
   SeqLocPtr           dnaloc;
   SMFeatItemPtr PNTR  featsByID;
   SMFeatItemPtr PNTR  featsBySfp;
@@ -7107,176 +7227,142 @@ static void IndexRecordedFeatures (SeqEntryPtr sep, Boolean dorevfeats, Uint4 ba
   SMFeatItemPtr PNTR  genesByLocusTag;
   SMFeatItemPtr PNTR  genesByPos;
   Int4                i;
-  Int4                j;
   SMFeatItemPtr       item;
   SMFeatItemPtr       last;
   BioseqPtr           nuc;
   Int4                numfeats;
   Int4                numgenes;
-  ObjMgrDataPtr       omdp;
   Int4                pt;
   SeqLocPtr           segloc;
   SeqFeatPtr          sfp;
   SeqLocPtr           slp;
   Int4                stop;
 
-  if (sep == NULL) return;
-  if (IS_Bioseq_set (sep)) {
-    bssp = (BioseqSetPtr) sep->data.ptrvalue;
-    if (bssp == NULL) return;
-    for (sep = bssp->seq_set; sep != NULL; sep = sep->next) {
-      IndexRecordedFeatures (sep, dorevfeats, baseItemID);
-    }
-    return;
-  }
-
-  if (! IS_Bioseq (sep)) return;
-  bsp = (BioseqPtr) sep->data.ptrvalue;
-  if (bsp == NULL) return;
-
-  omdp = SeqMgrGetOmdpForBioseq (bsp);
-  if (omdp == NULL) return;
-  bspextra = (BioseqExtraPtr) omdp->extradata;
-  if (bspextra == NULL) return;
+  if (bsp == NULL || bspextra == NULL) return;
 
   numfeats = bspextra->numfeats;
+  featsByID = bspextra->featsByID;
 
-  curr = bspextra->featlisthead;
-
-  if (numfeats > 0 && curr != NULL) {
-
-    /* build array of pointers into feature items */
+  if (numfeats > 0 && featsByID != NULL) {
 
-    featsByID = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
-    bspextra->featsByID = featsByID;
+    featsBySfp = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
+    bspextra->featsBySfp = featsBySfp;
 
-    if (featsByID != NULL) {
-      i = 0;
-      j = 0;
-      while (i < numfeats && curr != NULL) {
-        if (j >= curr->index || j >= bspextra->blocksize) {
-          j = 0;
-          curr = curr->next;
-        }
-        if (curr != NULL && j < curr->index && curr->data != NULL) {
-          featsByID [i] = &(curr->data [j]);
-          i++;
-          j++;
-        }
-      }
-      if (i < numfeats) {
-        ErrPostEx (SEV_WARNING, 0, 0, "SeqMgr indexing feature table build problem");
+    if (featsBySfp != NULL) {
+      for (i = 0; i < numfeats; i++) {
+        featsBySfp [i] = featsByID [i];
       }
 
-      featsBySfp = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
-      bspextra->featsBySfp = featsBySfp;
+      /* sort all features by SeqFeatPtr value */
 
-      if (featsBySfp != NULL) {
-        for (i = 0; i < numfeats; i++) {
-          featsBySfp [i] = featsByID [i];
-        }
+      StableMergeSort ((VoidPtr) featsBySfp, (size_t) numfeats, sizeof (SMFeatItemPtr), SortFeatItemListBySfp);
+    }
 
-        /* sort all features by SeqFeatPtr value */
+    featsByPos = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
+    bspextra->featsByPos = featsByPos;
 
-        StableMergeSort ((VoidPtr) featsBySfp, (size_t) numfeats, sizeof (SMFeatItemPtr), SortFeatItemListBySfp);
+    if (featsByPos != NULL) {
+      for (i = 0; i < numfeats; i++) {
+        featsByPos [i] = featsByID [i];
       }
 
-      featsByPos = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
-      bspextra->featsByPos = featsByPos;
+      /* sort all features by feature location on bioseq */
 
-      if (featsByPos != NULL) {
-        for (i = 0; i < numfeats; i++) {
-          featsByPos [i] = featsByID [i];
-        }
+      StableMergeSort ((VoidPtr) featsByPos, (size_t) numfeats, sizeof (SMFeatItemPtr), SortFeatItemListByPos);
 
-        /* sort all features by feature location on bioseq */
+      for (i = 0; i < numfeats; i++) {
+        item = featsByPos [i];
+        if (item != NULL) {
+          item->index = i;
+        }
+      }
 
-        StableMergeSort ((VoidPtr) featsByPos, (size_t) numfeats, sizeof (SMFeatItemPtr), SortFeatItemListByPos);
+      /* gap feature in record overrides flatfile-generated feature */
 
-        for (i = 0; i < numfeats; i++) {
+      if (baseItemID > 0) {
+        last = featsByPos [0];
+        for (i = 1; i < numfeats; i++) {
           item = featsByPos [i];
-          if (item != NULL) {
-            item->index = i;
-          }
-        }
-
-        /* gap feature in record overrides flatfile-generated feature */
-
-        if (baseItemID > 0) {
-          last = featsByPos [0];
-          for (i = 1; i < numfeats; i++) {
-            item = featsByPos [i];
-            if (item != NULL && last != NULL) {
-              if (last->subtype == FEATDEF_gap && item->subtype == FEATDEF_gap) {
-                if (last->left == item->left && last->right == item->right) {
-                  if (item->itemID >= baseItemID) {
-                    item->ignore = TRUE;
-                  }
+          if (item != NULL && last != NULL) {
+            if (last->subtype == FEATDEF_gap && item->subtype == FEATDEF_gap) {
+              if (last->left == item->left && last->right == item->right) {
+                if (item->itemID >= baseItemID) {
+                  item->ignore = TRUE;
                 }
               }
             }
-            last = item;
           }
+          last = item;
         }
-
-        /* build arrays of sorted gene, mRNA, CDS, publication, and biosource features for lookup by overlap */
-
-        bspextra->genesByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numgenes), 0, FEATDEF_GENE);
-        bspextra->mRNAsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->nummRNAs), 0, FEATDEF_mRNA);
-        bspextra->CDSsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numCDSs), 0, FEATDEF_CDS);
-        bspextra->pubsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numpubs), 0, FEATDEF_PUB);
-        bspextra->orgsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numorgs), 0, FEATDEF_BIOSRC);
-        bspextra->operonsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numoperons), 0, FEATDEF_operon);
       }
 
-      if (dorevfeats) {
-        featsByRev = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
-        bspextra->featsByRev = featsByRev;
+      /* build arrays of sorted gene, mRNA, CDS, publication, and biosource features for lookup by overlap */
 
-        if (featsByRev != NULL) {
-          for (i = 0; i < numfeats; i++) {
-            featsByRev [i] = featsByID [i];
-          }
+      bspextra->genesByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numgenes), 0, FEATDEF_GENE);
+      bspextra->mRNAsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->nummRNAs), 0, FEATDEF_mRNA);
+      bspextra->CDSsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numCDSs), 0, FEATDEF_CDS);
+      bspextra->pubsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numpubs), 0, FEATDEF_PUB);
+      bspextra->orgsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numorgs), 0, FEATDEF_BIOSRC);
+      bspextra->operonsByPos = SeqMgrBuildFeatureIndex (bsp, &(bspextra->numoperons), 0, FEATDEF_operon);
 
-          /* optionally sort all features by feature reverse location on bioseq */
+      /* implicit interval trees let overlap queries skip features that end before the location */
 
-          StableMergeSort ((VoidPtr) featsByRev, (size_t) numfeats, sizeof (SMFeatItemPtr), SortFeatItemListByRev);
-        }
-      }
+      bspextra->genesByRight = BuildRightEndTree (bspextra->genesByPos, bspextra->numgenes);
+      bspextra->mRNAsByRight = BuildRightEndTree (bspextra->mRNAsByPos, bspextra->nummRNAs);
+      bspextra->CDSsByRight = BuildRightEndTree (bspextra->CDSsByPos, bspextra->numCDSs);
+      bspextra->pubsByRight = BuildRightEndTree (bspextra->pubsByPos, bspextra->numpubs);
+      bspextra->orgsByRight = BuildRightEndTree (bspextra->orgsByPos, bspextra->numorgs);
+      bspextra->operonsByRight = BuildRightEndTree (bspextra->operonsByPos, bspextra->numoperons);
+    }
 
-      featsByLabel = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
-      bspextra->featsByLabel = featsByLabel;
+    if (dorevfeats) {
+      featsByRev = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
+      bspextra->featsByRev = featsByRev;
 
-      if (featsByLabel != NULL) {
+      if (featsByRev != NULL) {
         for (i = 0; i < numfeats; i++) {
-          featsByLabel [i] = featsByID [i];
+          featsByRev [i] = featsByID [i];
         }
 
-        /* sort all features by label value */
+        /* optionally sort all features by feature reverse location on bioseq */
 
-        StableMergeSort ((VoidPtr) featsByLabel, (size_t) numfeats, sizeof (SMFeatItemPtr), SortFeatItemListByLabel);
+        StableMergeSort ((VoidPtr) featsByRev, (size_t) numfeats, sizeof (SMFeatItemPtr), SortFeatItemListByRev);
       }
+    }
 
-      genesByPos = bspextra->genesByPos;
-      numgenes = bspextra->numgenes;
-      if (genesByPos != NULL && numgenes > 0) {
+    featsByLabel = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
+    bspextra->featsByLabel = featsByLabel;
 
-        genesByLocusTag = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numgenes + 1));
-        bspextra->genesByLocusTag = genesByLocusTag;
+    if (featsByLabel != NULL) {
+      for (i = 0; i < numfeats; i++) {
+        featsByLabel [i] = featsByID [i];
+      }
 
-        if (genesByLocusTag != NULL) {
-          for (i = 0; i < numgenes; i++) {
-            genesByLocusTag [i] = genesByPos [i];
-          }
+      /* sort all features by label value */
+
+      StableMergeSort ((VoidPtr) featsByLabel, (size_t) numfeats, sizeof (SMFeatItemPtr), SortFeatItemListByLabel);
+    }
 
-          /* sort by locus_tag value */
+    genesByPos = bspextra->genesByPos;
+    numgenes = bspextra->numgenes;
+    if (genesByPos != NULL && numgenes > 0) {
 
-          StableMergeSort ((VoidPtr) genesByLocusTag, (size_t) numgenes, sizeof (SMFeatItemPtr), SortFeatItemListByLocusTag);
+      genesByLocusTag = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numgenes + 1));
+      bspextra->genesByLocusTag = genesByLocusTag;
+
+      if (genesByLocusTag != NULL) {
+        for (i = 0; i < numgenes; i++) {
+          genesByLocusTag [i] = genesByPos [i];
         }
+
+        /* sort by locus_tag value */
+
+        StableMergeSort ((VoidPtr) genesByLocusTag, (size_t) numgenes, sizeof (SMFeatItemPtr), SortFeatItemListByLocusTag);
       }
     }
   }
 
+
   if (numfeats < 1 || (! ISA_aa (bsp->mol))) return;
   cds = SeqMgrGetCDSgivenProduct (bsp, NULL);
   if (cds == NULL) return;
@@ -7325,6 +7411,91 @@ static void IndexRecordedFeatures (SeqEntryPtr sep, Boolean dorevfeats, Uint4 ba
   }
 }
 
+
+/*****************************************************************************
+*
+*   IndexRecordedFeatures callback builds sorted arrays of features and genes,
+*     in lazy mode only building featsByID and holding the sort for first access
+*
+*****************************************************************************/
+
+static void IndexRecordedFeatures (SeqEntryPtr sep, Boolean dorevfeats, Uint4 baseItemID, Boolean lazy)
+
+{
+  BioseqPtr           bsp;
+  BioseqExtraPtr      bspextra;
+  BioseqSetPtr        bssp;
+  SMFeatBlockPtr      curr;
+  SMFeatItemPtr PNTR  featsByID;
+  Int4                i;
+  Int4                j;
+  Int4                numfeats;
+  ObjMgrDataPtr       omdp;
+
+  if (sep == NULL) return;
+  if (IS_Bioseq_set (sep)) {
+    bssp = (BioseqSetPtr) sep->data.ptrvalue;
+    if (bssp == NULL) return;
+    for (sep = bssp->seq_set; sep != NULL; sep = sep->next) {
+      IndexRecordedFeatures (sep, dorevfeats, baseItemID, lazy);
+    }
+    return;
+  }
+
+  if (! IS_Bioseq (sep)) return;
+  bsp = (BioseqPtr) sep->data.ptrvalue;
+  if (bsp == NULL) return;
+
+  omdp = SeqMgrGetOmdpForBioseq (bsp);
+  if (omdp == NULL) return;
+  bspextra = (BioseqExtraPtr) omdp->extradata;
+  if (bspextra == NULL) return;
+
+  numfeats = bspextra->numfeats;
+
+  curr = bspextra->featlisthead;
+
+  if (numfeats > 0 && curr != NULL) {
+
+    /* build array of pointers into feature items */
+
+    featsByID = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (numfeats + 1));
+    bspextra->featsByID = featsByID;
+
+    if (featsByID != NULL) {
+      i = 0;
+      j = 0;
+      while (i < numfeats && curr != NULL) {
+        if (j >= curr->index || j >= bspextra->blocksize) {
+          j = 0;
+          curr = curr->next;
+        }
+        if (curr != NULL && j < curr->index && curr->data != NULL) {
+          featsByID [i] = &(curr->data [j]);
+          i++;
+          j++;
+        }
+      }
+      if (i < numfeats) {
+        ErrPostEx (SEV_WARNING, 0, 0, "SeqMgr indexing feature table build problem");
+      }
+
+    }
+  }
+
+  /* segmented proteins are sorted now for DoSegmentedProtein */
+
+  if (lazy && bspextra->featsByID != NULL &&
+      (bsp->repr != Seq_repr_seg || (! ISA_aa (bsp->mol)))) {
+    bspextra->pendingBaseItemID = baseItemID;
+    bspextra->pendingRevFeats = dorevfeats;
+    bspextra->pendingIndex = LAZY_INDEX_HELD;
+    return;
+  }
+
+  SortRecordedFeatures (bsp, bspextra, dorevfeats, baseItemID);
+}
+
 /*****************************************************************************
 *
 *   IndexFeaturesOnEntity makes feature pointers across all Bioseqs in entity
@@ -7901,6 +8072,22 @@ static void IndexFeatIDsOnEntity (
   ValNodeFree (head);
 }
 
+static void ReleaseHeldFeatureIndex (BioseqPtr bsp, Pointer userdata)
+
+{
+  BioseqExtraPtr  bspextra;
+  ObjMgrDataPtr   omdp;
+
+  omdp = SeqMgrGetOmdpForBioseq (bsp);
+  if (omdp == NULL) return;
+  bspextra = (BioseqExtraPtr) omdp->extradata;
+  if (bspextra == NULL) return;
+
+  if (bspextra->pendingIndex == LAZY_INDEX_HELD) {
+    bspextra->pendingIndex = LAZY_INDEX_PENDING;
+  }
+}
+
 /*****************************************************************************
 *
 *   SeqMgrReindexBioseqExtraData refreshes internal indices for rapid retrieval
@@ -7912,7 +8099,9 @@ static Uint2 LIBCALL s_DoSeqMgrIndexFeatures (
   Pointer ptr,
   Boolean flip,
   Boolean dorevfeats,
-  ValNodePtr extra
+  ValNodePtr extra,
+  Boolean lazy,
+  SeqLocPtr region
 )
 
 {
@@ -8030,6 +8219,8 @@ static Uint2 LIBCALL s_DoSeqMgrIndexFeatures (
   exind.adpcount = 0;
   exind.seqlitid = 0;
   exind.flip = flip;
+  exind.region = NULL;
+  exind.regionbsp = NULL;
 
   MemSet ((Pointer) objMgrFilter, 0, sizeof (objMgrFilter));
   objMgrFilter [OBJ_BIOSEQ] = TRUE;
@@ -8063,6 +8254,11 @@ static Uint2 LIBCALL s_DoSeqMgrIndexFeatures (
   exind.adpcount = 0;
   exind.seqlitid = 0;
   exind.flip = flip;
+  exind.region = region;
+  exind.regionbsp = NULL;
+  if (region != NULL) {
+    exind.regionbsp = BioseqFindFromSeqLoc (region);
+  }
 
   MemSet ((Pointer) objMgrFilter, 0, sizeof (objMgrFilter));
   objMgrFilter [OBJ_BIOSEQ] = TRUE;
@@ -8075,7 +8271,7 @@ static Uint2 LIBCALL s_DoSeqMgrIndexFeatures (
 
   /* finish building array of sorted features on each indexed bioseq */
 
-  IndexRecordedFeatures (sep, dorevfeats, baseItemID);
+  IndexRecordedFeatures (sep, dorevfeats, baseItemID, lazy);
 
   /* set best protein feature for segmented protein bioseqs and their parts */
 
@@ -8172,6 +8368,12 @@ static Uint2 LIBCALL s_DoSeqMgrIndexFeatures (
 
   ValNodeFreeData (exind.adphead);
 
+  /* held bioseqs now build their sorted feature arrays on first access */
+
+  if (lazy) {
+    VisitBioseqsInSep (sep, NULL, ReleaseHeldFeatureIndex);
+  }
+
   return entityID;
 }
 
@@ -8185,6 +8387,37 @@ NLM_EXTERN Uint2 LIBCALL SeqMgrIndexFeaturesExEx (
   ValNodePtr extra
 )
 
+{
+  Uint2      eID;
+  Boolean    lazy = FALSE;
+  Int4       ret;
+  SeqMgrPtr  smp;
+
+  smp = SeqMgrReadLock ();
+  if (smp != NULL) {
+    lazy = smp->lazy_feat_index;
+  }
+  SeqMgrUnlock ();
+
+  ret = NlmMutexLockEx (&smp_feat_index_mutex);
+  if (ret) {
+    ErrPostEx (SEV_FATAL, 0, 0, "SeqMgrIndexFeatures mutex failed [%ld]", (long) ret);
+    return 0;
+  }
+
+  eID = s_DoSeqMgrIndexFeatures (entityID, ptr, flip, dorevfeats, extra, lazy, NULL);
+
+  NlmMutexUnlock (smp_feat_index_mutex);
+
+  return eID;
+}
+
+NLM_EXTERN Uint2 LIBCALL SeqMgrIndexFeaturesLazy (
+  Uint2 entityID,
+  Pointer ptr,
+  SeqLocPtr region
+)
+
 {
   Uint2  eID;
   Int4   ret;
@@ -8195,13 +8428,67 @@ NLM_EXTERN Uint2 LIBCALL SeqMgrIndexFeaturesExEx (
     return 0;
   }
 
-  eID = s_DoSeqMgrIndexFeatures (entityID, ptr, flip, dorevfeats, extra);
+  eID = s_DoSeqMgrIndexFeatures (entityID, ptr, FALSE, FALSE, NULL, TRUE, region);
 
   NlmMutexUnlock (smp_feat_index_mutex);
 
   return eID;
 }
 
+NLM_EXTERN void LIBCALL SeqMgrSetLazyFeatureIndexing (
+  Boolean lazy
+)
+
+{
+  SeqMgrPtr  smp;
+
+  smp = SeqMgrWriteLock ();
+  if (smp == NULL) return;
+  smp->lazy_feat_index = lazy;
+  SeqMgrUnlock ();
+}
+
+/* builds sorted feature arrays held back by lazy indexing, called from SeqMgrGetOmdpForBioseq */
+
+static void FinishLazyFeatureIndex (BioseqPtr bsp, ObjMgrDataPtr omdp)
+
+{
+  BioseqExtraPtr  bspextra;
+  Uint2           entityID;
+  SeqEntryPtr     oldscope;
+  Int4            ret;
+
+  if (bsp == NULL || omdp == NULL) return;
+  bspextra = (BioseqExtraPtr) omdp->extradata;
+  if (bspextra == NULL) return;
+
+  ret = NlmMutexLockEx (&smp_feat_index_mutex);
+  if (ret) {
+    ErrPostEx (SEV_FATAL, 0, 0, "SeqMgrIndexFeatures mutex failed [%ld]", (long) ret);
+    return;
+  }
+
+  /* another thread may have finished it, or this thread is already sorting it */
+
+  if (bspextra->pendingIndex == LAZY_INDEX_PENDING) {
+    bspextra->pendingIndex = LAZY_INDEX_BUSY;
+
+    entityID = bsp->idx.entityID;
+    if (entityID < 1) {
+      entityID = ObjMgrGetEntityIDForPointer (bsp);
+    }
+    oldscope = SeqEntrySetScope (SeqMgrGetTopSeqEntryForEntity (entityID));
+
+    SortRecordedFeatures (bsp, bspextra, bspextra->pendingRevFeats, bspextra->pendingBaseItemID);
+
+    SeqEntrySetScope (oldscope);
+
+    bspextra->pendingIndex = LAZY_INDEX_NONE;
+  }
+
+  NlmMutexUnlock (smp_feat_index_mutex);
+}
+
 NLM_EXTERN Uint2 LIBCALL SeqMgrIndexFeaturesEx (
   Uint2 entityID,
   Pointer ptr,
@@ -8722,6 +9009,7 @@ static SeqFeatPtr SeqMgrGetBestOverlappingFeat (
   Int4            swap;
   SeqLocPtr       tmp;
   Int4            to;
+  Int4Ptr         tree = NULL;
 
   if (context != NULL) {
     MemSet ((Pointer) context, 0, sizeof (SeqMgrFeatContext));
@@ -8749,26 +9037,32 @@ static SeqFeatPtr SeqMgrGetBestOverlappingFeat (
     case FEATDEF_GENE :
       array = bspextra->genesByPos;
       num = bspextra->numgenes;
+      tree = bspextra->genesByRight;
       break;
     case FEATDEF_CDS :
       array = bspextra->CDSsByPos;
       num = bspextra->numCDSs;
+      tree = bspextra->CDSsByRight;
       break;
     case FEATDEF_mRNA :
       array = bspextra->mRNAsByPos;
       num = bspextra->nummRNAs;
+      tree = bspextra->mRNAsByRight;
       break;
     case FEATDEF_PUB :
       array = bspextra->pubsByPos;
       num = bspextra->numpubs;
+      tree = bspextra->pubsByRight;
       break;
     case FEATDEF_BIOSRC :
       array = bspextra->orgsByPos;
       num = bspextra->numorgs;
+      tree = bspextra->orgsByRight;
       break;
       case FEATDEF_operon :
       array = bspextra->operonsByPos;
       num = bspextra->numoperons;
+      tree = bspextra->operonsByRight;
     default :
       break;
   }
@@ -8833,7 +9127,9 @@ static SeqFeatPtr SeqMgrGetBestOverlappingFeat (
     }
   }
 
-  if (feat != NULL) {
+  if (tree != NULL) {
+    hier = PrevOverlappingItem (tree, R, left);
+  } else if (feat != NULL) {
     hier = feat->overlap;
   }
 
@@ -8910,7 +9206,8 @@ static SeqFeatPtr SeqMgrGetBestOverlappingFeat (
     feat = array [R];
   }
 
-  /* also will go up gene overlap hierarchy pointers from original R hit */
+  /* also will go up gene overlap hierarchy pointers from original R hit, */
+  /* or visit every earlier feature that reaches the location if indexed */
 
   while (hier != -1) {
 
@@ -8946,7 +9243,13 @@ static SeqFeatPtr SeqMgrGetBestOverlappingFeat (
           }
         }
       }
-      hier = feat->overlap;
+      if (tree != NULL) {
+        hier = PrevOverlappingItem (tree, hier, left);
+      } else {
+        hier = feat->overlap;
+      }
+    } else if (tree != NULL) {
+      hier = PrevOverlappingItem (tree, hier, left);
     } else {
       hier = -1;
     }
@@ -10044,6 +10347,10 @@ NLM_EXTERN Int4 LIBCALL SeqMgrExploreDescriptors (BioseqPtr bsp, Pointer userdat
   return count;
 }
 
+/* the reverse position index is built on first use, possibly by several threads */
+
+static TNlmMutex  smp_feats_by_rev_mutex = NULL;
+
 static Int4 LIBCALL SeqMgrExploreFeaturesInt (BioseqPtr bsp, Pointer userdata,
                                               SeqMgrFeatExploreProc userfunc,
                                               SeqLocPtr locationFilter,
@@ -10083,22 +10390,27 @@ static Int4 LIBCALL SeqMgrExploreFeaturesInt (BioseqPtr bsp, Pointer userdata,
 
   if (doreverse) {
     if (bspextra->featsByRev == NULL) {
+      NlmMutexLockEx (&smp_feats_by_rev_mutex);
+      if (bspextra->featsByRev == NULL) {
 
-      /* index by reverse position if not already done */
+        /* index by reverse position if not already done, publish when sorted */
 
-      featsByRev = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (bspextra->numfeats + 1));
-      bspextra->featsByRev = featsByRev;
+        featsByRev = (SMFeatItemPtr PNTR) MemNew (sizeof (SMFeatItemPtr) * (bspextra->numfeats + 1));
 
-      if (featsByRev != NULL) {
-        featsByID = bspextra->featsByID;
-        for (i = 0; i < (Uint4) bspextra->numfeats; i++) {
-          featsByRev [i] = featsByID [i];
-        }
+        if (featsByRev != NULL) {
+          featsByID = bspextra->featsByID;
+          for (i = 0; i < (Uint4) bspextra->numfeats; i++) {
+            featsByRev [i] = featsByID [i];
+          }
+
+          /* sort all features by feature reverse location on bioseq */
 
-        /* sort all features by feature reverse location on bioseq */
+          StableMergeSort ((VoidPtr) featsByRev, (size_t) bspextra->numfeats, sizeof (SMFeatItemPtr), SortFeatItemListByRev);
+        }
 
-        StableMergeSort ((VoidPtr) featsByRev, (size_t) bspextra->numfeats, sizeof (SMFeatItemPtr), SortFeatItemListByRev);
+        bspextra->featsByRev = featsByRev;
       }
+      NlmMutexUnlock (smp_feats_by_rev_mutex);
     }
 
     featsByPos = bspextra->featsByRev;
@@ -128,6 +128,7 @@ typedef struct seqmng {        /* functions for sequence data management */
 	SeqIdIndexBlockPtr BioseqIndexData;    /* what BioseqIndex points to */
 	Boolean is_write_locked;
 	Int4 hold_indexing;      /* set by SeqMgrHoldIndexing */
+	Boolean lazy_feat_index;  /* set by SeqMgrSetLazyFeatureIndexing */
 	SIDPreCacheFunc seq_id_precache_func;
 	SeqLenLookupFunc seq_len_lookup_func;
 	AccnVerLookupFunc accn_ver_lookup_func;
@@ -778,6 +779,13 @@ typedef struct bioseqextra {
   SMFeatItemPtr PNTR  operonsByPos;    /* subset of featsByPos array containing only operon features */
   SMFeatItemPtr PNTR  genesByLocusTag; /* array of gene features sorted by locus_tag */
 
+  Int4Ptr             genesByRight;    /* implicit tree of largest right ends over genesByPos for overlap queries */
+  Int4Ptr             mRNAsByRight;    /* implicit tree of largest right ends over mRNAsByPos */
+  Int4Ptr             CDSsByRight;     /* implicit tree of largest right ends over CDSsByPos */
+  Int4Ptr             pubsByRight;     /* implicit tree of largest right ends over pubsByPos */
+  Int4Ptr             orgsByRight;     /* implicit tree of largest right ends over orgsByPos */
+  Int4Ptr             operonsByRight;  /* implicit tree of largest right ends over operonsByPos */
+
   SMFidItemPtr PNTR   featsByFeatID;   /* array of features sorted by feature ID string */
 
   BioseqPtr           parentBioseq;    /* segmented parent of this raw part all packaged together */
@@ -805,6 +813,9 @@ typedef struct bioseqextra {
   Uint4               bspItemID;       /* for bioseq explore functions */
   Uint4               bspIndex;        /* for bioseq explore functions */
   Int2                blocksize;       /* size of SMFeatBlock.data array to avoid wasting space */
+  Uint4               pendingBaseItemID; /* baseItemID saved for lazily sorted feature arrays */
+  Boolean             pendingRevFeats; /* dorevfeats saved for lazily sorted feature arrays */
+  Uint1               pendingIndex;    /* lazy indexing state, sorted feature arrays built on first access */
                                        /* additional fields to map between genome record and parts,
                                           genomic DNA and mRNA, and mRNA and protein */
 } BioseqExtra, PNTR BioseqExtraPtr;
@@ -77,6 +77,30 @@ static Uint1Ptr Na2toNa4 = NULL;
 static Uint1Ptr Na2to4Bit = NULL;
 static Uint1Ptr Na4to4Bit = NULL;
 static TNlmMutex seqport_mutex = NULL;
+static TNlmMutex seqport_read_mutex = NULL;
+
+
+/*****************************************************************************
+*
+*   SeqPortReadBytes(bs, pos, buf, len)
+*     seeks and reads as one step, since the ByteStore of a Bioseq keeps a
+*       single cursor (and a lazily built unit index) for all its readers,
+*       which may be SeqPorts on different threads
+*
+*****************************************************************************/
+
+static Int4 SeqPortReadBytes (ByteStorePtr bs, Int4 pos, VoidPtr buf, Int4 len)
+
+{
+  Int4  total;
+
+  NlmMutexLockEx (&seqport_read_mutex);
+  BSSeek (bs, pos, SEEK_SET);
+  total = BSRead (bs, buf, len);
+  NlmMutexUnlock (seqport_read_mutex);
+
+  return total;
+}
 
 
 /*****************************************************************************
@@ -547,6 +571,237 @@ NLM_EXTERN Uint2Ptr LIBCALL MapNa4ByteTo4BitString (Uint1Ptr bytep, Uint2Ptr buf
   return ptr;
 }
 
+/*****************************************************************************
+*
+*   Reverse complement mapping arrays
+*      Each entry holds the residues of one compressed byte in reverse order,
+*      already complemented, so bytes taken from the end of a run decode
+*      straight into minus strand order, 4 or 2 residues per lookup.
+*      The complement of an ncbi4na code is the code with its bits reversed,
+*      which leaves gap (0) and N (15) unchanged.
+*
+*****************************************************************************/
+
+static Uint1Ptr Na2toIUPACRevComp = NULL;
+static Uint1Ptr Na4toIUPACRevComp = NULL;
+static Uint1Ptr Na4toIUPACplusGapRevComp = NULL;
+static Uint1Ptr Na2to4BitRevComp = NULL;
+static Uint1Ptr Na4to4BitRevComp = NULL;
+
+static Uint1Ptr MakeNaRevCompTable (Int2 bc, CharPtr convert)
+
+{
+  Uint1     code;
+  Int2      byte, j;
+  Uint1Ptr  table;
+
+  table = (Uint1Ptr) MemNew (sizeof (Uint1) * 256 * bc);
+  if (table == NULL) return NULL;
+
+  for (byte = 0; byte < 256; byte++) {
+    for (j = 0; j < bc; j++) {
+
+      /* residue bc - 1 - j of byte, as an ncbi4na code */
+
+      if (bc == 4) {
+        code = (Uint1) (1 << ((byte >> (2 * j)) & 3));
+      } else {
+        code = (Uint1) ((byte >> (4 * j)) & 15);
+      }
+
+      /* reverse the bits to complement it */
+
+      code = (Uint1) (((code & 1) << 3) | ((code & 2) << 1) |
+                      ((code & 4) >> 1) | ((code & 8) >> 3));
+      table [byte * bc + j] = (Uint1) convert [code];
+    }
+  }
+
+  return table;
+}
+
+static void InitNaRevComp (void)
+
+{
+  Char  iupac [16] = {'N', 'A', 'C', 'M', 'G', 'R', 'S', 'V',
+                      'T', 'W', 'Y', 'H', 'K', 'D', 'B', 'N'};
+  Char  iupacplusgap [16] = {'-', 'A', 'C', 'M', 'G', 'R', 'S', 'V',
+                             'T', 'W', 'Y', 'H', 'K', 'D', 'B', 'N'};
+  Char  fourbit [16] = {15, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+  Int4  ret;
+  Uint1Ptr Na2toIUPACRevComp_local = NULL;
+
+  ret = NlmMutexLockEx (&seqport_mutex);  /* protect this section */
+  if (ret) {
+    ErrPostEx (SEV_FATAL, 0, 0, "MapNaByteToRevCompString mutex failed [%ld]", (long) ret);
+    return;
+  }
+
+  if (Na2toIUPACRevComp == NULL) {
+    Na4toIUPACRevComp = MakeNaRevCompTable (2, iupac);
+    Na4toIUPACplusGapRevComp = MakeNaRevCompTable (2, iupacplusgap);
+    Na2to4BitRevComp = MakeNaRevCompTable (4, fourbit);
+    Na4to4BitRevComp = MakeNaRevCompTable (2, fourbit);
+
+    /* set last, other threads test this one */
+
+    if (Na4toIUPACRevComp != NULL && Na4toIUPACplusGapRevComp != NULL &&
+        Na2to4BitRevComp != NULL && Na4to4BitRevComp != NULL) {
+      Na2toIUPACRevComp_local = MakeNaRevCompTable (4, iupac);
+    }
+    Na2toIUPACRevComp = Na2toIUPACRevComp_local;
+  }
+
+  NlmMutexUnlock (seqport_mutex);
+}
+
+/*****************************************************************************
+*
+*   MapNa2ByteToIUPACRevCompString and relatives
+*      decode total compressed bytes into the reverse complement of the
+*      residues they hold, reading bytep from the last byte back to the first
+*      return pointer past the last residue written, or buf on failure
+*
+*****************************************************************************/
+
+NLM_EXTERN Uint4Ptr LIBCALL MapNa2ByteToIUPACRevCompString (Uint1Ptr bytep, Uint4Ptr buf, Int4 total)
+
+{
+  Uint4Ptr  ptr;
+  Uint4Ptr  tbl;
+
+  if (bytep == NULL || buf == NULL) return buf;
+
+  if (Na2toIUPACRevComp == NULL) {
+    InitNaRevComp ();
+  }
+
+  if (Na2toIUPACRevComp == NULL) return buf;
+
+  tbl = (Uint4Ptr) Na2toIUPACRevComp;
+  ptr = buf;
+  bytep += total;
+
+  /* 4 characters per byte, 16 per pass */
+
+  for (; total >= 4; total -= 4) {
+    bytep -= 4;
+    ptr [0] = tbl [bytep [3]];
+    ptr [1] = tbl [bytep [2]];
+    ptr [2] = tbl [bytep [1]];
+    ptr [3] = tbl [bytep [0]];
+    ptr += 4;
+  }
+  while (total > 0) {
+    bytep--;
+    *ptr = tbl [*bytep];
+    ptr++;
+    total--;
+  }
+
+  return ptr;
+}
+
+static Uint2Ptr MapNa4ByteToRevComp (Uint1Ptr bytep, Uint2Ptr buf, Int4 total, Uint1Ptr table)
+
+{
+  Uint2Ptr  ptr;
+  Uint2Ptr  tbl;
+
+  tbl = (Uint2Ptr) table;
+  ptr = buf;
+  bytep += total;
+
+  /* 2 characters per byte, 8 per pass */
+
+  for (; total >= 4; total -= 4) {
+    bytep -= 4;
+    ptr [0] = tbl [bytep [3]];
+    ptr [1] = tbl [bytep [2]];
+    ptr [2] = tbl [bytep [1]];
+    ptr [3] = tbl [bytep [0]];
+    ptr += 4;
+  }
+  while (total > 0) {
+    bytep--;
+    *ptr = tbl [*bytep];
+    ptr++;
+    total--;
+  }
+
+  return ptr;
+}
+
+NLM_EXTERN Uint2Ptr LIBCALL MapNa4ByteToIUPACRevCompString (Uint1Ptr bytep, Uint2Ptr buf, Int4 total)
+
+{
+  if (bytep == NULL || buf == NULL) return buf;
+
+  if (Na2toIUPACRevComp == NULL) {
+    InitNaRevComp ();
+  }
+
+  if (Na2toIUPACRevComp == NULL) return buf;
+
+  return MapNa4ByteToRevComp (bytep, buf, total, Na4toIUPACRevComp);
+}
+
+NLM_EXTERN Uint2Ptr LIBCALL MapNa4ByteToIUPACplusGapRevCompString (Uint1Ptr bytep, Uint2Ptr buf, Int4 total)
+
+{
+  if (bytep == NULL || buf == NULL) return buf;
+
+  if (Na2toIUPACRevComp == NULL) {
+    InitNaRevComp ();
+  }
+
+  if (Na2toIUPACRevComp == NULL) return buf;
+
+  return MapNa4ByteToRevComp (bytep, buf, total, Na4toIUPACplusGapRevComp);
+}
+
+NLM_EXTERN Uint4Ptr LIBCALL MapNa2ByteTo4BitRevCompString (Uint1Ptr bytep, Uint4Ptr buf, Int4 total)
+
+{
+  Uint4Ptr  ptr;
+  Uint4Ptr  tbl;
+
+  if (bytep == NULL || buf == NULL) return buf;
+
+  if (Na2toIUPACRevComp == NULL) {
+    InitNaRevComp ();
+  }
+
+  if (Na2toIUPACRevComp == NULL) return buf;
+
+  tbl = (Uint4Ptr) Na2to4BitRevComp;
+  ptr = buf;
+  bytep += total;
+
+  while (total > 0) {
+    bytep--;
+    *ptr = tbl [*bytep];
+    ptr++;
+    total--;
+  }
+
+  return ptr;
+}
+
+NLM_EXTERN Uint2Ptr LIBCALL MapNa4ByteTo4BitRevCompString (Uint1Ptr bytep, Uint2Ptr buf, Int4 total)
+
+{
+  if (bytep == NULL || buf == NULL) return buf;
+
+  if (Na2toIUPACRevComp == NULL) {
+    InitNaRevComp ();
+  }
+
+  if (Na2toIUPACRevComp == NULL) return buf;
+
+  return MapNa4ByteToRevComp (bytep, buf, total, Na4to4BitRevComp);
+}
+
 /*****************************************************************************
 *
 *   SeqPort Routines
@@ -1363,8 +1618,7 @@ NLM_EXTERN Int2 SeqPortSeek (SeqPortPtr spp, Int4 offset, Int2 origin)
                 diff = 100;
                 lim = pos + diff - 1;
             }
-            BSSeek(spp->bp, pos, SEEK_SET);
-            spcp->total = (Int2) BSRead(spp->bp, (VoidPtr)buf, 
+            spcp->total = (Int2) SeqPortReadBytes(spp->bp, pos, (VoidPtr)buf, 
 diff);
             spcp->ctr = 0;
             spp->bytepos = lim;
@@ -1380,8 +1634,7 @@ diff);
                 diff = 100;
                 lim = pos - diff + 1;
             }
-            BSSeek(spp->bp, lim, SEEK_SET);
-            spcp->total = (Int2) BSRead(spp->bp, (VoidPtr)buf, 
+            spcp->total = (Int2) SeqPortReadBytes(spp->bp, lim, (VoidPtr)buf, 
 diff);
             spcp->ctr = (Int2)(diff - 1);
             spp->bytepos = lim;
@@ -1491,11 +1744,11 @@ NLM_EXTERN Int4 SeqPortTell (SeqPortPtr spp)
 static Uint1 LIBCALL SeqPortQuickGetResidue (SeqPortPtr spp, SPCacheQPtr spcpq, Boolean plus_strand)
 
 {
-  Uint1    bytes [100];
-  Int4     curpos, pos, lim, diff;
+  Uint1    bytes [sizeof (spcpq->buf)];
+  Int4     curpos, pos, lim, diff, maxbytes;
   CharPtr  ptr;
   Uint1    residue = INVALID_RESIDUE;
-  Int2     total, i, j;
+  Int2     total, ctr;
 
   if (spp == NULL || spcpq == NULL) return INVALID_RESIDUE;
 
@@ -1505,7 +1758,9 @@ static Uint1 LIBCALL SeqPortQuickGetResidue (SeqPortPtr spp, SPCacheQPtr spcpq,
 
     if (spcpq->ctr >= spcpq->total) {
 
-      /* read next buffer of bytes */
+      /* read next buffer of bytes, as many as will fill the residue buffer */
+
+      maxbytes = sizeof (spcpq->buf) / (Int4) (spp->bc);
 
       if (plus_strand) {
 
@@ -1513,12 +1768,11 @@ static Uint1 LIBCALL SeqPortQuickGetResidue (SeqPortPtr spp, SPCacheQPtr spcpq,
         pos = curpos / (Int4) (spp->bc);
         lim = spp->stop / (Int4) (spp->bc);
         diff = lim - pos + 1;
-        if (diff > 100) {
-          diff = 100;
+        if (diff > maxbytes) {
+          diff = maxbytes;
           lim = pos + diff - 1;
         }
-        BSSeek (spp->bp, pos, SEEK_SET);
-        total = (Int2) BSRead (spp->bp, (VoidPtr) bytes, diff);
+        total = (Int2) SeqPortReadBytes (spp->bp, pos, (VoidPtr) bytes, diff);
         spp->bytepos = lim;
 
       } else {
@@ -1527,31 +1781,47 @@ static Uint1 LIBCALL SeqPortQuickGetResidue (SeqPortPtr spp, SPCacheQPtr spcpq,
         pos = curpos / (Int4) (spp->bc);
         lim = spp->start / (Int4) (spp->bc);
         diff = pos - lim + 1;
-        if (diff > 100) {
-          diff = 100;
+        if (diff > maxbytes) {
+          diff = maxbytes;
           lim = pos - diff + 1;
         }
-        BSSeek (spp->bp, lim, SEEK_SET);
-        total = (Int2) BSRead (spp->bp, (VoidPtr) bytes, diff);
+        total = (Int2) SeqPortReadBytes (spp->bp, lim, (VoidPtr) bytes, diff);
         spp->bytepos = lim;
 
       }
 
       /* buffer is not null terminated, so uses special copy function */
+      /* minus strand is decoded reverse complemented, last byte first */
 
       ptr = spcpq->buf;
 
       if (spp->newcode == Seq_code_iupacna) {
         if (spp->oldcode == Seq_code_ncbi2na) {
-          ptr = (CharPtr) MapNa2ByteToIUPACString (bytes, (Uint4Ptr) ptr, total);
+          if (plus_strand) {
+            ptr = (CharPtr) MapNa2ByteToIUPACString (bytes, (Uint4Ptr) ptr, total);
+          } else {
+            ptr = (CharPtr) MapNa2ByteToIUPACRevCompString (bytes, (Uint4Ptr) ptr, total);
+          }
         } else if (spp->oldcode == Seq_code_ncbi4na) {
-          ptr = (CharPtr) MapNa4ByteToIUPACString (bytes, (Uint2Ptr) ptr, total);
+          if (plus_strand) {
+            ptr = (CharPtr) MapNa4ByteToIUPACString (bytes, (Uint2Ptr) ptr, total);
+          } else {
+            ptr = (CharPtr) MapNa4ByteToIUPACRevCompString (bytes, (Uint2Ptr) ptr, total);
+          }
         }
       } else if (spp->newcode == Seq_code_ncbi4na) {
         if (spp->oldcode == Seq_code_ncbi2na) {
-          ptr = (CharPtr) MapNa2ByteTo4BitString (bytes, (Uint4Ptr) ptr, total);
+          if (plus_strand) {
+            ptr = (CharPtr) MapNa2ByteTo4BitString (bytes, (Uint4Ptr) ptr, total);
+          } else {
+            ptr = (CharPtr) MapNa2ByteTo4BitRevCompString (bytes, (Uint4Ptr) ptr, total);
+          }
         } else if (spp->oldcode == Seq_code_ncbi4na) {
-          ptr = (CharPtr) MapNa4ByteTo4BitString (bytes, (Uint2Ptr) ptr, total);
+          if (plus_strand) {
+            ptr = (CharPtr) MapNa4ByteTo4BitString (bytes, (Uint2Ptr) ptr, total);
+          } else {
+            ptr = (CharPtr) MapNa4ByteTo4BitRevCompString (bytes, (Uint2Ptr) ptr, total);
+          }
         }
       }
 
@@ -1569,28 +1839,20 @@ static Uint1 LIBCALL SeqPortQuickGetResidue (SeqPortPtr spp, SPCacheQPtr spcpq,
           }
         }
       } else {
-        if (pos == (curpos / (Int4) (spp->bc))) {
-          diff = (curpos + 1) % (Int4) (spp->bc);
-          if (diff > 0) {
-            spcpq->total -= (Int4) (spp->bc) - diff;
-          }
-        }
-        if (lim == (spp->start / (Int4) (spp->bc))) {
-          spcpq->ctr += (spp->start) % (Int4) (spp->bc);
-        }
 
-        /* reverse complement */
+        /* trim residues past curpos from the front of the reversed buffer */
 
-        for (i = spcpq->ctr, j = spcpq->total - 1; i < j; i++, j--) {
-          residue = spcpq->buf [i];
-          spcpq->buf [i] = spcpq->buf [j];
-          spcpq->buf [j] = residue;
-        }
-        for (i = spcpq->ctr; i < spcpq->total; i++) {
-          residue = spcpq->buf [i];
-          spcpq->buf [i] = SeqCodeTableComp (spp->sctp, residue);
+        diff = (curpos + 1) % (Int4) (spp->bc);
+        if (diff > 0) {
+          spcpq->ctr += (Int4) (spp->bc) - diff;
         }
 
+        /* and residues before start from the back */
+
+        if (lim == (spp->start / (Int4) (spp->bc))) {
+          ctr = (Int2) ((spp->start) % (Int4) (spp->bc));
+          spcpq->total -= ctr;
+        }
       }
 
     }
@@ -1699,9 +1961,8 @@ NLM_EXTERN Uint1 LIBCALL SeqPortGetResidue (SeqPortPtr spp)
                             diff = 100;
                             lim = pos - 100 + 1;
                         }
-                        BSSeek(spp->bp, lim, SEEK_SET);
                         spcp->total = 
-(Int2)BSRead(spp->bp, (VoidPtr)(spcp->buf), diff);
+(Int2)SeqPortReadBytes(spp->bp, lim, (VoidPtr)(spcp->buf), diff);
                         spcp->ctr = (Int2)(diff - 1);
                         spp->bytepos = lim;
                     }
@@ -1721,9 +1982,8 @@ byte */
                             diff = 100;
                             lim = pos + diff - 1;
                         }
-                        BSSeek(spp->bp, pos, SEEK_SET);
                         spcp->total = 
-(Int2)BSRead(spp->bp, (VoidPtr)(spcp->buf), diff);
+(Int2)SeqPortReadBytes(spp->bp, pos, (VoidPtr)(spcp->buf), diff);
                         spcp->ctr = 0;
                         spp->bytepos = lim;
                     }
@@ -1961,29 +2221,13 @@ NLM_EXTERN Int2 LIBCALL SeqPortRead (SeqPortPtr spp, Uint1Ptr buf, Int2 len)
             loopmax = MIN ((spp->totlen - spp->curpos), (spcpq->total - spcpq->ctr));
             loopmax = MIN (loopmax, (Int4) (len - ctr));
         }
-        /* loopmax saves multiple comparisons, speeds up significantly */
+        /* quick cache holds only expanded residues, so copy the run in one block */
         if (loopmax > 0) {
-            while (loopmax > 0) {
-                retval = spcpq->buf [spcpq->ctr];
-                spcpq->ctr++;
-                spp->curpos++;
-                loopmax--;
-                if (IS_residue (retval)) {
-                    *buf = retval;
-                    buf++;
-                    ctr++;
-                } else {
-                    if (! ctr)   /* first one */
-                    {
-                        ctr = retval;   /* send return as negative number */
-                        ctr *= -1;
-                        return ctr;
-                    } else {
-                        spp->lastmsg = retval;
-                        return ctr;
-                    }
-                }
-            }
+            MemCopy (buf, spcpq->buf + spcpq->ctr, (size_t) loopmax);
+            spcpq->ctr += (Int2) loopmax;
+            spp->curpos += loopmax;
+            buf += loopmax;
+            ctr += (Int2) loopmax;
         } else {
             retval = SeqPortGetResidue(spp);
             if (IS_residue(retval))
@@ -2189,7 +2433,7 @@ static Int4 SeqPortStreamBlock (
   Char      ch;
   Int4      count = 0, cumulative, total;
   Int2      from, to;
-  Boolean   many_dashes, single_dash;
+  Boolean   many_dashes, rcdecode, single_dash;
   CharPtr   nd, ptr, str, tmp;
 
   if (bs == NULL || sdp == NULL) return 0;
@@ -2199,23 +2443,37 @@ static Int4 SeqPortStreamBlock (
   buf = (CharPtr) uncomp;
   bytes = (Uint1Ptr) compr;
 
-  BSSeek (bs, blk, SEEK_SET);
-
-  total = BSRead (bs, (VoidPtr) bytes, 1000L);
+  total = SeqPortReadBytes (bs, blk, (VoidPtr) bytes, 1000L);
   if (total < 1) return 0;
 
+  /* 2na and 4na minus strand is decoded already reverse complemented */
+
+  rcdecode = (Boolean) (revcomp && (alphabet == Seq_code_ncbi2na || alphabet == Seq_code_ncbi4na));
+
   ptr = buf;
   switch (alphabet) {
     case Seq_code_ncbi2na :
-      ptr = (CharPtr) MapNa2ByteToIUPACString (bytes, (Uint4Ptr) ptr, total);
+      if (rcdecode) {
+        ptr = (CharPtr) MapNa2ByteToIUPACRevCompString (bytes, (Uint4Ptr) ptr, total);
+      } else {
+        ptr = (CharPtr) MapNa2ByteToIUPACString (bytes, (Uint4Ptr) ptr, total);
+      }
       break;
     case Seq_code_ncbi4na :
       single_dash = (Boolean) ((sdp->flags & STREAM_GAP_MASK) == GAP_TO_SINGLE_DASH);
       many_dashes = (Boolean) ((sdp->flags & STREAM_GAP_MASK) == EXPAND_GAPS_TO_DASHES);
       if (single_dash || many_dashes) {
-        ptr = (CharPtr) MapNa4ByteToIUPACplusGapString (bytes, (Uint2Ptr) ptr, total);
+        if (rcdecode) {
+          ptr = (CharPtr) MapNa4ByteToIUPACplusGapRevCompString (bytes, (Uint2Ptr) ptr, total);
+        } else {
+          ptr = (CharPtr) MapNa4ByteToIUPACplusGapString (bytes, (Uint2Ptr) ptr, total);
+        }
       } else {
-        ptr = (CharPtr) MapNa4ByteToIUPACString (bytes, (Uint2Ptr) ptr, total);
+        if (rcdecode) {
+          ptr = (CharPtr) MapNa4ByteToIUPACRevCompString (bytes, (Uint2Ptr) ptr, total);
+        } else {
+          ptr = (CharPtr) MapNa4ByteToIUPACString (bytes, (Uint2Ptr) ptr, total);
+        }
       }
       break;
     default :
@@ -2242,42 +2500,40 @@ static Int4 SeqPortStreamBlock (
     from += start - cumulative;
   }
 
+  to = (Int2) total;
   if (stop < cumulative + total) {
     to = (Int2) (stop - cumulative + 1);
-    buf [to] = '\0';
   }
 
-  str = buf + from;
+  if (rcdecode) {
 
-  if (revcomp) {
+    /* buffer is reversed, so plus strand range [from, to) is mirrored */
 
-    /* reverse string first - middle base not touched, so cannot also complement here */
+    buf [total - from] = '\0';
+    str = buf + (total - to);
 
-    nd = str;
-    while (*nd != '\0') {
-      nd++;
-    }
-    nd--;
+  } else {
 
-    tmp = str;
-    while (nd > tmp) {
-      ch = *nd;
-      *nd = *tmp;
-      *tmp = ch;
-      nd--;
-      tmp++;
-    }
+    buf [to] = '\0';
+    str = buf + from;
 
-    /* now complement every base in string */
+    if (revcomp) {
 
-    nd = str;
-    ch = *nd;
-    while (ch != '\0') {
-      *nd = sdp->letterToComp [(int) (Uint1) ch];
-      nd++;
-      ch = *nd;
-    }
+      /* reverse and complement in one pass, meeting in the middle */
 
+      tmp = str;
+      nd = str + (to - from) - 1;
+      while (nd > tmp) {
+        ch = *nd;
+        *nd = sdp->letterToComp [(int) (Uint1) *tmp];
+        *tmp = sdp->letterToComp [(int) (Uint1) ch];
+        nd--;
+        tmp++;
+      }
+      if (nd == tmp) {
+        *tmp = sdp->letterToComp [(int) (Uint1) *tmp];
+      }
+    }
   }
 
   /* send characters to stream callback */
@@ -2286,11 +2542,7 @@ static Int4 SeqPortStreamBlock (
 
   /* return number of characters sent */
 
-  tmp = str;
-  while (*tmp != '\0') {
-    count++;
-    tmp++;
-  }
+  count = StringLen (str);
 
   return count;
 }
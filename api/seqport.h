@@ -282,6 +282,14 @@ NLM_EXTERN Uint2Ptr LIBCALL MapNa2ByteToNa4String PROTO((Uint1Ptr bytep, Uint2Pt
 NLM_EXTERN Uint4Ptr LIBCALL MapNa2ByteTo4BitString PROTO((Uint1Ptr bytep, Uint4Ptr buf, Int4 total));
 NLM_EXTERN Uint2Ptr LIBCALL MapNa4ByteTo4BitString PROTO((Uint1Ptr bytep, Uint2Ptr buf, Int4 total));
 
+/* reverse complement versions read bytep from the end, so buf gets the minus strand */
+
+NLM_EXTERN Uint4Ptr LIBCALL MapNa2ByteToIUPACRevCompString PROTO((Uint1Ptr bytep, Uint4Ptr buf, Int4 total));
+NLM_EXTERN Uint2Ptr LIBCALL MapNa4ByteToIUPACRevCompString PROTO((Uint1Ptr bytep, Uint2Ptr buf, Int4 total));
+NLM_EXTERN Uint2Ptr LIBCALL MapNa4ByteToIUPACplusGapRevCompString PROTO((Uint1Ptr bytep, Uint2Ptr buf, Int4 total));
+NLM_EXTERN Uint4Ptr LIBCALL MapNa2ByteTo4BitRevCompString PROTO((Uint1Ptr bytep, Uint4Ptr buf, Int4 total));
+NLM_EXTERN Uint2Ptr LIBCALL MapNa4ByteTo4BitRevCompString PROTO((Uint1Ptr bytep, Uint2Ptr buf, Int4 total));
+
 
 /*****************************************************************************
 *
@@ -4670,22 +4670,24 @@ ScoreAndEvalueToBuffers(FloatHi bit_score, FloatHi evalue,
    } else if (evalue < 0.0009) {
       sprintf(*evalue_buf, "%3.0le", evalue);
    } else if (evalue < 0.1) {
-      sprintf(*evalue_buf, "%4.3lf", evalue);
+      FloatHiToFixed(evalue, 3, 4, *evalue_buf);
    } else if (evalue < 1.0) { 
-      sprintf(*evalue_buf, "%3.2lf", evalue);
+      FloatHiToFixed(evalue, 2, 3, *evalue_buf);
    } else if (evalue < 10.0) {
-      sprintf(*evalue_buf, "%2.1lf", evalue);
+      FloatHiToFixed(evalue, 1, 2, *evalue_buf);
    } else { 
-      sprintf(*evalue_buf, "%5.0lf", evalue);
+      FloatHiToFixed(evalue, 0, 5, *evalue_buf);
    }
+   /* The fixed point cases go through FloatHiToFixed, which gives the same
+      text as sprintf at a fraction of the cost */
    if (bit_score > 9999)
       sprintf(bit_score_buf, "%4.3le", bit_score);
    else if (bit_score > 99.9)
-      sprintf(bit_score_buf, "%4.0ld", (long)bit_score);
+      FloatHiToFixed((FloatHi)(long)bit_score, 0, 4, bit_score_buf);
    else if (format_options & TX_INTEGER_BIT_SCORE)
-      sprintf(bit_score_buf, "%4.0lf", bit_score);
+      FloatHiToFixed(bit_score, 0, 4, bit_score_buf);
    else
-      sprintf(bit_score_buf, "%4.1lf", bit_score);
+      FloatHiToFixed(bit_score, 1, 4, bit_score_buf);
 #endif
 }
 
@@ -70,6 +70,7 @@ static char    *this_file = __FILE__;
 #include <macroapi.h>
 #include <objvalid.h>
 #include <valapi.h>
+#include <ncbithr.h>
 #include "ecnum_specific.inc"
 #include "ecnum_ambiguous.inc"
 #include "ecnum_deleted.inc"
@@ -182,6 +183,7 @@ NLM_EXTERN void ValidStructClear (ValidStructPtr vsp)
   Boolean         indexerVersion;
   Boolean         disableSuppression;
   Int2            validationLimit;
+  Int2            numThreads;
   ValidErrorFunc  errfunc;
   Pointer         userdata;
   Boolean         convertGiToAccn;
@@ -241,6 +243,7 @@ NLM_EXTERN void ValidStructClear (ValidStructPtr vsp)
   indexerVersion = vsp->indexerVersion;
   disableSuppression = vsp->disableSuppression;
   validationLimit = vsp->validationLimit;
+  numThreads = vsp->numThreads;
   errfunc = vsp->errfunc;
   userdata = vsp->userdata;
   convertGiToAccn = vsp->convertGiToAccn;
@@ -297,6 +300,7 @@ NLM_EXTERN void ValidStructClear (ValidStructPtr vsp)
   vsp->indexerVersion = indexerVersion;
   vsp->disableSuppression = disableSuppression;
   vsp->validationLimit = validationLimit;
+  vsp->numThreads = numThreads;
   vsp->errfunc = errfunc;
   vsp->userdata = userdata;
   vsp->convertGiToAccn = convertGiToAccn;
@@ -1035,6 +1039,168 @@ NLM_EXTERN CharPtr GetValidExplanation (int errcode, int subcode)
   return Nlm_GetErrLongText (THIS_MODULE, errcode, subcode);
 }
 
+/*
+*  When features are validated on several threads, messages are not reported
+*  as they are found.  Each is saved in a queue, features are queued as jobs
+*  that hold their own messages, and the queue is reported once all jobs are
+*  done, so messages come out in the same order as in serial validation.
+*/
+
+#define VALID_QUEUE_MSG  1
+#define VALID_QUEUE_FEAT 2
+
+typedef struct validmsg {
+  Boolean  custom;
+  ErrSev   severity;
+  int      errcode;
+  int      subcode;
+  Uint2    entityID;
+  Uint2    itemtype;
+  Uint4    itemID;
+  CharPtr  accession;
+  CharPtr  featureID;
+  CharPtr  message;
+  CharPtr  objtype;
+  CharPtr  label;
+  CharPtr  context;
+  CharPtr  location;
+  CharPtr  product;
+} ValidMsgData, PNTR ValidMsgPtr;
+
+typedef struct validmsgqueue {
+  ValNodePtr  head;
+  ValNodePtr  tail;
+  Boolean     deferFeats;
+  Int4        numjobs;
+} ValidMsgQueue, PNTR ValidMsgQueuePtr;
+
+typedef struct validfeatjob {
+  ValidStruct    vs;
+  GatherContext  gc;
+  ValidMsgQueue  msgs;
+} ValidFeatJob, PNTR ValidFeatJobPtr;
+
+static void PrepareValidatorThreads (ValidStructPtr vsp);
+static void ValidateQueuedFeats (ValidStructPtr vsp, ValidMsgQueuePtr vqp);
+
+static void QueueValidItem (ValidMsgQueuePtr vqp, Uint1 choice, Pointer ptr)
+
+{
+  ValNodePtr  vnp;
+
+  vnp = ValNodeNew (NULL);
+  if (vnp == NULL) return;
+  vnp->choice = choice;
+  vnp->data.ptrvalue = ptr;
+
+  if (vqp->tail != NULL) {
+    vqp->tail->next = vnp;
+  } else {
+    vqp->head = vnp;
+  }
+  vqp->tail = vnp;
+}
+
+static void QueueValidMsg (
+  ValidStructPtr vsp,
+  Boolean custom,
+  ErrSev severity,
+  int errcode,
+  int subcode,
+  Uint2 entityID,
+  Uint2 itemtype,
+  Uint4 itemID,
+  CharPtr accession,
+  CharPtr featureID,
+  CharPtr message,
+  CharPtr objtype,
+  CharPtr label,
+  CharPtr context,
+  CharPtr location,
+  CharPtr product
+)
+
+{
+  ValidMsgPtr  vmp;
+
+  vmp = (ValidMsgPtr) MemNew (sizeof (ValidMsgData));
+  if (vmp == NULL) return;
+
+  vmp->custom = custom;
+  vmp->severity = severity;
+  vmp->errcode = errcode;
+  vmp->subcode = subcode;
+  vmp->entityID = entityID;
+  vmp->itemtype = itemtype;
+  vmp->itemID = itemID;
+  vmp->accession = StringSave (accession);
+  vmp->featureID = StringSave (featureID);
+  vmp->message = StringSave (message);
+  vmp->objtype = StringSave (objtype);
+  vmp->label = StringSave (label);
+  vmp->context = StringSave (context);
+  vmp->location = StringSave (location);
+  vmp->product = StringSave (product);
+
+  QueueValidItem ((ValidMsgQueuePtr) vsp->msgQueue, VALID_QUEUE_MSG, (Pointer) vmp);
+}
+
+static void ReportValidMsgQueue (ValidStructPtr vsp, ValidMsgQueuePtr vqp)
+
+{
+  GatherContext     gc;
+  GatherContextPtr  gcp;
+  ValidFeatJobPtr   job;
+  Int2              i;
+  ValNodePtr        next, vnp;
+  ValidMsgPtr       vmp;
+
+  MemSet ((Pointer) &gc, 0, sizeof (GatherContext));
+  gcp = &gc;
+
+  for (vnp = vqp->head; vnp != NULL; vnp = next) {
+    next = vnp->next;
+    if (vnp->choice == VALID_QUEUE_MSG) {
+      vmp = (ValidMsgPtr) vnp->data.ptrvalue;
+      if (vmp->custom) {
+        (*(vsp->errfunc)) (vmp->severity, vmp->errcode, vmp->subcode, vmp->entityID,
+                           vmp->itemtype, vmp->itemID, vmp->accession, vmp->featureID,
+                           vmp->message, vmp->objtype, vmp->label, vmp->context,
+                           vmp->location, vmp->product, vsp->userdata);
+      } else {
+        gc.entityID = vmp->entityID;
+        gc.itemID = vmp->itemID;
+        gc.thistype = vmp->itemtype;
+        ErrPostItem (vmp->severity, vmp->errcode, vmp->subcode, "%s", vmp->message);
+      }
+      MemFree (vmp->accession);
+      MemFree (vmp->featureID);
+      MemFree (vmp->message);
+      MemFree (vmp->objtype);
+      MemFree (vmp->label);
+      MemFree (vmp->context);
+      MemFree (vmp->location);
+      MemFree (vmp->product);
+      MemFree (vmp);
+    } else if (vnp->choice == VALID_QUEUE_FEAT) {
+      job = (ValidFeatJobPtr) vnp->data.ptrvalue;
+      for (i = 0; i < 6; i++) {
+        vsp->errors [i] += job->vs.errors [i];
+      }
+      if (job->vs.far_fetch_failure) {
+        vsp->far_fetch_failure = TRUE;
+      }
+      ReportValidMsgQueue (vsp, &(job->msgs));
+      MemFree (job);
+    }
+    MemFree (vnp);
+  }
+
+  vqp->head = NULL;
+  vqp->tail = NULL;
+  vqp->numjobs = 0;
+}
+
 static void CustValErr (ValidStructPtr vsp, ErrSev severity, int errcode, int subcode)
 
 {
@@ -1353,6 +1519,12 @@ static void CustValErr (ValidStructPtr vsp, ErrSev severity, int errcode, int su
     }
   }
 
+  if (vsp->msgQueue != NULL) {
+    QueueValidMsg (vsp, TRUE, severity, errcode, subcode, entityID, itemtype, itemID, accession,
+                   featureID, message, objtype, label, context, location, product);
+    return;
+  }
+
   (*errfunc) (severity, errcode, subcode, entityID, itemtype, itemID, accession,
               featureID, message, objtype, label, context, location, product, vsp->userdata);
 }
@@ -1702,7 +1874,13 @@ NLM_EXTERN void CDECL ValidErr (ValidStructPtr vsp, int severity, int code1, int
       tmp += diff;
     }
 
-    ErrPostItem ((ErrSev) (severity), code1, code2, "%s", vsp->errbuf);
+    if (vsp->msgQueue != NULL) {
+      QueueValidMsg (vsp, FALSE, (ErrSev) (severity), code1, code2,
+                     gcp ? gcp->entityID : 0, gcp ? gcp->thistype : 0, gcp ? gcp->itemID : 0,
+                     NULL, NULL, vsp->errbuf, NULL, NULL, NULL, NULL, NULL);
+    } else {
+      ErrPostItem ((ErrSev) (severity), code1, code2, "%s", vsp->errbuf);
+    }
     vsp->errbuf[0] = '\0';
     return;
   }
@@ -1835,7 +2013,13 @@ NLM_EXTERN void CDECL ValidErr (ValidStructPtr vsp, int severity, int code1, int
     }
   }
 
-  ErrPostItem ((ErrSev) (severity), code1, code2, "%s", vsp->errbuf);
+  if (vsp->msgQueue != NULL) {
+    QueueValidMsg (vsp, FALSE, (ErrSev) (severity), code1, code2,
+                   gcp ? gcp->entityID : 0, gcp ? gcp->thistype : 0, gcp ? gcp->itemID : 0,
+                   NULL, NULL, vsp->errbuf, NULL, NULL, NULL, NULL, NULL);
+  } else {
+    ErrPostItem ((ErrSev) (severity), code1, code2, "%s", vsp->errbuf);
+  }
   vsp->errbuf[0] = '\0';
 }
 
@@ -1969,6 +2153,122 @@ static Boolean StringLooksLikeFakeStructuredComment (CharPtr str)
 }
 
 
+/*****************************************************************************
+*
+*   Valid1SeqFeat(gcp)
+*     feature level checks, called from the gather callback or on a
+*     validation thread
+*
+*****************************************************************************/
+static void Valid1SeqFeat (GatherContextPtr gcp)
+
+{
+  ValidStructPtr     vsp;
+  BioSourcePtr       biop;
+  BioseqPtr          bsp;
+  Char               buf [64];
+  SeqMgrFeatContext  context;
+  Int2               limit;
+  PubdescPtr         pdp;
+  SeqFeatPtr         sfp;
+  SeqIdPtr           sip;
+  Char               tmp [64];
+
+  vsp = (ValidStructPtr) (gcp->userdata);
+  vsp->gcp = gcp;
+
+  limit = vsp->validationLimit;
+
+  if (!vsp->onlyspell) {
+    if (limit == VALIDATE_ALL || limit == VALIDATE_FEAT) {
+      ValidateSeqFeat (gcp);
+      sfp = (SeqFeatPtr) (gcp->thisitem);
+      if (sfp != NULL) {
+        if (sfp->data.choice == SEQFEAT_BIOSRC) {
+          biop = (BioSourcePtr) sfp->data.value.ptrvalue;
+          ValidateBioSource (vsp, gcp, biop, sfp, NULL);
+        }
+        if (sfp->data.choice == SEQFEAT_PUB) {
+          pdp = (PubdescPtr) sfp->data.value.ptrvalue;
+          ValidatePubdesc (vsp, gcp, pdp);
+        }
+        if (sfp->cit != NULL) {
+          ValidateSfpCit (vsp, gcp, sfp);
+        }
+        if (vsp->useSeqMgrIndexes) {
+          if (SeqMgrGetDesiredFeature (gcp->entityID, NULL, 0, 0, sfp, &context) == NULL) {
+            StringCpy (buf, "?");
+            bsp = vsp->bsp;
+            if (bsp != NULL) {
+              SeqIdWrite (bsp->id, buf, PRINTID_FASTA_LONG, sizeof (buf) - 1);
+            }
+            ValidErr (vsp, SEV_ERROR, ERR_SEQ_FEAT_UnindexedFeature, "Feature is not indexed on Bioseq %s", buf);
+          } else {
+            bsp = BioseqFindFromSeqLoc (sfp->location);
+            if (bsp != NULL) {
+              sip = SeqLocId (sfp->location);
+              if (sip != NULL && sip->choice != SEQID_GI && sip->choice != SEQID_GIBBSQ && sip->choice != SEQID_GIBBMT) {
+                SeqIdWrite (sip, buf, PRINTID_FASTA_SHORT, sizeof (buf) - 1);
+                for (sip = bsp->id; sip != NULL; sip = sip->next) {
+                  if (sip->choice == SEQID_GI || sip->choice == SEQID_GIBBSQ || sip->choice == SEQID_GIBBMT) continue;
+                  SeqIdWrite (sip, tmp, PRINTID_FASTA_SHORT, sizeof (tmp) - 1);
+                  if (StringICmp (buf, tmp) != 0) continue;
+                  if (StringCmp (buf, tmp) == 0) continue;
+                  ValidErr (vsp, SEV_ERROR, ERR_SEQ_FEAT_FeatureSeqIDCaseDifference,
+                            "Sequence identifier in feature location differs in capitalization with identifier on Bioseq");
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  if (limit == VALIDATE_ALL || limit == VALIDATE_FEAT) {
+    SpellCheckSeqFeat (gcp);
+  }
+}
+
+/*****************************************************************************
+*
+*   DeferSeqFeat(vsp, gcp)
+*     queues a feature for validation on a thread, with copies of the
+*     validator state and gather context as they are now
+*
+*****************************************************************************/
+static void DeferSeqFeat (ValidStructPtr vsp, GatherContextPtr gcp)
+
+{
+  ValidFeatJobPtr   job;
+  ValidMsgQueuePtr  vqp;
+
+  vqp = (ValidMsgQueuePtr) vsp->msgQueue;
+
+  job = (ValidFeatJobPtr) MemNew (sizeof (ValidFeatJob));
+  if (job == NULL) {
+    Valid1SeqFeat (gcp);
+    return;
+  }
+
+  MemCopy ((Pointer) &(job->vs), (Pointer) vsp, sizeof (ValidStruct));
+  MemCopy ((Pointer) &(job->gc), (Pointer) gcp, sizeof (GatherContext));
+  job->gc.userdata = (Pointer) &(job->vs);
+  job->vs.gcp = &(job->gc);
+  job->vs.errbuf = NULL;
+  MemSet ((Pointer) job->vs.errors, 0, sizeof (job->vs.errors));
+  job->vs.far_fetch_failure = FALSE;
+  job->vs.msgQueue = (VoidPtr) &(job->msgs);
+
+  QueueValidItem (vqp, VALID_QUEUE_FEAT, (Pointer) job);
+  (vqp->numjobs)++;
+
+  /* leave the current feature set, as ValidateSeqFeat would */
+
+  vsp->descr = NULL;
+  vsp->sfp = (SeqFeatPtr) gcp->thisitem;
+}
+
+
 /*****************************************************************************
 *
 *   Valid1GatherProc(gcp)
@@ -1985,22 +2285,19 @@ static Boolean Valid1GatherProc (GatherContextPtr gcp)
   SeqAnnotPtr        sap;
   Boolean            is_blast_align;
   Int2               limit;
-  SeqFeatPtr         sfp;
   ValNodePtr         sdp;
   SeqGraphPtr        sgp;
   BioSourcePtr       biop;
   ObjectIdPtr        oip;
   PubdescPtr         pdp;
   CharPtr            ptr;
-  BioseqPtr          bsp;
   SeqIdPtr           sip;
   CharPtr            str;
   Char               buf [64];
-  Char               tmp [64];
   ValNodePtr         vnp2;
-  SeqMgrFeatContext  context;
   UserObjectPtr      uop;
   EFieldValid        sc_valid;
+  ValidMsgQueuePtr   vqp;
 
   vsp = (ValidStructPtr) (gcp->userdata);
   vsp->gcp = gcp;               /* needed for ValidErr */
@@ -2070,53 +2367,11 @@ static Boolean Valid1GatherProc (GatherContextPtr gcp)
     }
     break;
   case OBJ_SEQFEAT:
-    if (!vsp->onlyspell) {
-      if (limit == VALIDATE_ALL || limit == VALIDATE_FEAT) {
-        ValidateSeqFeat (gcp);
-        sfp = (SeqFeatPtr) (gcp->thisitem);
-        if (sfp != NULL) {
-          if (sfp->data.choice == SEQFEAT_BIOSRC) {
-            biop = (BioSourcePtr) sfp->data.value.ptrvalue;
-            ValidateBioSource (vsp, gcp, biop, sfp, NULL);
-          }
-          if (sfp->data.choice == SEQFEAT_PUB) {
-            pdp = (PubdescPtr) sfp->data.value.ptrvalue;
-            ValidatePubdesc (vsp, gcp, pdp);
-          }
-          if (sfp->cit != NULL) {
-            ValidateSfpCit (vsp, gcp, sfp);
-          }
-          if (vsp->useSeqMgrIndexes) {
-            if (SeqMgrGetDesiredFeature (gcp->entityID, NULL, 0, 0, sfp, &context) == NULL) {
-              StringCpy (buf, "?");
-              bsp = vsp->bsp;
-              if (bsp != NULL) {
-                SeqIdWrite (bsp->id, buf, PRINTID_FASTA_LONG, sizeof (buf) - 1);
-              }
-              ValidErr (vsp, SEV_ERROR, ERR_SEQ_FEAT_UnindexedFeature, "Feature is not indexed on Bioseq %s", buf);
-            } else {
-              bsp = BioseqFindFromSeqLoc (sfp->location);
-              if (bsp != NULL) {
-                sip = SeqLocId (sfp->location);
-                if (sip != NULL && sip->choice != SEQID_GI && sip->choice != SEQID_GIBBSQ && sip->choice != SEQID_GIBBMT) {
-                  SeqIdWrite (sip, buf, PRINTID_FASTA_SHORT, sizeof (buf) - 1);
-                  for (sip = bsp->id; sip != NULL; sip = sip->next) {
-                    if (sip->choice == SEQID_GI || sip->choice == SEQID_GIBBSQ || sip->choice == SEQID_GIBBMT) continue;
-                    SeqIdWrite (sip, tmp, PRINTID_FASTA_SHORT, sizeof (tmp) - 1);
-                    if (StringICmp (buf, tmp) != 0) continue;
-                    if (StringCmp (buf, tmp) == 0) continue;
-                    ValidErr (vsp, SEV_ERROR, ERR_SEQ_FEAT_FeatureSeqIDCaseDifference,
-                              "Sequence identifier in feature location differs in capitalization with identifier on Bioseq");
-                  }
-                }
-              }
-            }
-          }
-        }
-      }
-    }
-    if (limit == VALIDATE_ALL || limit == VALIDATE_FEAT) {
-      SpellCheckSeqFeat (gcp);
+    vqp = (ValidMsgQueuePtr) vsp->msgQueue;
+    if (vqp != NULL && vqp->deferFeats) {
+      DeferSeqFeat (vsp, gcp);
+    } else {
+      Valid1SeqFeat (gcp);
     }
     break;
   case OBJ_SEQGRAPH :
@@ -4055,6 +4310,7 @@ NLM_EXTERN Boolean ValidateSeqEntry (SeqEntryPtr sep, ValidStructPtr vsp)
   FindRepData     frd;
   Int4            numInferences;
   Int4            numAccessions;
+  ValidMsgQueue   vmq;
 
   if (sep == NULL || vsp == NULL) return FALSE;
 
@@ -4371,8 +4627,24 @@ NLM_EXTERN Boolean ValidateSeqEntry (SeqEntryPtr sep, ValidStructPtr vsp)
         }
       }
 
+      /* feature checks can be run on several threads, with messages held until all are done */
+
+      if (vsp->numThreads > 1 && NlmThreadsAvailable () && vsp->spellfunc == NULL && (! vsp->onlyspell) &&
+          (vsp->validationLimit == VALIDATE_ALL || vsp->validationLimit == VALIDATE_FEAT)) {
+        MemSet ((Pointer) &vmq, 0, sizeof (ValidMsgQueue));
+        vmq.deferFeats = TRUE;
+        PrepareValidatorThreads (vsp);
+        vsp->msgQueue = (VoidPtr) &vmq;
+      }
+
       GatherSeqEntry (sep, (Pointer) vsp, Valid1GatherProc, &gs);
 
+      if (vsp->msgQueue != NULL) {
+        ValidateQueuedFeats (vsp, &vmq);
+        vsp->msgQueue = NULL;
+        ReportValidMsgQueue (vsp, &vmq);
+      }
+
       /* restore inferenceAccnCheck flag for next record */
       vsp->inferenceAccnCheck = inferenceAccnCheck;
 
@@ -27963,3 +28235,209 @@ NLM_EXTERN void SpellCallBack (char *str)
   ValidErr (globalvsp, sev, ERR_GENERIC_Spell, "[ %s ]", (CharPtr) str);
   return;
 }
+
+/*****************************************************************************
+*
+*   Validation of queued features on several threads
+*
+*****************************************************************************/
+
+/* app properties used by feature checks, which belong to the thread that sets them */
+
+static CharPtr validThreadProps [] = {
+  "InternalNcbiSequin",
+  "ValidateCDSmRNAoneToOne",
+  "SpliceValidateAsError",
+  "SequinUseEMBLFeatures",
+  "NcbiSubutilValidation",
+  "SpecificECNumberFSA",
+  "AmbiguousECNumberFSA",
+  "DeletedECNumberFSA",
+  "ReplacedEECNumberFSA",
+  "BodiesOfWaterFSA",
+  "CountryLatLonData",
+  "WaterLatLonData",
+  NULL
+};
+
+#define NUM_VALID_THREAD_PROPS (sizeof (validThreadProps) / sizeof (validThreadProps [0]) - 1)
+
+typedef struct validthreaddata {
+  ValidFeatJobPtr PNTR  jobs;
+  Int4                  numjobs;
+  Int4                  next;
+  TNlmMutex             lock;
+  SeqEntryPtr           scope;
+  Pointer               props [NUM_VALID_THREAD_PROPS];
+  ErrOpts               erropts;
+} ValidThreadData, PNTR ValidThreadPtr;
+
+static void PrimeValidFsa (TextFsaPtr fsa)
+
+{
+  if (fsa == NULL) return;
+  TextFsaNext (fsa, 0, ' ', NULL);
+}
+
+/* builds tables that are otherwise loaded on first use, so threads only read them */
+
+static void PrepareValidatorThreads (ValidStructPtr vsp)
+
+{
+  ErrSev  logsev;
+  ErrSev  msgsev;
+
+  if (vsp->sourceQualTags == NULL) {
+    InitializeSourceQualTags (vsp);
+  }
+  if (vsp->modifiedBases == NULL) {
+    InitializeModBaseFSA (vsp);
+  }
+  if (vsp->sgmlStrings == NULL) {
+    InitializeSgmlStringsFSA (vsp);
+  }
+  PrimeValidFsa (vsp->sourceQualTags);
+  PrimeValidFsa (vsp->modifiedBases);
+  PrimeValidFsa (vsp->sgmlStrings);
+
+  PrimeValidFsa (GetSpecificECNumberFSA ());
+  PrimeValidFsa (GetAmbiguousECNumberFSA ());
+  PrimeValidFsa (GetDeletedECNumberFSA ());
+  PrimeValidFsa (GetReplacedECNumberFSA ());
+  PrimeValidFsa (GetBodiesOfWaterFSA ());
+
+  /* do not report missing data files that a single-threaded run might never open */
+
+  msgsev = ErrSetMessageLevel (SEV_MAX);
+  logsev = ErrSetLogLevel (SEV_MAX);
+  GetLatLonCountryData ();
+  GetLatLonWaterData ();
+  SetupInstCollTable ();
+  ErrSetLogLevel (logsev);
+  ErrSetMessageLevel (msgsev);
+}
+
+static void RunValidFeatJob (ValidFeatJobPtr job, CharPtr errbuf)
+
+{
+  job->vs.errbuf = errbuf;
+  Valid1SeqFeat (&(job->gc));
+  if (job->vs.errbuf != errbuf) {
+    MemFree (job->vs.errbuf);
+  }
+  job->vs.errbuf = NULL;
+}
+
+static VoidPtr ValidateFeatJobsProc (VoidPtr arg)
+
+{
+  CharPtr         errbuf;
+  Int2            i;
+  Int4            j;
+  ValidThreadPtr  vtp;
+
+  vtp = (ValidThreadPtr) arg;
+  if (vtp == NULL) return NULL;
+
+  SeqEntrySetScope (vtp->scope);
+  for (i = 0; validThreadProps [i] != NULL; i++) {
+    if (vtp->props [i] != NULL) {
+      SetAppProperty (validThreadProps [i], vtp->props [i]);
+    }
+  }
+  ErrRestoreOptions (&(vtp->erropts));
+
+  errbuf = (CharPtr) MemNew (8192);
+
+  for (;;) {
+    NlmMutexLockEx (&(vtp->lock));
+    j = vtp->next;
+    if (j < vtp->numjobs) {
+      (vtp->next)++;
+    }
+    NlmMutexUnlock (vtp->lock);
+    if (j >= vtp->numjobs) break;
+
+    RunValidFeatJob (vtp->jobs [j], errbuf);
+  }
+
+  MemFree (errbuf);
+
+  /* free translation tables this thread built, shared tables are left alone */
+
+  TransTableFreeAll ();
+  for (i = 0; validThreadProps [i] != NULL; i++) {
+    if (vtp->props [i] != NULL) {
+      SetAppProperty (validThreadProps [i], NULL);
+    }
+  }
+  SeqEntrySetScope (NULL);
+
+  return NULL;
+}
+
+static void ValidateQueuedFeats (ValidStructPtr vsp, ValidMsgQueuePtr vqp)
+
+{
+  CharPtr          errbuf;
+  Int2             i, numThreads = 0;
+  Int4             j;
+  ValidFeatJobPtr  PNTR jobs;
+  VoidPtr          status;
+  TNlmThread       PNTR thds = NULL;
+  ValNodePtr       vnp;
+  ValidThreadData  vtd;
+
+  if (vsp == NULL || vqp == NULL || vqp->numjobs < 1) return;
+
+  jobs = (ValidFeatJobPtr PNTR) MemNew (sizeof (ValidFeatJobPtr) * vqp->numjobs);
+  if (jobs == NULL) return;
+  j = 0;
+  for (vnp = vqp->head; vnp != NULL && j < vqp->numjobs; vnp = vnp->next) {
+    if (vnp->choice != VALID_QUEUE_FEAT) continue;
+    jobs [j] = (ValidFeatJobPtr) vnp->data.ptrvalue;
+    j++;
+  }
+
+  MemSet ((Pointer) &vtd, 0, sizeof (ValidThreadData));
+  vtd.jobs = jobs;
+  vtd.numjobs = j;
+  vtd.scope = SeqEntryGetScope ();
+  for (i = 0; validThreadProps [i] != NULL; i++) {
+    vtd.props [i] = GetAppProperty (validThreadProps [i]);
+  }
+  ErrSaveOptions (&(vtd.erropts));
+
+  if (vsp->numThreads > 1 && vtd.numjobs > 1) {
+    thds = (TNlmThread PNTR) MemNew (sizeof (TNlmThread) * vsp->numThreads);
+  }
+  if (thds != NULL) {
+    NlmMutexInit (&(vtd.lock));
+    while (numThreads < vsp->numThreads && numThreads < vtd.numjobs) {
+      thds [numThreads] = NlmThreadCreate (ValidateFeatJobsProc, (Pointer) &vtd);
+      if (NlmThreadCompare (thds [numThreads], NULL_thread)) break;
+      numThreads++;
+    }
+  }
+
+  if (numThreads > 0) {
+    for (i = 0; i < numThreads; i++) {
+      NlmThreadJoin (thds [i], &status);
+    }
+  } else {
+
+    /* no threads could be started, so validate the features here */
+
+    errbuf = (CharPtr) MemNew (8192);
+    for (j = 0; j < vtd.numjobs; j++) {
+      RunValidFeatJob (jobs [j], errbuf);
+    }
+    MemFree (errbuf);
+  }
+
+  if (vtd.lock != NULL) {
+    NlmMutexDestroy (vtd.lock);
+  }
+  MemFree (thds);
+  MemFree (jobs);
+}
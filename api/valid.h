@@ -187,6 +187,8 @@ typedef struct validstruct {
     VoidPtr trna_array;            /* sorted feature index array of tRNA features */
     Int4 numrrna;                  /* number of rRNA features */
     Int4 numtrna;                  /* number of tRNA features */
+    Int2 numThreads;               /* validate features on this many threads if > 1 */
+    VoidPtr msgQueue;              /* messages held for reporting in order when using threads */
 } ValidStruct, PNTR ValidStructPtr;
 
 NLM_EXTERN Boolean ValidateSeqEntry PROTO((SeqEntryPtr sep, ValidStructPtr vsp));
@@ -388,6 +388,10 @@ NLM_EXTERN AsnIoBSPtr LIBCALL AsnIoBSClose PROTO((AsnIoBSPtr aibp));
 NLM_EXTERN Int2 LIBCALL AsnIoBSRead PROTO((Pointer, CharPtr, Uint2));
 NLM_EXTERN Int2 LIBCALL AsnIoBSWrite PROTO((Pointer, CharPtr, Uint2));
 
+   /*** write through a large-block OutBuf (ncbiobuf.h) ***/
+NLM_EXTERN AsnIoPtr LIBCALL AsnIoOutBufOpen PROTO((CharPtr mode, OutBufPtr obp));
+NLM_EXTERN Int2 LIBCALL AsnIoOutBufWrite PROTO((Pointer, CharPtr, Uint2));
+
   /** Copy and Compare functions ***/
 NLM_EXTERN Pointer LIBCALL AsnIoCopy PROTO((Pointer from, AsnReadFunc readfunc, AsnWriteFunc writefunc));
 NLM_EXTERN Pointer LIBCALL AsnIoMemCopy PROTO((Pointer from, AsnReadFunc readfunc, AsnWriteFunc writefunc));
@@ -1417,6 +1417,55 @@ NLM_EXTERN Int2 LIBCALL  AsnIoBSRead (Pointer ptr, CharPtr buf, Uint2 count)
 	return (Int2) bytes;
 }
 
+/*****************************************************************************
+*
+*   AsnIoOutBufOpen(mode, obp)
+*      output only: "w", "wb" or "wx"
+*      AsnIoClose() writes out what is left in the AsnIo buffer but leaves
+*      obp alone; the caller flushes or frees it afterwards
+*
+*****************************************************************************/
+NLM_EXTERN AsnIoPtr LIBCALL  AsnIoOutBufOpen (CharPtr mode, OutBufPtr obp)
+{
+	Int1 type;
+	AsnIoPtr aip;
+
+	if ((mode == NULL) || (obp == NULL))
+		return NULL;
+
+	if (! StringCmp(mode, "w"))
+		type = (ASNIO_OUT | ASNIO_TEXT);
+	else if (! StringCmp(mode, "wb"))
+		type = (ASNIO_OUT | ASNIO_BIN);
+	else if (! StringCmp(mode, "wx"))
+	{
+		type = (ASNIO_OUT | ASNIO_TEXT);
+		type |= ASNIO_XML;
+	}
+	else
+	{
+		AsnIoErrorMsg(NULL, 81, mode);
+		return NULL;
+	}
+
+	aip = AsnIoNew(type, NULL, (Pointer)obp, NULL, AsnIoOutBufWrite);
+	if (aip != NULL)
+		AsnIoSetBufsize(aip, 10000);  /* fewer, bigger blocks to the OutBuf */
+	return aip;
+}
+
+/*****************************************************************************
+*
+*   AsnIoOutBufWrite(ptr, buf, count)
+*
+*****************************************************************************/
+NLM_EXTERN Int2 LIBCALL  AsnIoOutBufWrite (Pointer ptr, CharPtr buf, Uint2 count)
+{
+	if (! OutBufWrite((OutBufPtr)ptr, buf, (size_t) count))
+		return -1;
+	return (Int2) count;
+}
+
 /*****************************************************************************
 *
 *   AsnIoCopy(from, fromfunc, tofunc)
@@ -61,6 +61,7 @@
 #include <ncbierr.h>
 #include <ncbistr.h>
 #include <ncbibs.h>
+#include <ncbiobuf.h>
 #include <ncbitime.h>
 #include <ncbifile.h>
 #include <ncbimath.h>
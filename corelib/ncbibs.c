@@ -53,6 +53,7 @@
 */
 
 #include <ncbi.h>
+#include <ncbithr.h>
 #include <ncbiwin.h>
 
          /* maximum size allocated for BSUnit.str */
@@ -66,6 +67,183 @@ extern Nlm_Boolean wrote_to_handle;  /* needed by Microsoft DOS Virtual mem */
 #define MAX_BSALLOC 10000
 #endif
 
+/*****************************************************************************
+*
+*   Shared BSUnit storage
+*      BSUnits made by BSDup, BSSlice, BSInsertFromBS and by splitting a
+*      BSUnit point into the same str, at their own start offset.  refcnt
+*      counts the BSUnits using str.  A BSUnit is given a private copy of its
+*      bytes (BSUnshareUnit) before anything is written to it.  The counts
+*      are protected by a mutex since shared storage may be released by
+*      Bioseqs being freed on different threads.
+*
+*****************************************************************************/
+static TNlmMutex bs_share_mutex;
+
+static Nlm_Boolean BSShareUnit (Nlm_BSUnitPtr from, Nlm_BSUnitPtr to)
+
+{
+	if (NlmMutexLockEx (&bs_share_mutex) != 0)
+		return FALSE;
+	if (from->refcnt == NULL)
+	{
+		from->refcnt = (Nlm_Int4Ptr) Nlm_MemNew (sizeof (Nlm_Int4));
+		if (from->refcnt == NULL)
+		{
+			NlmMutexUnlock (bs_share_mutex);
+			return FALSE;
+		}
+		*(from->refcnt) = 1;
+	}
+	(*(from->refcnt))++;
+	to->str = from->str;
+	to->refcnt = from->refcnt;
+	to->start = from->start;
+	NlmMutexUnlock (bs_share_mutex);
+	return TRUE;
+}
+
+static void BSReleaseUnit (Nlm_BSUnitPtr bsup)
+
+{
+	Nlm_Boolean last = TRUE;
+
+	if (bsup->refcnt != NULL)
+	{
+		NlmMutexLockEx (&bs_share_mutex);
+		(*(bsup->refcnt))--;
+		last = (Nlm_Boolean) (*(bsup->refcnt) == 0);
+		NlmMutexUnlock (bs_share_mutex);
+		if (last)
+			Nlm_MemFree (bsup->refcnt);
+		bsup->refcnt = NULL;
+	}
+	if (last)
+		Nlm_HandFree (bsup->str);
+	bsup->str = NULL;
+}
+
+static Nlm_Boolean BSUnshareUnit (Nlm_BSUnitPtr bsup)
+
+{
+	Nlm_Handle thand;
+	Nlm_BytePtr to, from;
+	Nlm_Boolean last;
+
+	if (bsup->refcnt == NULL)
+		return TRUE;
+
+	NlmMutexLockEx (&bs_share_mutex);
+	last = (Nlm_Boolean) (*(bsup->refcnt) == 1);
+	NlmMutexUnlock (bs_share_mutex);
+	if (last)                 /* nobody else uses it any more */
+	{
+		Nlm_MemFree (bsup->refcnt);
+		bsup->refcnt = NULL;
+		return TRUE;
+	}
+
+	thand = Nlm_HandNew ((size_t) bsup->len_avail);
+	if (thand == NULL)
+		return FALSE;
+	to = (Nlm_BytePtr) Nlm_HandLock (thand);
+	from = (Nlm_BytePtr) Nlm_HandLock (bsup->str) + bsup->start;
+	Nlm_MemCopy (to, from, (size_t) bsup->len);
+#ifdef MSC_VIRT
+	wrote_to_handle = TRUE;
+#endif
+	Nlm_HandUnlock (bsup->str);
+	Nlm_HandUnlock (thand);
+	BSReleaseUnit (bsup);
+	bsup->str = thand;
+	bsup->start = 0;
+	return TRUE;
+}
+
+/*****************************************************************************
+*
+*   BSUnit index
+*      BSSeek used to walk the chain from the start for every backward seek,
+*      which is slow on long chains of small BSUnits (sequences built a byte
+*      at a time).  The index holds each BSUnit with its offset so the unit
+*      is found by binary search.  It is built when first needed and marked
+*      out of date (indexnum = 0) when BSUnits are added, removed or resized.
+*
+*****************************************************************************/
+static Nlm_Boolean BSBuildIndex (Nlm_ByteStorePtr bsp)
+
+{
+	Nlm_BSUnitPtr bsup;
+	Nlm_Int4 num, offset;
+
+	bsp->index = (Nlm_BSUnitPtr PNTR) Nlm_MemFree (bsp->index);
+	bsp->offsets = (Nlm_Int4Ptr) Nlm_MemFree (bsp->offsets);
+	bsp->indexnum = 0;
+
+	for (num = 0, bsup = bsp->chain; bsup != NULL; bsup = bsup->next)
+		num++;
+	if (num == 0)
+		return FALSE;
+
+	bsp->index = (Nlm_BSUnitPtr PNTR) Nlm_MemNew ((size_t) num * sizeof (Nlm_BSUnitPtr));
+	bsp->offsets = (Nlm_Int4Ptr) Nlm_MemNew ((size_t) num * sizeof (Nlm_Int4));
+	if (bsp->index == NULL || bsp->offsets == NULL)
+	{
+		bsp->index = (Nlm_BSUnitPtr PNTR) Nlm_MemFree (bsp->index);
+		bsp->offsets = (Nlm_Int4Ptr) Nlm_MemFree (bsp->offsets);
+		return FALSE;
+	}
+
+	for (num = 0, offset = 0, bsup = bsp->chain; bsup != NULL; bsup = bsup->next, num++)
+	{
+		bsp->index [num] = bsup;
+		bsp->offsets [num] = offset;
+		offset += bsup->len;
+	}
+	bsp->indexnum = num;
+	return TRUE;
+}
+
+/*****************************************************************************
+*
+*   BSFindUnit(bsp, sp, startp)
+*      returns the last BSUnit starting at or before sp, which is the one
+*      containing sp unless sp is past the end, and puts its offset in startp
+*
+*****************************************************************************/
+static Nlm_BSUnitPtr BSFindUnit (Nlm_ByteStorePtr bsp, Nlm_Int4 sp, Nlm_Int4Ptr startp)
+
+{
+	Nlm_BSUnitPtr bsup;
+	Nlm_Int4 lo, hi, mid, start;
+
+	if ((bsp->indexnum > 0) || BSBuildIndex (bsp))
+	{
+		lo = 0;
+		hi = bsp->indexnum - 1;
+		while (lo < hi)
+		{
+			mid = (lo + hi + 1) / 2;
+			if (bsp->offsets [mid] <= sp)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+		*startp = bsp->offsets [lo];
+		return bsp->index [lo];
+	}
+
+	start = 0;                  /* no memory for index, walk the chain */
+	bsup = bsp->chain;
+	while ((bsup->next != NULL) && ((start + bsup->len) <= sp))
+	{
+		start += bsup->len;
+		bsup = bsup->next;
+	}
+	*startp = start;
+	return bsup;
+}
+
 /*****************************************************************************
 *
 *   Pointer Nlm_BSMerge(bsp, dest)
@@ -101,7 +279,7 @@ NLM_EXTERN Nlm_VoidPtr LIBCALL  Nlm_BSMerge (Nlm_ByteStorePtr bsp, Nlm_VoidPtr d
 
 	while (bsup != NULL)
 	{
-		from = (Nlm_BytePtr) Nlm_HandLock(bsup->str);
+		from = (Nlm_BytePtr) Nlm_HandLock(bsup->str) + bsup->start;
 		Nlm_MemCopy(tmp, from, bsup->len);
 		Nlm_HandUnlock(bsup->str);
 		tmp += bsup->len;
@@ -135,31 +313,27 @@ NLM_EXTERN Nlm_ByteStorePtr LIBCALL Nlm_BSNew (Nlm_Int4 len)
 
 /*****************************************************************************
 *
-*   Int4 BSAdd(bsp, len, use_min_size)
-*   	adds len bytes BEFORE current bsp->seekptr
-*       bsp->seekptr returned pointing at first added byte
-*   	returns bytes added
-*       if (use_min_size) then does not add anything smaller than MIN_BSALLOC
+*   BSOpenGap(bsp, lastp, okp)
+*      finds where BSUnits can be linked in at bsp->seekptr, splitting the
+*      BSUnit there if needed
+*      returns the BSUnit before the gap (NULL at start of chain) and puts
+*      the BSUnit after the gap in lastp
+*      the two halves of a split BSUnit share the storage of the original
 *
 *****************************************************************************/
-NLM_EXTERN Nlm_Int4 LIBCALL Nlm_BSAdd (Nlm_ByteStorePtr bsp, Nlm_Int4 len, Nlm_Boolean use_min_size)
+static Nlm_BSUnitPtr BSOpenGap (Nlm_ByteStorePtr bsp, Nlm_BSUnitPtr PNTR lastp, Nlm_BoolPtr okp)
 
 {
 	Nlm_BSUnitPtr bsup,      /* current bsunit */
 		          ccbsup,    /* bsp->curchain */
 				lastbsup,    /* bsunit after added section  */
 				prevbsup;    /* bsunit before added section */
-	Nlm_BytePtr to, from;
-	Nlm_Int4 added = 0,
-		      tlen;
-	Nlm_Handle thand;
-
-	if ((bsp == NULL) || (len == 0))
-		return added;
+	Nlm_Int4 tlen;
 
 	lastbsup = NULL;
 	prevbsup = NULL;
 	ccbsup = bsp->curchain;
+	*okp = TRUE;
 
 	if (bsp->chain != NULL)        /* add or insert in exisiting chain */
 	{
@@ -176,6 +350,8 @@ NLM_EXTERN Nlm_Int4 LIBCALL Nlm_BSAdd (Nlm_ByteStorePtr bsp, Nlm_Int4 len, Nlm_B
 		else if (bsp->seekptr == (bsp->chain_offset + ccbsup->len))
 		{
 			prevbsup = ccbsup; /* JK */
+			lastbsup = ccbsup->next;   /* empty space left by BSNew */
+			ccbsup->len_avail = ccbsup->len;   /* no longer last */
 		}										 /* after all blocks */
 		else if (bsp->seekptr >= (bsp->chain_offset + ccbsup->len_avail))
 		{
@@ -184,7 +360,13 @@ NLM_EXTERN Nlm_Int4 LIBCALL Nlm_BSAdd (Nlm_ByteStorePtr bsp, Nlm_Int4 len, Nlm_B
 		else                /* split a bsunit */
 		{
 			bsup = (Nlm_BSUnitPtr) Nlm_MemNew(sizeof(Nlm_BSUnit));
-			if (bsup == NULL) return added;
+			if (bsup == NULL || ! BSShareUnit(ccbsup, bsup))
+			{
+				Nlm_MemFree(bsup);
+				*okp = FALSE;
+				return NULL;
+			}
+			bsp->indexnum = 0;
 			if (bsp->chain_offset != 0)          /* not first BSUnit */
 			{
 				prevbsup = bsp->chain;
@@ -196,37 +378,51 @@ NLM_EXTERN Nlm_Int4 LIBCALL Nlm_BSAdd (Nlm_ByteStorePtr bsp, Nlm_Int4 len, Nlm_B
 			    bsp->chain = bsup;
 			bsup->next = ccbsup;
 			tlen = bsp->seekptr - bsp->chain_offset;  /* len of first half */
-			bsup->str = Nlm_HandNew((size_t) tlen);
-			if (bsup->str == NULL) return added;
 			bsup->len = (Nlm_Int2) tlen;
 			bsup->len_avail = (Nlm_Int2) tlen;
-			to = (Nlm_BytePtr) Nlm_HandLock(bsup->str);
-			thand = ccbsup->str;
-			from = (Nlm_BytePtr) Nlm_HandLock(thand);
-			Nlm_MemCopy(to, from, (size_t) tlen);
-#ifdef MSC_VIRT
-			wrote_to_handle = TRUE;
-#endif
-			Nlm_HandUnlock(bsup->str);
-			from += tlen;      /* point past copied region */
 			tlen = ccbsup->len - tlen;    /* the last half */
+			ccbsup->start += bsup->len;
 			ccbsup->len = (Nlm_Int2) tlen;
 			ccbsup->len_avail = (Nlm_Int2) tlen;
-			ccbsup->str = Nlm_HandNew((size_t) tlen);
-			if (ccbsup->str == NULL) return added;
-			to = (Nlm_BytePtr) Nlm_HandLock(ccbsup->str);
-			Nlm_MemCopy(to, from, (size_t) tlen);
-#ifdef MSC_VIRT
-	wrote_to_handle = TRUE;
-#endif
-			Nlm_HandUnlock(ccbsup->str);
-			Nlm_HandUnlock(thand);
-			Nlm_HandFree(thand);
+			bsp->curchain = ccbsup;
+			bsp->chain_offset = bsp->seekptr;
 			prevbsup = bsup;
 			lastbsup = ccbsup;
 		}
 	}
 
+	*lastp = lastbsup;
+	return prevbsup;
+}
+
+/*****************************************************************************
+*
+*   Int4 BSAdd(bsp, len, use_min_size)
+*   	adds len bytes BEFORE current bsp->seekptr
+*       bsp->seekptr returned pointing at first added byte
+*   	returns bytes added
+*       if (use_min_size) then does not add anything smaller than MIN_BSALLOC
+*
+*****************************************************************************/
+NLM_EXTERN Nlm_Int4 LIBCALL Nlm_BSAdd (Nlm_ByteStorePtr bsp, Nlm_Int4 len, Nlm_Boolean use_min_size)
+
+{
+	Nlm_BSUnitPtr bsup,      /* current bsunit */
+		          ccbsup,    /* first added bsunit */
+				lastbsup,    /* bsunit after added section  */
+				prevbsup;    /* bsunit before added section */
+	Nlm_Int4 added = 0,
+		      tlen;
+	Nlm_Boolean ok;
+
+	if ((bsp == NULL) || (len == 0))
+		return added;
+
+	prevbsup = BSOpenGap(bsp, &lastbsup, &ok);
+	if (! ok)
+		return added;
+	bsp->indexnum = 0;
+
 	ccbsup = NULL;
 	bsup = NULL;
 	while (len)
@@ -281,18 +477,19 @@ NLM_EXTERN Nlm_Int4 LIBCALL  Nlm_BSDelete (Nlm_ByteStorePtr bsp, Nlm_Int4 len)
 		          ccbsup,    /* bsp->curchain */
 				nextbsup,    /* bsunit after added section  */
 				prevbsup;    /* bsunit before added section */
-	Nlm_BytePtr to, from;
+	Nlm_BytePtr to;
 	Nlm_Int4 added = 0,
 		      offset,
 		      tlen,
 			  start,
 			  save;
-	Nlm_Handle thand;
 
 	if ((bsp == NULL) || (len == 0) || (bsp->chain == NULL) ||
 		(bsp->seekptr >= bsp->totlen))
 		return added;
 
+	bsp->indexnum = 0;
+
 	if ((bsp->seekptr + len) > bsp->totlen)   /* deleting too much */
 		len = bsp->totlen - bsp->seekptr;
 
@@ -321,30 +518,26 @@ NLM_EXTERN Nlm_Int4 LIBCALL  Nlm_BSDelete (Nlm_ByteStorePtr bsp, Nlm_Int4 len)
 		save = bsup->len - tlen;
 		if (save)    /* some bytes left after delete */
 		{
-			thand = bsup->str;
-			bsup->str = Nlm_HandNew((size_t) save);
-			if (bsup->str == NULL) return added;
-			bsup->len = (Nlm_Int2) save;
-			bsup->len_avail = (Nlm_Int2) save;
-			to = (Nlm_BytePtr) Nlm_HandLock(bsup->str);
-			from = (Nlm_BytePtr) Nlm_HandLock(thand);
-			if (offset)         /* get the beginning */
-				Nlm_MemCopy(to, from, (size_t) offset);
-			save -= offset;
-			if (save)           /* save end */
-				Nlm_MemCopy((to + offset), (from + (offset + tlen)), (size_t)save);
-			Nlm_HandUnlock(thand);
-			Nlm_HandFree(thand);
+			if (! offset)       /* drop the beginning */
+				bsup->start += (Nlm_Int2) tlen;
+			else if (save > offset)   /* close up the middle */
+			{
+				if (! BSUnshareUnit(bsup)) return added;
+				to = (Nlm_BytePtr) Nlm_HandLock(bsup->str) + bsup->start;
+				Nlm_MemMove((to + offset), (to + (offset + tlen)), (size_t)(save - offset));
 #ifdef MSC_VIRT
 	wrote_to_handle = TRUE;
 #endif
-			Nlm_HandUnlock(bsup->str);
+				Nlm_HandUnlock(bsup->str);
+			}                   /* else just drop the end */
+			bsup->len = (Nlm_Int2) save;
+			bsup->len_avail = (Nlm_Int2) save;
 			if (tlen < len)
 				bsup = nextbsup;
 		}
 		else                    /* delete the whole thing */
 		{
-			Nlm_HandFree(bsup->str);
+			BSReleaseUnit(bsup);
 			Nlm_MemFree(bsup);
 			bsup = nextbsup;
 		}
@@ -414,7 +607,6 @@ NLM_EXTERN Nlm_Int2 LIBCALL  Nlm_BSSeek (Nlm_ByteStorePtr bsp, Nlm_Int4 offset,
 {
 	Nlm_Int4 sp, start = 0;
 	Nlm_BSUnitPtr bsup;
-	Nlm_Boolean done;
 
 	if (bsp == NULL)
 		return 1;
@@ -456,7 +648,7 @@ NLM_EXTERN Nlm_Int2 LIBCALL  Nlm_BSSeek (Nlm_ByteStorePtr bsp, Nlm_Int4 offset,
 	{
 		if (sp > (bsp->chain_offset + bsup->len_avail))
 		{
-			start = bsp->chain_offset;
+			bsup = BSFindUnit(bsp, sp - 1, &start);   /* holds last byte */
 			while (sp > (start + bsup->len_avail))
 			{
 				start += bsup->len;
@@ -467,27 +659,12 @@ NLM_EXTERN Nlm_Int2 LIBCALL  Nlm_BSSeek (Nlm_ByteStorePtr bsp, Nlm_Int4 offset,
 	else if ((sp < bsp->chain_offset) ||
 		(sp >= (bsp->chain_offset + bsup->len)))
 	{
-		if (sp < bsp->chain_offset)
-		{
-			bsup = bsp->chain;
-			start = 0;
-		}
+		start = bsp->chain_offset + bsup->len;
+		if ((sp >= start) && (bsup->next != NULL) &&
+			(sp < (start + bsup->next->len)))
+			bsup = bsup->next;           /* reading straight through */
 		else
-		{
-			start = bsp->chain_offset + bsup->len;
-			bsup = bsup->next;
-		}
-		done = FALSE;
-		while (! done)
-		{
-			if ((start + bsup->len) > sp)
-				done = TRUE;
-			else
-			{
-				start += bsup->len;
-				bsup = bsup->next;
-			}
-		}
+			bsup = BSFindUnit(bsp, sp, &start);
 	}
 	if (bsup != bsp->curchain)
 	{
@@ -586,7 +763,9 @@ NLM_EXTERN Nlm_Int4 LIBCALL  Nlm_BSWrite (Nlm_ByteStorePtr bsp, Nlm_VoidPtr ptr,
 			bsp->chain_offset = start;
 			bsp->curchain = bsup;
 		}
-		to = (Nlm_BytePtr)Nlm_HandLock(bsup->str) + offset;
+		if (! BSUnshareUnit(bsup))     /* copy on write */
+			return added;
+		to = (Nlm_BytePtr)Nlm_HandLock(bsup->str) + bsup->start + offset;
 		Nlm_MemCopy(to, from, (size_t) tlen);
 #ifdef MSC_VIRT
 	wrote_to_handle = TRUE;
@@ -597,7 +776,8 @@ NLM_EXTERN Nlm_Int4 LIBCALL  Nlm_BSWrite (Nlm_ByteStorePtr bsp, Nlm_VoidPtr ptr,
 			diff = (tlen + offset) - bsup->len;
 			bsp->totlen += diff;
 			bsup->len += (Nlm_Int2) diff;
-
+			if (bsup->next != NULL)     /* moved later bsunits */
+				bsp->indexnum = 0;
 		}
 		offset = 0;        /* only offset on first one */
 		len -= tlen;
@@ -653,7 +833,7 @@ NLM_EXTERN Nlm_Int4 LIBCALL  Nlm_BSRead (Nlm_ByteStorePtr bsp, Nlm_VoidPtr ptr,
 		if (! tlen)       /* out of data */
 			return added;
 		bsp->chain_offset = start;
-		from = (Nlm_BytePtr)Nlm_HandLock(bsup->str) + offset;
+		from = (Nlm_BytePtr)Nlm_HandLock(bsup->str) + bsup->start + offset;
 		Nlm_MemCopy(to, from, (size_t) tlen);
 		Nlm_HandUnlock(bsup->str);
 		offset = 0;        /* only offset on first one */
@@ -697,7 +877,7 @@ NLM_EXTERN Nlm_Int2 LIBCALL  Nlm_BSGetByte (Nlm_ByteStorePtr bsp)
 
 	diff = bsp->seekptr - bsp->chain_offset;
 	bsup = bsp->curchain;
-	ptr = (Nlm_BytePtr) Nlm_HandLock(bsup->str);
+	ptr = (Nlm_BytePtr) Nlm_HandLock(bsup->str) + bsup->start;
 	retval = (Nlm_Int2) *(ptr + diff);
 	Nlm_HandUnlock(bsup->str);
 
@@ -746,26 +926,87 @@ NLM_EXTERN Nlm_Int4 LIBCALL  Nlm_BSInsert (Nlm_ByteStorePtr bsp, Nlm_VoidPtr ptr
 *       reads from bsp2 starting from current seek position
 *       writes from current seekptr position
 *       seekptr left pointing after last byte written
-*       allocates storage if needed
 *       inserts data BEFORE seekptr
+*       the inserted BSUnits share storage with bsp2, nothing is copied
+*       inserts fewer than len bytes if bsp2 does not have that many
 *
 *****************************************************************************/
 NLM_EXTERN Nlm_Int4 LIBCALL  Nlm_BSInsertFromBS (Nlm_ByteStorePtr bsp, Nlm_ByteStorePtr bsp2, Nlm_Int4 len)
 {
-	Nlm_Int4 added;
-	Nlm_Int2 x;
+	Nlm_BSUnitPtr head = NULL,   /* shared copies of bsp2 bsunits */
+		          tail = NULL,
+		          bsup,
+		          from,
+		          lastbsup,      /* bsunit after inserted section */
+		          prevbsup;      /* bsunit before inserted section */
+	Nlm_Int4 added = 0, offset, tlen;
+	Nlm_Boolean ok;
+
+	if ((bsp == NULL) || (bsp2 == NULL) || (len <= 0))
+		return added;
 
-	added = Nlm_BSAdd(bsp, len, FALSE);
-	if (added != len)
+	from = bsp2->curchain;
+	offset = bsp2->seekptr - bsp2->chain_offset;
+	while ((len) && (from != NULL))
 	{
-		Nlm_BSDelete(bsp, added);
+		tlen = from->len - offset;
+		if (tlen > len)
+			tlen = len;
+		if (tlen > 0)
+		{
+			bsup = (Nlm_BSUnitPtr) Nlm_MemNew(sizeof(Nlm_BSUnit));
+			if (bsup == NULL || ! BSShareUnit(from, bsup))
+			{
+				Nlm_MemFree(bsup);
+				break;
+			}
+			bsup->start += (Nlm_Int2) offset;
+			bsup->len = (Nlm_Int2) tlen;
+			bsup->len_avail = (Nlm_Int2) tlen;
+			if (tail == NULL)
+				head = bsup;
+			else
+				tail->next = bsup;
+			tail = bsup;
+			len -= tlen;
+			added += tlen;
+		}
+		offset = 0;
+		from = from->next;
+	}
+	if (! added)
+		return added;
+
+	prevbsup = BSOpenGap(bsp, &lastbsup, &ok);
+	if (! ok)
+	{
+		for (bsup = head; bsup != NULL; bsup = head)
+		{
+			head = bsup->next;
+			BSReleaseUnit(bsup);
+			Nlm_MemFree(bsup);
+		}
 		return 0;
 	}
+	Nlm_BSSeek(bsp2, added, SEEK_CUR);
 
-	for (added = 0; added < len; added++)
+	if (prevbsup == NULL)
+		bsp->chain = head;
+	else
+		prevbsup->next = head;
+	tail->next = lastbsup;
+	bsp->totlen += added;
+	bsp->seekptr += added;
+	bsp->indexnum = 0;
+	if (lastbsup != NULL)          /* point at the following data */
+	{
+		bsp->curchain = lastbsup;
+		bsp->chain_offset = bsp->seekptr;
+	}
+	else
 	{
-		x = Nlm_BSGetByte(bsp2);
-		Nlm_BSPutByte(bsp, x);
+		bsp->curchain = tail;
+		bsp->chain_offset = bsp->seekptr - tail->len;
 	}
 	return added;
 }
@@ -788,12 +1029,43 @@ NLM_EXTERN Nlm_ByteStorePtr LIBCALL  Nlm_BSFree (Nlm_ByteStorePtr bsp)
 	{
 		tmp = bsup;
 		bsup = bsup->next;
-		Nlm_HandFree(tmp->str);
+		BSReleaseUnit(tmp);
 		Nlm_MemFree(tmp);
 	}
+	Nlm_MemFree(bsp->index);
+	Nlm_MemFree(bsp->offsets);
 	return (Nlm_ByteStorePtr) Nlm_MemFree(bsp);
 }
 
+/*****************************************************************************
+*
+*   ByteStorePtr Nlm_BSSlice(source, offset, len)
+*      the new ByteStore shares storage with source until either is written
+*
+*****************************************************************************/
+NLM_EXTERN Nlm_ByteStorePtr LIBCALL Nlm_BSSlice (Nlm_ByteStorePtr source, Nlm_Int4 offset, Nlm_Int4 len)
+
+{
+  Nlm_ByteStorePtr  dest;
+  Nlm_Int4          sourceLoc;
+
+  if (source == NULL || offset < 0 || len < 0 || offset + len > source->totlen)
+    return NULL;
+
+  dest = (Nlm_ByteStorePtr) Nlm_MemNew (sizeof (Nlm_ByteStore));
+  if (dest == NULL || len == 0)
+    return dest;
+
+  sourceLoc = Nlm_BSTell (source);
+  Nlm_BSSeek (source, offset, SEEK_SET);
+  if (Nlm_BSInsertFromBS (dest, source, len) < len)
+    dest = Nlm_BSFree (dest);
+  else
+    Nlm_BSSeek (dest, 0L, SEEK_SET);
+  Nlm_BSSeek (source, sourceLoc, SEEK_SET);
+  return dest;
+}
+
 /*****************************************************************************
 *
 *   ByteStorePtr Nlm_BSDup(bsp)
@@ -805,33 +1077,19 @@ NLM_EXTERN Nlm_ByteStorePtr LIBCALL  Nlm_BSFree (Nlm_ByteStorePtr bsp)
 NLM_EXTERN Nlm_ByteStorePtr LIBCALL Nlm_BSDup (Nlm_ByteStorePtr source)
 
 {
-  Nlm_Byte          buf [BUFSIZE + 4];
-  Nlm_Int4          count;
   Nlm_ByteStorePtr  dest;
-  Nlm_Int4          sourceLen;
   Nlm_Int4          sourceLoc;
 
   dest = NULL;
   if (source != NULL) {
-    sourceLen = Nlm_BSLen (source);
-    dest = Nlm_BSNew (sourceLen);
     /* read the original location */
     sourceLoc = Nlm_BSTell(source);
-    Nlm_BSSeek(source, 0L, SEEK_SET);
+    dest = Nlm_BSSlice (source, 0L, Nlm_BSLen (source));
     if (dest != NULL) {
-      count = MIN (sourceLen, (Nlm_Int4) BUFSIZE);
-      while (count > 0 && sourceLen > 0) {
-        Nlm_BSRead (source, buf, count);
-        Nlm_BSWrite (dest, buf, count);
-        sourceLen -= count;
-        count = MIN (sourceLen, (Nlm_Int4) BUFSIZE);
-      }
       /* for neatness, make the duplicate point to the
 	     same location as the old one */
       Nlm_BSSeek(dest, sourceLoc, SEEK_SET);
     }
-    /* restore original location */
-    Nlm_BSSeek(source, sourceLoc, SEEK_SET);
   }
   return dest;
 }
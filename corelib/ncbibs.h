@@ -61,7 +61,9 @@ typedef struct bsunit {             /* for building multiline strings */
 	Nlm_Handle str;            /* the string piece */
 	Nlm_Int2 len_avail,
 		 len;
-	struct bsunit PNTR next; }       /* the next one */
+	struct bsunit PNTR next;       /* the next one */
+	Nlm_Int4Ptr refcnt;        /* BSUnits sharing str, NULL if not shared */
+	Nlm_Int2 start; }          /* offset of this piece within str */
 Nlm_BSUnit, PNTR Nlm_BSUnitPtr;
 
 typedef struct bytestore {
@@ -70,6 +72,9 @@ typedef struct bytestore {
 		chain_offset;       /* offset in ByteStore of first byte in curchain */
 	Nlm_BSUnitPtr chain,       /* chain of elements */
 		curchain;           /* the BSUnit containing seekptr */
+	Nlm_BSUnitPtr PNTR index;  /* BSUnits in chain order, for BSSeek */
+	Nlm_Int4Ptr offsets;        /* offset in ByteStore of each indexed BSUnit */
+	Nlm_Int4 indexnum;          /* number indexed, 0 if index is out of date */
 } Nlm_ByteStore, PNTR Nlm_ByteStorePtr;
 
 NLM_EXTERN Nlm_VoidPtr LIBCALL Nlm_BSMerge PROTO((Nlm_ByteStorePtr ssp, Nlm_VoidPtr dest));
@@ -102,6 +107,17 @@ NLM_EXTERN Nlm_Boolean LIBCALL Nlm_BSEqual PROTO((Nlm_ByteStorePtr bs1, Nlm_Byte
 *****************************************************************************/
 NLM_EXTERN Nlm_Int4 LIBCALL Nlm_BSAdd PROTO((Nlm_ByteStorePtr bsp, Nlm_Int4 len, Nlm_Boolean use_min_size));
 
+/*****************************************************************************
+*
+*   Shared storage
+*      BSDup, BSSlice and BSInsertFromBS do not copy bytes.  The new BSUnits
+*      point into the same storage as the source, which is reference counted
+*      and copied only when one of the ByteStores writes to it.  BSSlice
+*      returns a new ByteStore holding len bytes of source starting at offset.
+*
+*****************************************************************************/
+NLM_EXTERN Nlm_ByteStorePtr LIBCALL Nlm_BSSlice PROTO((Nlm_ByteStorePtr source, Nlm_Int4 offset, Nlm_Int4 len));
+
 /****************************************************************************
 *
 *   Integer storage utilities
@@ -152,6 +168,7 @@ NLM_EXTERN Nlm_ByteStorePtr LIBCALL Nlm_BSDupAndSwapUint4 (Nlm_ByteStorePtr sour
 #define BSInsert Nlm_BSInsert
 #define BSInsertFromBS Nlm_BSInsertFromBS
 #define BSDup Nlm_BSDup
+#define BSSlice Nlm_BSSlice
 #define BSEqual Nlm_BSEqual
 #define BSRead Nlm_BSRead
 #define BSGetByte Nlm_BSGetByte
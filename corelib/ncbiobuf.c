@@ -0,0 +1,454 @@
+/*  ncbiobuf.c
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+* File Name:  ncbiobuf.c
+*
+* $Revision: 1.1 $
+*
+* File Description:
+*   OutBuf functions: large-block buffered output for report formatters,
+*   and fast integer and fixed point text conversions
+*
+* Modifications:
+* --------------------------------------------------------------------------
+* Date     Name        Description of modification
+* -------  ----------  -----------------------------------------------------
+*
+* ==========================================================================
+*/
+
+#include <ncbi.h>
+#include <ncbiobuf.h>
+
+#ifdef OS_UNIX
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+#if defined(OS_MSWIN) || defined(OS_NT)
+#include <io.h>
+#endif
+
+         /* the scaled value must stay below this for the fast fixed point
+            conversion; the error of value * 10^precision is then well
+            below FIXED_TIE_MARGIN */
+#define FIXED_FAST_MAX 2147483647.0
+#define FIXED_TIE_MARGIN 1.0e-6
+#define FIXED_PRECISION_MAX 9
+
+static const Nlm_Char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const Nlm_FloatHi powers_of_ten[FIXED_PRECISION_MAX + 1] = {
+	1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0,
+	1000000.0, 10000000.0, 100000000.0, 1000000000.0 };
+
+/*****************************************************************************
+*
+*   OutBufPtr Nlm_OutBufNew(fp, size)
+*   OutBufPtr Nlm_OutBufNewFd(fd, size)
+*   OutBufPtr Nlm_OutBufNewEx(proc, userdata, size)
+*      create a buffer of size bytes (OUTBUF_DEFAULT_SIZE if 0) in front of
+*      a stream, a file descriptor or a write function
+*
+*****************************************************************************/
+static Nlm_OutBufPtr s_OutBufNew (size_t size)
+{
+	Nlm_OutBufPtr obp;
+
+	obp = (Nlm_OutBufPtr) Nlm_MemNew(sizeof(Nlm_OutBuf));
+	if (obp == NULL)
+		return NULL;
+	if (size == 0)
+		size = OUTBUF_DEFAULT_SIZE;
+	obp->buf = (Nlm_CharPtr) Nlm_MemGet(size, MGET_ERRPOST);
+	if (obp->buf == NULL)
+		return (Nlm_OutBufPtr) Nlm_MemFree(obp);
+	obp->size = size;
+	obp->fd = -1;
+	return obp;
+}
+
+NLM_EXTERN Nlm_OutBufPtr LIBCALL Nlm_OutBufNew (FILE PNTR fp, size_t size)
+{
+	Nlm_OutBufPtr obp;
+
+	if (fp == NULL)
+		return NULL;
+	if ((obp = s_OutBufNew(size)) != NULL)
+		obp->fp = fp;
+	return obp;
+}
+
+NLM_EXTERN Nlm_OutBufPtr LIBCALL Nlm_OutBufNewFd (int fd, size_t size)
+{
+	Nlm_OutBufPtr obp;
+
+	if (fd < 0)
+		return NULL;
+	if ((obp = s_OutBufNew(size)) != NULL)
+		obp->fd = fd;
+	return obp;
+}
+
+NLM_EXTERN Nlm_OutBufPtr LIBCALL Nlm_OutBufNewEx (Nlm_OutBufWriteProc proc, Nlm_VoidPtr userdata, size_t size)
+{
+	Nlm_OutBufPtr obp;
+
+	if (proc == NULL)
+		return NULL;
+	if ((obp = s_OutBufNew(size)) != NULL)
+	{
+		obp->proc = proc;
+		obp->userdata = userdata;
+	}
+	return obp;
+}
+
+/*****************************************************************************
+*
+*   OutBufPtr Nlm_OutBufFree(obp)
+*      writes out what is left in the buffer and frees it; the stream or
+*      file descriptor is neither flushed nor closed
+*
+*****************************************************************************/
+NLM_EXTERN Nlm_OutBufPtr LIBCALL Nlm_OutBufFree (Nlm_OutBufPtr obp)
+{
+	if (obp == NULL)
+		return NULL;
+	Nlm_OutBufFlush(obp);
+	Nlm_MemFree(obp->buf);
+	return (Nlm_OutBufPtr) Nlm_MemFree(obp);
+}
+
+/*****************************************************************************
+*
+*   s_OutBufSend(obp, data1, size1, data2, size2)
+*      writes two pieces of data, in order, to the destination; on UNIX
+*      file descriptors both go out with a single writev()
+*
+*****************************************************************************/
+static Nlm_Boolean s_OutBufSend (Nlm_OutBufPtr obp, const Nlm_Char PNTR data1, size_t size1, const Nlm_Char PNTR data2, size_t size2)
+{
+	if (obp->failed)
+		return FALSE;
+
+	if (obp->fp != NULL)
+	{
+		if ((size1 > 0 && fwrite(data1, 1, size1, obp->fp) != size1) ||
+		    (size2 > 0 && fwrite(data2, 1, size2, obp->fp) != size2))
+			obp->failed = TRUE;
+	}
+	else if (obp->proc != NULL)
+	{
+		if ((size1 > 0 && ! (*obp->proc)(obp->userdata, data1, size1)) ||
+		    (size2 > 0 && ! (*obp->proc)(obp->userdata, data2, size2)))
+			obp->failed = TRUE;
+	}
+	else
+	{
+#ifdef OS_UNIX
+		struct iovec iov[2];
+		int cnt = 0, first = 0;
+		ssize_t written;
+
+		if (size1 > 0)
+		{
+			iov[cnt].iov_base = (void *) data1;
+			iov[cnt++].iov_len = size1;
+		}
+		if (size2 > 0)
+		{
+			iov[cnt].iov_base = (void *) data2;
+			iov[cnt++].iov_len = size2;
+		}
+		while (first < cnt)
+		{
+			written = writev(obp->fd, iov + first, cnt - first);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				obp->failed = TRUE;
+				break;
+			}
+			while (first < cnt && (size_t) written >= iov[first].iov_len)
+			{
+				written -= iov[first].iov_len;
+				first++;
+			}
+			if (first < cnt)
+			{
+				iov[first].iov_base = (char *) iov[first].iov_base + written;
+				iov[first].iov_len -= written;
+			}
+		}
+#else
+		const Nlm_Char PNTR data [2];
+		size_t size [2];
+		int i;
+
+		data [0] = data1;  size [0] = size1;
+		data [1] = data2;  size [1] = size2;
+		for (i = 0; i < 2 && ! obp->failed; i++)
+		{
+			while (size [i] > 0)
+			{
+				int written = write(obp->fd, data [i], (unsigned int) size [i]);
+				if (written <= 0)
+				{
+					obp->failed = TRUE;
+					break;
+				}
+				data [i] += written;
+				size [i] -= written;
+			}
+		}
+#endif
+	}
+
+	return (Nlm_Boolean) ! obp->failed;
+}
+
+/*****************************************************************************
+*
+*   Boolean Nlm_OutBufFlush(obp)
+*      writes out the contents of the buffer
+*
+*****************************************************************************/
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufFlush (Nlm_OutBufPtr obp)
+{
+	Nlm_Boolean retval;
+
+	if (obp == NULL)
+		return FALSE;
+	if (obp->used == 0)
+		return (Nlm_Boolean) ! obp->failed;
+	retval = s_OutBufSend(obp, obp->buf, obp->used, NULL, 0);
+	obp->used = 0;
+	return retval;
+}
+
+/*****************************************************************************
+*
+*   Boolean Nlm_OutBufWrite(obp, data, size)
+*      appends size bytes; data that would not fit is written out together
+*      with the buffer contents without being copied
+*
+*****************************************************************************/
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufWrite (Nlm_OutBufPtr obp, const Nlm_Char PNTR data, size_t size)
+{
+	Nlm_Boolean retval;
+
+	if (obp == NULL || (data == NULL && size > 0))
+		return FALSE;
+
+	if (obp->used + size <= obp->size)
+	{
+		MemCpy(obp->buf + obp->used, data, size);
+		obp->used += size;
+		return (Nlm_Boolean) ! obp->failed;
+	}
+
+	if (size < obp->size / 2)
+	{
+		/* small piece: start a new block with it */
+		retval = Nlm_OutBufFlush(obp);
+		MemCpy(obp->buf, data, size);
+		obp->used = size;
+		return retval;
+	}
+
+	retval = s_OutBufSend(obp, obp->buf, obp->used, data, size);
+	obp->used = 0;
+	return retval;
+}
+
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufPuts (Nlm_OutBufPtr obp, const Nlm_Char PNTR str)
+{
+	if (str == NULL)
+		return FALSE;
+	return Nlm_OutBufWrite(obp, str, StrLen(str));
+}
+
+NLM_EXTERN Nlm_CharPtr LIBCALL Nlm_OutBufReserve (Nlm_OutBufPtr obp, size_t size)
+{
+	if (obp == NULL)
+		return NULL;
+
+	if (obp->used + size > obp->size)
+	{
+		Nlm_OutBufFlush(obp);
+		if (size > obp->size)
+		{
+			Nlm_CharPtr buf = (Nlm_CharPtr) Nlm_MemMore(obp->buf, size);
+			if (buf == NULL)
+				return NULL;
+			obp->buf = buf;
+			obp->size = size;
+		}
+	}
+	if (obp->failed)
+		return NULL;
+	return obp->buf + obp->used;
+}
+
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufPutInt8 (Nlm_OutBufPtr obp, Nlm_Int8 value)
+{
+	Nlm_CharPtr ptr;
+
+	if ((ptr = Nlm_OutBufReserve(obp, OUTBUF_INT8_TEXT_MAX)) == NULL)
+		return FALSE;
+	Nlm_OutBufCommit(obp, Nlm_Int8ToText(value, ptr));
+	return TRUE;
+}
+
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufPutFixed (Nlm_OutBufPtr obp, Nlm_FloatHi value, int precision)
+{
+	Nlm_Char buf [512];   /* enough for any double in %f notation */
+
+	return Nlm_OutBufWrite(obp, buf, Nlm_FloatHiToFixed(value, precision, 0, buf));
+}
+
+/*****************************************************************************
+*
+*   size_t Nlm_Int8ToText(value, buf)
+*      converts two digits per step, from the end of the number
+*
+*****************************************************************************/
+NLM_EXTERN size_t LIBCALL Nlm_Int8ToText (Nlm_Int8 value, Nlm_CharPtr buf)
+{
+	Nlm_Char tmp [OUTBUF_INT8_TEXT_MAX];
+	Nlm_CharPtr ptr = tmp + sizeof(tmp);
+	Nlm_Uint8 u;
+	size_t len;
+
+	u = (value < 0) ? (Nlm_Uint8) 0 - (Nlm_Uint8) value : (Nlm_Uint8) value;
+
+	while (u >= 100)
+	{
+		unsigned int pair = (unsigned int) (u % 100) * 2;
+		u /= 100;
+		*--ptr = digit_pairs [pair + 1];
+		*--ptr = digit_pairs [pair];
+	}
+	if (u >= 10)
+	{
+		*--ptr = digit_pairs [u * 2 + 1];
+		*--ptr = digit_pairs [u * 2];
+	}
+	else
+		*--ptr = (Nlm_Char) ('0' + u);
+	if (value < 0)
+		*--ptr = '-';
+
+	len = tmp + sizeof(tmp) - ptr;
+	MemCpy(buf, ptr, len);
+	buf [len] = '\0';
+	return len;
+}
+
+/*****************************************************************************
+*
+*   size_t Nlm_FloatHiToFixed(value, precision, width, buf)
+*      rounds value * 10^precision to an integer and prints that with a
+*      decimal point inserted; values for which this is not guaranteed to
+*      give the correctly rounded result of printf go through sprintf
+*
+*****************************************************************************/
+NLM_EXTERN size_t LIBCALL Nlm_FloatHiToFixed (Nlm_FloatHi value, int precision, int width, Nlm_CharPtr buf)
+{
+	Nlm_Char digits [OUTBUF_INT8_TEXT_MAX];
+	Nlm_FloatHi scaled, rounded, frac;
+	Nlm_Boolean negative;
+	size_t ndigits, len, intlen, pad;
+	Nlm_CharPtr ptr;
+
+	if (precision >= 0 && precision <= FIXED_PRECISION_MAX && value != 0.0)
+	{
+		negative = (Nlm_Boolean) (value < 0.0);
+		scaled = (negative ? -value : value) * powers_of_ten [precision];
+		if (scaled < FIXED_FAST_MAX)   /* also false for NaN */
+		{
+			rounded = floor(scaled);
+			frac = scaled - rounded;
+			if (frac > 0.5 + FIXED_TIE_MARGIN)
+				rounded += 1.0;
+			else if (frac >= 0.5 - FIXED_TIE_MARGIN)
+				rounded = -1.0;   /* too close to a tie */
+			if (rounded > 0.0 || (rounded == 0.0 && ! negative))
+			{
+				ndigits = Nlm_Int8ToText((Nlm_Int8) rounded, digits);
+				/* at least one digit before the decimal point */
+				intlen = (ndigits > (size_t) precision) ? ndigits - precision : 1;
+				len = (negative ? 1 : 0) + intlen + (precision > 0 ? precision + 1 : 0);
+				pad = (width > 0 && (size_t) width > len) ? width - len : 0;
+
+				ptr = buf;
+				for ( ; pad > 0; pad--)
+					*ptr++ = ' ';
+				if (negative)
+					*ptr++ = '-';
+				if (ndigits > (size_t) precision)
+				{
+					MemCpy(ptr, digits, intlen);
+					ptr += intlen;
+				}
+				else
+					*ptr++ = '0';
+				if (precision > 0)
+				{
+					*ptr++ = '.';
+					if (ndigits < (size_t) precision)
+					{
+						MemSet(ptr, '0', precision - ndigits);
+						ptr += precision - ndigits;
+						MemCpy(ptr, digits, ndigits);
+						ptr += ndigits;
+					}
+					else
+					{
+						MemCpy(ptr, digits + ndigits - precision, precision);
+						ptr += precision;
+					}
+				}
+				*ptr = '\0';
+				return ptr - buf;
+			}
+		}
+	}
+
+	sprintf(buf, "%*.*f", width, precision, value);
+	return StrLen(buf);
+}
@@ -0,0 +1,151 @@
+/*  ncbiobuf.h
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+* File Name:  ncbiobuf.h
+*
+* $Revision: 1.1 $
+*
+* File Description:
+*   OutBuf typedefs, prototypes, and defines
+*
+*   An OutBuf collects report output in one large block and hands it to
+*   a stdio stream, a file descriptor or a caller supplied write function
+*   (e.g. a compressor) only when the block is full.  Pieces larger than
+*   the free space are passed on without being copied.  The text
+*   conversions of integers and fixed point numbers produce exactly what
+*   sprintf("%ld") and sprintf("%*.*f") would.
+*
+* Modifications:
+* --------------------------------------------------------------------------
+* Date     Name        Description of modification
+* -------  ----------  -----------------------------------------------------
+*
+* ==========================================================================
+*/
+
+#ifndef _NCBIOBUF_
+#define _NCBIOBUF_
+
+#undef NLM_EXTERN
+#ifdef NLM_IMPORT
+#define NLM_EXTERN NLM_IMPORT
+#else
+#define NLM_EXTERN extern
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+         /* size of the block used when 0 is passed to the constructors */
+#define OUTBUF_DEFAULT_SIZE 65536
+
+         /* largest text produced by Nlm_Int8ToText, including the '\0' */
+#define OUTBUF_INT8_TEXT_MAX 21
+
+/* Destination of an OutBuf other than a stream or a file descriptor;
+   must write all size bytes and return FALSE on failure */
+typedef Nlm_Boolean (LIBCALLBACK *Nlm_OutBufWriteProc) PROTO((Nlm_VoidPtr userdata, const Nlm_Char PNTR data, size_t size));
+
+typedef struct outbuf {
+	FILE PNTR fp;               /* destination stream, or NULL */
+	int fd;                     /* destination file descriptor, or -1 */
+	Nlm_OutBufWriteProc proc;   /* destination function, or NULL */
+	Nlm_VoidPtr userdata;       /* passed to proc */
+	Nlm_CharPtr buf;            /* the block being filled */
+	size_t size,                /* allocated size of buf */
+		used;                   /* bytes of buf waiting to be written */
+	Nlm_Boolean failed;         /* TRUE once a write has failed */
+} Nlm_OutBuf, PNTR Nlm_OutBufPtr;
+
+NLM_EXTERN Nlm_OutBufPtr LIBCALL Nlm_OutBufNew PROTO((FILE PNTR fp, size_t size));
+NLM_EXTERN Nlm_OutBufPtr LIBCALL Nlm_OutBufNewFd PROTO((int fd, size_t size));
+NLM_EXTERN Nlm_OutBufPtr LIBCALL Nlm_OutBufNewEx PROTO((Nlm_OutBufWriteProc proc, Nlm_VoidPtr userdata, size_t size));
+NLM_EXTERN Nlm_OutBufPtr LIBCALL Nlm_OutBufFree PROTO((Nlm_OutBufPtr obp));
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufFlush PROTO((Nlm_OutBufPtr obp));
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufWrite PROTO((Nlm_OutBufPtr obp, const Nlm_Char PNTR data, size_t size));
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufPuts PROTO((Nlm_OutBufPtr obp, const Nlm_Char PNTR str));
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufPutInt8 PROTO((Nlm_OutBufPtr obp, Nlm_Int8 value));
+NLM_EXTERN Nlm_Boolean LIBCALL Nlm_OutBufPutFixed PROTO((Nlm_OutBufPtr obp, Nlm_FloatHi value, int precision));
+
+/*****************************************************************************
+*
+*   CharPtr OutBufReserve(obp, size)
+*       makes room for at least size bytes at the end of the buffer and
+*       returns a pointer to them, so that text can be formatted in place;
+*       OutBufCommit(obp, n) then adds the n bytes actually produced
+*       returns NULL if out of memory or the buffer could not be flushed
+*
+*****************************************************************************/
+NLM_EXTERN Nlm_CharPtr LIBCALL Nlm_OutBufReserve PROTO((Nlm_OutBufPtr obp, size_t size));
+#define Nlm_OutBufCommit(obp,n) ((obp)->used += (n))
+
+/*****************************************************************************
+*
+*   Text conversions
+*      write the text into buf, '\0'-terminated, and return its length
+*      Int8ToText(value, buf)
+*         same as sprintf("%lld"); buf must hold OUTBUF_INT8_TEXT_MAX bytes
+*      FloatHiToFixed(value, precision, width, buf)
+*         same as sprintf("%*.*f", width, precision, value); falls back on
+*         sprintf only when value is not small enough to be converted
+*         exactly or is too close to a rounding tie to decide quickly
+*
+*****************************************************************************/
+NLM_EXTERN size_t LIBCALL Nlm_Int8ToText PROTO((Nlm_Int8 value, Nlm_CharPtr buf));
+NLM_EXTERN size_t LIBCALL Nlm_FloatHiToFixed PROTO((Nlm_FloatHi value, int precision, int width, Nlm_CharPtr buf));
+
+
+#define OutBuf Nlm_OutBuf
+#define OutBufPtr Nlm_OutBufPtr
+#define OutBufWriteProc Nlm_OutBufWriteProc
+#define OutBufNew Nlm_OutBufNew
+#define OutBufNewFd Nlm_OutBufNewFd
+#define OutBufNewEx Nlm_OutBufNewEx
+#define OutBufFree Nlm_OutBufFree
+#define OutBufFlush Nlm_OutBufFlush
+#define OutBufWrite Nlm_OutBufWrite
+#define OutBufPuts Nlm_OutBufPuts
+#define OutBufPutInt8 Nlm_OutBufPutInt8
+#define OutBufPutFixed Nlm_OutBufPutFixed
+#define OutBufReserve Nlm_OutBufReserve
+#define OutBufCommit Nlm_OutBufCommit
+#define Int8ToText Nlm_Int8ToText
+#define FloatHiToFixed Nlm_FloatHiToFixed
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#undef NLM_EXTERN
+#ifdef NLM_EXPORT
+#define NLM_EXTERN NLM_EXPORT
+#else
+#define NLM_EXTERN
+#endif
+
+#endif
@@ -1438,6 +1438,10 @@ Int2 Main (void)
 
   start_time = GetSecs ();
 
+  /* features are only sorted on bioseqs whose deflines need them */
+
+  SeqMgrSetLazyFeatureIndexing (TRUE);
+
   /* populate parameter structure */
 
   ffd.expand_gaps = expandgaps;
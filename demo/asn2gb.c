@@ -50,6 +50,7 @@
 #include <explore.h>
 #include <gather.h>
 #include <toasn3.h>
+#include <ncbithr.h>
 #include <asn2gnbp.h>
 
 /* asn2gnbi.h needed to test PUBSEQGetAccnVer in accpubseq.c */
@@ -1337,6 +1338,256 @@ static void CheckOrder (
 #endif
 }
 
+/* concurrent report generation for release files (-t 1 with -T) */
+
+typedef struct batchrecord {
+  SeqEntryPtr    sep;
+  CharPtr        text;
+  size_t         len;
+  size_t         size;
+  time_t         elapsed;
+  Char           label [41];
+  TNlmSemaphore  done;
+} BatchRecord, PNTR BatchRecordPtr;
+
+typedef struct batchqueue {
+  BatchRecordPtr  records;
+  Int4            size;
+  Int4            count;
+  Int4            next;
+  TNlmMutex       lock;
+  Int2            numThreads;
+  TNlmThread      PNTR thds;
+  FmtType         format;
+  FmtType         altformat;
+  ModType         mode;
+  StlType         style;
+  FlgType         flags;
+  LckType         locks;
+  CstType         custom;
+  XtraPtr         extra;
+} BatchQueue, PNTR BatchQueuePtr;
+
+#define BATCH_RECORDS_PER_THREAD 8
+
+static BatchQueuePtr BatchQueueNew (
+  Int2 numThreads,
+  FmtType format,
+  FmtType altformat,
+  ModType mode,
+  StlType style,
+  FlgType flags,
+  LckType locks,
+  CstType custom,
+  XtraPtr extra
+)
+
+{
+  BatchQueuePtr  bqp;
+  Int4           i;
+
+  bqp = (BatchQueuePtr) MemNew (sizeof (BatchQueue));
+  if (bqp == NULL) return NULL;
+
+  bqp->size = (Int4) numThreads * BATCH_RECORDS_PER_THREAD;
+  bqp->records = (BatchRecordPtr) MemNew (sizeof (BatchRecord) * bqp->size);
+  bqp->thds = (TNlmThread PNTR) MemNew (sizeof (TNlmThread) * numThreads);
+  if (bqp->records == NULL || bqp->thds == NULL) {
+    MemFree (bqp->records);
+    MemFree (bqp->thds);
+    MemFree (bqp);
+    return NULL;
+  }
+  for (i = 0; i < bqp->size; i++) {
+    bqp->records [i].done = NlmSemaInit (0);
+  }
+
+  bqp->numThreads = numThreads;
+  bqp->format = format;
+  bqp->altformat = altformat;
+  bqp->mode = mode;
+  bqp->style = style;
+  bqp->flags = flags;
+  bqp->locks = locks;
+  bqp->custom = custom;
+  bqp->extra = extra;
+
+  return bqp;
+}
+
+static BatchQueuePtr BatchQueueFree (
+  BatchQueuePtr bqp
+)
+
+{
+  Int4  i;
+
+  if (bqp == NULL) return NULL;
+
+  for (i = 0; i < bqp->size; i++) {
+    NlmSemaDestroy (bqp->records [i].done);
+  }
+  if (bqp->lock != NULL) {
+    NlmMutexDestroy (bqp->lock);
+  }
+  MemFree (bqp->records);
+  MemFree (bqp->thds);
+
+  return (BatchQueuePtr) MemFree (bqp);
+}
+
+/* collects the flatfile text of one record in place of fprintf to the output file */
+
+static void CaptureBatchText (
+  CharPtr str,
+  Pointer userdata,
+  BlockType blocktype,
+  Uint2 entityID,
+  Uint2 itemtype,
+  Uint4 itemID,
+  Int4 left,
+  Int4 right
+)
+
+{
+  BatchRecordPtr  brp;
+  size_t          len;
+  size_t          size;
+  CharPtr         text;
+
+  brp = (BatchRecordPtr) userdata;
+  if (brp == NULL || str == NULL) return;
+  len = StringLen (str);
+  if (len == 0) return;
+
+  if (brp->len + len > brp->size) {
+    size = MAX (2 * brp->size, brp->len + len + 4096);
+    if (brp->text == NULL) {
+      text = (CharPtr) MemNew (size);
+    } else {
+      text = (CharPtr) MemMore (brp->text, size);
+    }
+    if (text == NULL) return;
+    brp->text = text;
+    brp->size = size;
+  }
+  MemCopy (brp->text + brp->len, str, len);
+  brp->len += len;
+}
+
+static VoidPtr FormatBatchProc (
+  VoidPtr arg
+)
+
+{
+  BatchQueuePtr   bqp;
+  BatchRecordPtr  brp;
+  Int4            i;
+  time_t          starttime;
+  XtraBlock       xtra;
+
+  bqp = (BatchQueuePtr) arg;
+  if (bqp == NULL) return NULL;
+
+  for (;;) {
+    NlmMutexLockEx (&(bqp->lock));
+    i = bqp->next;
+    if (i < bqp->count) {
+      (bqp->next)++;
+    }
+    NlmMutexUnlock (bqp->lock);
+    if (i >= bqp->count) break;
+
+    brp = &(bqp->records [i]);
+
+    /* each record gets its own extra block, since it carries the write callback data */
+
+    MemCopy ((Pointer) &xtra, (Pointer) bqp->extra, sizeof (XtraBlock));
+    xtra.ffwrite = CaptureBatchText;
+    xtra.userdata = (Pointer) brp;
+
+    starttime = GetSecs ();
+    SeqEntryToGnbk (brp->sep, NULL, bqp->format, bqp->mode, bqp->style,
+                    bqp->flags, bqp->locks, bqp->custom, &xtra, NULL);
+    if (bqp->altformat != 0) {
+      SeqEntryToGnbk (brp->sep, NULL, bqp->altformat, bqp->mode, bqp->style,
+                      bqp->flags, bqp->locks, bqp->custom, &xtra, NULL);
+    }
+    brp->elapsed = GetSecs () - starttime;
+
+    NlmSemaPost (brp->done);
+  }
+
+  return NULL;
+}
+
+/*
+*  Formats the records read so far on several threads.  Records are read
+*  while no formatting thread is running, since Bioseqs are visible to the
+*  SeqMgr before SeqEntryAsnRead has finished filling them in.  Reports are
+*  written in input order as each one completes, and the records are freed
+*  once all threads are done, followed by the cleanup that serial processing
+*  does after every record.
+*/
+
+static void FormatBatchRecords (
+  BatchQueuePtr bqp,
+  FILE *ofp,
+  Int4Ptr numrecords,
+  time_t PNTR worsttime,
+  CharPtr longest
+)
+
+{
+  BatchRecordPtr  brp;
+  Int2            i;
+  Int4            j;
+  ObjMgrPtr       omp;
+  VoidPtr         status;
+
+  if (bqp == NULL || bqp->count == 0) return;
+
+  bqp->next = 0;
+  NlmMutexInit (&(bqp->lock));
+  for (i = 0; i < bqp->numThreads; i++) {
+    bqp->thds [i] = NlmThreadCreate (FormatBatchProc, (Pointer) bqp);
+  }
+
+  for (j = 0; j < bqp->count; j++) {
+    brp = &(bqp->records [j]);
+    NlmSemaWait (brp->done);
+    if (ofp != NULL && brp->len > 0) {
+      FileWrite (brp->text, sizeof (Char), brp->len, ofp);
+    }
+    brp->text = MemFree (brp->text);
+    brp->len = 0;
+    brp->size = 0;
+    if (brp->elapsed > *worsttime) {
+      *worsttime = brp->elapsed;
+      StringCpy (longest, brp->label);
+    }
+    (*numrecords)++;
+  }
+
+  for (i = 0; i < bqp->numThreads; i++) {
+    NlmThreadJoin (bqp->thds [i], &status);
+  }
+
+  for (j = 0; j < bqp->count; j++) {
+    brp = &(bqp->records [j]);
+    brp->sep = SeqEntryFree (brp->sep);
+  }
+  bqp->count = 0;
+
+  omp = ObjMgrGet ();
+  ObjMgrReapOne (omp);
+  SeqMgrClearBioseqIndex ();
+  ObjMgrFreeCache (0);
+  FreeSeqIdGiCache ();
+
+  SeqEntrySetScope (NULL);
+}
+
 static Int2 HandleMultipleRecords (
   CharPtr inputFile,
   CharPtr outputFile,
@@ -1356,6 +1607,7 @@ static Int2 HandleMultipleRecords (
   CharPtr ffdiff,
   CharPtr asn2flat,
   CharPtr accn,
+  Int2 numThreads,
   FILE *logfp
 )
 
@@ -1364,6 +1616,8 @@ static Int2 HandleMultipleRecords (
   AsnModulePtr    amp;
   AsnTypePtr      atp, atp_bss, atp_desc, atp_sbp, atp_se = NULL, atp_ssp;
   Boolean         atp_se_seen = FALSE;
+  BatchQueuePtr   bqp = NULL;
+  BatchRecordPtr  brp;
   BioseqPtr       bsp;
   BioseqSetPtr    bssp;
   Char            buf [41];
@@ -1540,6 +1794,11 @@ static Int2 HandleMultipleRecords (
   longest [0] = '\0';
   worsttime = 0;
 
+  if (numThreads > 1) {
+    bqp = BatchQueueNew (numThreads, format, altformat, mode, style,
+                         flags, locks, custom, extra);
+  }
+
   while ((! io_failure) && (atp = AsnReadId (aip, amp, atp)) != NULL) {
     if (aip->io_failure) {
       io_failure = TRUE;
@@ -1647,28 +1906,54 @@ static Int2 HandleMultipleRecords (
             }
           }
 
-          starttime = GetSecs ();
-          useFfdiff = (Boolean) (format == GENBANK_FMT && (! hasRefSeq));
-          CompareFlatFiles (path1, path2, path3, sep, ofp,
-                            format, altformat, mode, style, flags, locks,
-                            custom, extra, batch, ffdiff, asn2flat, useFfdiff);
-          stoptime = GetSecs ();
-          if (stoptime - starttime > worsttime) {
-            worsttime = stoptime - starttime;
-            StringCpy (longest, buf);
+          if (bqp != NULL) {
+
+            /* queue record, formatted with the rest of the batch */
+
+            brp = &(bqp->records [bqp->count]);
+            brp->sep = sep;
+            StringCpy (brp->label, buf);
+            (bqp->count)++;
+            sep = NULL;
+
+          } else {
+
+            starttime = GetSecs ();
+            useFfdiff = (Boolean) (format == GENBANK_FMT && (! hasRefSeq));
+            CompareFlatFiles (path1, path2, path3, sep, ofp,
+                              format, altformat, mode, style, flags, locks,
+                              custom, extra, batch, ffdiff, asn2flat, useFfdiff);
+            stoptime = GetSecs ();
+            if (stoptime - starttime > worsttime) {
+              worsttime = stoptime - starttime;
+              StringCpy (longest, buf);
+            }
+            numrecords++;
           }
-          numrecords++;
         }
       }
-      SeqEntryFree (sep);
 
-      omp = ObjMgrGet ();
-      ObjMgrReapOne (omp);
-      SeqMgrClearBioseqIndex ();
-      ObjMgrFreeCache (0);
-      FreeSeqIdGiCache ();
+      if (bqp != NULL) {
 
-      SeqEntrySetScope (NULL);
+        /* global cleanup waits until no queued record is in memory */
+
+        SeqEntryFree (sep);
+        if (bqp->count >= bqp->size) {
+          FormatBatchRecords (bqp, ofp, &numrecords, &worsttime, longest);
+        }
+
+      } else {
+
+        SeqEntryFree (sep);
+
+        omp = ObjMgrGet ();
+        ObjMgrReapOne (omp);
+        SeqMgrClearBioseqIndex ();
+        ObjMgrFreeCache (0);
+        FreeSeqIdGiCache ();
+
+        SeqEntrySetScope (NULL);
+      }
 
     } else if (atp == atp_desc && (! atp_se_seen)) {
       descr = SeqDescrAsnRead (aip, atp);
@@ -1705,6 +1990,11 @@ static Int2 HandleMultipleRecords (
     io_failure = TRUE;
   }
 
+  if (bqp != NULL) {
+    FormatBatchRecords (bqp, ofp, &numrecords, &worsttime, longest);
+    bqp = BatchQueueFree (bqp);
+  }
+
   if (io_failure) {
     Message (MSG_POSTERR, "Asn io_failure for input file '%s'", inputFile);
   }
@@ -2037,6 +2327,7 @@ typedef enum {
   r_argRemote,
   A_argAccession,
   F_argFarFeats,
+  T_argThreads,
 #ifdef OS_UNIX
   q_argFfDiff,
   n_argAsn2Flat,
@@ -2097,6 +2388,8 @@ Args myargs [] = {
     TRUE, 'A', ARG_STRING, 0.0, 0, NULL},
   {"Remote Annotation Fetch Test (use -A Accession,0,-1 instead)", "F", NULL, NULL,
     TRUE, 'F', ARG_BOOLEAN, 0.0, 0, NULL},
+  {"Number of Threads for Batch Report (-t 1)", "1", "1", NULL,
+    TRUE, 'T', ARG_INT, 0.0, 0, NULL},
 #ifdef OS_UNIX
 #ifdef PROC_I80X86
   {"Ffdiff Executable", "ffdiff", NULL, NULL,
@@ -2176,6 +2469,7 @@ Int2 Main (
   CharPtr      str;
   Uint1        strand = Seq_strand_plus;
   StlType      style = NORMAL_STYLE;
+  Int2         threads = 1;
   Int4         to = 0;
   Int2         type = 0;
   Char         xmlbuf [128];
@@ -2455,6 +2749,17 @@ Int2 Main (
 
   extra = &xtra;
 
+  /* release file reports can be formatted on several threads, but not when
+     records are written as GBSeq, fetched remotely, or saved by accession */
+
+  if (myargs [T_argThreads].intvalue > 1 && batch == 1 && (! do_gbseq) &&
+      (! remote) && accn == NULL &&
+      (flags & HTML_XML_ASN_MASK) != CREATE_XML_GBSEQ_FILE &&
+      (flags & HTML_XML_ASN_MASK) != CREATE_ASN_GBSEQ_FILE &&
+      NlmThreadsAvailable ()) {
+    threads = (Int2) myargs [T_argThreads].intvalue;
+  }
+
   starttime = GetSecs ();
 
   if (StringDoesHaveText (accntofetch)) {
@@ -2476,7 +2781,7 @@ Int2 Main (
                                    myargs [o_argOutputFile].strvalue,
                                    format, altformat, mode, style, flags, locks,
                                    custom, extra, type, batch, binary, compressed,
-                                   propOK, ffdiff, asn2flat, accn, logfp);
+                                   propOK, ffdiff, asn2flat, accn, threads, logfp);
   } else if (catenated) {
 
     rsult = HandleCatenatedRecord (myargs [i_argInputFile].strvalue,
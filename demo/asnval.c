@@ -100,6 +100,7 @@ typedef struct valflags {
   Boolean  validateBarcode;
   Int2     verbosity;
   Int2     type;
+  Int2     numThreads;
   Int4     skipcount;
   Int4     maxcount;
   CharPtr  outpath;
@@ -840,6 +841,7 @@ static void DoValidation (
   vsp->rubiscoTest = vfp->rubiscoTest;
   vsp->disableSuppression = vfp->disableSuppression;
   vsp->indexerVersion = vfp->indexerVersion;
+  vsp->numThreads = vfp->numThreads;
 
   if (ofp == NULL && vfp->outfp != NULL) {
     ofp = vfp->outfp;
@@ -1619,6 +1621,7 @@ typedef enum {
   d_argAsnIdx,
   l_argLockFar,
   T_argThreads,
+  t_argNumThreads,
   F_argTestNetwork,
   L_argLogFile,
   K_argSummary,
@@ -1702,6 +1705,8 @@ Args myargs [] = {
     TRUE, 'l', ARG_BOOLEAN, 0.0, 0, NULL},
   {"Use Threads", "F", NULL, NULL,
     TRUE, 'T', ARG_BOOLEAN, 0.0, 0, NULL},
+  {"Number of Threads for Feature Validation", "1", "1", "64",
+    TRUE, 't', ARG_INT, 0.0, 0, NULL},
   {"Test Network Access", "F", NULL, NULL,
     TRUE, 'F', ARG_BOOLEAN, 0.0, 0, NULL},
   {"Log File", NULL, NULL, NULL,
@@ -1944,6 +1949,7 @@ Int2 Main (void)
   vfd.compressed = compressed;
   vfd.lock = lock;
   vfd.useThreads = usethreads;
+  vfd.numThreads = (Int2) myargs [t_argNumThreads].intvalue;
   vfd.type = type;
   vfd.logfp = NULL;
   vfd.num_errors = 0;
@@ -2005,6 +2011,12 @@ Int2 Main (void)
     LocalSeqFetchInit (FALSE);
   }
 
+  /* fetch functions may not be called from several threads at once */
+
+  if (remote || local || indexed) {
+    vfd.numThreads = 1;
+  }
+
   if (indexed) {
     AsnIndexedLibFetchEnable (asnidx, TRUE);
   }
@@ -982,8 +982,9 @@ ARG_FORCE_OLD,
 ARG_COMP_BASED_STATS,
 ARG_SMITH_WATERMAN,
 #ifdef ALLOW_FULL_SMITH_WATERMAN
-ARG_SMITH_WATERMAN_ALL
+ARG_SMITH_WATERMAN_ALL,
 #endif
+ARG_COMPRESSED_LOOKUP
 } BlastArguments;
 
 #define NUMARG (sizeof(myargs)/sizeof(myargs[0]))
@@ -997,8 +998,8 @@ static Args myargs[] = {
       "stdin", NULL, NULL, FALSE, 'i', ARG_FILE_IN, 0.0, 0, NULL}, /* ARG_QUERY */
     { "Expectation value (E)",  
       "10.0", NULL, NULL, FALSE, 'e', ARG_FLOAT, 0.0, 0, NULL},    /* ARG_EVALUE */
-    { "alignment view options:\n0 = pairwise,\n1 = query-anchored showing identities,\n2 = query-anchored no identities,\n3 = flat query-anchored, show identities,\n4 = flat query-anchored, no identities,\n5 = query-anchored no identities and blunt ends,\n6 = flat query-anchored, no identities and blunt ends,\n7 = XML Blast output,\n8 = tabular, \n9 tabular with comment lines\n10 ASN, text\n11 ASN, binary", /* 4 */
-      "0", "0", "11", FALSE, 'm', ARG_INT, 0.0, 0, NULL},         /* ARG_FORMAT */
+    { "alignment view options:\n0 = pairwise,\n1 = query-anchored showing identities,\n2 = query-anchored no identities,\n3 = flat query-anchored, show identities,\n4 = flat query-anchored, no identities,\n5 = query-anchored no identities and blunt ends,\n6 = flat query-anchored, no identities and blunt ends,\n7 = XML Blast output,\n8 = tabular, \n9 tabular with comment lines\n10 ASN, text\n11 ASN, binary\n12 columnar binary, appended to the output file", /* 4 */
+      "0", "0", "12", FALSE, 'm', ARG_INT, 0.0, 0, NULL},         /* ARG_FORMAT */
     { "BLAST report Output File", 
       "stdout", NULL, NULL, TRUE, 'o', ARG_FILE_OUT, 0.0, 0, NULL}, /* ARG_OUT */
     { "Filter query sequence (DUST with blastn, SEG with others)", 
@@ -1131,6 +1132,10 @@ static Args myargs[] = {
     { "Compute only Smith-Waterman alignments (new engine only)",
       "F", NULL, NULL, FALSE, 'h', ARG_BOOLEAN, 0.0, 0, NULL},         /* ARG_SMITH_WATERMAN_ALL */
 #endif
+    { "Allow a compressed alphabet lookup table for large blastp "
+      "searches\n      (faster for large query batches, less sensitive; "
+      "new engine only)",
+      "F", NULL, NULL, FALSE, 'c', ARG_BOOLEAN, 0.0, 0, NULL},         /* ARG_COMPRESSED_LOOKUP */
 };
 
 
@@ -1252,6 +1257,8 @@ s_FillOptions(SBlastOptions* options)
        SBlastOptionsSetWindowSize(options, myargs[ARG_WINDOW].intvalue);
 
    SBlastOptionsSetThreshold(options, myargs[ARG_THRESHOLD].floatvalue);
+   SBlastOptionsSetCompressedLookup(options, 
+                                    myargs[ARG_COMPRESSED_LOOKUP].intvalue);
 
    if (program_number != eBlastTypeTblastx)
       is_gapped = myargs[ARG_GAPPED].intvalue;
@@ -1427,6 +1434,7 @@ Int2 Main_new (void)
    BlastFormattingInfo* asn_format_info = NULL;  /* For ASN.1 output. */  /* For ASN.1 output. */
    Int4 ctr = 1;
    Boolean tabular_output = FALSE;
+   BlastColumnarWriter* columnar = NULL;  /* For columnar output. */
    Blast_SummaryReturn* sum_returns = Blast_SummaryReturnNew();
    Blast_SummaryReturn* full_sum_returns = NULL;
    char* blast_program = myargs[ARG_PROGRAM].strvalue;
@@ -1493,7 +1501,20 @@ Int2 Main_new (void)
    if (myargs[ARG_FORMAT].intvalue == 8 && myargs[ARG_USEMEGABLAST].intvalue)
         tabular_output = TRUE;
 
-   if (!tabular_output) {
+   if (myargs[ARG_FORMAT].intvalue == eAlignViewColumnar) {
+       if (!StringCmp(myargs[ARG_OUT].strvalue, "stdout")) {
+            ErrPostEx(SEV_FATAL, 1, 0, "blast: Columnar output must be "
+                      "written to a file (-o option)\n");
+            return (1);
+       }
+       if ((columnar = BlastColumnarWriterNew(myargs[ARG_OUT].strvalue,
+                                              TRUE)) == NULL) {
+            ErrPostEx(SEV_FATAL, 1, 0, "blast: Unable to open output file %s\n", 
+                myargs[ARG_OUT].strvalue);
+            return (1);
+       }
+   }
+   else if (!tabular_output) {
        Int2 finfo_status = BlastFormattingInfoNew(myargs[ARG_FORMAT].intvalue, options,
                               blast_program, dbname,
                               myargs[ARG_OUT].strvalue, &format_info);
@@ -1550,7 +1571,7 @@ Int2 Main_new (void)
 
    /* Get the query (queries), loop if necessary. */
    while (1) {
-      SBlastSeqalignArray* seqalign_arr=NULL;
+      BlastHSPResults* results = NULL;
       BlastTabularFormatData* tf_data = NULL;
       SeqLoc* lcase_mask = NULL;
       SeqLoc* repeat_mask = NULL; /* Repeat mask locations */
@@ -1665,10 +1686,21 @@ Int2 Main_new (void)
       if (repeat_mask)
           lcase_mask = ValNodeLink(&lcase_mask, repeat_mask);
 
-      status = Blast_DatabaseSearch(query_slp, psi_checkpoint,
-                                    dbname, lcase_mask, options,
-                                    tf_data, &seqalign_arr,
-                                    &filter_loc, sum_returns);
+      if (columnar)
+          status = Blast_DatabaseSearchToColumnar(query_slp, psi_checkpoint,
+                                                  dbname, lcase_mask, options,
+                                                  columnar, &filter_loc,
+                                                  sum_returns);
+      else if (tabular_output)
+          status = Blast_DatabaseSearch(query_slp, psi_checkpoint,
+                                        dbname, lcase_mask, options,
+                                        tf_data, NULL,
+                                        &filter_loc, sum_returns);
+      else
+          status = Blast_DatabaseSearchHSPResults(query_slp, psi_checkpoint,
+                                                  dbname, lcase_mask, options,
+                                                  &results, &filter_loc,
+                                                  sum_returns);
       if (status != 0) {
             /* Jump out if fatal error or unknown reason for exit. */
             if (sum_returns && sum_returns->error)
@@ -1699,24 +1731,26 @@ Int2 Main_new (void)
        /* Post warning or error messages, no matter what the search status was. */
        SBlastMessageErrPost(sum_returns->error);
 
-       if (!status && !tabular_output) {
+       if (!status && !tabular_output && !columnar) {
+           /* The ASN.1 goes to a secondary file, if requested, as each
+              query is formatted. */
+           BlastFormattingInfo* format_infos[2];
+           Int4 num_formats = 0;
 /*   FIXME:
            Int4** ascii_matrix = BlastMatrixConvert(sbp->matrix);
 */
-           if (myargs[ARG_ASNOUT].strvalue) {
-                   /* This just prints out the ASN.1 to a secondary file. */
-                   status = 
-                       BLAST_FormatResults(seqalign_arr, num_queries, query_slp, 
-                                   NULL, asn_format_info, sum_returns);
-           }
-           
+           if (myargs[ARG_ASNOUT].strvalue)
+               format_infos[num_formats++] = asn_format_info;
+           format_infos[num_formats++] = format_info;
+
            /* Format the results */
            status = 
-               BLAST_FormatResults(seqalign_arr, num_queries, query_slp, 
-                                   filter_loc, format_info, sum_returns);
+               BLAST_FormatHSPResults(&results, num_queries, query_slp, NULL,
+                                      filter_loc, format_infos, num_formats,
+                                      sum_returns);
        }
 
-       seqalign_arr = SBlastSeqalignArrayFree(seqalign_arr);
+       results = Blast_HSPResultsFree(results);
        /* Update the cumulative summary returns structure and clean the returns
           substructures for the current search iteration. */
        Blast_SummaryReturnUpdate(sum_returns, &full_sum_returns);
@@ -1734,7 +1768,9 @@ Int2 Main_new (void)
    full_sum_returns = Blast_SummaryReturnFree(full_sum_returns);
    GeneticCodeSingletonFini();
 
-   if (!tabular_output)
+   if (columnar)
+      columnar = BlastColumnarWriterFree(columnar);
+   else if (!tabular_output)
       format_info = BlastFormattingInfoFree(format_info);
    else
    {
@@ -1766,6 +1802,8 @@ Int2 Main_old (void)
  
 {
     AsnIoPtr aip, xml_aip;
+    FILE *xml_fp = NULL;
+    OutBufPtr xml_obuf = NULL;
     BioseqPtr fake_bsp = NULL, query_bsp, bsp;
     BioSourcePtr source;
     BLAST_MatrixPtr matrix;
@@ -1844,6 +1882,12 @@ Int2 Main_old (void)
     }
 
     align_view = (Int1) myargs[ARG_FORMAT].intvalue;
+
+    if (align_view == eAlignViewColumnar) {
+        ErrPostEx(SEV_FATAL, 1, 0, "Columnar output (-m 12) is not "
+                  "available with the old engine (-V T or -l)\n");
+        return (1);
+    }
     outfp = NULL;
     if (align_view != 7 && align_view != 10 && align_view != 11 && blast_outputfile != NULL) {
         if ((outfp = FileOpen(blast_outputfile, "w")) == NULL) {
@@ -2149,7 +2193,13 @@ Int2 Main_old (void)
           fprintf(outfp, "<PRE>\n");
        }
     } else if (align_view == 7 ) {
-        xml_aip = AsnIoOpen(blast_outputfile, "wx");
+        /* XML goes out in large blocks through an OutBuf */
+        if ((xml_fp = FileOpen(blast_outputfile, "w")) == NULL) {
+            ErrPostEx(SEV_FATAL, 1, 0, "blast: Unable to open output file %s\n", blast_outputfile);
+            return (1);
+        }
+        xml_obuf = OutBufNew(xml_fp, 0);
+        xml_aip = AsnIoOutBufOpen("wx", xml_obuf);
     }
 
 #ifndef BLAST_CS_API
@@ -2905,8 +2955,11 @@ Int2 Main_old (void)
         if (html) {
             fprintf(outfp, "</PRE>\n</BODY>\n</HTML>\n");
         }
-    } else if (align_view == 7)
+    } else if (align_view == 7) {
         xml_aip = AsnIoClose(xml_aip);
+        xml_obuf = OutBufFree(xml_obuf);
+        FileClose(xml_fp);
+    }
     
     /* AM: query concatenation. */
     mult_queries = BlastMultQueriesDestruct( mult_queries );
@@ -0,0 +1,198 @@
+/* $Id$
+* ===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's offical duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================*/
+
+/*****************************************************************************
+
+File name: blastcol.c
+
+Contents: Converts columnar BLAST results files (blastall -m 12) to tabular
+          output or to Seq-aligns
+
+******************************************************************************
+ * $Revision: 1.1 $
+ * */
+
+static char const rcsid[] = "$Id$";
+
+#include <ncbi.h>
+#include <objall.h>
+#include <objsset.h>
+#include <readdb.h>
+#include <algo/blast/api/blast_columnar.h>
+#include <algo/blast/api/blast_format.h>
+
+#define NUMARG (sizeof(myargs)/sizeof(myargs[0]))
+
+typedef enum {
+   ARG_INPUT = 0,
+   ARG_OUTPUT,
+   ARG_FORMAT,
+   ARG_DB,
+   ARG_SHOWGIS
+} BlastColArguments;
+
+static Args myargs[] = {
+   { "Columnar BLAST results file",
+     NULL, NULL, NULL, FALSE, 'i', ARG_FILE_IN, 0.0, 0, NULL},  /* ARG_INPUT */
+   { "Output file",
+     "stdout", NULL, NULL, TRUE, 'o', ARG_FILE_OUT, 0.0, 0, NULL}, /* ARG_OUTPUT */
+   { "Output format:\n0 = tabular,\n1 = ASN.1 Seq-annots, text,\n"
+     "2 = ASN.1 Seq-annots, binary",
+     "0", "0", "2", FALSE, 'm', ARG_INT, 0.0, 0, NULL},         /* ARG_FORMAT */
+   { "Database searched; by default the one saved with the results",
+     NULL, NULL, NULL, TRUE, 'd', ARG_STRING, 0.0, 0, NULL},    /* ARG_DB */
+   { "Show GI's in deflines",
+     "F", NULL, NULL, FALSE, 'I', ARG_BOOLEAN, 0.0, 0, NULL},   /* ARG_SHOWGIS */
+};
+
+/** Write the Seq-aligns of one block, one Seq-annot per query.
+ * @param block The block [in]
+ * @param rdfp The database searched [in]
+ * @param aip Where to write [in]
+ * @return 0 on success
+ */
+static Int2
+s_WriteSeqAnnots(const BlastColumnarBlock* block, ReadDBFILE* rdfp,
+                 AsnIo* aip)
+{
+   SBlastSeqalignArray* seqalign_arr = NULL;
+   SeqLoc* query_slp = BlastColumnarBlockGetQuerySeqLocs(block);
+   Boolean db_is_na;
+   Uint1 align_type = GetOldAlignType(block->program, &db_is_na);
+   Int4 query_index;
+   Int2 status;
+
+   status = BlastColumnarBlockToSeqAlign(block, rdfp, query_slp,
+                                         &seqalign_arr);
+
+   for (query_index = 0; status == 0 &&
+           query_index < seqalign_arr->num_queries; ++query_index) {
+      SeqAnnot* seqannot;
+
+      if (seqalign_arr->array[query_index] == NULL)
+         continue;
+      seqannot = SeqAnnotNew();
+      seqannot->type = 2;
+      AddAlignInfoToSeqAnnot(seqannot, align_type);
+      seqannot->data = seqalign_arr->array[query_index];
+      seqalign_arr->array[query_index] = NULL;
+      SeqAnnotAsnWrite(seqannot, aip, NULL);
+      AsnIoReset(aip);
+      seqannot = SeqAnnotFree(seqannot);
+   }
+
+   seqalign_arr = SBlastSeqalignArrayFree(seqalign_arr);
+   FreeSeqLocSetComponents(query_slp);
+   query_slp = SeqLocSetFree(query_slp);
+   return status;
+}
+
+Int2 Main(void)
+{
+   BlastColumnarReader* reader = NULL;
+   BlastColumnarBlock block;
+   ReadDBFILE* rdfp = NULL;
+   char* rdfp_name = NULL;
+   Boolean rdfp_is_prot = FALSE;
+   FILE* outfp = NULL;
+   OutBuf* obuf = NULL;
+   AsnIo* aip = NULL;
+   Int4 format;
+   Int2 status = 0;
+
+   if (! GetArgs ("blastcol", NUMARG, myargs))
+      return (1);
+
+   UseLocalAsnloadDataAndErrMsg ();
+
+   if (! SeqEntryLoad())
+      return 1;
+
+   ErrSetMessageLevel(SEV_WARNING);
+
+   format = myargs[ARG_FORMAT].intvalue;
+
+   if ((reader = BlastColumnarReaderNew(myargs[ARG_INPUT].strvalue)) == NULL)
+      return 1;
+
+   if ((outfp = FileOpen(myargs[ARG_OUTPUT].strvalue,
+                         format == 2 ? "wb" : "w")) == NULL ||
+       (obuf = OutBufNew(outfp, 0)) == NULL ||
+       (format > 0 &&
+        (aip = AsnIoOutBufOpen(format == 2 ? "wb" : "w", obuf)) == NULL)) {
+      ErrPostEx(SEV_FATAL, 1, 0, "Unable to open output file %s",
+                myargs[ARG_OUTPUT].strvalue);
+      return 1;
+   }
+
+   while (status == 0 && BlastColumnarReaderNextBlock(reader, &block)) {
+      const char* db_name = myargs[ARG_DB].strvalue ?
+         myargs[ARG_DB].strvalue : block.db_name;
+      Boolean db_is_prot = Blast_SubjectIsProtein(block.program);
+
+      if (!db_name) {
+         ErrPostEx(SEV_ERROR, 1, 0, "No database name saved with the "
+                   "results; use the -d option");
+         status = 1;
+         break;
+      }
+
+      /* Blocks appended by different searches may be for different
+         databases */
+      if (!rdfp || StringCmp(rdfp_name, db_name) ||
+          rdfp_is_prot != db_is_prot) {
+         rdfp = readdb_destruct(rdfp);
+         rdfp_name = MemFree(rdfp_name);
+         rdfp_name = StringSave(db_name);
+         rdfp_is_prot = db_is_prot;
+         if ((rdfp = readdb_new(rdfp_name, db_is_prot)) == NULL) {
+            ErrPostEx(SEV_ERROR, 1, 0, "Unable to open database %s",
+                      rdfp_name);
+            status = 1;
+            break;
+         }
+      }
+
+      if (format == 0) {
+         status = BlastColumnarBlockPrintTabular(&block, rdfp, obuf,
+                     (Boolean) myargs[ARG_SHOWGIS].intvalue, TRUE);
+      } else {
+         status = s_WriteSeqAnnots(&block, rdfp, aip);
+      }
+   }
+
+   if (aip)
+      AsnIoClose(aip);
+   if (obuf->failed)
+      status = 1;
+   OutBufFree(obuf);
+   FileClose(outfp);
+
+   rdfp = readdb_destruct(rdfp);
+   rdfp_name = MemFree(rdfp_name);
+   reader = BlastColumnarReaderFree(reader);
+
+   return status ? 1 : 0;
+}
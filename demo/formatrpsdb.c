@@ -149,6 +149,7 @@ static char const rcsid[] = "$Id: formatrpsdb.c,v 1.29 2010/10/20 13:09:42 madde
 #include <blfmtutl.h>
 #include <posit.h>
 #include <profiles.h>
+#include <ncbithr.h>
 
 #include <algo/blast/core/blast_options.h>
 #include <algo/blast/core/blast_aalookup.h>
@@ -190,6 +191,7 @@ typedef struct RPS_DbInfo {
     Int4 gap_extend;
     Int4 scale_factor;
     Int4 curr_seq_offset;
+    Int4 num_seqs_added;
     QuerySetUpOptions *query_options;
     LookupTableOptions *lookup_options;
     BlastAaLookupTable *lookup;
@@ -223,6 +225,8 @@ Args dump_args[] = {
       "1", NULL, NULL, TRUE, 'E', ARG_INT, 0.0, 0, NULL},
     {"Underlying score matrix (if not present in the scoremat)",
       "BLOSUM62", NULL, NULL, TRUE, 'U', ARG_STRING, 0.0, 0, NULL},
+    {"Number of threads to use when building the lookup table",
+      "1", "1", NULL, TRUE, 'a', ARG_INT, 0.0, 0, NULL},
 };
 
 enum {
@@ -238,6 +242,7 @@ enum {
     gap_open_arg,
     gap_extend_arg,
     underlying_matrix_arg,
+    num_threads_arg,
     NUMARG               /* must be last */
 };
 
@@ -609,35 +614,318 @@ Int2 RPSUpdatePSSM(RPS_DbInfo *info,
     return 0;
 }
 
-/* Incrementally update the BLAST lookup table with
-   words derived from the present sequence 
-        info contains all the information on data files
-                and parameters from previously added sequences
-        seq is the sequence and PSSM read in from the next data file
-        seq_size is the number of letters in this sequence
+/* The lookup table is built after all the PSSMs have been
+   written, from the finished PSSM file. The profiles are split
+   into runs of consecutive sequences ('chunks'); the word
+   neighborhoods of each chunk go into a private lookup table,
+   and the chunks can be indexed concurrently. The private tables
+   are then merged cell by cell in chunk order, so that every
+   chain of hits is exactly what indexing the profiles one at a
+   time would have produced */
+
+/* Profiles are split into this many chunks per thread, so that
+   a thread that finishes early can pick up more work */
+
+#define RPS_CHUNKS_PER_THREAD 4
+
+typedef struct RPS_LookupChunk {
+    Int4 first_seq;               /* first profile in the chunk */
+    Int4 last_seq;                /* one past the last profile */
+    BlastAaLookupTable *lookup;   /* words of just these profiles */
+} RPS_LookupChunk;
+
+/* Data shared by the threads that build the lookup table */
+
+typedef struct RPS_LookupBuild {
+    RPS_DbInfo *info;
+    Int4 **pssm_rows;             /* one pointer per PSSM column in the
+                                     .rps file */
+    Int4 *seq_offsets;            /* start of each profile in pssm_rows */
+    RPS_LookupChunk *chunks;
+    Int4 num_chunks;
+    Int4 next_chunk;              /* the next chunk to be indexed */
+    TNlmMutex chunk_mutex;        /* protects next_chunk */
+    Int4 num_threads;
+} RPS_LookupBuild;
+
+/* Argument of a thread that merges part of the lookup table */
+
+typedef struct RPS_MergeRange {
+    RPS_LookupBuild *build;
+    Int4 first_cell;
+    Int4 last_cell;
+    Boolean failed;               /* a chain could not be enlarged */
+} RPS_MergeRange;
+
+/* Add the words of one profile to a lookup table
+        lookup is the table to update
+        build contains the PSSM data of all profiles
+        seq_index is the (0-based) position of the profile
 */
-Int2 RPSUpdateLookup(RPS_DbInfo *info, 
-                    PssmWithParameters *seq, 
-                    Int4 seq_size)
+static void RPSIndexProfile(BlastAaLookupTable *lookup,
+                            RPS_LookupBuild *build,
+                            Int4 seq_index)
 {
     BlastSeqLoc *lookup_segment = NULL;
+    Int4 seq_start = build->seq_offsets[seq_index];
+    Int4 seq_size = build->seq_offsets[seq_index + 1] - seq_start - 1;
 
     /* Tell the blast engine to index the entire input
        sequence. Since only the PSSM matters for lookup 
        table creation, the process does not require 
-       actually extracting the sequence data from 'seq'*/
+       actually extracting the sequence data. NULL is
+       passed in place of the query */
 
     BlastSeqLocNew(&lookup_segment, 0, seq_size - 1);
+    BlastAaLookupIndexQuery(lookup, build->pssm_rows + seq_start,
+                            NULL, lookup_segment, seq_start);
+    BlastSeqLocFree(lookup_segment);
+}
 
-    /* add this sequence to the lookup table. NULL
-       is passed in place of the query */
+/* Thread that indexes chunks of profiles until none are left */
 
-    BlastAaLookupIndexQuery(info->lookup, info->posMatrix,
-                                  NULL, lookup_segment,
-                                  info->curr_seq_offset);
+static VoidPtr RPSIndexChunksThread(VoidPtr data)
+{
+    RPS_LookupBuild *build = (RPS_LookupBuild *)data;
+    RPS_LookupChunk *chunk;
+    Int4 i;
 
-    BlastSeqLocFree(lookup_segment);
-    return 0;
+    for (;;) {
+        NlmMutexLockEx(&build->chunk_mutex);
+        chunk = NULL;
+        if (build->next_chunk < build->num_chunks)
+            chunk = build->chunks + build->next_chunk++;
+        NlmMutexUnlock(build->chunk_mutex);
+        if (chunk == NULL)
+            break;
+
+        if (BlastAaLookupTableNew(build->info->lookup_options,
+                                  &chunk->lookup) != 0)
+            break;
+        chunk->lookup->use_pssm = TRUE;
+        for (i = chunk->first_seq; i < chunk->last_seq; i++)
+            RPSIndexProfile(chunk->lookup, build, i);
+    }
+    return NULL;
+}
+
+/* Thread that appends the hits of all chunks to a range of
+   cells of the final lookup table, in chunk order */
+
+static VoidPtr RPSMergeChunksThread(VoidPtr data)
+{
+    RPS_MergeRange *range = (RPS_MergeRange *)data;
+    RPS_LookupBuild *build = range->build;
+    Int4 **backbone = build->info->lookup->thin_backbone;
+    Int4 cell, i;
+
+    for (cell = range->first_cell; cell < range->last_cell; cell++) {
+        for (i = 0; i < build->num_chunks; i++) {
+            Int4 **chunk_backbone = build->chunks[i].lookup->thin_backbone;
+            Int4 *src = chunk_backbone[cell];
+            Int4 *dest = backbone[cell];
+
+            if (src == NULL)
+                continue;
+
+            if (dest == NULL) {
+                /* the first chain for this cell is taken over as is */
+                backbone[cell] = src;
+            }
+            else {
+                Int4 chain_size = dest[0];
+                while (chain_size < dest[1] + src[1] + 2)
+                    chain_size *= 2;
+                if (chain_size != dest[0]) {
+                    dest = (Int4 *)realloc(dest, chain_size * sizeof(Int4));
+                    if (dest == NULL) {
+                        /* the chains not merged yet are still owned
+                           by their chunk, and freed with it */
+                        range->failed = TRUE;
+                        return NULL;
+                    }
+                    dest[0] = chain_size;
+                    backbone[cell] = dest;
+                }
+                memcpy(dest + dest[1] + 2, src + 2, src[1] * sizeof(Int4));
+                dest[1] += src[1];
+                sfree(src);
+            }
+            chunk_backbone[cell] = NULL;
+        }
+    }
+    return NULL;
+}
+
+/* Run a thread function on num_threads threads, each with its
+   own argument, or serially if threads are not available */
+
+static void RPSRunThreads(Int4 num_threads, TNlmThreadStart func,
+                          VoidPtr args, size_t arg_size)
+{
+    TNlmThread *thread_array;
+    Int4 i;
+
+    if (num_threads > 1 && NlmThreadsAvailable()) {
+        thread_array = (TNlmThread *)MemNew(num_threads * sizeof(TNlmThread));
+        for (i = 0; i < num_threads; i++) {
+            thread_array[i] = NlmThreadCreate(func, 
+                                       (VoidPtr)((char *)args + i * arg_size));
+            if (thread_array[i] == NULL_thread) {
+                /* do the work of this thread here instead */
+                ErrPostEx(SEV_WARNING, 0, 0, "Failure to create thread");
+                func((VoidPtr)((char *)args + i * arg_size));
+            }
+        }
+        for (i = 0; i < num_threads; i++) {
+            if (thread_array[i] != NULL_thread)
+                NlmThreadJoin(thread_array[i], NULL);
+        }
+        MemFree(thread_array);
+    }
+    else {
+        for (i = 0; i < num_threads; i++)
+            func((VoidPtr)((char *)args + i * arg_size));
+    }
+}
+
+/* Log the throughput of one stage of the database build */
+
+static void RPSLogStage(const char *stage, Nlm_StopWatchPtr timer,
+                        Int4 num_seqs, Int4 num_letters)
+{
+    Nlm_FloatHi seconds;
+
+    StopWatchStop(timer);
+    seconds = GetElapsedTime(timer);
+    ErrLogPrintf("%s: %ld profiles, %ld letters in %.2f s",
+                 stage, (long)num_seqs, (long)num_letters, seconds);
+    if (seconds > 0)
+        ErrLogPrintf(" (%.0f letters/s)", num_letters / seconds);
+    ErrLogPrintf("\n");
+    StopWatchStart(timer);
+}
+
+/* Fill the BLAST lookup table with the words of all the
+   profiles in the (already complete) PSSM file
+        info contains all the information on data files
+                and parameters from previously added sequences
+        timer measures each stage of the build
+*/
+static Int2 RPSBuildLookup(RPS_DbInfo *info, Nlm_StopWatchPtr timer)
+{
+    RPS_LookupBuild build;
+    RPS_MergeRange *ranges;
+    Nlm_MemMapPtr pssm_mmap;
+    Int4 *pssm_start;
+    Int4 num_pssm_rows, num_letters;
+    Int2 status = 0;
+    Int4 num_threads = MAX(dump_args[num_threads_arg].intvalue, 1);
+    Int4 i, seq;
+
+    if (info->num_seqs_added == 0)
+        return 1;
+
+    memset(&build, 0, sizeof(build));
+    build.info = info;
+
+    /* Map the PSSM file, and find the start of each PSSM column
+       in it, the way RPS blast does when it searches */
+
+    fflush(info->pssm_fd);
+    pssm_mmap = Nlm_MemMapInit(info->pssm_file);
+    if (pssm_mmap == NULL) {
+        ErrPostEx(SEV_ERROR, 0, 0, "Cannot map %s", info->pssm_file);
+        return 1;
+    }
+    build.seq_offsets = ((BlastRPSProfileHeader *)pssm_mmap->mmp_begin)
+                                                        ->start_offsets;
+    num_pssm_rows = info->curr_seq_offset;
+    pssm_start = build.seq_offsets + info->num_seqs + 1;
+    build.pssm_rows = (Int4 **)MemNew((num_pssm_rows + 1) * sizeof(Int4 *));
+    for (i = 0; i < num_pssm_rows + 1; i++) {
+        build.pssm_rows[i] = pssm_start;
+        pssm_start += BLASTAA_SIZE;
+    }
+
+    /* Split the profiles into chunks of about the same number
+       of letters */
+
+    build.num_threads = num_threads;
+    build.num_chunks = MIN(num_threads * RPS_CHUNKS_PER_THREAD, 
+                           info->num_seqs_added);
+    build.chunks = (RPS_LookupChunk *)MemNew(build.num_chunks * 
+                                             sizeof(RPS_LookupChunk));
+    for (i = seq = 0; i < build.num_chunks; i++) {
+        Int4 chunk_end = (Int4)((Int8)num_pssm_rows * (i + 1) / 
+                                build.num_chunks);
+        build.chunks[i].first_seq = seq;
+        while (seq < info->num_seqs_added &&
+               (seq == build.chunks[i].first_seq ||
+                build.seq_offsets[seq + 1] <= chunk_end))
+            seq++;
+        build.chunks[i].last_seq = seq;
+    }
+    build.chunks[build.num_chunks - 1].last_seq = info->num_seqs_added;
+
+    /* Compute the word neighborhoods of all the chunks */
+
+    NlmMutexInit(&build.chunk_mutex);
+    RPSRunThreads(num_threads, RPSIndexChunksThread, &build, 0);
+    NlmMutexDestroy(build.chunk_mutex);
+
+    for (i = 0; i < build.num_chunks; i++) {
+        if (build.chunks[i].lookup == NULL) {
+            ErrPostEx(SEV_ERROR, 0, 0, "Cannot allocate lookup table");
+            status = 1;
+            goto cleanup;
+        }
+    }
+    num_letters = num_pssm_rows - info->num_seqs_added;
+    RPSLogStage("Word neighborhoods", timer, 
+                info->num_seqs_added, num_letters);
+
+    /* Merge the chunks; each thread handles a range of cells */
+
+    ranges = (RPS_MergeRange *)MemNew(num_threads * sizeof(RPS_MergeRange));
+    for (i = 0; i < num_threads; i++) {
+        ranges[i].build = &build;
+        ranges[i].first_cell = (Int4)((Int8)info->lookup->backbone_size * 
+                                      i / num_threads);
+        ranges[i].last_cell = (Int4)((Int8)info->lookup->backbone_size * 
+                                     (i + 1) / num_threads);
+    }
+    RPSRunThreads(num_threads, RPSMergeChunksThread, ranges, 
+                  sizeof(RPS_MergeRange));
+    for (i = 0; i < num_threads; i++) {
+        if (ranges[i].failed)
+            status = 1;
+    }
+    MemFree(ranges);
+    if (status != 0) {
+        ErrPostEx(SEV_ERROR, 0, 0, "Cannot allocate lookup table");
+        goto cleanup;
+    }
+    RPSLogStage("Merge", timer, info->num_seqs_added, num_letters);
+
+    /* The chains now belong to the final lookup table */
+
+cleanup:
+    for (i = 0; i < build.num_chunks; i++) {
+        BlastAaLookupTable *lookup = build.chunks[i].lookup;
+        Int4 cell;
+
+        if (lookup == NULL)
+            continue;
+        for (cell = 0; cell < lookup->backbone_size; cell++)
+            sfree(lookup->thin_backbone[cell]);
+        sfree(lookup->thin_backbone);
+        BlastAaLookupTableDestruct(lookup);
+    }
+    MemFree(build.chunks);
+    MemFree(build.pssm_rows);
+    Nlm_MemMapFini(pssm_mmap);
+    return status;
 }
 
 /* The first sequence in the list determines several
@@ -881,17 +1169,12 @@ Int2 RPSAddSequence(RPS_DbInfo *info,
         return 1;
     }
 
-    /* Add this sequence' PSSM to the PSSM file. Also keep 
-       the PSSM in memory for use with indexing */
+    /* Add this sequence' PSSM to the PSSM file. The sequence
+       is indexed later, once all the PSSMs are on disk */
 
     if (RPSUpdatePSSM(info, seq, seq_index, seq_size, alphabet_size) != 0)
         return 1;
 
-    /* index this sequence, add it to the lookup table */
-
-    if (RPSUpdateLookup(info, seq, seq_size) != 0)
-        return 1;
-
     /* Write the sequence size and the Karlin k value to the .aux file */
 
     fprintf(info->aux_fd, "%d\n", seq_size);
@@ -902,6 +1185,7 @@ Int2 RPSAddSequence(RPS_DbInfo *info,
        must include the trailing sentinel */
 
     info->curr_seq_offset += (seq_size + 1); 
+    info->num_seqs_added++;
     if (info->posMatrix != NULL) {
         for (i = 0; i < seq_size + 1; i++)
             MemFree(info->posMatrix[i]);
@@ -933,7 +1217,7 @@ size_t FileWriteInChunks(const void* ptr, size_t size, size_t n, FILE* stream)
    final setup on the BLAST lookup table and finish
    up the RPS files */
 
-void RPS_DbClose(RPS_DbInfo *info)
+void RPS_DbClose(RPS_DbInfo *info, Nlm_StopWatchPtr timer)
 {
     /* Write the last context offset to the PSSM file. 
        This is the total number of letters for all RPS
@@ -943,9 +1227,22 @@ void RPS_DbClose(RPS_DbInfo *info)
                         (info->num_seqs - 1) * sizeof(Int4), SEEK_SET);
     FileWrite(&info->curr_seq_offset, sizeof(Int4), 1, info->pssm_fd);
 
-    /* Pack the lookup table into its compressed form */
+    /* If the input stopped early, the end of the last profile
+       added was never written; the lookup table build needs it */
 
-    if (BlastAaLookupFinalize(info->lookup, eBackbone) != 0) {
+    if (info->num_seqs_added > 0 && info->num_seqs_added < info->num_seqs) {
+        fseek(info->pssm_fd, sizeof(BlastRPSProfileHeader) + 
+                       (info->num_seqs_added - 1) * sizeof(Int4), SEEK_SET);
+        FileWrite(&info->curr_seq_offset, sizeof(Int4), 1, info->pssm_fd);
+    }
+
+    /* Index all the sequences, then pack the lookup table 
+       into its compressed form */
+
+    if (RPSBuildLookup(info, timer) != 0) {
+        ErrPostEx(SEV_WARNING, 0, 0, "Failed to build lookup table");
+    }
+    else if (BlastAaLookupFinalize(info->lookup, eBackbone) != 0) {
         ErrPostEx(SEV_WARNING, 0, 0, "Failed to compress lookup table");
     }
     else {
@@ -1026,6 +1323,9 @@ void RPS_DbClose(RPS_DbInfo *info)
         /* write the new overflow array */
 
         FileWriteInChunks(lut->overflow, sizeof(Int4), cursor, info->lookup_fd);
+        fflush(info->lookup_fd);
+        RPSLogStage("Lookup table packing", timer, info->num_seqs_added,
+                    info->curr_seq_offset - info->num_seqs_added);
     }
 
     /* Free data, close files */
@@ -1057,6 +1357,7 @@ Int2 Main(void)
     Int4 num_files;
     Int4 index;
     RPS_DbInfo rps_info;
+    Nlm_StopWatchPtr timer;
     
     /* get arguments */
     StringCpy(buf, "formatrpsdb ");
@@ -1122,6 +1423,7 @@ Int2 Main(void)
     /* Initialize the RPS structure */
 
     RPS_DbInfoInit(&rps_info, num_files, output_dbname);
+    timer = StopWatchStart(StopWatchNew());
 
     /* Walk through each file in the list, recover the
        scoremat from it, add the enclosed Bioseq to the 
@@ -1187,7 +1489,11 @@ Int2 Main(void)
 
     ValNodeFreeData(file_list);
 
-    RPS_DbClose(&rps_info);
+    RPSLogStage("Scoremats read and PSSMs written", timer, 
+                rps_info.num_seqs_added, 
+                rps_info.curr_seq_offset - rps_info.num_seqs_added);
+    RPS_DbClose(&rps_info, timer);
+    StopWatchFree(timer);
 
     if(FormatDBClose(fdbp))
         return 4;
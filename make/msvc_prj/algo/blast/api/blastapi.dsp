@@ -58,6 +58,10 @@ SOURCE=..\..\..\..\..\algo\blast\api\blast_api.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\..\..\..\algo\blast\api\blast_columnar.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\..\..\..\algo\blast\api\blast_format.c
 # End Source File
 # Begin Source File
@@ -130,6 +134,10 @@ SOURCE=..\..\..\..\..\algo\blast\api\blast_api.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\..\..\..\algo\blast\api\blast_columnar.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\..\..\..\algo\blast\api\blast_format.h
 # End Source File
 # Begin Source File
@@ -194,6 +194,10 @@ SOURCE=..\..\..\..\..\algo\blast\core\hspfilter_collector.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\..\..\..\algo\blast\core\blast_memarena.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\..\..\..\algo\blast\core\index_ungapped.c
 # End Source File
 # Begin Source File
@@ -399,6 +403,10 @@ SOURCE=..\..\..\..\..\algo\blast\core\hspfilter_collector.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\..\..\..\algo\blast\core\blast_memarena.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\..\..\..\algo\blast\core\index_ungapped.h
 # End Source File
 # Begin Source File
@@ -259,6 +259,10 @@ SOURCE=..\..\..\..\corelib\ncbibs.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\..\..\corelib\ncbiobuf.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\..\..\corelib\ncbienv.c
 # End Source File
 # Begin Source File
@@ -501,6 +505,10 @@ SOURCE=..\..\..\..\corelib\ncbibs.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\..\..\corelib\ncbiobuf.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\..\..\corelib\ncbienv.h
 # End Source File
 # Begin Source File
@@ -6,8 +6,8 @@ NCBI_MAKE_SHELL = /bin/sh
 NCBI_AR=ar
 NCBI_CC = gcc -pipe -D_GNU_SOURCE
 NCBI_CFLAGS1 = -c -fPIC
-NCBI_LDFLAGS1 = -s -DNDEBUG -O3 -mavx2 -ffast-math -fPIC
-NCBI_OPTFLAG = -O3 -mavx2 -ffast-math
+NCBI_LDFLAGS1 = -s -DNDEBUG -O3 -mavx2 -ffast-math -fopenmp -fPIC
+NCBI_OPTFLAG = -O3 -mavx2 -ffast-math -fopenmp
 NCBI_BIN_MASTER = /home/coremake/ncbi/bin
 NCBI_BIN_COPY = /home/coremake/ncbi/bin
 NCBI_INCDIR = /home/coremake/ncbi/include
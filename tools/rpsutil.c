@@ -471,6 +471,10 @@ RPSInfoPtr RPSInitEx(CharPtr dbname, Int4 query_is_prot, BLAST_OptionsBlkPtr bla
         }
     }
     
+    /* Only the profiles hit by a query are read; read-ahead would
+       only evict pages that other searches share */
+    Nlm_MemMapAdvisePtr(rpsinfo->mmMatrix, eMMA_Random);
+
     rpsinfo->matrixCount = header[1];
     
     rpsinfo->offsets = header + 2; /* Strarting from 3rd integer */